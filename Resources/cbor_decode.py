@@ -0,0 +1,154 @@
+# coding=utf-8
+#
+# cbor_decode.py - decode g2core CBOR output ($jb=1) back to JSON
+#
+# Reads a raw capture of the controller's output stream (e.g. cat /dev/ttyACM0 > capture.bin)
+# from a file or stdin. Binary frames start with the CBOR self-describe tag D9 D9 F7;
+# anything else is passed through as a line of text (exception reports are still JSON text).
+#
+# Status reports are keyed by cfgArray index. The controller sends an {"srk":{token:index}}
+# map ahead of them, which is used here to turn the indexes back into tokens.
+#
+#   python3 cbor_decode.py capture.bin              print each frame as JSON
+#   python3 cbor_decode.py --stats capture.bin      also compare bytes per report with JSON text
+#
+# The JSON sizes in --stats are what json_serialize() would have sent for the same values,
+# with floats printed at 3 decimals (the default precision for positions).
+
+import json
+import struct
+import sys
+
+FRAME_TAG = b'\xd9\xd9\xf7'
+BREAK = object()
+
+
+class Decoder(object):
+    def __init__(self, data, pos):
+        self.data = data
+        self.pos = pos
+
+    def _byte(self):
+        b = self.data[self.pos]
+        self.pos += 1
+        return b
+
+    def _uint(self, info):
+        if info < 24:
+            return info
+        size = {24: 1, 25: 2, 26: 4, 27: 8}[info]
+        value = int.from_bytes(self.data[self.pos:self.pos + size], 'big')
+        self.pos += size
+        return value
+
+    def item(self):
+        initial = self._byte()
+        major, info = initial >> 5, initial & 0x1f
+        if initial == 0xff:
+            return BREAK
+        if major == 0:
+            return self._uint(info)
+        if major == 1:
+            return -1 - self._uint(info)
+        if major == 3:
+            length = self._uint(info)
+            text = self.data[self.pos:self.pos + length].decode('ascii')
+            self.pos += length
+            return text
+        if major == 4:
+            items = []
+            while True:
+                value = self.item()
+                if value is BREAK:
+                    return items
+                items.append(value)
+        if major == 5:
+            pairs = []
+            while True:
+                key = self.item()
+                if key is BREAK:
+                    return pairs
+                pairs.append((key, self.item()))
+        if initial == 0xf4:
+            return False
+        if initial == 0xf5:
+            return True
+        if initial == 0xf6:
+            return None
+        if initial == 0xfa:
+            value = struct.unpack('>f', self.data[self.pos:self.pos + 4])[0]
+            self.pos += 4
+            return value
+        raise ValueError('unsupported CBOR initial byte 0x%02x at %d' % (initial, self.pos - 1))
+
+
+def to_json(pairs, keys):
+    obj = {}
+    for key, value in pairs:
+        if isinstance(key, int):
+            key = keys.get(key, str(key))
+        if isinstance(value, list) and value and isinstance(value[0], tuple):
+            value = to_json(value, keys)
+        elif isinstance(value, list) and not value:
+            value = {}
+        obj[key] = value
+    return obj
+
+
+def json_text_length(obj):
+    def rounded(value):
+        if isinstance(value, dict):
+            return {k: rounded(v) for k, v in value.items()}
+        if isinstance(value, float):
+            return round(value, 3)
+        return value
+    return len(json.dumps(rounded(obj), separators=(',', ':'))) + 1     # + newline
+
+
+def frames(data):
+    pos = 0
+    while pos < len(data):
+        if data.startswith(FRAME_TAG, pos):
+            decoder = Decoder(data, pos + len(FRAME_TAG))
+            value = decoder.item()
+            yield 'cbor', value, decoder.pos - pos
+            pos = decoder.pos
+        else:
+            end = data.find(b'\n', pos)
+            tag = data.find(FRAME_TAG, pos)
+            if end < 0 or (0 <= tag < end):
+                end = tag if tag >= 0 else len(data)
+            else:
+                end += 1
+            yield 'text', data[pos:end].decode('ascii', 'replace'), end - pos
+            pos = end
+
+
+def main(args):
+    stats = '--stats' in args
+    args = [a for a in args if a != '--stats']
+    data = open(args[0], 'rb').read() if args else sys.stdin.buffer.read()
+
+    keys = {}
+    reports = binary_bytes = json_bytes = 0
+    for kind, value, length in frames(data):
+        if kind == 'text':
+            sys.stdout.write(value)
+            continue
+        obj = to_json(value, keys)
+        if 'srk' in obj:
+            keys = {index: token for token, index in obj['srk'].items()}
+        if 'sr' in obj:
+            reports += 1
+            binary_bytes += length
+            json_bytes += json_text_length(obj)
+        print(json.dumps(obj, separators=(',', ':')))
+
+    if stats and reports:
+        print('%d status reports: %.1f bytes/report CBOR, %.1f bytes/report JSON (%.0f%%)' % (
+            reports, binary_bytes / float(reports), json_bytes / float(reports),
+            100.0 * binary_bytes / json_bytes))
+
+
+if __name__ == '__main__':
+    main(sys.argv[1:])
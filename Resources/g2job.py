@@ -0,0 +1,400 @@
+# coding=utf-8
+#
+# g2job.py - make a pre-parsed (binary) job from a Gcode program
+#
+# Does the work the controller's Gcode parser would do for each block - normalization, word
+# and number parsing, modal state tracking and inch to mm conversion - and writes the result
+# as a stream of canonical machine operations that g2core runs directly (see g2core/job.h).
+# Blocks that don't reduce to the operations in the format (tool changes, offsets, probing,
+# homing, G53...) are written as Gcode text records and run through the parser as usual,
+# prefixed with the units and distance modes in effect so they mean what they meant.
+#
+#   python3 g2job.py program.nc job.g2j             write the job
+#   python3 g2job.py --inches program.nc job.g2j    the program assumes G20 until it says otherwise
+#   python3 g2job.py --stats program.nc job.g2j     also compare the job with the Gcode text
+#   python3 g2job.py --list job.g2j                 print the records of a job
+#
+# Like sending the text, the job assumes the controller starts in G21 (or G20 with --inches),
+# G90, G91.1, G94 and G17. Programs normally set these in their preamble anyway.
+
+import re
+import struct
+import sys
+
+JOB_MAGIC = 0x424A3247          # "G2JB"
+JOB_VERSION = 1
+HEADER = struct.Struct('<IBBHII')
+
+(JOB_END, JOB_LINE, JOB_TRAVERSE, JOB_FEED, JOB_ARC, JOB_DWELL,
+ JOB_SPINDLE, JOB_COOLANT, JOB_JSON, JOB_GCODE, JOB_STOP) = range(11)
+OP_NAMES = ['end', 'line', 'traverse', 'feed', 'arc', 'dwell', 'spindle', 'coolant', 'json', 'gcode', 'stop']
+
+MODE_INCREMENTAL = 0x01
+MODE_ARC_ABSOLUTE = 0x02
+MODE_INVERSE_TIME = 0x04
+MODE_FEED = 0x08
+MODE_CCW = 0x10
+MODE_RADIUS = 0x20
+MODE_TURNS = 0x40
+MODE_MOTION_WORD = 0x80
+
+SPINDLE_SPEED = 0x01
+SPINDLE_CONTROL = 0x02
+
+SPINDLE_OFF, SPINDLE_CW, SPINDLE_CCW = 0, 1, 2
+COOLANT_OFF, COOLANT_ON = 0, 1
+COOLANT_MIST, COOLANT_FLOOD, COOLANT_BOTH = 1, 2, 3
+PROGRAM_STOP, PROGRAM_END = 0, 1
+
+AXES = 'XYZUVWABC'              # bit order of the axes field (cmAxes)
+LINEAR = 'XYZUVWIJKR'           # words converted to mm
+MM_PER_INCH = 25.4
+
+# G and M codes (times 10) that reduce to records. Anything else is sent as text.
+G_CODES = {0, 10, 20, 30, 40, 170, 180, 190, 200, 210, 900, 910, 901, 911, 930, 940}
+CANNED_CYCLES = set(range(810, 900, 10))     # G81-G89 - expanded by the firmware, so sent as text
+M_CODES = {0, 10, 20, 30, 40, 50, 70, 80, 90, 300, 600, 1000}
+WORD_LETTERS = set('NGMFSPRIJK' + AXES)
+
+WORD = re.compile(r'([A-Z])(-?(?:[0-9]+\.?[0-9]*|\.[0-9]+))')
+
+
+# Normalization - the same rules as _lex_gcode_block() in gcode_parser.cpp
+
+def _lex_comment(line, i, ac):
+    i += 1                                      # skip the '('
+    in_msg = False
+    if line[i:i + 3].lower() == 'msg':
+        i += 3
+        if line[i:i + 1] == ' ':
+            i += 1
+        if ac and ac[-1] == '}':
+            ac[-1] = ','
+        else:
+            ac.append('{')
+        ac.extend('msg:"')
+        in_msg = True
+    elif line[i:i + 1] == '{':
+        if ac and ac[-1] == '}':                # merge json comments
+            ac[-1] = ','
+            i += 1
+    else:                                       # plain comment - discard it
+        while i < len(line) and line[i] != ')':
+            i += 1
+        return i
+
+    in_string = escaped = False
+    while i < len(line):
+        c = line[i]
+        if in_string and c == '\\':
+            escaped = True
+        elif not escaped and c == '"':
+            if in_msg:
+                ac.append('\\')
+            else:
+                in_string = not in_string
+        elif not in_string and c == ')':
+            if in_msg:
+                ac.extend('"}')
+            break
+        else:
+            escaped = False
+        if in_string or in_msg or c != ' ':
+            ac.append(c)
+        i += 1
+    return i
+
+
+def normalize(line):
+    """Returns the normalized block, the active comment and the block delete flag"""
+    block, ac = [], []
+    i = 0
+    block_delete = line.startswith('/')
+    if block_delete:
+        i = 1
+    last_char_was_digit = False
+    while i < len(line):
+        c = line[i]
+        if c in ';%\0':
+            break
+        if c == '(':
+            i = _lex_comment(line, i, ac)
+            if i >= len(line):
+                break
+        elif ('A' <= c <= 'Z') or ('a' <= c <= 'z'):
+            block.append(c.upper())
+            last_char_was_digit = False
+        elif ('0' <= c <= '9') or c == '.':
+            following = line[i + 1:i + 2]
+            if last_char_was_digit or c != '0' or not ('0' <= following <= '9' and following != ''):
+                block.append(c)
+            last_char_was_digit = True
+        elif c == '-':
+            block.append(c)
+            last_char_was_digit = False
+        i += 1
+    return ''.join(block), ''.join(ac), block_delete
+
+
+def words(block):
+    """Returns [(letter, text)] or None if the block isn't all well formed words"""
+    found = []
+    pos = 0
+    while pos < len(block):
+        match = WORD.match(block, pos)
+        if not match:
+            return None
+        found.append((match.group(1), match.group(2)))
+        pos = match.end()
+    return found
+
+
+def code(text):
+    return int(round(float(text) * 10))         # G90.1 -> 901
+
+
+# Records
+
+def _f32(value):
+    return struct.pack('<f', value)
+
+
+def record(op, payload):
+    return bytes([op, len(payload)]) + payload
+
+
+def text_record(op, text):
+    payload = text.encode('ascii') + b'\0'
+    if len(payload) > 255:
+        raise ValueError('block too long for a text record: ' + text)
+    return record(op, payload)
+
+
+class Encoder(object):
+    def __init__(self, inches=False):
+        self.inches = inches
+        self.incremental = False
+        self.arc_absolute = False
+        self.inverse_time = False
+        self.plane = 0
+        self.motion = None                      # 0, 10, 20, 30, 50, 51, 810-890 or None for G80 / unknown
+        self.records = []
+        self.compiled = self.text = 0
+
+    def _mm(self, letter, value):
+        return value * MM_PER_INCH if (self.inches and letter in LINEAR) else value
+
+    def _modes(self):
+        return ((MODE_INCREMENTAL if self.incremental else 0) |
+                (MODE_ARC_ABSOLUTE if self.arc_absolute else 0) |
+                (MODE_INVERSE_TIME if self.inverse_time else 0))
+
+    def _apply_modal(self, g):
+        if g in (0, 10, 20, 30, 50, 51) or g in CANNED_CYCLES:
+            self.motion = g
+        elif g == 800:
+            self.motion = None
+        elif g in (170, 180, 190):
+            self.plane = (g - 170) // 10
+        elif g in (200, 210):
+            self.inches = (g == 200)
+        elif g in (900, 910):
+            self.incremental = (g == 910)
+        elif g in (901, 911):
+            self.arc_absolute = (g == 901)
+        elif g in (930, 940):
+            self.inverse_time = (g == 930)
+
+    def modes_text(self):
+        return '%s%s%s%s%s%s' % ('G20' if self.inches else 'G21', 'G91' if self.incremental else 'G90',
+                                 ('G17', 'G18', 'G19')[self.plane], 'G90.1' if self.arc_absolute else 'G91.1',
+                                 'G93' if self.inverse_time else 'G94', 'G80' if self.motion is None else '')
+
+    def _text(self, block, ac, found):
+        codes = [code(v) for (l, v) in found or [] if l == 'G']
+        prefix = ''
+        if not any(g in (200, 210) for g in codes):
+            prefix += 'G20' if self.inches else 'G21'
+        if not any(g in (900, 910) for g in codes):
+            prefix += 'G91' if self.incremental else 'G90'
+        for g in codes:
+            self._apply_modal(g)
+        self.records.append(text_record(JOB_GCODE, prefix + block + ('(' + ac + ')' if ac else '')))
+        self.text += 1
+
+    def _compile(self, found, ac):
+        """Returns the records for a block, or None if it has to be sent as text"""
+        v = {}
+        gs, ms = [], []
+        for letter, text in found:
+            if letter not in WORD_LETTERS:
+                return None
+            if letter == 'G':
+                gs.append(code(text))
+            elif letter == 'M':
+                ms.append(code(text))
+            else:
+                v[letter] = text                # last one wins, as in the parser
+        if any(g not in G_CODES for g in gs) or any(m not in M_CODES for m in ms):
+            return None
+        if self.inverse_time and 'F' not in v:
+            return None                         # let the parser report the missing feed rate
+        inches_before = self.inches
+        if any(a in v for a in 'ABC') and (self.inches or 200 in gs):
+            return None                         # rotary words in inches depend on the axis mode
+        dwell = 40 in gs
+        json = 1000 in ms
+        motion = self.motion
+        for g in gs:
+            if g in (0, 10, 20, 30):
+                motion = g
+        if motion in (50, 51) or motion in CANNED_CYCLES:
+            return None                         # G5 and G5.1 splines and canned cycle holes are sent as text
+        axes = [a for a in AXES if a in v]
+        offsets = [a for a in 'IJK' if a in v]
+        arc_words = offsets or ('R' in v) or ('P' in v and not dwell)
+        if (dwell and (axes or 'P' not in v or json)) or (json and (axes or not ac)):
+            return None
+        if (not dwell) and (not json) and ((axes and motion is None) or (arc_words and motion not in (20, 30))):
+            return None
+
+        saved = (self.inches, self.incremental, self.arc_absolute, self.inverse_time, self.plane, self.motion)
+        for g in gs:
+            self._apply_modal(g)
+        self.inches = inches_before             # F and the axis words below are in the block's units...
+        for g in gs:                            #...which is whatever G20/G21 in the block says
+            if g in (200, 210):
+                self.inches = (g == 200)
+        out = []
+        if 'N' in v:
+            out.append(record(JOB_LINE, struct.pack('<i', int(float(v['N'])))))
+        spindle = [m for m in ms if m in (30, 40, 50)]
+        if 'S' in v or spindle:
+            flags = (SPINDLE_SPEED if 'S' in v else 0) | (SPINDLE_CONTROL if spindle else 0)
+            control = {30: SPINDLE_CW, 40: SPINDLE_CCW, 50: SPINDLE_OFF}.get(spindle[-1] if spindle else 50)
+            out.append(record(JOB_SPINDLE, bytes([flags, control]) + _f32(float(v.get('S', 0)))))
+        if 70 in ms:
+            out.append(record(JOB_COOLANT, bytes([COOLANT_ON, COOLANT_MIST])))
+        if 80 in ms:
+            out.append(record(JOB_COOLANT, bytes([COOLANT_ON, COOLANT_FLOOD])))
+        if 90 in ms:
+            out.append(record(JOB_COOLANT, bytes([COOLANT_OFF, COOLANT_BOTH])))
+
+        feed = b''
+        modes = self._modes()
+        if 'F' in v:
+            f = float(v['F'])
+            feed = _f32(f if self.inverse_time else self._mm('F', f))
+            modes |= MODE_FEED
+        mask = sum(1 << AXES.index(a) for a in axes)
+        targets = b''.join(_f32(self._mm(a, float(v[a]))) for a in axes)
+
+        if dwell:
+            if feed:
+                out.append(record(JOB_FEED, bytes([modes]) + struct.pack('<H', 0) + feed))
+            out.append(record(JOB_DWELL, _f32(float(v['P']))))
+        elif json:
+            if feed:
+                out.append(record(JOB_FEED, bytes([modes]) + struct.pack('<H', 0) + feed))
+            out.append(text_record(JOB_JSON, ac))
+        elif motion in (20, 30) and (axes or arc_words or feed or (20 in gs) or (30 in gs)):
+            modes |= ((MODE_CCW if motion == 30 else 0) | (MODE_RADIUS if 'R' in v else 0) |
+                      (MODE_TURNS if 'P' in v else 0) | (MODE_MOTION_WORD if (20 in gs or 30 in gs) else 0))
+            offset_mask = sum(1 << 'IJK'.index(a) for a in offsets)
+            payload = bytes([modes, self.plane]) + struct.pack('<H', mask) + bytes([offset_mask]) + feed + targets
+            payload += b''.join(_f32(self._mm(a, float(v[a]))) for a in offsets)
+            if 'R' in v:
+                payload += _f32(self._mm('R', float(v['R'])))
+            if 'P' in v:
+                payload += _f32(float(v['P']))
+            out.append(record(JOB_ARC, payload))
+        elif axes or feed:
+            op = JOB_TRAVERSE if (motion == 0 and axes) else JOB_FEED
+            out.append(record(op, bytes([modes]) + struct.pack('<H', mask if axes else 0) + feed + targets))
+
+        stops = [m for m in ms if m in (0, 10, 20, 300, 600)]
+        if stops:
+            if stops[-1] in (20, 300):
+                out.append(text_record(JOB_GCODE, self.modes_text()))   # M2 leaves the units alone
+                out.append(record(JOB_STOP, bytes([PROGRAM_END])))
+            else:
+                out.append(record(JOB_STOP, bytes([PROGRAM_STOP])))
+        if not out and not gs:
+            self.inches, self.incremental, self.arc_absolute, self.inverse_time, self.plane, self.motion = saved
+        return out
+
+    def add_line(self, line):
+        line = line.split('*')[0].strip()      # checksums are for the serial link
+        block, ac, block_delete = normalize(line)
+        if block_delete or (not block):
+            return                              # nothing for the controller to do
+        found = words(block)
+        out = self._compile(found, ac) if found is not None else None
+        if out is None:
+            self._text(block, ac, found)
+        else:
+            self.records.extend(out)
+            self.compiled += 1
+
+    def finish(self, source_bytes):
+        if not (self.records and self.records[-1][0] == JOB_STOP):
+            self.records.append(text_record(JOB_GCODE, self.modes_text()))
+        header = HEADER.pack(JOB_MAGIC, JOB_VERSION, 0, HEADER.size, len(self.records), source_bytes)
+        return header + b''.join(self.records)
+
+
+def decode(data):
+    magic, version, _, header_size, count, source_bytes = HEADER.unpack_from(data, 0)
+    if magic != JOB_MAGIC or version != JOB_VERSION:
+        raise ValueError('not a version %d g2core job' % JOB_VERSION)
+    pos = header_size
+    while pos < len(data):
+        op, length = data[pos], data[pos + 1]
+        yield op, data[pos + 2:pos + 2 + length]
+        pos += 2 + length
+
+
+def describe(op, payload):
+    name = OP_NAMES[op] if op < len(OP_NAMES) else str(op)
+    if op in (JOB_JSON, JOB_GCODE):
+        return '%s %s' % (name, payload[:-1].decode('ascii'))
+    if op in (JOB_TRAVERSE, JOB_FEED, JOB_ARC):
+        modes = payload[0]
+        head = 5 if op == JOB_ARC else 3
+        mask = struct.unpack_from('<H', payload, 2 if op == JOB_ARC else 1)[0]
+        floats = struct.unpack_from('<%df' % ((len(payload) - head) // 4), payload, head)
+        names = (['F'] if modes & MODE_FEED else []) + [a for i, a in enumerate(AXES) if mask & (1 << i)]
+        if op == JOB_ARC:
+            names += [a for i, a in enumerate('IJK') if payload[4] & (1 << i)]
+            names += (['R'] if modes & MODE_RADIUS else []) + (['P'] if modes & MODE_TURNS else [])
+        return '%s modes=0x%02x %s' % (name, modes, ' '.join('%s%g' % (n, f) for n, f in zip(names, floats)))
+    return '%s %s' % (name, payload.hex())
+
+
+def main(args):
+    stats = '--stats' in args
+    listing = '--list' in args
+    inches = '--inches' in args
+    args = [a for a in args if not a.startswith('--')]
+
+    if listing:
+        for op, payload in decode(open(args[0], 'rb').read()):
+            print(describe(op, payload))
+        return
+
+    source = open(args[0], 'rb').read()
+    encoder = Encoder(inches)
+    for line in source.decode('ascii', 'replace').splitlines():
+        encoder.add_line(line)
+    job = encoder.finish(len(source))
+    open(args[1], 'wb').write(job)
+
+    if stats:
+        blocks = encoder.compiled + encoder.text
+        print('%d bytes of Gcode, %d bytes of job (%.0f%%)' % (len(source), len(job), 100.0 * len(job) / len(source)))
+        print('%d blocks: %d pre-parsed, %d sent as text; %d records, %.1f job bytes/block' % (
+            blocks, encoder.compiled, encoder.text, len(encoder.records), (len(job) - HEADER.size) / float(max(blocks, 1))))
+
+
+if __name__ == '__main__':
+    main(sys.argv[1:])
@@ -0,0 +1,180 @@
+/*
+ * config_host.h - the config system built for the host, for the config, JSON and status report tests
+ * This file is part of the g2core project
+ *
+ * Compiles config.cpp, json_parser.cpp and text_parser.cpp as they are, with cfgArray taken
+ * from config_app.cpp (see config_table() in extract.py), against the stubs below. It holds
+ * definitions, so each test includes it exactly once. A test that builds report.cpp as well
+ * defines CONFIG_HOST_REPORT first, which leaves out the stubs report.cpp replaces.
+ */
+#ifndef CONFIG_HOST_H_ONCE
+#define CONFIG_HOST_H_ONCE
+
+#include <chrono>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <algorithm>
+
+using std::isnan;
+using std::isinf;
+using std::min;
+using std::max;
+
+#include "g2core.h"
+#include "config.h"
+#include "json_parser.h"
+#include "text_parser.h"
+#include "report.h"
+#include "persistence.h"
+#include "help.h"
+#include "config_app.h"
+
+#define NUL (char)0x00
+#define DEL (char)0x7F
+
+#include "util.inc"
+
+/**** stubs for what the compiled sources call ****/
+
+#define MOTORS 6                            // the most cfgArray has entries for
+#define D_IN_CHANNELS 9                     // as gpio.h
+
+enum { MACHINE_INITIALIZING = 0, MACHINE_READY };
+enum { INCHES = 0, MILLIMETERS };
+enum { TEXT_MODE_ = 0 };
+#define MODEL nullptr
+
+struct GCodeState_t;
+struct {
+    uint8_t machine_state = MACHINE_READY;
+    struct { uint8_t motion_mode; } gm;             // read by report.cpp's queue reports
+} cm1;
+auto *cm = &cm1;
+
+#define RX_BUFFER_SIZE 512                  // as xio.h
+#define SAVED_BUFFER_LEN RX_BUFFER_SIZE     // as controller.h
+#define OUTPUT_BUFFER_LEN 512               // as controller.h
+
+enum { CONTROLLER_READY = 4 };                      // as controller.h
+
+struct {
+    uint8_t controller_state = CONTROLLER_READY;
+    char out_buf[OUTPUT_BUFFER_LEN];
+    bool responses_suppressed;
+    char *bufp;
+    char saved_buf[SAVED_BUFFER_LEN];
+    uint16_t linelen;
+    commMode comm_mode;
+    commMode comm_request_mode;
+    float null;
+} cs;
+
+stat_t status_code;                                 // for ritorno, as main.cpp
+char *get_status_message(stat_t status) { return ((char *)"status"); }
+#ifndef CONFIG_HOST_REPORT                          // defined by tests that build report.cpp
+srSingleton_t sr;
+#endif
+
+void convert_outgoing_float(nvObj_t *nv)            // values stay in mm - the test doesn't switch units
+{
+    if (nv->valuetype != TYPE_FLOAT) { return; }    // as _convert() in config_app.cpp
+    nv->precision = cfgArray[nv->index].precision;
+    nv->valuetype = TYPE_FLOAT;
+}
+
+static std::vector<std::string> host_output;        // lines the firmware wrote
+static bool host_capture = false;
+
+int xio_writeline(const char *buffer, bool only_to_muted = false)
+{
+    if (host_capture) { host_output.push_back(buffer); }
+    return (strlen(buffer));
+}
+size_t xio_write(const char *buffer, size_t size, bool only_to_muted = false) { return (size); }
+
+static uint32_t host_ms = 0;                        // SysTick time - the test moves it
+uint32_t SysTickTimer_getValue() { return (host_ms); }
+
+static uint8_t units_mode = MILLIMETERS;
+uint8_t cm_get_units_mode(const GCodeState_t *) { return (units_mode); }
+stat_t cm_set_units_mode(const uint8_t mode) { units_mode = mode; return (STAT_OK); }
+stat_t cm_panic(const stat_t panic_code, const char *info) { return (panic_code); }
+stat_t cm_is_alarmed() { return (STAT_OK); }
+void cm_parse_clear(const char *s) {}
+#ifndef CONFIG_HOST_REPORT
+static int exceptions = 0;
+stat_t rpt_exception(stat_t status, const char *msg) { exceptions++; return (status); }
+void rpt_print_loading_configs_message() {}
+void rpt_print_initializing_message() {}
+void sr_init_status_report() {}
+bool sr_restore_status_report() { return (true); }
+void sr_mark_all_changed() {}
+stat_t sr_request_status_report(cmStatusReportRequest request_type) { return (STAT_OK); }
+stat_t sr_run_text_status_report() { return (STAT_OK); }
+#endif
+stat_t help_defa(nvObj_t *nv) { return (STAT_OK); }
+stat_t help_general(nvObj_t *nv) { return (STAT_OK); }
+void persistence_init() {}
+void persistence_reset() {}
+static int persisted = 0;
+stat_t read_persistent_value(nvObj_t *nv) { return (STAT_NOOP); }
+stat_t write_persistent_value(nvObj_t *nv) { persisted++; return (STAT_OK); }
+
+/**** host bindings for cfgArray entries the test doesn't build ****
+ *
+ *  host_get() and host_set() keep one value per index. The derived setters stand in for
+ *  st_set_sa() and friends (motor), cm_set_jm()/cm_set_jh() (axis) and cm_set_coord()/
+ *  cm_set_tof() (offset): each recomputes its derived value unless nv_deferring_derived() is
+ *  on, and the deferred-settings functions recompute them all, as the firmware does.
+ */
+
+static uint32_t host_value[2000];                    // more than cfgArray has
+static float host_value_flt[2000];
+static int host_fail_index = -1;                    // host setters fail this index
+static int recomputes = 0;                          // derived values computed
+static int host_gets = 0;                           // host getter calls
+
+static stat_t host_get(nvObj_t *nv)
+{
+    host_gets++;
+    memcpy(&nv->value_int, &host_value[nv->index], sizeof(uint32_t));
+    nv->value_flt = host_value_flt[nv->index];
+    nv->valuetype = (valueType)(cfgArray[nv->index].flags & F_TYPE_MASK);
+    if (nv->valuetype == TYPE_STRING) {
+        return (nv_copy_string(nv, "host"));        // string getters point stringp at their text
+    }
+    return (STAT_OK);
+}
+
+static stat_t host_set(nvObj_t *nv)
+{
+    if (nv->index == host_fail_index) {
+        return (STAT_INPUT_VALUE_RANGE_ERROR);
+    }
+    memcpy(&host_value[nv->index], &nv->value_int, sizeof(uint32_t));
+    host_value_flt[nv->index] = nv->value_flt;
+    return (STAT_OK);
+}
+
+static stat_t host_set_derived(nvObj_t *nv)
+{
+    ritorno(host_set(nv));
+    if (!nv_deferring_derived()) {
+        recomputes++;
+    }
+    return (STAT_OK);
+}
+static stat_t host_set_motor(nvObj_t *nv) { return (host_set_derived(nv)); }
+static stat_t host_set_axis(nvObj_t *nv) { return (host_set_derived(nv)); }
+static stat_t host_set_offset(nvObj_t *nv) { return (host_set_derived(nv)); }
+static void host_print(nvObj_t *nv) {}
+
+void cm_apply_deferred_settings() { recomputes++; }
+void st_apply_deferred_settings() { recomputes++; }
+
+#include "config_app.inc"
+#include "config_source.inc"
+#include "config_table.inc"
+
+#endif  // End of include guard: CONFIG_HOST_H_ONCE
@@ -0,0 +1,393 @@
+/*
+ * config_test.cpp - host test and benchmark of the config system, JSON parser and transactions
+ * This file is part of the g2core project
+ *
+ * Builds the config system as it is (see config_host.h).
+ *
+ *  - token lookup: every token in cfgArray, whole or as group and remainder, resolves to the
+ *    index the linear scan nv_get_index() used before finds, and unknown tokens miss. The
+ *    benchmark compares lookups/s of each kind with the linear scan
+ *  - transactions: a whole profile - every setting - fits in one transaction, commit
+ *    persists it and recomputes derived values once, and a failed set or an abort puts
+ *    back every value the transaction changed
+ *  - text mode dumps: $dump=<pattern> streams the same settings as {"dump":"<pattern>"},
+ *    with no response of its own ahead of the dump
+ *  - the benchmark applies a profile of every host-settable setting one {"token":value} line at
+ *    a time through json_parser(), with and without a transaction
+ *
+ * Run it with run_config_test.sh. It prints the measurements and exits non-zero on failure.
+ */
+
+#include "config_host.h"
+
+/**** test ****/
+
+typedef std::chrono::steady_clock host_clock;
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+static double seconds_since(host_clock::time_point start)
+{
+    return (std::chrono::duration<double>(host_clock::now() - start).count());
+}
+
+static stat_t send(const char *line)            // one line from the host, as the controller hands it over
+{
+    char buf[NV_MESSAGE_LEN];
+    strncpy(buf, line, sizeof(buf)-1);
+    buf[sizeof(buf)-1] = NUL;
+    return (json_parser(buf));
+}
+
+static index_t linear_index(const char *group, const char *token)  // nv_get_index() before the hash chains
+{
+    char str[TOKEN_LEN + GROUP_LEN + 1];
+    strcpy(str, group);
+    strcat(str, token);
+    for (index_t i=0; i < nv_index_max(); i++) {
+        if (strcmp(str, cfgArray[i].token) == 0) {
+            return (i);
+        }
+    }
+    return (NO_MATCH);
+}
+
+/*
+ * The profile: every setting a host can set - each F_INITIALIZE entry that isn't read-only -
+ * as one {"token":value} line, the way a settings file is sent.
+ */
+static std::vector<index_t> profile;
+static std::vector<std::string> profile_lines;
+
+static void make_profile(int version)
+{
+    profile.clear();
+    profile_lines.clear();
+    for (index_t i=0; i < nv_index_max(); i++) {
+        if ((nv_setting_slot[i] == NO_MATCH) || (cfgArray[i].set == set_ro) ) {
+            continue;
+        }
+        if (cfgArray[i].set != host_set && cfgArray[i].set != host_set_motor && cfgArray[i].set != host_set_axis &&
+            cfgArray[i].set != host_set_offset && cfgArray[i].set != set_flt && cfgArray[i].set != (fptrCmd)set_int32 &&
+            cfgArray[i].set != set_data) {
+            continue;                           // the communications settings would change how the test talks
+        }
+        char line[64];
+        if (_txn_is_float(i)) {
+            sprintf(line, "{\"%s\":%d.25}", cfgArray[i].token, version + (i % 100));
+        } else {
+            sprintf(line, "{\"%s\":%d}", cfgArray[i].token, version % 2);
+        }
+        profile.push_back(i);
+        profile_lines.push_back(line);
+    }
+}
+
+static std::vector<uint32_t> snapshot()         // the value of every profile setting, as nv_get() reads it
+{
+    std::vector<uint32_t> values;
+    for (index_t i : profile) {
+        nvObj_t nv;
+        _txn_get(&nv, i);
+        uint32_t v;
+        memcpy(&v, _txn_is_float(i) ? (void *)&nv.value_flt : (void *)&nv.value_int, sizeof(v));
+        values.push_back(v);
+    }
+    return (values);
+}
+
+static int profile_persists()
+{
+    int n = 0;
+    for (index_t i : profile) {
+        n += (cfgArray[i].flags & F_PERSIST) ? 1 : 0;
+    }
+    return (n);
+}
+
+/*
+ * Lookups as the callers make them: a whole token (text mode, status reports, flat JSON), a
+ * group and the token's remainder (nested JSON such as {"x":{"vm":n}}), and tokens that
+ * aren't in the table - which the linear scan compared against every entry.
+ */
+struct lookup {
+    char group[GROUP_LEN+1];
+    char token[TOKEN_LEN+1];
+};
+
+static std::vector<lookup> lookups(const int kind)
+{
+    std::vector<lookup> list;
+    for (index_t i=0; i < nv_index_max(); i++) {
+        lookup l = {};
+        const char *token = cfgArray[i].token;
+        size_t glen = strlen(cfgArray[i].group);
+        if (kind == 0) {
+            strcpy(l.token, token);
+        } else if (kind == 1) {
+            if ((glen == 0) || (strncmp(token, cfgArray[i].group, glen) != 0) || (token[glen] == NUL)) {
+                continue;
+            }
+            strcpy(l.group, cfgArray[i].group);
+            strcpy(l.token, token + glen);
+        } else {
+            snprintf(l.token, sizeof(l.token), "#%s", token);   // no token has a #
+        }
+        list.push_back(l);
+    }
+    return (list);
+}
+
+static void test_lookup()
+{
+    const char *kinds[] = { "tokens", "group + token", "misses" };
+    int longest = 0;
+    for (index_t b=0; b < NV_HASH_BUCKETS; b++) {
+        int length = 0;
+        for (index_t i = nv_hash_head[b]; i != NO_MATCH; i = nv_hash_next[i]) {
+            length++;
+        }
+        longest = max(longest, length);
+    }
+    printf("token lookup: %d entries, %d buckets, longest chain %d\n", nv_index_max(), NV_HASH_BUCKETS, longest);
+    printf("                    hash chains    linear scan\n");
+
+    for (int kind=0; kind < 3; kind++) {
+        std::vector<lookup> list = lookups(kind);
+        index_t mismatches = 0;
+        for (const lookup &l : list) {
+            index_t i = nv_get_index(l.group, l.token);
+            mismatches += (i != linear_index(l.group, l.token)) ? 1 : 0;
+            mismatches += ((kind < 2) == (i == NO_MATCH)) ? 1 : 0;
+        }
+        check(mismatches == 0, "nv_get_index() finds what the linear scan does");
+
+        const int rounds = 200;
+        volatile index_t sink = 0;
+        host_clock::time_point start = host_clock::now();
+        for (int r=0; r < rounds; r++) {
+            for (const lookup &l : list) {
+                sink += nv_get_index(l.group, l.token);
+            }
+        }
+        double hashed = seconds_since(start);
+        start = host_clock::now();
+        for (int r=0; r < rounds; r++) {
+            for (const lookup &l : list) {
+                sink += linear_index(l.group, l.token);
+            }
+        }
+        double linear = seconds_since(start);
+        double n = (double)rounds * list.size();
+        printf("  %-14s %10.0f/s  %10.0f/s  (%.0fx slower)\n", kinds[kind], n / hashed, n / linear, linear / hashed);
+    }
+}
+
+static void test_transactions()
+{
+    make_profile(1);
+    int settings = 0;
+    for (index_t i=0; i < nv_index_max(); i++) {
+        settings += (nv_setting_slot[i] != NO_MATCH) ? 1 : 0;
+    }
+    check(settings == NV_SETTINGS, "every F_INITIALIZE entry has a setting slot");
+    printf("transactions: %d settings, the profile sets %d of them\n", NV_SETTINGS, (int)profile.size());
+
+    // a whole profile commits: derived values once, every persisted setting written once
+    std::vector<uint32_t> before = snapshot();
+    send("{\"txn\":1}");
+    recomputes = 0;
+    persisted = 0;
+    for (const std::string &line : profile_lines) {
+        send(line.c_str());
+    }
+    check(txn.count == profile.size(), "the transaction holds the whole profile");
+    check(txn.status == STAT_OK, "every set in the profile succeeds");
+    check(recomputes == 0, "derived values are deferred while the transaction is open");
+    check(persisted == 0, "nothing is persisted while the transaction is open");
+    send("{\"txn\":0}");
+    check(txn.state == TXN_CLOSED, "commit closes the transaction");
+    check(recomputes == 2, "commit recomputes derived values once");
+    check(persisted == profile_persists(), "commit persists every persisted setting in the profile");
+    std::vector<uint32_t> committed = snapshot();
+    check(committed != before, "commit keeps the new values");
+
+    // a failed set rolls back every setting the transaction changed
+    make_profile(2);
+    send("{\"txn\":1}");
+    persisted = 0;
+    for (size_t n=0; n < profile_lines.size(); n++) {
+        if (n == profile_lines.size() / 2) {
+            host_fail_index = profile[n];           // fail one set halfway through
+        }
+        send(profile_lines[n].c_str());
+        host_fail_index = -1;
+    }
+    check(txn.status != STAT_OK, "the failed set is remembered");
+    send("{\"txn\":0}");
+    check(txn.state == TXN_CLOSED, "a failed commit closes the transaction");
+    check(persisted == 0, "a failed commit persists nothing");
+    check(snapshot() == committed, "a failed commit restores every value");
+
+    // abort restores too, and the next transaction starts clean
+    send("{\"txn\":1}");
+    for (const std::string &line : profile_lines) {
+        send(line.c_str());
+    }
+    send("{\"txn\":-1}");
+    check(txn.state == TXN_CLOSED, "abort closes the transaction");
+    check(snapshot() == committed, "abort restores every value");
+    bool clean = true;
+    for (size_t b=0; b < sizeof(nv_txn_touched); b++) {
+        clean &= (nv_txn_touched[b] == 0);
+    }
+    check(clean, "no setting is left marked after the transaction closes");
+
+    // each line inside a transaction still gets its response, so flow control is unchanged
+    send("{\"txn\":1}");
+    host_output.clear();
+    host_capture = true;
+    send(profile_lines[0].c_str());
+    host_capture = false;
+    check((host_output.size() == 1) && (strstr(host_output[0].c_str(), "\"r\"") != NULL), "a set inside a transaction gets its response");
+    send("{\"txn\":-1}");
+
+    // a non-setting fails the transaction
+    send("{\"txn\":1}");
+    send("{\"fb\":1}");                          // read-only, not a setting
+    check(txn.status == STAT_COMMAND_NOT_ACCEPTED, "a value that is not a setting is refused inside a transaction");
+    send("{\"txn\":-1}");
+    send("{\"txn\":1}");
+    send("{\"gc\":\"g0x10\"}");
+    check(txn.status == STAT_COMMAND_NOT_ACCEPTED, "Gcode is refused inside a transaction");
+    send("{\"txn\":-1}");
+
+    // a host that goes away can't leave a transaction open
+    send("{\"txn\":1}");
+    send(profile_lines[0].c_str());
+    nv_txn_abort();                                 // what disconnect and job kill call
+    check((txn.state == TXN_CLOSED) && (snapshot() == committed), "nv_txn_abort() rolls back");
+
+    send("{\"txn\":1}");
+    send(profile_lines[0].c_str());
+    host_ms += NV_TXN_TIMEOUT_MS - 1;
+    nv_txn_callback();
+    check(txn.state == TXN_OPEN, "a transaction with recent sets stays open");
+    send(profile_lines[1].c_str());
+    host_ms += NV_TXN_TIMEOUT_MS - 1;
+    nv_txn_callback();
+    check(txn.state == TXN_OPEN, "each set restarts the idle timeout");
+    exceptions = 0;
+    host_ms += 1;
+    nv_txn_callback();
+    check((txn.state == TXN_CLOSED) && (snapshot() == committed) && (exceptions == 1), "an idle transaction is aborted and reported");
+
+    host_ms = 0xFFFFFFFF - 10;                      // the timeout survives SysTick wraparound
+    send("{\"txn\":1}");
+    host_ms += 100;
+    nv_txn_callback();
+    check(txn.state == TXN_OPEN, "the idle timeout is wrap-safe");
+    send("{\"txn\":-1}");
+
+    send("{\"txn\":1}");
+    send(profile_lines[0].c_str());
+    send("{\"defa\":1}");
+    check(txn.state == TXN_CLOSED, "$defa aborts the transaction");
+}
+
+/*
+ * The benchmark applies the profile end to end - one line at a time through json_parser(),
+ * response and all - without and with a transaction. The derived setters here only count,
+ * so this measures the config path; on the board each recompute also costs the setter's math.
+ */
+static void benchmark_apply()
+{
+    const int rounds = 50;
+    make_profile(3);
+
+    recomputes = 0;
+    host_clock::time_point start = host_clock::now();
+    for (int r=0; r < rounds; r++) {
+        for (const std::string &line : profile_lines) {
+            send(line.c_str());
+        }
+    }
+    double plain = seconds_since(start) / rounds;
+    int plain_recomputes = recomputes / rounds;
+
+    recomputes = 0;
+    start = host_clock::now();
+    for (int r=0; r < rounds; r++) {
+        send("{\"txn\":1}");
+        for (const std::string &line : profile_lines) {
+            send(line.c_str());
+        }
+        send("{\"txn\":0}");
+    }
+    double txn_time = seconds_since(start) / rounds;
+    int txn_recomputes = recomputes / rounds;
+
+    printf("apply a %d-line profile:\n", (int)profile_lines.size());
+    printf("  line by line   %8.1f us  %4d derived recomputes\n", plain * 1e6, plain_recomputes);
+    printf("  in a txn       %8.1f us  %4d derived recomputes\n", txn_time * 1e6, txn_recomputes);
+}
+
+static std::vector<std::string> dump_output(const char *line, stat_t (*parser)(char *))
+{
+    char buf[NV_MESSAGE_LEN];
+    strncpy(buf, line, sizeof(buf)-1);
+    buf[sizeof(buf)-1] = NUL;
+    host_output.clear();
+    host_capture = true;
+    parser(buf);
+    while (nv_dump_is_running()) {
+        nv_dump_callback();
+    }
+    host_capture = false;
+    return (host_output);
+}
+
+static stat_t json_line(char *str) { return (json_parser(str)); }
+
+static void test_text_dump()
+{
+    const char *patterns[] = { "*", "1*", "?vm", "x*", "di*", "zz" };
+    for (const char *pattern : patterns) {
+        std::string json = std::string("{\"dump\":\"") + pattern + "\"}";
+        std::string text = std::string("$dump=") + pattern;
+        std::vector<std::string> expected = dump_output(json.c_str(), json_line);
+        std::vector<std::string> got = dump_output(text.c_str(), text_parser);
+        check(!expected.empty() && (got == expected), "$dump=<pattern> streams what {\"dump\":\"<pattern>\"} does");
+    }
+    std::vector<std::string> all = dump_output("$dump", text_parser);
+    check(all == dump_output("{\"dump\":n}", json_line), "$dump streams every setting");
+    printf("text dumps: %d lines for $dump\n", (int)all.size());
+}
+
+int main()
+{
+    cs.comm_mode = JSON_MODE;
+    config_init();
+    js.json_mode = JSON_MODE;
+    js.json_verbosity = JV_CONFIGS;                 // every set gets its full response
+
+    test_lookup();
+    test_transactions();
+    test_text_dump();
+    benchmark_apply();
+
+    if (failures) {
+        printf("%d FAILED\n", failures);
+        return (1);
+    }
+    printf("PASS\n");
+    return (0);
+}
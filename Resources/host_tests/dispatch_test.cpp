@@ -0,0 +1,313 @@
+/*
+ * dispatch_test.cpp - host test and benchmark of batched command dispatch
+ * This file is part of the g2core project
+ *
+ * Builds _dispatch_command() and _dispatch_batch_can_continue() as they are, on a simulated
+ * controller loop. Each pass costs the rest of the controller's callbacks, each dispatched
+ * line costs its parse and plan, and the planner runs its queue down in simulated time as
+ * the blocks execute. mp_is_phat_city_time() and mp_planner_is_full() keep the firmware's
+ * rules: phat city with an empty planner or more than PHAT_CITY_MS planned, full at
+ * PLANNER_BUFFER_HEADROOM buffers from the end of the queue.
+ *
+ *  - guards: a line that starts an arc, a canned cycle, a homing/probing/jogging cycle, a
+ *    feedhold, a settings dump or Marlin mode, or that arrives with a realtime character
+ *    pending, is the last line of its batch; a full planner ends the batch too
+ *  - the time slice: no batch runs past DISPATCH_BATCH_MS by more than one line
+ *  - the benchmark streams a job of equal blocks as fast as the host can send them, one line
+ *    per pass (as before batching) and batched, and reports the job time, how long the
+ *    planner took to fill, how long it ran dry, and the lines taken per dispatching pass
+ *
+ * The pass and line costs are model inputs, not measurements - they are printed with the
+ * results, which scale with them.
+ *
+ * Run it with run_dispatch_test.sh. It prints the measurements and exits non-zero on failure.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+
+typedef uint8_t stat_t;
+#define STAT_OK 0
+#define STAT_EAGAIN 2
+#define STAT_NOOP 3
+
+#define NUL (char)0x00
+#define RX_BUFFER_SIZE 512                      // as xio.h
+#define PLANNER_QUEUE_SIZE 48                   // as planner.h
+#define PLANNER_BUFFER_HEADROOM 4
+#define PHAT_CITY_MS 100.0
+
+#include "dispatch_defs.inc"
+
+/**** stand-ins for the state the dispatcher reads ****/
+
+typedef uint16_t devflags_t;
+#define DEV_IS_CTRL  (0x0001)
+#define DEV_IS_DATA  (0x0002)
+#define DEV_IS_MUTED (0x0008)
+#define DEV_IS_BOTH  (DEV_IS_CTRL | DEV_IS_DATA)
+
+typedef struct gcTokens { int words; } gcTokens_t;
+
+enum cmControllerState { CONTROLLER_READY, CONTROLLER_PAUSED };
+enum { TEXT_MODE, JSON_MODE, MARLIN_COMM_MODE };
+enum { BLOCK_INACTIVE, BLOCK_ACTIVE };
+enum { CYCLE_NONE, CYCLE_MACHINING, CYCLE_HOMING, CYCLE_PROBE, CYCLE_JOG };
+enum { FEEDHOLD_OFF, FEEDHOLD_SYNC };
+
+struct {
+    cmControllerState controller_state;
+    char *bufp;
+    uint16_t linelen;
+    int16_t line_checksum;
+} cs;
+
+struct { uint8_t json_mode; } js;
+
+typedef struct cmMachine {
+    struct { uint8_t run_state; } arc, canned;
+    uint8_t cycle_type;
+    uint8_t hold_state;
+} cmMachine_t;
+static cmMachine_t cm1;
+static cmMachine_t *cm = &cm1;
+
+typedef struct mpPlanner { int unused; } mpPlanner_t;
+static mpPlanner_t mp1;
+static mpPlanner_t *mp = &mp1;
+
+/**** the simulation ****/
+
+static double host_us = 0;                      // simulated time
+static double pass_us = 50;                     // the rest of a controller pass
+static double line_us = 150;                    // parse and plan of one line
+static double block_us = 5000;                  // execution time of each block
+
+static std::deque<double> blocks;               // queued blocks, the first one running
+static double block_end = 0;                    // when the running block finishes
+static double starved_us = 0;                   // time the planner ran dry while there was input
+static bool started = false;
+
+static std::vector<std::string> host_lines;     // what the host sends, all in the RX buffer
+static size_t next_line = 0;
+static char line_buf[RX_BUFFER_SIZE];
+static int dispatched = 0;
+
+static bool batching = true;                    // false: one line per pass, as before batching
+static char host_realtime = NUL;
+static bool host_dump = false;
+
+static void advance(double us)
+{
+    host_us += us;
+    while (!blocks.empty() && (block_end <= host_us)) {
+        blocks.pop_front();
+        if (!blocks.empty()) {
+            block_end += blocks.front();
+        }
+    }
+}
+
+static void queue_block(double us)
+{
+    if (blocks.empty()) {
+        if (started && (next_line < host_lines.size())) {
+            starved_us += host_us - block_end;
+        }
+        block_end = host_us + us;
+        started = true;
+    }
+    blocks.push_back(us);
+}
+
+uint32_t SysTickTimer_getValue() { return ((uint32_t)(host_us / 1000)); }
+
+bool mp_planner_is_full(const mpPlanner_t *_mp) { return (blocks.size() > PLANNER_QUEUE_SIZE - PLANNER_BUFFER_HEADROOM); }
+
+bool mp_is_phat_city_time()
+{
+    if (!batching) {
+        return (false);                         // batch is then always 1
+    }
+    double plannable_ms = 0;                    // queued behind the running block
+    for (size_t b=1; b < blocks.size(); b++) {
+        plannable_ms += blocks[b] / 1000;
+    }
+    return ((plannable_ms <= 0) || (PHAT_CITY_MS < plannable_ms));
+}
+
+char *xio_readline(devflags_t &flags, uint16_t &size)
+{
+    if (next_line == host_lines.size()) {
+        return (NULL);
+    }
+    strcpy(line_buf, host_lines[next_line++].c_str());
+    flags = DEV_IS_DATA;
+    size = strlen(line_buf);
+    return (line_buf);
+}
+
+int16_t xio_get_line_checksum() { return (-1); }
+char xio_get_realtime() { return (host_realtime); }
+bool nv_dump_is_running() { return (host_dump); }
+bool job_is_running() { return (false); }
+stat_t job_dispatch() { return (STAT_OK); }
+
+static void _dispatch_kernel(const devflags_t flags, gcTokens_t *tokens = nullptr)
+{
+    advance(line_us);
+    dispatched++;
+    const char *line = cs.bufp;
+    if      (strncmp(line, "G2 ", 3) == 0)    { cm->arc.run_state = BLOCK_ACTIVE; }
+    else if (strncmp(line, "G81 ", 4) == 0)   { cm->canned.run_state = BLOCK_ACTIVE; }
+    else if (strncmp(line, "G28.2", 5) == 0)  { cm->cycle_type = CYCLE_HOMING; }
+    else if (strncmp(line, "G38.2", 5) == 0)  { cm->cycle_type = CYCLE_PROBE; }
+    else if (strncmp(line, "!", 1) == 0)      { cm1.hold_state = FEEDHOLD_SYNC; }
+    else if (strncmp(line, "{dump", 5) == 0)  { host_dump = true; }
+    else if (strncmp(line, "M105", 4) == 0)   { js.json_mode = MARLIN_COMM_MODE; }
+    else if (strncmp(line, "RT", 2) == 0)     { host_realtime = '!'; } // a '!' lands while this line runs
+    else                                      { queue_block(block_us); }
+}
+
+#include "dispatch.inc"
+
+/**** test ****/
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+static void reset(const std::vector<std::string> &lines)
+{
+    memset(&cs, 0, sizeof(cs));
+    memset(&cm1, 0, sizeof(cm1));
+    js.json_mode = JSON_MODE;
+    host_realtime = NUL;
+    host_dump = false;
+    host_lines = lines;
+    next_line = 0;
+    dispatched = 0;
+    blocks.clear();
+    started = false;
+    starved_us = 0;
+    batching = true;
+}
+
+static int one_pass()                           // lines dispatched by one pass
+{
+    int before = dispatched;
+    _dispatch_command();
+    return (dispatched - before);
+}
+
+static void test_guards()
+{
+    line_us = 100;
+    struct { const char *line; const char *what; } guards[] = {
+        { "G2 X10 Y10 I5",  "an arc ends the batch" },
+        { "G81 X1 Z-1 R1",  "a canned cycle ends the batch" },
+        { "G28.2 X0",       "homing ends the batch" },
+        { "G38.2 Z-10",     "probing ends the batch" },
+        { "!",              "a feedhold ends the batch" },
+        { "{dump:\"\"}",    "a settings dump ends the batch" },
+        { "M105",           "Marlin mode ends the batch" },
+        { "RT",             "a pending realtime character ends the batch" },
+    };
+    for (auto &g : guards) {
+        reset({ "G1 X1", "G1 X2", g.line, "G1 X3", "G1 X4" });
+        check(one_pass() == 3, g.what);
+    }
+
+    std::vector<std::string> lines(100, "G1 X1");
+    reset(lines);
+    check(one_pass() == DISPATCH_BATCH_LINES, "an empty planner takes a full batch");
+    check(one_pass() == 1, "a planner short of time takes one line per pass");
+
+    block_us = 50000;                           // long blocks - phat city once two are queued
+    reset(lines);
+    int passes = 0;
+    while (!mp_planner_is_full(mp) && (passes++ < 100)) {
+        one_pass();
+    }
+    check(blocks.size() == PLANNER_QUEUE_SIZE - PLANNER_BUFFER_HEADROOM + 1, "batches stop when the planner is full");
+
+    line_us = 700;                              // slow lines - the time slice ends the batch
+    reset(lines);
+    double start = host_us;
+    int n = one_pass();
+    check((n < DISPATCH_BATCH_LINES) && (host_us - start <= (DISPATCH_BATCH_MS + 1) * 1000 + line_us),
+          "a batch stops at the end of its time slice");
+    printf("guards: %d checked; a %.0f us line ends its batch after %d lines (%.1f ms)\n",
+           (int)(sizeof(guards) / sizeof(guards[0])), line_us, n, (host_us - start) / 1000);
+}
+
+struct jobResult {
+    double job_ms;
+    double fill_ms;                             // until the planner is first full
+    double starved_ms;
+    double lines_per_pass;                      // in the passes that dispatched
+};
+
+static jobResult run_job(bool batch, int lines)
+{
+    reset(std::vector<std::string>(lines, "G1 X1"));
+    batching = batch;
+    int passes = 0;
+    double fill_us = 0;
+    host_us = 0;
+    while ((next_line < host_lines.size()) || !blocks.empty()) {
+        advance(pass_us);
+        passes += (one_pass() != 0) ? 1 : 0;
+        if ((fill_us == 0) && mp_planner_is_full(mp)) {
+            fill_us = host_us;
+        }
+    }
+    return { host_us / 1000, fill_us / 1000, starved_us / 1000, (double)lines / passes };
+}
+
+static void benchmark()
+{
+    const int lines = 2000;
+    line_us = 150;
+    printf("stream %d lines, %.0f us to parse and plan a line:\n", lines, line_us);
+    printf("  block   pass     one line per pass                     batched\n");
+    printf("     ms     us   job ms  fill ms  dry ms  lines/pass   job ms  fill ms  dry ms  lines/pass\n");
+    for (double pass : { 50.0, 200.0 }) {
+        for (double block : { 0.25, 1.0, 5.0, 50.0 }) {
+            pass_us = pass;
+            block_us = block * 1000;
+            jobResult one = run_job(false, lines);
+            jobResult batched = run_job(true, lines);
+            printf("  %5.2f  %5.0f  %7.0f  %7.1f  %6.1f  %10.2f  %7.0f  %7.1f  %6.1f  %10.2f\n", block, pass,
+                   one.job_ms, one.fill_ms, one.starved_ms, one.lines_per_pass,
+                   batched.job_ms, batched.fill_ms, batched.starved_ms, batched.lines_per_pass);
+            check(batched.job_ms <= one.job_ms + block, "batching never slows a job");
+            check(batched.starved_ms <= one.starved_ms, "batching never starves the planner more");
+            check(batched.fill_ms <= one.fill_ms, "batching never fills the planner slower");
+        }
+    }
+}
+
+int main()
+{
+    test_guards();
+    benchmark();
+
+    if (failures) {
+        printf("%d FAILED\n", failures);
+        return (1);
+    }
+    printf("PASS\n");
+    return (0);
+}
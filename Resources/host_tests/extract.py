@@ -0,0 +1,285 @@
+#!/usr/bin/env python3
+"""
+extract.py - pull code out of the g2core sources for the host tests
+
+The firmware needs the ARM toolchain and Motate to build, so the host tests compile the
+real code on their own and supply stubs for everything else it calls. For each test this
+script writes .inc files into the output directory, built from:
+
+    function  one function definition, found by its signature
+    span      the text of a file from one marker through another
+    source    a whole file without its project #includes
+    table     cfgArray and the tables built from it (see config_table())
+
+    python3 extract.py <test> <output directory>
+"""
+
+import os
+import re
+import sys
+
+G2CORE = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', 'g2core')
+
+# LineRXBuffer, the realtime mailbox and the xio realtime functions - see rx_host.h
+RX_BUFFER = {
+    'xio_defs.inc': [
+        ('span', 'xio.h', '#define XIO_CHECKSUM_NONE', '#define XIO_CHECKSUM_UNKNOWN -2'),
+        ('span', 'xio.h', '#define NUL (char)0x00', '            (c == CHAR_QUEUE_FLUSH));\n}'),
+    ],
+    'xio_realtime.inc': [
+        ('span', 'xio.cpp', 'struct xioRealtimeMailbox {', 'xioRealtimeMailbox xio_realtime;'),
+        ('span', 'xio.cpp', 'template <uint16_t _size, typename owner_type, uint8_t _header_count = 8', '}; // LineRXBuffer'),
+    ],
+    'xio_realtime_api.inc': [
+        ('span', 'xio.cpp', 'char xio_get_realtime() {', 'void xio_release_realtime() {\n    return xio_realtime.release();\n}'),
+    ],
+}
+
+# The config system - see config_host.h
+CONFIG = {
+    'util.inc': [
+        ('span', 'util.h', 'char *escape_string(char *dst, char *src, const uint16_t size);', 'char *scan_number(char *str, numberScan_t *n, const bool exponent);'),
+        ('span', 'util.h', '#ifndef EPSILON', '#define fp_TRUE(a) (a > EPSILON)\n#endif'),
+        ('function', 'util.cpp', 'char *escape_string(char *dst, char *src, const uint16_t size)'),
+        ('span', 'util.cpp', 'static const float _pow10_flt[]', '        p[_i2a(p, n)]=\'\\0\';\n        }\n    return (strlen(str));\n}'),
+    ],
+    'config_app.inc': [
+        ('span', 'config_app.cpp', 'cfgParameters_t cfg;', '\n'),
+        ('function', 'config_app.cpp', 'static stat_t _set_int_tests(nvObj_t *nv, int32_t low, int32_t high)'),
+        ('function', 'config_app.cpp', 'stat_t get_integer(nvObj_t *nv, const int32_t value) '),
+        ('function', 'config_app.cpp', 'stat_t set_integer(nvObj_t *nv, uint8_t &value, uint8_t low, uint8_t high) '),
+        ('function', 'config_app.cpp', 'stat_t set_int32(nvObj_t *nv, int32_t &value, int32_t low, int32_t high) '),
+        ('function', 'config_app.cpp', 'bool nv_group_is_prefixed(char *group)'),
+    ],
+    'config_source.inc': [
+        ('source', 'config.cpp'),
+        ('source', 'json_parser.cpp'),
+        ('source', 'text_parser.cpp'),
+    ],
+    'config_table.inc': [
+        ('table', ['config.cpp', 'json_parser.cpp', 'text_parser.cpp']),
+    ],
+}
+
+TESTS = {
+    'plan_path': {
+        'path_types.inc': [
+            ('span', 'planner.h', 'typedef enum {\n    PATH_LINE', '} mpPath_t;'),
+        ],
+        'path_functions.inc': [
+            ('function', 'plan_line.cpp', 'static inline float _dot3(const float a[], const float b[])'),
+            ('function', 'plan_line.cpp', 'stat_t mp_arc(const cmArc_t* arc)'),
+            ('function', 'plan_line.cpp', 'stat_t mp_spline(GCodeState_t* _gm, const float control_1[], const float control_2[])'),
+            ('function', 'plan_line.cpp', 'static void _spline_tangent(const float d1[], const float d2[], const float chord[], float tangent[])'),
+            ('function', 'plan_line.cpp', 'static void _calculate_arc_vmax(mpBuf_t* bf, const float radius, const float planar_fraction)'),
+            ('function', 'plan_exec.cpp', 'static void _exec_path_position(const float travel, float position[])'),
+            ('function', 'plan_exec.cpp', 'static void _exec_arc_step(const float segment_length, float position[])'),
+            ('function', 'plan_exec.cpp', 'static float _exec_spline_speed(const float t)'),
+            ('function', 'planner.cpp', 'bool mp_planner_is_full(const mpPlanner_t *_mp)'),
+            ('function', 'planner.cpp', 'bool mp_free_run_buffer()'),
+            ('function', 'planner.cpp', 'mpSpline_t * mp_get_spline_buffer()'),
+        ],
+    },
+    'config': CONFIG,
+    'status_report': dict(CONFIG, **{
+        'config_table.inc': [
+            ('table', ['config.cpp', 'json_parser.cpp', 'text_parser.cpp', 'report.cpp']),
+        ],
+        'xio_congestion.inc': [
+            ('span', 'xio.h', '#define XIO_TX_CONGESTION_MS', 'after a write had to wait'),
+            ('function', 'xio.cpp', 'bool xio_tx_congested()'),
+        ],
+        'report_source.inc': [
+            ('source', 'report.cpp'),
+        ],
+    }),
+    'number': {
+        'util.inc': [
+            ('span', 'util.h', 'char *escape_string(char *dst, char *src, const uint16_t size);', 'char *scan_number(char *str, numberScan_t *n, const bool exponent);'),
+            ('span', 'util.cpp', 'static const float _pow10_flt[]', '    n->value = _scan_value(n, start, str);\n    return (str);\n}'),
+        ],
+    },
+    'gcode': {
+        'util.inc': [
+            ('span', 'util.h', 'char *escape_string(char *dst, char *src, const uint16_t size);', 'char *scan_number(char *str, numberScan_t *n, const bool exponent);'),
+            ('span', 'util.cpp', 'static const float _pow10_flt[]', '    n->value = _scan_value(n, start, str);\n    return (str);\n}'),
+        ],
+        'gcode_defs.inc': [
+            ('span', 'xio.h', '#define XIO_CHECKSUM_NONE', '#define XIO_CHECKSUM_UNKNOWN -2'),
+            ('span', 'gcode.h', '#define GCODE_MAX_WORDS', '} gcTokens_t;'),
+        ],
+        'gcode_tokenize.inc': [
+            ('function', 'gcode_parser.cpp', 'static stat_t _verify_checksum(char *str, int16_t checksum, bool *has_checksum)'),
+            ('span', 'gcode_parser.cpp', 'enum gcCharClass {', '    return (words_ok);\n}'),
+            ('function', 'gcode_parser.cpp', 'static stat_t _get_next_gcode_word(char **pstr, char *letter, float *value, int32_t *value_int)'),
+            ('function', 'gcode_parser.cpp', 'bool gcode_tokenize(char *block, gcTokens_t *tokens, int16_t checksum)'),
+        ],
+    },
+    'realtime': dict(RX_BUFFER, **{
+        'dispatch_realtime.inc': [
+            ('function', 'controller.cpp', 'static stat_t _dispatch_realtime()'),
+        ],
+    }),
+    'rx_checksum': dict(RX_BUFFER, **{
+        'verify_checksum.inc': [
+            ('function', 'gcode_parser.cpp', 'static stat_t _verify_checksum(char *str, int16_t checksum, bool *has_checksum)'),
+        ],
+    }),
+    'dispatch': {
+        'dispatch_defs.inc': [
+            ('span', 'controller.h', '#define DISPATCH_BATCH_LINES', '// data lines that may be read and tokenized ahead of dispatch'),
+        ],
+        'dispatch.inc': [
+            ('span', 'controller.cpp', 'typedef struct parseAheadLine {', 'static parseAheadQueue_t pa;'),
+            ('function', 'controller.cpp', 'static bool _dispatch_batch_can_continue()'),
+            ('function', 'controller.cpp', 'static stat_t _dispatch_command()'),
+        ],
+    },
+    'offsets': {
+        'offsets_defs.inc': [
+            ('span', 'gcode.h', 'typedef enum {\n    INCHES = 0', '} cmAxisMode;'),
+            ('span', 'canonical_machine.h', '#define _to_millimeters(a)', '// set by cm_set_units_mode()'),
+        ],
+        'offsets.inc': [
+            ('function', 'canonical_machine.cpp', 'void cm_set_absolute_override(GCodeState_t *gcode_state, const uint8_t absolute_override)'),
+            ('function', 'canonical_machine.cpp', 'void cm_update_offsets()'),
+            ('function', 'canonical_machine.cpp', 'float cm_get_combined_offset(const uint8_t axis)'),
+            ('function', 'canonical_machine.cpp', 'float cm_get_display_offset(const GCodeState_t *gcode_state, const uint8_t axis)'),
+            ('function', 'canonical_machine.cpp', 'void cm_set_display_offsets(GCodeState_t *gcode_state)'),
+            ('function', 'canonical_machine.cpp', 'static float _calc_ABC(const uint8_t axis, const float target[])'),
+            ('function', 'canonical_machine.cpp', 'void cm_set_model_target(const float target[], const bool flags[])'),
+            ('function', 'canonical_machine.cpp', 'stat_t cm_set_units_mode(const uint8_t mode)'),
+            ('function', 'canonical_machine.cpp', 'stat_t cm_set_distance_mode(const uint8_t mode)'),
+            ('span', 'canonical_machine.cpp', 'stat_t cm_set_g10_data(', '    cm_update_offsets();\n    return (STAT_OK);\n}'),
+            ('function', 'canonical_machine.cpp', 'static void _exec_offset(float *value, bool *flag)'),
+            ('function', 'canonical_machine.cpp', 'stat_t cm_set_tl_offset(const uint8_t H_word, const bool H_flag, const bool apply_additional)'),
+            ('function', 'canonical_machine.cpp', 'stat_t cm_cancel_tl_offset()'),
+            ('function', 'canonical_machine.cpp', 'stat_t cm_set_coord_system(const uint8_t coord_system)'),
+            ('function', 'canonical_machine.cpp', 'stat_t cm_set_g92_offsets(const float offset[], const bool flag[])'),
+            ('function', 'canonical_machine.cpp', 'stat_t cm_reset_g92_offsets()'),
+            ('function', 'canonical_machine.cpp', 'stat_t cm_suspend_g92_offsets()'),
+            ('function', 'canonical_machine.cpp', 'stat_t cm_resume_g92_offsets()'),
+            ('span', 'canonical_machine.cpp', 'static bool _offsets_deferred = false;', '    _cm_offsets_changed();\n    return (STAT_OK);\n}'),
+            ('function', 'canonical_machine.cpp', 'stat_t cm_set_tof(nvObj_t *nv)'),
+            ('span', 'canonical_machine.cpp', 'static uint16_t _junction_accel_deferred', 'one bit per axis'),
+            ('function', 'canonical_machine.cpp', 'void cm_apply_deferred_settings()'),
+        ],
+    },
+    'persistence': {
+        'persistence_source.inc': [
+            ('source', 'persistence.cpp'),
+        ],
+    },
+}
+
+# Setters that recompute a derived value, or defer it while nv_deferring_derived() is on.
+# config_test.cpp stands in for them with setters that keep the same deferral.
+DERIVED_SETTERS = {
+    'st_set_sa': 'host_set_motor', 'st_set_tr': 'host_set_motor',
+    'st_set_mi': 'host_set_motor', 'st_set_su': 'host_set_motor',
+    'cm_set_jm': 'host_set_axis', 'cm_set_jh': 'host_set_axis',
+    'cm_set_coord': 'host_set_offset', 'cm_set_tof': 'host_set_offset',
+}
+
+TARGETED = {'get_int32', 'get_flt', 'get_data', 'set_int32', 'set_flt', 'set_data'}
+
+
+def read(name):
+    with open(os.path.join(G2CORE, name)) as f:
+        return f.read()
+
+
+def function(source, signature):
+    """return the definition starting with signature, through its closing brace"""
+    start = source.find('\n' + signature)
+    while (start >= 0) and not source[source.index('\n', start + 1):].startswith('\n{'):
+        start = source.find('\n' + signature, start + 1)     # a prototype - skip it
+    if start < 0:
+        sys.exit('extract.py: not found: ' + signature)
+    depth = 0
+    i = source.index('{', start)
+    while True:
+        if source[i] == '{':
+            depth += 1
+        elif source[i] == '}':
+            depth -= 1
+            if depth == 0:
+                return source[start + 1:i + 1] + '\n\n'
+        i += 1
+
+
+def span(source, begin, end):
+    """return the text from begin through end"""
+    start = source.find(begin)
+    if start < 0:
+        sys.exit('extract.py: not found: ' + begin)
+    stop = source.find(end, start)
+    if stop < 0:
+        sys.exit('extract.py: not found: ' + end)
+    return source[start:stop + len(end)] + '\n\n'
+
+
+def without_includes(source):
+    """return the file with its project #includes removed - the test includes what it needs"""
+    return re.sub(r'(?m)^\s*#include\s+"[^"]*".*$', '', source)
+
+
+def config_table(compiled):
+    """
+    return cfgArray and the rest of config_app.cpp's tables, with the bindings the test
+    doesn't build replaced by host stand-ins
+
+    Tokens, flags, precision and the table's #if structure are kept as they are, so the
+    index, hash chains and setting slots are the firmware's. Bindings defined in the
+    compiled files are kept, and their targets point into host_target[]. Every other
+    getter and setter becomes host_get() or a host setter that keeps a value per index.
+    Defaults are 0.
+    """
+    defined = set()
+    for name in compiled:
+        defined.update(re.findall(r'(?m)^(?:stat_t|void)\s+(\w+)\s*\(nvObj_t\s*\*\s*nv\)', read(name)))
+    text = span(read('config_app.cpp'), 'constexpr cfgItem_t cfgArray[] = {', 'uint8_t nv_txn_touched[(NV_SETTINGS + 7) / 8];')
+    rows = 0
+    lines = []
+    for line in text.split('\n'):
+        m = re.match(r'^(\s*)\{(.*?)\}(.*)$', line)
+        if (m is None) or not m.group(2).lstrip().startswith('"'):
+            lines.append(line)
+            continue
+        f = [x.strip() for x in m.group(2).split(',')]
+        print_, get, set_ = f[4:7]
+        print_ = print_ if print_ in defined else 'host_print'
+        get = get if get in defined else 'host_get'
+        set_ = set_ if set_ in defined else DERIVED_SETTERS.get(set_, 'host_set')
+        target = '&host_target[%d]' % rows if (get in TARGETED) or (set_ in TARGETED) else 'nullptr'
+        lines.append('%s{ %s, %s, %s, %s, %s, %s, %s, %s, 0 }%s' %
+                     (m.group(1), f[0], f[1], f[2], f[3], print_, get, set_, target, m.group(3)))
+        rows += 1
+    return 'static uint32_t host_target[%d];\n\n' % rows + '\n'.join(lines)
+
+
+def extract(item):
+    kind = item[0]
+    if kind == 'function':
+        return function(read(item[1]), item[2])
+    if kind == 'span':
+        return span(read(item[1]), item[2], item[3])
+    if kind == 'source':
+        return '#line 1 "%s"\n' % item[1] + without_includes(read(item[1])) + '\n'
+    if kind == 'table':
+        return config_table(item[1])
+    sys.exit('extract.py: unknown item ' + kind)
+
+
+def main():
+    if (len(sys.argv) != 3) or (sys.argv[1] not in TESTS):
+        sys.exit('usage: extract.py <%s> <output directory>' % '|'.join(sorted(TESTS)))
+    out = sys.argv[2]
+    for name, items in TESTS[sys.argv[1]].items():
+        with open(os.path.join(out, name), 'w') as f:
+            for item in items:
+                f.write(extract(item))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,301 @@
+/*
+ * gcode_tokenize_test.cpp - host test and benchmark of the Gcode tokenizer used for parse-ahead
+ * This file is part of the g2core project
+ *
+ * Builds gcode_tokenize() and what it calls - _verify_checksum(), _lex_gcode_block() and
+ * scan_number() - as they are, with _get_next_gcode_word(), which walks a normalized block
+ * when it is parsed as text. Checked:
+ *
+ *  - hand picked blocks normalize to the text and words expected: case, white space,
+ *    leading zeros, block delete, plain, active and MSG comments, ';' and '%' endings
+ *  - on a million generated lines, the words captured by the tokenizer are the ones
+ *    _get_next_gcode_word() reads from the normalized block - letter, value and integer
+ *    value, and the offset of the rest of the block - so gcode_parser_tokens() parses the
+ *    same block gcode_parser() would. A line the tokenizer declines is one the text path
+ *    reports an error for, or one with more than GCODE_MAX_WORDS words
+ *  - a checksum computed as the line was received gives the same result as one computed
+ *    from the text
+ *  - _parse_ahead() tokenizes a copy placed after the line text, and only for lines under
+ *    RX_BUFFER_SIZE/3. The worst growth - an MSG comment of quotes, each escaped - stays
+ *    inside the parse-ahead line buffer for every length up to that limit
+ *
+ * The benchmark times gcode_tokenize() per line of a typical job - the work parse-ahead moves
+ * out of dispatch into the time the planner is full - against walking the captured words,
+ * which is what is left for dispatch.
+ *
+ * Run it with run_gcode_tokenize_test.sh. It prints the measurements and exits non-zero on failure.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+using std::isnan;
+using std::isinf;
+using std::min;
+using std::max;
+
+#include "g2core.h"
+
+#define NUL (char)0x00
+#define RX_BUFFER_SIZE 512                      // as xio.h
+#define MARLIN_COMPAT_ENABLED false
+
+inline void debug_trap(const char *reason) {}
+
+#include "util.inc"
+#include "gcode_defs.inc"
+#include "gcode_tokenize.inc"
+
+typedef std::chrono::steady_clock host_clock;
+
+static int failures = 0;
+
+static void check(bool ok, const char *what, const char *line = "")
+{
+    if (!ok) {
+        if (failures++ < 20) {
+            printf("FAIL: %s: %s\n", what, line);
+        }
+    }
+}
+
+static int16_t received_checksum(const char *line)  // as xio computes it while scanning the line
+{
+    int16_t checksum = 0;
+    for (const char *p = line; *p != NUL; p++) {
+        if (*p == '*') {
+            return (checksum);
+        }
+        checksum ^= (uint8_t)*p;
+    }
+    return (XIO_CHECKSUM_NONE);
+}
+
+static void test_blocks()
+{
+    struct { const char *line; const char *block; int words; const char *comment; } cases[] = {
+        { "g1 x100 Y100 f400",              "G1X100Y100F400",   4, "" },
+        { "G0 X-0123.004 y00.5",            "G0X-123.004Y0.5",  3, "" },
+        { "/G1 X1",                         "G1X1",             2, "" },
+        { "G0 ({xv:1}) x10 (comment)",      "G0X10",            2, "{xv:1}" },
+        { "M100 ({a:t}) (c) ({b:f}) (c)",   "M100",             1, "{a:t,b:f}" },
+        { "M0 (MSG Change tool)",           "M0",               1, "{msg:\"Change tool\"}" },
+        { "G1 X1 ; the rest Y2",            "G1X1",             2, "" },
+        { "G1 X1 % Y2",                     "G1X1",             2, "" },
+        { "(just a comment)",               "",                 0, "" },
+        { "N10 G1 X1*80",                   "N10G1X1",          3, "" },
+        { "G1\tX1\x01 Y2\x7f",              "G1X1Y2",           3, "" },
+    };
+    for (auto &c : cases) {
+        char buf[RX_BUFFER_SIZE];
+        strcpy(buf, c.line);
+        gcTokens_t tokens;
+        bool ok = gcode_tokenize(buf, &tokens, XIO_CHECKSUM_UNKNOWN);
+        check(ok && (tokens.status == STAT_OK), "tokenized", c.line);
+        check(strcmp(tokens.block, c.block) == 0, "normalized block", c.line);
+        check(tokens.word_count == c.words, "word count", c.line);
+        check(strcmp(tokens.active_comment, c.comment) == 0, "active comment", c.line);
+    }
+    char buf[RX_BUFFER_SIZE];
+    gcTokens_t tokens;
+    strcpy(buf, "/G1 X1");
+    gcode_tokenize(buf, &tokens, XIO_CHECKSUM_UNKNOWN);
+    check(tokens.block_delete, "block delete is flagged");
+    strcpy(buf, "N10 G1 X1*81");
+    gcode_tokenize(buf, &tokens, XIO_CHECKSUM_UNKNOWN);
+    check(tokens.status == STAT_CHECKSUM_MATCH_FAILED, "a wrong checksum is deferred to the parse");
+    strcpy(buf, "G1 X1*63");
+    gcode_tokenize(buf, &tokens, XIO_CHECKSUM_UNKNOWN);
+    check(tokens.status == STAT_MISSING_LINE_NUMBER_WITH_CHECKSUM, "a checksum needs a line number");
+
+    const char *declined[] = { "G1 X", "G1 X1.2.3", "G1 XY1", "1 X1", "G1 X--1" };
+    for (const char *line : declined) {
+        strcpy(buf, line);
+        check(!gcode_tokenize(buf, &tokens, XIO_CHECKSUM_UNKNOWN), "a malformed word is declined", line);
+    }
+    printf("blocks: %d normalized as expected\n", (int)(sizeof(cases) / sizeof(cases[0])));
+}
+
+static uint32_t seed = 1;
+static uint32_t random_u32()
+{
+    seed ^= seed << 13;                         // xorshift32
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return (seed);
+}
+
+static std::string random_number()
+{
+    char str[32];
+    switch (random_u32() % 6) {
+        case 0:  sprintf(str, "%u", random_u32() % 100); break;
+        case 1:  sprintf(str, "%d.%03u", (int)(random_u32() % 2000) - 1000, random_u32() % 1000); break;
+        case 2:  sprintf(str, "-%u.%u", random_u32() % 100, random_u32() % 10); break;
+        case 3:  sprintf(str, "00%u.5", random_u32() % 100); break;        // octal-looking
+        case 4:  sprintf(str, ".%u", random_u32() % 10000); break;
+        default: sprintf(str, "%u", random_u32()); break;                 // line numbers past 2^24
+    }
+    return (str);
+}
+
+static std::string random_line()
+{
+    static const char letters[] = "GMXYZABCFIJKNPRSTgxyzfn";
+    static const char *noise[] = { " ", "  ", "\t", "(plain)", "({xv:1})", "(msg hi \"there\")", "\x7f", "$" };
+    static const char *malformed[] = { ".", "-", "X", "--", "G." };
+    std::string line = (random_u32() % 20 == 0) ? "/" : "";
+    int words = random_u32() % 24;
+    for (int w=0; w < words; w++) {
+        line += letters[random_u32() % (sizeof(letters)-1)];
+        if (random_u32() % 4 == 0) {
+            line += ' ';
+        }
+        line += random_number();
+        if (random_u32() % 3 == 0) {
+            line += noise[random_u32() % (sizeof(noise) / sizeof(noise[0]))];
+        }
+        if (random_u32() % 64 == 0) {
+            line += malformed[random_u32() % (sizeof(malformed) / sizeof(malformed[0]))];
+        }
+    }
+    switch (random_u32() % 10) {
+        case 0: line += " ; trailing comment X1"; break;
+        case 1: line = "N" + std::to_string(random_u32() % 100000) + line;
+                line += "*" + std::to_string(received_checksum(line.c_str()) ^ ((random_u32() % 8 == 0) ? 1 : 0)); break;
+    }
+    return (line.substr(0, RX_BUFFER_SIZE / 3 - 1));
+}
+
+static void test_words()
+{
+    const int lines = 1000000;
+    int declined = 0, too_many = 0;
+    for (int n=0; n < lines; n++) {
+        std::string line = random_line();
+        char buf[RX_BUFFER_SIZE], copy[RX_BUFFER_SIZE];
+        strcpy(buf, line.c_str());
+        strcpy(copy, line.c_str());
+        gcTokens_t tokens, received;
+        bool ok = gcode_tokenize(buf, &tokens, XIO_CHECKSUM_UNKNOWN);
+        bool ok_received = gcode_tokenize(copy, &received, received_checksum(line.c_str()));
+        check((ok == ok_received) && (tokens.status == received.status) && (tokens.checksum == received.checksum) &&
+              (strcmp(buf, copy) == 0), "a received checksum matches one computed from the text", line.c_str());
+        if (tokens.status != STAT_OK) {
+            continue;
+        }
+
+        char *pstr = tokens.block;              // what the text path reads from the same block
+        char letter;
+        float value;
+        int32_t value_int;
+        stat_t status;
+        int i = 0;
+        bool same = true;
+        while ((status = _get_next_gcode_word(&pstr, &letter, &value, &value_int)) == STAT_OK) {
+            if (ok) {
+                gcWord_t *w = &tokens.words[i];
+                same &= (i < tokens.word_count) && (w->letter == letter) && (memcmp(&w->value, &value, sizeof(value)) == 0) &&
+                        (w->value_int == value_int) && (tokens.block + w->rest == pstr);
+            }
+            i++;
+        }
+        if (ok) {
+            check(same && (i == tokens.word_count) && (status == STAT_COMPLETE), "tokens match the text path", line.c_str());
+        } else {
+            declined++;
+            too_many += (status == STAT_COMPLETE) ? 1 : 0;
+            check((status != STAT_COMPLETE) || (i > GCODE_MAX_WORDS), "a declined line is an error on the text path", line.c_str());
+        }
+    }
+    printf("words: %d generated lines, %d declined (%d for too many words)\n", lines, declined, too_many);
+}
+
+static void test_parse_ahead_bound()
+{
+    const int limit = RX_BUFFER_SIZE / 3;       // _parse_ahead() tokenizes lines shorter than this
+    int worst = 0;
+    for (int len=1; len < limit; len++) {
+        for (int closed=0; closed < 2; closed++) {
+            std::string line = "(msg" + std::string(max(len - 4 - closed, 0), '"') + (closed ? ")" : "");
+            line.resize(len);
+            char buf[RX_BUFFER_SIZE + 16];      // a parse-ahead line and a canary
+            memset(buf, 0x55, sizeof(buf));
+            strcpy(buf, line.c_str());
+            char *block = buf + line.size() + 1;
+            strcpy(block, line.c_str());
+            gcTokens_t tokens;
+            gcode_tokenize(block, &tokens, XIO_CHECKSUM_NONE);
+            int used = (tokens.active_comment + strlen(tokens.active_comment) + 1) - buf;
+            worst = max(worst, used);
+            bool canary = true;
+            for (size_t i = RX_BUFFER_SIZE; i < sizeof(buf); i++) {
+                canary &= (buf[i] == 0x55);
+            }
+            check((used <= RX_BUFFER_SIZE) && canary, "a parse-ahead block stays in its line buffer", line.c_str());
+        }
+    }
+    printf("parse-ahead: the worst line under %d characters uses %d of %d bytes\n", limit, worst, RX_BUFFER_SIZE);
+}
+
+static void benchmark()
+{
+    std::vector<std::string> job;               // CAM output - short moves, a few comments and M-codes
+    for (int n=0; n < 10000; n++) {
+        char line[80];
+        switch (n % 50) {
+            case 0:  sprintf(line, "(Pass %d)", n / 50); break;
+            case 1:  sprintf(line, "G0 Z5.000"); break;
+            case 2:  sprintf(line, "M3 S12000"); break;
+            default: sprintf(line, "G1 X%d.%03d Y%d.%03d F1500", n % 300, (n * 7) % 1000, (n * 3) % 200, (n * 11) % 1000);
+        }
+        job.push_back(line);
+    }
+    static char bufs[10000][RX_BUFFER_SIZE / 2];
+    static gcTokens_t tokens[10000];
+    const int rounds = 20;
+    double tokenize = 0, walk = 0;
+    volatile float sink = 0;
+    for (int r=0; r < rounds; r++) {
+        for (size_t n=0; n < job.size(); n++) {
+            strcpy(bufs[n], job[n].c_str());
+        }
+        host_clock::time_point start = host_clock::now();
+        for (size_t n=0; n < job.size(); n++) {
+            gcode_tokenize(bufs[n], &tokens[n], XIO_CHECKSUM_NONE);
+        }
+        tokenize += std::chrono::duration<double>(host_clock::now() - start).count();
+        start = host_clock::now();
+        for (size_t n=0; n < job.size(); n++) {
+            for (uint8_t i=0; i < tokens[n].word_count; i++) {
+                sink += tokens[n].words[i].value;
+            }
+        }
+        walk += std::chrono::duration<double>(host_clock::now() - start).count();
+    }
+    double lines = (double)rounds * job.size();
+    printf("benchmark: %.1f ns per line to tokenize (moved ahead), %.1f ns to walk the words at dispatch\n",
+           tokenize / lines * 1e9, walk / lines * 1e9);
+}
+
+int main()
+{
+    test_blocks();
+    test_words();
+    test_parse_ahead_bound();
+    benchmark();
+
+    if (failures) {
+        printf("%d FAILED\n", failures);
+        return (1);
+    }
+    printf("PASS\n");
+    return (0);
+}
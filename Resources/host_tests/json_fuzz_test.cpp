@@ -0,0 +1,186 @@
+/*
+ * json_fuzz_test.cpp - JSON parser seed corpus, mutation fuzzer and benchmark
+ * This file is part of the g2core project
+ *
+ * Builds the config system as it is (see config_host.h) with AddressSanitizer and
+ * UndefinedBehaviorSanitizer, so any read or write outside the input line, the nv list or
+ * the output buffer stops the test.
+ *
+ *  - corpus: every line in json_corpus.txt parses to the status recorded for it
+ *  - fuzz: each corpus line is mutated (bytes flipped, replaced with JSON punctuation,
+ *    inserted, deleted, truncated, spliced with another line, runs repeated) and run
+ *    through json_parser(), response and all. Each input sits at the very end of its own
+ *    heap block, so reading past its terminating NUL is caught. The generator is seeded,
+ *    so a failure reproduces; pass a different seed and count to explore further.
+ *  - benchmark: parse time per corpus line, for the parse alone and with the response
+ *
+ *      json_fuzz_test <corpus> [iterations] [seed]
+ *
+ * Run it with run_json_fuzz_test.sh. It exits non-zero on failure.
+ */
+
+#include "config_host.h"
+
+#include <fstream>
+
+typedef std::chrono::steady_clock host_clock;
+
+#define LINE_MAX_CHARS (RX_BUFFER_SIZE-1)           // the longest line xio hands over
+
+struct seedLine {
+    stat_t status;
+    std::string line;
+};
+
+static const struct { const char *name; stat_t status; } statuses[] = {
+    { "OK", STAT_OK },
+    { "UNRECOGNIZED_NAME", STAT_UNRECOGNIZED_NAME },
+    { "BAD_NUMBER_FORMAT", STAT_BAD_NUMBER_FORMAT },
+    { "VALUE_TYPE_ERROR", STAT_VALUE_TYPE_ERROR },
+    { "JSON_SYNTAX_ERROR", STAT_JSON_SYNTAX_ERROR },
+    { "JSON_TOO_MANY_PAIRS", STAT_JSON_TOO_MANY_PAIRS },
+    { "INPUT_EXCEEDS_MAX_LENGTH", STAT_INPUT_EXCEEDS_MAX_LENGTH },
+};
+
+static std::vector<seedLine> read_corpus(const char *file)
+{
+    std::vector<seedLine> corpus;
+    std::ifstream in(file);
+    std::string text;
+    while (std::getline(in, text)) {
+        if (text.empty() || (text[0] == '#')) {
+            continue;
+        }
+        size_t space = text.find(' ');
+        seedLine seed = { 0xFF, text.substr(space + 1) };
+        for (auto &s : statuses) {
+            if (text.compare(0, space, s.name) == 0) {
+                seed.status = s.status;
+            }
+        }
+        if (seed.status == 0xFF) {
+            printf("json_corpus: unknown status in: %s\n", text.c_str());
+            exit(1);
+        }
+        corpus.push_back(seed);
+    }
+    return (corpus);
+}
+
+static stat_t parse(const std::string &line, const bool respond)  // as the controller hands a line over
+{
+    char *buf = (char *)malloc(line.size() + 1);    // no slack - an overread hits the redzone
+    memcpy(buf, line.c_str(), line.size() + 1);
+    cs.bufp = buf;
+    strncpy(cs.saved_buf, buf, SAVED_BUFFER_LEN-1);     // _dispatch_kernel() saves the line for reporting
+    stat_t status = STAT_OK;
+    if (respond) {
+        json_parser(buf);
+    } else {
+        status = _json_parser_kernal(nv_reset_nv_list(), buf);
+    }
+    free(buf);
+    return (status);
+}
+
+static void finish_line()                       // what the main loop does before the next line
+{
+    while (nv_dump_is_running()) {
+        nv_dump_callback();                         // a {dump:...} streams to the end
+    }
+    nv_txn_abort();                                 // a {txn:1} would hold later lines' sets
+}
+
+static uint32_t seed = 1;
+static uint32_t random_u32()
+{
+    seed ^= seed << 13;                             // xorshift32
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return (seed);
+}
+
+static const char punctuation[] = "{}[]\":,.-+eE0123456789 nt\\\x7f\x01";
+
+static std::string mutate(const std::vector<seedLine> &corpus, std::string s)
+{
+    int edits = 1 + random_u32() % 4;
+    while (edits--) {
+        size_t at = s.empty() ? 0 : random_u32() % s.size();
+        switch (random_u32() % 7) {
+            case 0: if (!s.empty()) { s[at] ^= 1 << (random_u32() % 8); } break;
+            case 1: if (!s.empty()) { s[at] = punctuation[random_u32() % (sizeof(punctuation)-1)]; } break;
+            case 2: s.insert(at, 1, punctuation[random_u32() % (sizeof(punctuation)-1)]); break;
+            case 3: if (!s.empty()) { s.erase(at, 1 + random_u32() % 4); } break;
+            case 4: s.resize(at); break;
+            case 5: { const std::string &other = corpus[random_u32() % corpus.size()].line;
+                      s = s.substr(0, at) + other.substr(min(at % 8, other.size())); break; }
+            case 6: if (!s.empty()) { s.insert(at, s.substr(at, 1 + random_u32() % 8), 0, std::string::npos);
+                                      for (int r = random_u32() % 64; r > 0; r--) { s.insert(at, 1, s[at]); } } break;
+        }
+    }
+    s.erase(std::remove(s.begin(), s.end(), NUL), s.end());  // lines never hold a NUL
+    if (s.size() > LINE_MAX_CHARS) {
+        s.resize(LINE_MAX_CHARS);
+    }
+    return (s);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        printf("usage: json_fuzz_test <corpus> [iterations] [seed]\n");
+        return (1);
+    }
+    uint32_t iterations = (argc > 2) ? strtoul(argv[2], NULL, 0) : 2000000;
+    seed = (argc > 3) ? strtoul(argv[3], NULL, 0) : 1;
+    const uint32_t first_seed = seed;
+
+    cs.comm_mode = JSON_MODE;
+    config_init();
+    js.json_mode = JSON_MODE;
+    js.json_verbosity = JV_CONFIGS;                 // responses echo everything that was parsed
+
+    int failures = 0;
+    std::vector<seedLine> corpus = read_corpus(argv[1]);
+    for (const seedLine &s : corpus) {
+        stat_t status = parse(s.line, false);
+        if (status != s.status) {
+            printf("FAIL: %s - status %d, expected %d\n", s.line.c_str(), status, s.status);
+            failures++;
+        }
+        parse(s.line, true);
+        finish_line();
+    }
+    printf("corpus: %d lines\n", (int)corpus.size());
+
+    host_clock::time_point start = host_clock::now();
+    for (uint32_t n=0; n < iterations; n++) {
+        std::string line = mutate(corpus, corpus[random_u32() % corpus.size()].line);
+        parse(line, true);
+        finish_line();
+    }
+    printf("fuzz: %u mutated lines in %.1f s (seed %u)\n", iterations,
+           std::chrono::duration<double>(host_clock::now() - start).count(), (unsigned)first_seed);
+
+    const int rounds = 2000;
+    double times[2];
+    for (int respond=0; respond < 2; respond++) {
+        start = host_clock::now();
+        for (int r=0; r < rounds; r++) {
+            for (const seedLine &s : corpus) {
+                parse(s.line, respond);
+                finish_line();
+            }
+        }
+        times[respond] = std::chrono::duration<double>(host_clock::now() - start).count() / (rounds * corpus.size());
+    }
+    printf("benchmark (sanitized build): %.0f ns per corpus line to parse, %.0f ns with the response\n", times[0] * 1e9, times[1] * 1e9);
+
+    if (failures) {
+        printf("%d FAILED\n", failures);
+        return (1);
+    }
+    printf("PASS\n");
+    return (0);
+}
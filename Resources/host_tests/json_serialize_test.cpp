@@ -0,0 +1,300 @@
+/*
+ * json_serialize_test.cpp - host test and benchmark of the bounds-checked json_serialize()
+ * This file is part of the g2core project
+ *
+ * Builds the config system as it is (see config_host.h). The nv lists serialized are the
+ * responses the firmware sends: one for every corpus line in json_corpus.txt, one for every
+ * cfgArray token asked for on its own (groups expand to all their members), and a list with
+ * every value type at its longest - a string value that fills most of the buffer,
+ * INT32_MIN, hex data, nested parents left open. Checked:
+ *
+ *  - the response json_serialize() writes is byte for byte the one the serializer wrote
+ *    before every write was bounds-checked (reference_serialize() below, kept as it was)
+ *  - for every buffer size from 1 to one past the response, nothing is written past the
+ *    end of the buffer; a buffer too small gives -1 and an empty string, and one big
+ *    enough gives the whole response and its length
+ *
+ * The benchmark times both serializers over the same responses, into a buffer big enough
+ * for the old one.
+ *
+ *      json_serialize_test <corpus>
+ *
+ * Run it with run_json_serialize_test.sh. It prints the measurements and exits non-zero on failure.
+ */
+
+#include "config_host.h"
+
+#include <fstream>
+
+typedef std::chrono::steady_clock host_clock;
+
+static int failures = 0;
+
+static void check(bool ok, const char *what, const char *detail = "")
+{
+    if (!ok) {
+        if (failures++ < 20) {
+            printf("FAIL: %s: %s\n", what, detail);
+        }
+    }
+}
+
+/*
+ * reference_serialize() - json_serialize() as it was before every write was bounds-checked.
+ * It checks for overrun only after each whole object, so it is only run into a buffer far
+ * bigger than any response.
+ */
+static uint16_t reference_serialize(nvObj_t *nv, char *out_buf, uint16_t size)
+{
+    char *str = out_buf;
+    char *str_max = out_buf + size;
+    int8_t initial_depth = nv->depth;
+    int8_t prev_depth = 0;
+    uint8_t need_a_comma = false;
+
+    *str++ = '{';                                 // write opening curly
+
+    while (true) {
+        if (nv->valuetype != TYPE_EMPTY) {
+            if (need_a_comma) { *str++ = ',';}
+            need_a_comma = true;
+            strcpy(str++, "\"");
+            strcpy(str, nv->token); str += strlen(nv->token);
+            strcpy(str++, "\":"); str++;
+
+            switch (nv->valuetype)  {
+                case (TYPE_EMPTY):  {   break; }
+                case (TYPE_NULL):   {   strcpy(str, "null");
+                                        str += 4;
+                                        break;
+                                    }
+                case (TYPE_PARENT): {   *str++ = '{';
+                                        need_a_comma = false;
+                                        break;
+                                    }
+                case (TYPE_FLOAT):  {   convert_outgoing_float(nv);
+                                        str += floattoa(str, nv->value_flt, nv->precision);
+                                        break;
+                                    }
+                case (TYPE_INTEGER):{   str += sprintf(str, "%d", (int)nv->value_int);
+                                        break;
+                                    }
+                case (TYPE_STRING): {   *str++ = '"';
+                                        strcpy(str, *nv->stringp);
+                                        str += strlen(*nv->stringp);
+                                        *str++ = '"';
+                                        break;
+                                    }
+                case (TYPE_BOOLEAN):{   if (nv->value_int) {
+                                            strcpy(str, "false");
+                                            str += 5;
+                                        } else {
+                                            strcpy(str, "true");
+                                            str += 4;
+                                        }
+                                        break;
+                                    }
+                case (TYPE_DATA):   {   uint32_t *v = (uint32_t*)&nv->value_flt;
+                                        str += sprintf(str, "\"0x%lx\"", (unsigned long)*v);
+                                        break;
+                                    }
+                case (TYPE_ARRAY):  {   strcpy(str++, "[");
+                                        strcpy(str, *nv->stringp);
+                                        str += strlen(*nv->stringp);
+                                        strcpy(str++, "]");
+                                        break;
+                                    }
+                default: {}
+            }
+        }
+        if (str >= str_max) { return (-1);}     // signal buffer overrun
+        if ((nv = nv->nx) == NULL) { break;}    // end of the list
+
+        while (nv->depth < prev_depth--) {      // iterate the closing curlies
+            need_a_comma = true;
+            *str++ = '}';
+        }
+        prev_depth = nv->depth;
+    }
+
+    // closing curlies and NEWLINE
+    while (prev_depth-- > initial_depth) {
+        *str++ = '}';
+    }
+    str += sprintf((char *)str, "}\n");         // using sprintf for this last one ensures a NUL termination
+    if (str > out_buf + size) {
+        return (-1);
+    }
+    return (str - out_buf);
+}
+
+/*
+ * A response is kept as a copy of the nv list the firmware serialized, with its links
+ * pointing into the copy, so it can be serialized again after the list is reused.
+ */
+struct response {
+    std::vector<nvObj_t> list;
+    std::vector<std::string> strings;
+    std::string text;                               // what the firmware sent, if anything
+};
+
+static std::vector<response> responses;
+
+static void keep_response(const char *text)
+{
+    response r;
+    for (nvObj_t *nv = nv_header; nv != NULL; nv = nv->nx) {
+        r.list.push_back(*nv);
+        bool has_string = (nv->valuetype == TYPE_STRING) || (nv->valuetype == TYPE_ARRAY);
+        r.strings.push_back(has_string ? *nv->stringp : "");
+    }
+    r.text = text;
+    responses.push_back(r);
+}
+
+static void link(response &r)                       // point the copy's links at itself
+{
+    for (size_t i=0; i < r.list.size(); i++) {
+        r.list[i].nx = (i + 1 < r.list.size()) ? &r.list[i+1] : NULL;
+        r.list[i].stringp = (char (*)[])&r.strings[i][0];
+    }
+}
+
+static void respond(const std::string &line)
+{
+    cs.comm_mode = JSON_MODE;                       // corpus lines may have changed them
+    js.json_mode = JSON_MODE;
+    js.json_verbosity = JV_CONFIGS;                 // responses echo everything that was parsed
+    char buf[RX_BUFFER_SIZE];
+    strncpy(buf, line.c_str(), sizeof(buf)-1);
+    buf[sizeof(buf)-1] = NUL;
+    cs.bufp = buf;
+    strncpy(cs.saved_buf, buf, SAVED_BUFFER_LEN-1);
+    host_output.clear();
+    host_capture = true;
+    json_parser(buf);
+    host_capture = false;
+    keep_response(host_output.empty() ? "" : host_output.back().c_str());
+    while (nv_dump_is_running()) {
+        nv_dump_callback();
+    }
+    nv_txn_abort();
+}
+
+static void collect(const char *corpus)
+{
+    std::ifstream in(corpus);
+    std::string text;
+    while (std::getline(in, text)) {
+        if (!text.empty() && (text[0] != '#')) {
+            respond(text.substr(text.find(' ') + 1));
+        }
+    }
+    for (index_t i=0; i < nv_index_max(); i++) {
+        respond(std::string("{\"") + cfgArray[i].token + "\":n}");
+    }
+
+    static char text_value[OUTPUT_BUFFER_LEN];      // every value type at its longest
+    memset(text_value, 'a', OUTPUT_BUFFER_LEN - 100);
+    nv_reset_nv_list();
+    nv_add_string("msg", text_value);
+    nv_add_integer("n", INT32_MIN);
+    nv_add_integer("line", INT32_MAX);
+    nv_add_data("data", 0xFFFFFFFF);
+    nv_add_data("zero", 0);
+    nv_add_float("v", -123456.789);
+    nvObj_t *nv = nv_add_integer("bool", 1);
+    nv->valuetype = TYPE_BOOLEAN;
+    nv = nv_add_integer("null", 0);
+    nv->valuetype = TYPE_NULL;
+    nv = nv_add_integer("p", 0);
+    nv->valuetype = TYPE_PARENT;                    // a parent left open, closed at the end
+    nv = nv_add_integer("q", 0);
+    nv->depth = 2;
+    nv = nv_add_string("f", "1,0,255");
+    nv->valuetype = TYPE_ARRAY;
+    nv->nx = NULL;
+    keep_response("");
+}
+
+static bool canary_intact(const char *buf, const int size)
+{
+    for (int i = size; i < size + 16; i++) {
+        if (buf[i] != 0x55) {
+            return (false);
+        }
+    }
+    return (true);
+}
+
+static void test_bounds()
+{
+    int sizes = 0, longest = 0, sent = 0;
+    for (response &r : responses) {
+        link(r);
+
+        static char reference[4096], big[4096];
+        uint16_t reference_len = reference_serialize(&r.list[0], reference, sizeof(reference));
+        int16_t len = json_serialize(&r.list[0], big, sizeof(big));
+        check((len == (int16_t)reference_len) && (strcmp(big, reference) == 0), "the response is what it was before", reference);
+        if (!r.text.empty() && (r.text[0] == '{')) {         // {"ej":0} answers in text
+            check(r.text == big, "the firmware sent the same response", (r.text + " vs " + big).c_str());
+            sent++;
+        }
+        longest = max(longest, (int)len);
+
+        std::vector<char> buf(len + 2 + 16);
+        for (int size = 1; size <= len + 2; size++) {
+            memset(buf.data(), 0x55, buf.size());
+            int16_t got = json_serialize(&r.list[0], buf.data(), size);
+            bool fits = (size > len);
+            check(canary_intact(buf.data(), size), "nothing is written past the buffer", reference);
+            if (fits) {
+                check((got == len) && (strcmp(buf.data(), reference) == 0), "a buffer big enough gets the whole response", reference);
+            } else {
+                check((got == -1) && (buf[0] == NUL), "a buffer too small gets -1 and an empty string", reference);
+            }
+            sizes++;
+        }
+    }
+    printf("bounds: %d responses (%d as sent by the firmware), longest %d bytes, %d buffer sizes\n",
+           (int)responses.size(), sent, longest, sizes);
+}
+
+static void benchmark()
+{
+    const int rounds = 200;
+    static char buf[4096];
+    double times[2] = { 0, 0 };
+    volatile int sink = 0;
+    for (int old=0; old < 2; old++) {
+        host_clock::time_point start = host_clock::now();
+        for (int round=0; round < rounds; round++) {
+            for (response &r : responses) {
+                link(r);
+                sink += old ? reference_serialize(&r.list[0], buf, sizeof(buf)) : json_serialize(&r.list[0], buf, sizeof(buf));
+            }
+        }
+        times[old] = std::chrono::duration<double>(host_clock::now() - start).count() / (rounds * responses.size());
+    }
+    printf("benchmark: %.0f ns per response bounds-checked, %.0f ns before\n", times[0] * 1e9, times[1] * 1e9);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        printf("usage: json_serialize_test <corpus>\n");
+        return (1);
+    }
+    config_init();
+    collect(argv[1]);
+    test_bounds();
+    benchmark();
+
+    if (failures) {
+        printf("%d FAILED\n", failures);
+        return (1);
+    }
+    printf("PASS\n");
+    return (0);
+}
@@ -0,0 +1,194 @@
+/*
+ * number_test.cpp - exhaustive rounding test and benchmark of scan_number()
+ * This file is part of the g2core project
+ *
+ * Builds scan_number() from util.cpp as it is and checks it against glibc strtof(), which
+ * is correctly rounded, bit for bit. Each family below is covered completely:
+ *
+ *  - every decimal of up to 7 significant digits, with the point in every position and
+ *    both signs ("1234567", "123.4567", ".1234567") - the Gcode and JSON numbers that
+ *    take the exact float path
+ *  - every float in the binades [1,2), [1024,2048) and [2^-10,2^-9), printed with 9
+ *    significant digits so it reads back to itself - the double path
+ *  - the point halfway between each pair of adjacent floats in [1,2) and [2^24,2^25), to
+ *    17 digits - the double lands on the float midpoint and must go to strtof()
+ *  - mantissas 1-99999 with every exponent from e-45 to e+38 (JSON only)
+ *
+ * value_int is checked against the integer part (as atol() reads it) throughout, and the
+ * end pointer against strtof()'s.
+ *
+ * Run it with run_number_test.sh. It prints the counts and timings and exits non-zero on failure.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <chrono>
+#include <algorithm>
+
+using std::isnan;
+using std::isinf;
+using std::min;
+using std::max;
+
+#include "g2core.h"
+
+#define NUL (char)0x00
+
+#include "util.inc"
+
+typedef std::chrono::steady_clock host_clock;
+
+static uint64_t checked = 0;
+static uint64_t failures = 0;
+
+static void check(const char *str, const bool exponent)
+{
+    numberScan_t n;
+    char buf[64];
+    strcpy(buf, str);
+    char *end = scan_number(buf, &n, exponent);
+
+    char *want_end;
+    float want = strtof(buf, &want_end);
+    long want_int = atol(buf);
+    uint32_t got_bits, want_bits;
+    memcpy(&got_bits, &n.value, 4);
+    memcpy(&want_bits, &want, 4);
+
+    checked++;
+    if ((got_bits != want_bits) || (n.value_int != (int32_t)want_int) || (end != want_end)) {
+        if (failures++ < 20) {
+            printf("FAIL: \"%s\" read %.9g (int %ld, %d chars) - strtof %.9g (int %ld, %d chars)\n", str, (double)n.value,
+                   (long)n.value_int, (int)(end - buf), (double)want, want_int, (int)(want_end - buf));
+        }
+    }
+}
+
+static void decimals()                          // every decimal of up to 7 significant digits
+{
+    char digits[16], str[32];
+    for (uint32_t m=0; m < 10000000; m++) {
+        int len = sprintf(digits, "%u", m);
+        for (int point=0; point <= 7; point++) {
+            char *p = str;
+            if (m & 1) {
+                *p++ = '-';                     // half of them negative
+            }
+            if (point == 0) {
+                strcpy(p, digits);
+            } else if (point >= len) {
+                *p++ = '.';
+                for (int z = point - len; z > 0; z--) {
+                    *p++ = '0';
+                }
+                strcpy(p, digits);
+            } else {
+                memcpy(p, digits, len - point);
+                p += len - point;
+                *p++ = '.';
+                strcpy(p, digits + len - point);
+            }
+            check(str, false);
+        }
+    }
+}
+
+static void binade(const float low)             // every float in [low, 2*low), 9 digits
+{
+    char str[32];
+    uint32_t bits;
+    memcpy(&bits, &low, 4);
+    for (uint32_t i=0; i < (1UL << 23); i++, bits++) {
+        float f;
+        memcpy(&f, &bits, 4);
+        sprintf(str, "%.9g", (double)f);
+        check(str, true);
+    }
+}
+
+static void midpoints(const float low)          // halfway between each pair of floats in [low, 2*low)
+{
+    char str[40];
+    uint32_t bits;
+    memcpy(&bits, &low, 4);
+    for (uint32_t i=0; i < (1UL << 23); i++, bits++) {
+        float f, g;
+        memcpy(&f, &bits, 4);
+        uint32_t next = bits + 1;
+        memcpy(&g, &next, 4);
+        sprintf(str, "%.17g", ((double)f + (double)g) / 2);
+        check(str, true);
+    }
+}
+
+static void exponents()                         // JSON exponents across the whole float range
+{
+    char str[32];
+    for (uint32_t m=1; m < 100000; m++) {
+        for (int e=-45; e <= 38; e++) {
+            sprintf(str, "%ue%d", m, e);
+            check(str, true);
+        }
+    }
+}
+
+static void benchmark()
+{
+    static char corpus[100000][16];
+    for (int i=0; i < 100000; i++) {            // Gcode-like coordinates and feeds
+        sprintf(corpus[i], "%d.%03d", (int)((i * 7919L) % 2000) - 1000, (int)((i * 104729L) % 1000));
+    }
+    const int rounds = 20;
+    volatile float sink = 0;
+    host_clock::time_point start = host_clock::now();
+    for (int r=0; r < rounds; r++) {
+        for (int i=0; i < 100000; i++) {
+            numberScan_t n;
+            scan_number(corpus[i], &n, false);
+            sink += n.value + n.value_int;
+        }
+    }
+    double scanned = std::chrono::duration<double>(host_clock::now() - start).count();
+    start = host_clock::now();
+    for (int r=0; r < rounds; r++) {
+        for (int i=0; i < 100000; i++) {
+            char *end;
+            sink += strtof(corpus[i], &end) + atol(corpus[i]);
+        }
+    }
+    double library = std::chrono::duration<double>(host_clock::now() - start).count();
+    double numbers = rounds * 100000.0;
+    printf("benchmark: %.1f ns per number with scan_number(), %.1f ns with strtof() + atol()\n",
+           scanned / numbers * 1e9, library / numbers * 1e9);
+}
+
+int main()
+{
+    struct { const char *name; void (*run)(); } families[] = {
+        { "7-digit decimals", decimals },
+        { "binade [1,2)", [] { binade(1.0f); } },
+        { "binade [1024,2048)", [] { binade(1024.0f); } },
+        { "binade [2^-10,2^-9)", [] { binade(1.0f / 1024); } },
+        { "midpoints [1,2)", [] { midpoints(1.0f); } },
+        { "midpoints [2^24,2^25)", [] { midpoints(16777216.0f); } },
+        { "exponents", exponents },
+    };
+    for (auto &family : families) {
+        uint64_t before = checked;
+        host_clock::time_point start = host_clock::now();
+        family.run();
+        printf("%-24s %10llu numbers  %5.1f s\n", family.name, (unsigned long long)(checked - before),
+               std::chrono::duration<double>(host_clock::now() - start).count());
+    }
+    benchmark();
+
+    if (failures) {
+        printf("%llu of %llu FAILED\n", (unsigned long long)failures, (unsigned long long)checked);
+        return (1);
+    }
+    printf("PASS\n");
+    return (0);
+}
@@ -0,0 +1,403 @@
+/*
+ * offsets_test.cpp - host test and benchmark of the cached work offsets
+ * This file is part of the g2core project
+ *
+ * Builds the real offset and target functions listed in extract.py against the stand-ins
+ * below. A long random run of G10 L1/L2/L10/L20, G43/G43.2/G49, G54-G59, the G92 family,
+ * G20/G21, G90/G91, $g54x-$g59c and $tofx sets (some inside a deferred settings load) and
+ * G53 moves is checked:
+ *
+ *  - after every command the cached combined and display offsets are the sums the offsets
+ *    had before they were cached (reference_*() below, kept as they were), bit for bit
+ *  - every move's target and captured display offsets are what they were before
+ *  - a deferred settings load leaves the cache alone until cm_apply_deferred_settings()
+ *
+ * The benchmark times the offset work the gcode parser does for one move - absolute
+ * override set and cleared, the target set and the display offsets captured - both ways.
+ *
+ * Run it with run_offsets_test.sh. It prints the measurements and exits non-zero on failure.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <chrono>
+#include <random>
+
+/**** stand-ins for what the extracted functions use ****/
+
+typedef uint16_t stat_t;
+#define STAT_OK 0
+#define STAT_L_WORD_IS_MISSING 1
+#define STAT_L_WORD_IS_INVALID 2
+#define STAT_P_WORD_IS_INVALID 3
+#define STAT_H_WORD_IS_INVALID 4
+static stat_t status_code;
+#define ritorno(a) if((status_code=a) != STAT_OK) { return(status_code); }
+
+#define AXES 9
+enum { AXIS_X=0, AXIS_Y, AXIS_Z, AXIS_U, AXIS_V, AXIS_W, AXIS_A, AXIS_B, AXIS_C };
+#define COORDS 6
+#define TOOLS 32
+#define MM_PER_INCH (25.4)
+#define MARLIN_COMPAT_ENABLED false
+#define copy_vector(d,s) (memcpy(d,s,sizeof(d)))
+
+#include "offsets_defs.inc"
+
+struct GCodeState_t {
+    float target[AXES];
+    float display_offset[AXES];
+    cmUnitsMode units_mode;
+    cmCoordSystem coord_system;
+    cmAbsoluteOverride absolute_override;
+    cmDistanceMode distance_mode;
+    uint8_t tool;
+};
+
+struct cmAxis_t {
+    cmAxisMode axis_mode;
+    float radius;
+};
+
+struct cmMachine_t {                        // the fields of cmMachine_t the offsets use
+    float coord_offset[COORDS+1][AXES];
+    float tool_offset[AXES];
+    GCodeState_t gm;
+    struct {
+        float position[AXES];
+        float g92_offset[AXES];
+        bool g92_offset_enable;
+    } gmx;
+    cmAxis_t a[AXES];
+    bool return_flags[AXES];
+    bool deferred_write_flag;
+    float combined_offset[AXES];
+    float display_offset[AXES];
+    float mm_per_unit;
+};
+
+static cmMachine_t cm1;
+static cmMachine_t *cm = &cm1;
+#define MODEL (GCodeState_t *)&cm->gm
+
+static struct {
+    float tt_offset[TOOLS+1][AXES];
+} tt;
+
+struct nvObj_t {
+    char group[8];
+    char token[8];
+    float value_flt;
+};
+
+static const char axis_letters[] = "xyzuvwabc";
+static uint8_t _axis(nvObj_t *nv) { return (strchr(axis_letters, nv->token[strlen(nv->token)-1]) - axis_letters); }
+static uint8_t _coord(nvObj_t *nv) { return (nv->token[2] - '3'); }   // g54x is coord 1
+static stat_t get_float(nvObj_t *nv, const float value) { nv->value_flt = value; return (STAT_OK); }
+static stat_t set_float(nvObj_t *nv, float &value) { value = nv->value_flt; return (STAT_OK); }
+
+static bool host_deferring = false;         // a settings load is running
+static bool nv_deferring_derived() { return (host_deferring); }
+void _cm_recalc_junction_accel(const uint8_t axis) {}
+
+static int queued = 0;
+static void mp_queue_command(void (*cm_exec)(float *, bool *), float *value, bool *flag) { queued++; }
+static void mp_set_runtime_display_offset(float offsets[]) {}
+
+void cm_update_offsets();
+void cm_set_display_offsets(GCodeState_t *gcode_state);
+
+#include "offsets.inc"
+
+/**** the offsets as they were before they were cached ****/
+
+#define reference_to_millimeters(a)  ((cm->gm.units_mode == INCHES) ? ((float)a * (float)MM_PER_INCH) : (float)a)
+
+static float reference_combined_offset(const uint8_t axis)
+{
+    if (cm->gm.absolute_override >= ABSOLUTE_OVERRIDE_ON_DISPLAY_WITH_OFFSETS) {
+        return (0);
+    }
+    float offset = cm->coord_offset[cm->gm.coord_system][axis] + cm->tool_offset[axis];
+    if (cm->gmx.g92_offset_enable == true) {
+        offset += cm->gmx.g92_offset[axis];
+    }
+    return (offset);
+}
+
+static void reference_set_display_offsets(GCodeState_t *gcode_state)
+{
+    for (uint8_t axis = AXIS_X; axis < AXES; axis++) {
+
+        // if absolute override is on for G53 so position should be displayed with no offsets
+        if (cm->gm.absolute_override == ABSOLUTE_OVERRIDE_ON_DISPLAY_WITH_NO_OFFSETS) {
+            gcode_state->display_offset[axis] = 0;
+        }
+
+        // all other cases: position should be displayed with currently active offsets
+        else {
+            gcode_state->display_offset[axis] = cm->coord_offset[cm->gm.coord_system][axis] +
+                                                cm->tool_offset[axis];
+            if (cm->gmx.g92_offset_enable == true) {
+                gcode_state->display_offset[axis] += cm->gmx.g92_offset[axis];
+            }
+        }
+    }
+}
+
+static void reference_set_absolute_override(GCodeState_t *gcode_state, const uint8_t absolute_override)
+{
+    gcode_state->absolute_override = (cmAbsoluteOverride)absolute_override;
+    reference_set_display_offsets(MODEL);   // must reset offsets if you change absolute override
+}
+
+static float reference_calc_ABC(const uint8_t axis, const float target[])
+{
+    if ((cm->a[axis].axis_mode == AXIS_STANDARD) || (cm->a[axis].axis_mode == AXIS_INHIBITED)) {
+        return(target[axis]);    // no mm conversion - it's in degrees
+    }
+    // radius mode
+    return (reference_to_millimeters(target[axis]) * 360.0 / (2 * M_PI * cm->a[axis].radius));
+}
+
+static void reference_set_model_target(const float target[], const bool flags[])
+{
+    uint8_t axis;
+    float tmp = 0;
+
+    copy_vector(cm->gm.target, cm->gmx.position);
+    for (axis=AXIS_X; axis<=AXIS_W; axis++) {
+        if (!flags[axis] || cm->a[axis].axis_mode == AXIS_DISABLED) {
+            continue;
+        } else if ((cm->a[axis].axis_mode == AXIS_STANDARD) || (cm->a[axis].axis_mode == AXIS_INHIBITED)) {
+            if (cm->gm.distance_mode == ABSOLUTE_DISTANCE_MODE) {
+                cm->gm.target[axis] = reference_combined_offset(axis) + reference_to_millimeters(target[axis]);
+            } else {
+                cm->gm.target[axis] += reference_to_millimeters(target[axis]);
+            }
+            cm->return_flags[axis] = true;
+        }
+    }
+    for (axis=AXIS_A; axis<=AXIS_C; axis++) {
+        if (!flags[axis] || cm->a[axis].axis_mode == AXIS_DISABLED) {
+            continue;
+        } else {
+            tmp = reference_calc_ABC(axis, target);
+        }
+        if (cm->gm.distance_mode == ABSOLUTE_DISTANCE_MODE) {
+            cm->gm.target[axis] = tmp + reference_combined_offset(axis);
+        }
+        else {
+            cm->gm.target[axis] += tmp;
+        }
+        cm->return_flags[axis] = true;
+    }
+}
+
+/**** test ****/
+
+typedef std::chrono::steady_clock host_clock;
+
+static int failures = 0;
+
+static void check(bool ok, const char *what, const char *detail = "")
+{
+    if (!ok) {
+        if (failures++ < 20) {
+            printf("FAIL: %s: %s\n", what, detail);
+        }
+    }
+}
+
+static std::mt19937 rng(44);
+
+static float random_value() { return ((int)(rng() % 200001) - 100000) / 1000.0; }
+static uint32_t random_below(uint32_t n) { return (rng() % n); }
+
+static void random_words(float words[], bool flags[])
+{
+    for (uint8_t axis = AXIS_X; axis < AXES; axis++) {
+        flags[axis] = (random_below(3) == 0);
+        words[axis] = random_value();
+    }
+}
+
+static bool same(const float a[], const float b[])
+{
+    return (memcmp(a, b, AXES * sizeof(float)) == 0);
+}
+
+static void setup()
+{
+    memset(&cm1, 0, sizeof(cm1));
+    memset(&tt, 0, sizeof(tt));
+    for (uint8_t axis = AXIS_X; axis < AXES; axis++) {
+        cm->a[axis].axis_mode = AXIS_STANDARD;
+        cm->a[axis].radius = 10 + axis;
+    }
+    cm->a[AXIS_B].axis_mode = AXIS_RADIUS;
+    cm->a[AXIS_V].axis_mode = AXIS_INHIBITED;
+    cm->a[AXIS_W].axis_mode = AXIS_DISABLED;
+    cm_set_units_mode(MILLIMETERS);
+    cm_set_coord_system(G54);
+}
+
+static void check_cache(const char *command)
+{
+    float combined[AXES];
+    for (uint8_t axis = AXIS_X; axis < AXES; axis++) {
+        combined[axis] = reference_combined_offset(axis);
+        check(cm_get_combined_offset(axis) == combined[axis], "cm_get_combined_offset() reads the cache", command);
+    }
+    check(same(cm->combined_offset, combined), "the combined offsets are the sums they were", command);
+    GCodeState_t display = cm->gm;
+    reference_set_display_offsets(&display);
+    check(same(cm->gm.display_offset, display.display_offset), "the model's display offsets are the sums they were", command);
+    check(same(cm->display_offset, display.display_offset), "the cached display offsets are the sums they were", command);
+}
+
+static void move(const uint8_t absolute_override)
+{
+    float words[AXES];
+    bool flags[AXES];
+    random_words(words, flags);
+
+    // as _execute_gcode_block() and cm_straight_feed() do it
+    cmMachine_t before = *cm;
+    cm_set_absolute_override(MODEL, absolute_override);
+    check_cache("G53 on");
+    cm_set_model_target(words, flags);
+    cm_set_display_offsets(&cm->gm);
+    GCodeState_t moved = cm->gm;
+    cm_set_absolute_override(MODEL, ABSOLUTE_OVERRIDE_OFF);
+
+    cmMachine_t after = *cm;
+    *cm = before;
+    reference_set_absolute_override(MODEL, absolute_override);
+    reference_set_model_target(words, flags);
+    reference_set_display_offsets(&cm->gm);
+    check(same(moved.target, cm->gm.target), "the move's target is what it was", "move");
+    check(same(moved.display_offset, cm->gm.display_offset), "the move's display offsets are what they were", "move");
+    *cm = after;
+
+    for (uint8_t axis = AXIS_X; axis < AXES; axis++) {
+        cm->gmx.position[axis] = cm->gm.target[axis];
+    }
+}
+
+static void settings_load()
+{
+    float combined[AXES];
+    copy_vector(combined, cm->combined_offset);
+    host_deferring = true;
+    for (int i = random_below(4) + 1; i > 0; i--) {
+        nvObj_t nv = {};
+        if (random_below(2)) {
+            snprintf(nv.token, sizeof(nv.token), "g5%d%c", 4 + random_below(COORDS), axis_letters[random_below(AXES)]);
+            nv.value_flt = random_value();
+            cm_set_coord(&nv);
+        } else {
+            snprintf(nv.token, sizeof(nv.token), "tof%c", axis_letters[random_below(AXES)]);
+            nv.value_flt = random_value();
+            cm_set_tof(&nv);
+        }
+    }
+    check(same(cm->combined_offset, combined), "a settings load leaves the cache alone until it ends", "");
+    host_deferring = false;
+    cm_apply_deferred_settings();
+}
+
+static void test_commands()
+{
+    const int commands = 200000;
+    int moves = 0;
+    setup();
+    for (int i = 0; i < commands; i++) {
+        float words[AXES];
+        bool flags[AXES];
+        random_words(words, flags);
+        const char *command = "";
+        switch (random_below(14)) {
+            case 0: {
+                static const uint8_t L[] = { 1, 2, 10, 20 };
+                uint8_t L_word = L[random_below(4)];
+                uint8_t P_word = (L_word == 2 || L_word == 20) ? 1 + random_below(COORDS) : 1 + random_below(TOOLS);
+                cm_set_g10_data(P_word, true, L_word, true, words, flags);
+                command = "G10";
+                break;
+            }
+            case 1: { cm_set_tl_offset(random_below(TOOLS + 1), random_below(2), false); command = "G43"; break; }
+            case 2: { cm_set_tl_offset(random_below(TOOLS + 1), true, true); command = "G43.2"; break; }
+            case 3: { cm_cancel_tl_offset(); command = "G49"; break; }
+            case 4: { cm_set_coord_system(G54 + random_below(COORDS)); command = "G54-G59"; break; }
+            case 5: { cm_set_g92_offsets(words, flags); command = "G92"; break; }
+            case 6: { cm_reset_g92_offsets(); command = "G92.1"; break; }
+            case 7: { cm_suspend_g92_offsets(); command = "G92.2"; break; }
+            case 8: { cm_resume_g92_offsets(); command = "G92.3"; break; }
+            case 9: { cm_set_units_mode(random_below(2) ? INCHES : MILLIMETERS); command = "G20/G21"; break; }
+            case 10: { cm_set_distance_mode(random_below(2) ? INCREMENTAL_DISTANCE_MODE : ABSOLUTE_DISTANCE_MODE); command = "G90/G91"; break; }
+            case 11: { settings_load(); command = "settings load"; break; }
+            default: {
+                move(random_below(4) ? ABSOLUTE_OVERRIDE_OFF : 1 + random_below(2));
+                moves++;
+                command = "move";
+            }
+        }
+        check_cache(command);
+    }
+    printf("commands: %d, %d of them moves, %d queued offset changes\n", commands, moves, queued);
+}
+
+static void benchmark()
+{
+    const int rounds = 2000000;
+    float words[AXES] = { 10, 20, 30, 0, 0, 0, 40, 50, 60 };
+    bool flags[][AXES] = {{ true, true, false }, { true, true, true, true, true, false, true, true, true }};
+    const char *names[] = { "XY", "every axis" };
+    setup();
+    cm_set_g10_data(2, true, 2, true, words, flags[1]);
+    cm_set_coord_system(G55);
+    cm_set_g92_offsets(words, flags[0]);
+    tt.tt_offset[1][AXIS_Z] = 5;
+    cm_set_tl_offset(1, true, false);
+    volatile float sink = 0;
+    for (int f = 0; f < 2; f++) {
+        double times[2] = { 0, 0 };
+        for (int old = 0; old < 2; old++) {
+            host_clock::time_point start = host_clock::now();
+            for (int round = 0; round < rounds; round++) {
+                words[AXIS_X] = round;
+                if (old) {
+                    reference_set_absolute_override(MODEL, ABSOLUTE_OVERRIDE_OFF);
+                    reference_set_model_target(words, flags[f]);
+                    reference_set_display_offsets(&cm->gm);
+                    reference_set_absolute_override(MODEL, ABSOLUTE_OVERRIDE_OFF);
+                } else {
+                    cm_set_absolute_override(MODEL, ABSOLUTE_OVERRIDE_OFF);
+                    cm_set_model_target(words, flags[f]);
+                    cm_set_display_offsets(&cm->gm);
+                    cm_set_absolute_override(MODEL, ABSOLUTE_OVERRIDE_OFF);
+                }
+                sink = sink + cm->gm.target[AXIS_X] + cm->gm.display_offset[AXIS_C];
+            }
+            times[old] = std::chrono::duration<double>(host_clock::now() - start).count() / rounds;
+        }
+        printf("benchmark: %s move, %.1f ns cached, %.1f ns before\n", names[f], times[0] * 1e9, times[1] * 1e9);
+    }
+}
+
+int main()
+{
+    test_commands();
+    benchmark();
+
+    if (failures) {
+        printf("%d FAILED\n", failures);
+        return (1);
+    }
+    printf("PASS\n");
+    return (0);
+}
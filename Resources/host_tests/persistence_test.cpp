@@ -0,0 +1,314 @@
+/*
+ * persistence_test.cpp - host test and benchmark of the NVM record log
+ * This file is part of the g2core project
+ *
+ * Builds persistence.cpp as it is, on its file-backed flash emulator (__NVM_FILE). Every
+ * fwrite() the emulator makes goes through host_fwrite() below, which counts the bytes
+ * programmed and can cut the power part way through a write or fail the flash outright.
+ *
+ *  - replay: persistence_init() on a full log, and its time
+ *  - compaction: values survive any number of compactions and reboots
+ *  - torn writes: power is cut at every point of a compaction and of record appends, and
+ *    after each reboot every value is the last one acknowledged (the write that was cut
+ *    may land or not)
+ *  - flash failure: NVM is disabled and reported once, and nothing retries
+ *  - write amplification: flash bytes and records programmed per setting written
+ *
+ * Run it with run_persistence_test.sh. It prints the measurements and exits non-zero on failure.
+ */
+
+#include <stdio.h>
+#include <chrono>
+#include <map>
+#include <algorithm>
+
+using std::min;
+using std::max;
+
+#include "g2core.h"
+#include "persistence.h"
+#include "report.h"
+
+#define NUL (char)0x00
+
+/**** stubs for what persistence.cpp calls ****/
+
+#define NV_TEST_ENTRIES 720                 // about cfgArray's F_INITIALIZE count
+
+const cfgItem_t cfgArray[NV_TEST_ENTRIES] = {};
+uint16_t nvm_slot[NV_TEST_ENTRIES];
+index_t nv_index_max() { return (NV_TEST_ENTRIES); }
+
+enum cmCycleType { CYCLE_NONE = 0, CYCLE_MACHINING };
+struct { cmCycleType cycle_type; } cm1;
+auto *cm = &cm1;
+
+static int exceptions = 0;
+stat_t rpt_exception(stat_t status, const char *msg) { exceptions++; return (status); }
+
+/**** flash fault injection ****/
+
+static long power_budget = -1;              // bytes that can still be written, -1 for no limit
+static bool flash_failed = false;           // every write fails
+static uint64_t flash_bytes = 0;            // bytes programmed or erased
+static uint32_t flash_writes = 0;           // fwrite() calls
+
+static size_t host_fwrite(const void *ptr, size_t size, size_t count, FILE *f)
+{
+    size_t bytes = size * count;
+    flash_writes++;
+    if (flash_failed || (power_budget == 0)) {
+        return (0);
+    }
+    if ((power_budget > 0) && ((long)bytes > power_budget)) {
+        bytes = power_budget;               // the power goes part way through
+        power_budget = 0;
+        fwrite(ptr, 1, bytes, f);
+        flash_bytes += bytes;
+        return (bytes);
+    }
+    if (power_budget > 0) {
+        power_budget -= bytes;
+    }
+    flash_bytes += bytes;
+    return (fwrite(ptr, size, count, f));
+}
+
+#define __NVM_FILE host_nvm_file
+static char host_nvm_file[256];
+
+#define fwrite host_fwrite
+#include "persistence_source.inc"
+#undef fwrite
+
+/**** test ****/
+
+typedef std::chrono::steady_clock host_clock;
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+static void reboot()                        // power comes back: RAM is gone, flash is not
+{
+    if (nvm_file != NULL) {
+        fclose(nvm_file);
+        nvm_file = NULL;
+    }
+    power_budget = -1;
+    persistence_init();
+}
+
+static stat_t write_value(const index_t index, const int32_t value)
+{
+    nvObj_t nv;
+    nv.index = index;
+    nv.value_int = value;
+    nv.value_flt = (float)value;
+    return (write_persistent_value(&nv));
+}
+
+static bool read_value(const index_t index, int32_t *value)
+{
+    nvObj_t nv;
+    nv.index = index;
+    if (read_persistent_value(&nv) != STAT_OK) {
+        return (false);
+    }
+    *value = nv.value_int;
+    return (nv.value_flt == (float)nv.value_int);
+}
+
+typedef std::map<index_t, int32_t> model_t;    // what the log should hold
+
+static bool log_matches(const model_t &model, const index_t torn_index = NO_MATCH, const int32_t torn_value = 0)
+{
+    for (index_t i=0; i < NV_TEST_ENTRIES; i++) {
+        int32_t value;
+        bool found = read_value(i, &value);
+        auto m = model.find(i);
+        if ((i == torn_index) && found && (value == torn_value)) {
+            continue;                       // the cut write landed
+        }
+        if (m == model.end() ? found : (!found || (value != m->second))) {
+            printf("  index %d: %s, expected %s\n", i, found ? "has a value" : "has none", (m == model.end()) ? "none" : "a value");
+            return (false);
+        }
+    }
+    return (true);
+}
+
+static uint32_t seed = 12345;
+static uint32_t random_u32()
+{
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 8);
+}
+
+static void start_blank()
+{
+    if (nvm_file != NULL) {
+        fclose(nvm_file);
+        nvm_file = NULL;
+    }
+    remove(host_nvm_file);
+    power_budget = -1;
+    flash_failed = false;
+    persistence_init();
+}
+
+static void test_replay_and_compaction()
+{
+    start_blank();
+    check(nvm.enabled, "a blank file starts an empty log");
+
+    model_t model;
+    for (uint32_t n=0; n < 3 * NVM_SLOTS; n++) {       // several compactions' worth
+        index_t index = random_u32() % 300;
+        int32_t value = (int32_t)n;
+        check(write_value(index, value) == STAT_OK, "append succeeds");
+        model[index] = value;
+    }
+    check(nvm.compactions >= 2, "the log compacts when it fills");
+    reboot();
+    check(nvm.enabled && log_matches(model), "values survive compaction and reboot");
+    check(nvm.bad_records == 0, "a clean log replays without bad records");
+
+    // fill the active segment to the end and time the replay
+    while (nvm.next_slot < NVM_SLOTS - 1) {
+        index_t index = random_u32() % 300;
+        int32_t value = (int32_t)nvm.next_slot;
+        write_value(index, value);
+        model[index] = value;
+    }
+    const int rounds = 200;
+    host_clock::time_point start = host_clock::now();
+    for (int r=0; r < rounds; r++) {
+        reboot();
+    }
+    double replay = std::chrono::duration<double>(host_clock::now() - start).count() / rounds;
+    check(log_matches(model), "a full log replays");
+    printf("replay: %u record slots in %.1f us (file emulator, includes fopen)\n", (unsigned)NVM_SLOTS - 1, replay * 1e6);
+}
+
+/*
+ * Cut the power at every kth byte of a stretch of writes, reboot, and check the log. The
+ * stretch is the write that fills the segment - its compaction is the longest write there
+ * is - followed by appends into the new segment.
+ */
+static void test_torn_writes()
+{
+    int cuts = 0, bad = 0;
+    for (long budget = 1; ; budget += 97) {
+        start_blank();
+        model_t model;
+        seed = 777;
+        while (nvm.next_slot < NVM_SLOTS - 1) {
+            index_t index = random_u32() % 300;
+            int32_t value = (int32_t)nvm.next_slot;
+            write_value(index, value);
+            model[index] = value;
+        }
+        power_budget = budget;
+        index_t torn_index = NO_MATCH;
+        int32_t torn_value = 0;
+        for (int n=0; (n < 40) && (power_budget != 0); n++) {
+            index_t index = random_u32() % 300;
+            int32_t value = 1000000 + n;
+            if (write_value(index, value) == STAT_OK) {
+                model[index] = value;
+            } else {
+                torn_index = index;
+                torn_value = value;
+            }
+        }
+        if (power_budget != 0) {
+            break;                          // the whole stretch fit - every cut point is covered
+        }
+        cuts++;
+        reboot();
+        bool ok = nvm.enabled && log_matches(model, torn_index, torn_value);
+        bad += ok ? 0 : 1;
+        if (!ok) {
+            printf("  cut after %ld bytes: log does not match\n", budget);
+        }
+    }
+    check(bad == 0, "every value is the last acknowledged one after a power cut");
+    printf("torn writes: power cut at %d points across a compaction and appends\n", cuts);
+}
+
+static void test_flash_failure()
+{
+    start_blank();
+    write_value(1, 1);
+    exceptions = 0;
+    flash_failed = true;
+    check(write_value(2, 2) == STAT_PERSISTENCE_ERROR, "a failed program is reported");
+    check(!nvm.enabled && (exceptions == 1), "a failed program disables NVM once");
+    uint32_t writes = flash_writes;
+    check(write_value(3, 3) == STAT_OK, "writes after the failure are accepted");
+    check(flash_writes == writes, "nothing is written once NVM is disabled");
+
+    // a failure while flushing writes held back during a cycle
+    start_blank();
+    while (nvm.next_slot < NVM_SLOTS - 1) {
+        write_value(random_u32() % 300, (int32_t)nvm.next_slot);
+    }
+    cm->cycle_type = CYCLE_MACHINING;
+    for (index_t i=0; i < NVM_PENDING_MAX; i++) {
+        write_value(i, -1 - i);
+    }
+    cm->cycle_type = CYCLE_NONE;
+    exceptions = 0;
+    flash_failed = true;
+    writes = flash_writes;
+    persistence_callback();                 // the flush compacts, and the compaction fails
+    uint32_t first = flash_writes - writes;
+    for (int pass=0; pass < 100; pass++) {
+        persistence_callback();
+    }
+    check((exceptions == 1) && !nvm.enabled, "a failed compaction disables NVM once");
+    check(flash_writes - writes == first, "a failed compaction is not retried");
+    flash_failed = false;
+}
+
+static void test_write_amplification()
+{
+    printf("write amplification (flash bytes programmed or erased, and records, per setting written):\n");
+    const index_t working_sets[] = { 20, 150, 300, 700 };
+    for (index_t set : working_sets) {
+        start_blank();
+        uint64_t bytes = flash_bytes;
+        const uint32_t writes = 20000;
+        for (uint32_t n=0; n < writes; n++) {
+            write_value(random_u32() % set, (int32_t)n);
+        }
+        double records = (double)(nvm.records_written + nvm.records_copied) / nvm.records_written;
+        printf("  %3u settings  %5.1f bytes/write  %4.2f records/write  %3u compactions\n",
+               (unsigned)set, (double)(flash_bytes - bytes) / writes, records, (unsigned)nvm.compactions);
+        check(records < 2.5, "compaction copies under 1.5 records per write");
+    }
+}
+
+int main()
+{
+    snprintf(host_nvm_file, sizeof(host_nvm_file), "%s/g2core_nvm.bin", getenv("OUT") ? getenv("OUT") : "/tmp");
+
+    test_replay_and_compaction();
+    test_torn_writes();
+    test_flash_failure();
+    test_write_amplification();
+
+    if (failures) {
+        printf("%d FAILED\n", failures);
+        return (1);
+    }
+    printf("PASS\n");
+    return (0);
+}
@@ -0,0 +1,459 @@
+/*
+ * plan_path_test.cpp - host test of arc and spline blocks and the spline pool
+ * This file is part of the g2core project
+ *
+ * Builds the real planner functions listed in extract.py against the stubs below and checks:
+ *
+ *  - splines (G5, G5.1) under three transforms, including a non-uniform scale: every runtime
+ *    point is on the curve, the planned length matches the curve, speed along the curve is
+ *    even, the entry unit vector is a unit vector and the path ends on the target
+ *  - arc blocks: runtime points from _exec_path_position() and from the stepped sin/cos of
+ *    _exec_arc_step() stay on the transformed arc
+ *  - the spline pool: mp_planner_is_full() holds input back once it is used up, freed blocks
+ *    return their entries, and queued splines keep their geometry as the pool wraps
+ *
+ * Run it with run_plan_path_test.sh. It prints the measurements and exits non-zero on failure.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+/**** stubs for what the extracted functions call ****/
+
+typedef uint16_t stat_t;
+#define STAT_OK 0
+#define STAT_NOOP 3
+#define STAT_MINIMUM_LENGTH_MOVE 9
+#define STAT_FAILED_GET_PLANNER_BUFFER 10
+#define STAT_FAILED_TO_GET_PLANNER_BUFFER 11
+
+#define AXES 9
+enum { AXIS_X=0, AXIS_Y, AXIS_Z, AXIS_U, AXIS_V, AXIS_W, AXIS_A, AXIS_B, AXIS_C };
+#define INIT_AXES_ZEROES {0,0,0,0,0,0,0,0,0}
+#define EPSILON     ((float)0.00001)
+#define EPSILON3    ((float)0.001)
+#define copy_vector(d,s) (memcpy(d,s,sizeof(d)))
+#define PLANNER_BUFFER_HEADROOM 4
+#define BLOCK_TYPE_ALINE 1
+#define SR_REQUEST_TIMED_FULL 0
+
+using std::min;
+using std::max;
+static inline float square(float x) { return (x*x); }
+
+static void sr_request_status_report(int) {}
+static stat_t cm_panic(stat_t status, const char *) { return (status); }
+static stat_t rpt_exception(stat_t status, const char *) { return (status); }
+static void qr_request_queue_report(int) {}
+static void _audit_buffers() {}
+
+typedef uint8_t cmAxes;
+struct GCodeState_t { float target[AXES]; float feed_rate; };
+struct cmTransform_t { float matrix[3][3]; float offset[3]; };
+struct cmArc_t {
+    float position[AXES];
+    float radius, theta, angular_travel, linear_travel;
+    cmAxes plane_axis_0, plane_axis_1, linear_axis;
+    float center_0, center_1;
+    GCodeState_t gm;
+};
+
+#include "path_types.inc"
+
+struct mpBuf_t {
+    mpBuf_t *nx;
+    bool in_use;
+    float unit[AXES];
+    bool axis_flags[AXES];
+    float length;
+    mpPath_t path;
+    cmTransform_t inverse;
+    GCodeState_t gm;
+    stat_t (*bf_func)(mpBuf_t *);
+    float cruise_vset, cruise_vmax, absolute_vmax, block_time;
+};
+
+struct mpPlannerQueue_t {
+    mpBuf_t *r, *w;
+    uint8_t queue_size;
+    uint8_t buffers_available;
+    mpSpline_t *spline;
+    uint8_t spline_pool_size;
+    uint8_t splines_taken;
+    uint8_t splines_freed;
+};
+
+struct mpPlanner_t {
+    float position[AXES];
+    mpPlannerQueue_t q;
+};
+
+struct mpPlannerRuntime_t {
+    mpPath_t path;
+    float target[AXES];
+    float path_travel;
+    float arc_sin, arc_cos;
+    uint8_t arc_correction_count;
+};
+
+#define QUEUE_SIZE 48
+static mpBuf_t queue[QUEUE_SIZE];
+static mpSpline_t splines[SPLINE_POOL_SIZE];
+static mpPlanner_t mp1;
+static mpPlanner_t *mp = &mp1;
+static mpPlannerRuntime_t mr1;
+static mpPlannerRuntime_t *mr = &mr1;
+static struct { uint8_t available = 3; } jc;
+
+static struct { float max_junction_accel; } axes[AXES];
+static struct { float junction_integration_time; decltype(axes) &a = axes; } cm1;
+static decltype(cm1) *cm = &cm1;
+
+static cmTransform_t transform;
+static const cmTransform_t *cm_get_transform(const GCodeState_t *, bool) { return (&transform); }
+
+static void _clear_buffer(mpBuf_t *bf)
+{
+    mpBuf_t *nx = bf->nx;
+    memset(bf, 0, sizeof(mpBuf_t));
+    bf->nx = nx;
+}
+
+static mpBuf_t *mp_get_write_buffer()
+{
+    if (mp->q.w->in_use) { return (NULL); }
+    _clear_buffer(mp->q.w);
+    mp->q.w->in_use = true;
+    mp->q.buffers_available--;
+    return (mp->q.w);
+}
+
+static void mp_commit_write_buffer(int) { mp->q.w = mp->q.w->nx; }
+static stat_t mp_exec_aline(mpBuf_t *) { return (STAT_OK); }
+static void _calculate_jerk(mpBuf_t *, const float []) {}
+static void _set_bf_diagnostics(mpBuf_t *) {}
+static void _calculate_vmaxes(mpBuf_t *bf, const float [], float xyz_length, float)
+{
+    bf->block_time = xyz_length / bf->gm.feed_rate;
+    bf->cruise_vset = bf->cruise_vmax = bf->length / bf->block_time;
+    bf->absolute_vmax = 1e9;
+}
+
+static void _init_queue()
+{
+    memset(&mp1.q, 0, sizeof(mp1.q));
+    for (uint8_t i = 0; i < QUEUE_SIZE; i++) {
+        _clear_buffer(&queue[i]);
+        queue[i].in_use = false;
+        queue[i].nx = &queue[(i+1) % QUEUE_SIZE];
+    }
+    mp1.q.r = mp1.q.w = queue;
+    mp1.q.queue_size = QUEUE_SIZE;
+    mp1.q.buffers_available = QUEUE_SIZE;
+    mp1.q.spline = splines;
+    mp1.q.spline_pool_size = SPLINE_POOL_SIZE;
+}
+
+static void _calculate_arc_vmax(mpBuf_t *bf, const float radius, const float planar_fraction);
+static void _spline_tangent(const float d1[], const float d2[], const float chord[], float tangent[]);
+static float _exec_spline_speed(const float t);
+static mpSpline_t *mp_get_spline_buffer();
+
+#include "path_functions.inc"
+
+/**** reference geometry in double precision ****/
+
+static void _set_transform(double rotate, double tram, double scale_x, double scale_y, double x, double y)
+{
+    double c = cos(rotate), s = sin(rotate), ct = cos(tram), st = sin(tram);
+    double m[3][3] = {{c*scale_x, -s*scale_y, 0}, {s*scale_x, c*scale_y, 0}, {0, 0, 1}};
+    double t[3][3] = {{1, 0, 0}, {0, ct, -st}, {0, st, ct}};
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            double v = 0;
+            for (int k = 0; k < 3; k++) { v += t[i][k] * m[k][j]; }
+            transform.matrix[i][j] = v;
+        }
+    }
+    transform.offset[0] = x;
+    transform.offset[1] = y;
+    transform.offset[2] = 0;
+}
+
+static void _apply(const double in[3], double out[3])
+{
+    for (int i = 0; i < 3; i++) {
+        out[i] = transform.offset[i];
+        for (int j = 0; j < 3; j++) { out[i] += transform.matrix[i][j] * in[j]; }
+    }
+}
+
+static void _bezier(const double p[4][3], double t, double out[3])
+{
+    double u = 1-t;
+    for (int i = 0; i < 3; i++) {
+        out[i] = u*u*u*p[0][i] + 3*u*u*t*p[1][i] + 3*u*t*t*p[2][i] + t*t*t*p[3][i];
+    }
+}
+
+static void _bezier_d1(const double p[4][3], double t, double out[3])
+{
+    double u = 1-t;
+    for (int i = 0; i < 3; i++) {
+        out[i] = 3*u*u*(p[1][i]-p[0][i]) + 6*u*t*(p[2][i]-p[1][i]) + 3*t*t*(p[3][i]-p[2][i]);
+    }
+}
+
+static double _distance(const float a[3], const double b[3])
+{
+    return (sqrt(pow(a[0]-b[0], 2) + pow(a[1]-b[1], 2) + pow(a[2]-b[2], 2)));
+}
+
+static int failures = 0;
+
+static void _check(bool ok, const char *what, double value, double limit)
+{
+    printf("  %-40s %.2e  (limit %.1e)  %s\n", what, value, limit, ok ? "ok" : "FAIL");
+    if (!ok) { failures++; }
+}
+
+/**** tests ****/
+
+struct splineCase {
+    const char *name;
+    double x0, y0, z0, i, j, p, q, x1, y1, dz;
+    bool quadratic;                     // G5.1 - I,J is the single control point
+    double ripple_limit;
+};
+
+static const splineCase spline_cases[] = {
+    {"s-curve",     0, 0, 0,  20, 0,   -20, 0,   40, 30,  0, false, 0.01},
+    {"wide loop",   0, 0, 0,  60, 60,  60, -60,  10, 0,   0, false, 0.01},
+    {"gentle",      5, 5, 1,  10, 2,   -10, -2,  55, 10, -2, false, 0.01},
+    {"near cusp",   0, 0, 0,  30, 30,  -30, 30,  1, 0,    0, false, 0.06},
+    {"ctrl on end", 0, 0, 0,  0, 0,    0, 0,     25, 10,  0, false, 0.01},
+    {"quadratic",   0, 0, 0,  15, 25,  0, 0,     30, 0,   0, true,  0.01},
+    {"quad helix",  10, 0, 0, 0, 20,   0, 0,     -10, 0, -5, true,  0.01},
+    {"short",       0, 0, 0,  0.3, 0.1, -0.2, 0.2, 0.8, 0.4, 0, false, 0.01},
+};
+
+static void _test_splines()
+{
+    static const double transforms[][6] = {{0, 0, 1, 1, 0, 0}, {0.4, 0.001, 1, 1, 5, -3}, {0.2, 0, 2, 0.5, 0, 0}};
+    double worst_deviation = 0, worst_length = 0, worst_unit = 0, worst_end = 0, worst_excess_ripple = 0;
+
+    for (const auto &t : transforms) {
+        _set_transform(t[0], t[1], t[2], t[3], t[4], t[5]);
+        for (const auto &c : spline_cases) {
+            _init_queue();
+            double model[4][3] = {{c.x0, c.y0, c.z0}, {0}, {0}, {c.x1, c.y1, c.z0 + c.dz}};
+            if (!c.quadratic) {
+                model[1][0] = c.x0 + c.i;  model[1][1] = c.y0 + c.j;
+                model[2][0] = c.x1 + c.p;  model[2][1] = c.y1 + c.q;
+            } else {                    // raise to a cubic as cm_spline_feed() does
+                for (int i = 0; i < 2; i++) {
+                    double ctrl = model[0][i] + (i ? c.j : c.i);
+                    model[1][i] = model[0][i] + (ctrl - model[0][i]) * 2/3.0;
+                    model[2][i] = model[3][i] + (ctrl - model[3][i]) * 2/3.0;
+                }
+            }
+            model[1][2] = c.z0 + c.dz/3;
+            model[2][2] = c.z0 + c.dz*2/3;
+            double p[4][3];
+            for (int k = 0; k < 4; k++) { _apply(model[k], p[k]); }
+
+            GCodeState_t gm = {};
+            for (int i = 0; i < 3; i++) { gm.target[i] = model[3][i]; }
+            gm.target[AXIS_A] = 30;
+            gm.feed_rate = 1000;
+            for (int i = 0; i < AXES; i++) { mp->position[i] = (i < 3) ? p[0][i] : 0; }
+            float control_1[3], control_2[3];
+            for (int i = 0; i < 3; i++) { control_1[i] = model[1][i]; control_2[i] = model[2][i]; }
+            if (mp_spline(&gm, control_1, control_2) != STAT_OK) {
+                printf("  %s: mp_spline() failed\n", c.name);
+                failures++;
+                continue;
+            }
+            mpBuf_t *bf = mp->q.r;
+            mr->path = bf->path;
+            copy_vector(mr->target, bf->gm.target);
+
+            // dense reference polyline of the transformed curve and its cumulative length
+            const int R = 200000;
+            std::vector<double> cum(R+1, 0), pts(3*(R+1));
+            for (int k = 0; k <= R; k++) {
+                _bezier(p, (double)k/R, &pts[3*k]);
+                if (k) { cum[k] = cum[k-1] + sqrt(pow(pts[3*k]-pts[3*k-3], 2) + pow(pts[3*k+1]-pts[3*k-2], 2) + pow(pts[3*k+2]-pts[3*k-1], 2)); }
+            }
+            double xyz_length = cum[R];
+            double length = sqrt(xyz_length*xyz_length + 30*30);
+            worst_length = fmax(worst_length, fabs(bf->path.length - length) / length);
+
+            const int N = 1000;
+            size_t index = 0;
+            double previous = 0, ripple = 0, deviation = 0;
+            for (int n = 1; n <= N; n++) {
+                float position[3];
+                _exec_path_position(bf->path.length * n / N, position);
+                double best = 1e18;
+                size_t best_index = index;
+                for (size_t k = index; (k <= (size_t)R) && (k < index + 20000); k++) {
+                    double d = _distance(position, &pts[3*k]);
+                    if (d < best) { best = d; best_index = k; }
+                }
+                index = best_index;
+                double tt = (double)best_index / R;         // refine to the closest point on the curve
+                for (int it = 0; it < 4; it++) {
+                    double q[3], d[3], num = 0, den = 0;
+                    _bezier(p, tt, q);
+                    _bezier_d1(p, tt, d);
+                    for (int i = 0; i < 3; i++) { num += (q[i]-position[i]) * d[i]; den += d[i]*d[i]; }
+                    if (den < 1e-20) { break; }
+                    tt = fmin(1, fmax(0, tt - num/den));
+                }
+                double q[3];
+                _bezier(p, tt, q);
+                deviation = fmax(deviation, fmin(_distance(position, q), best));
+                double s = cum[best_index] / xyz_length;
+                if (n < N) { ripple = fmax(ripple, fabs((s - previous) * N - 1)); }
+                previous = s;
+            }
+            double end[3];
+            _bezier(p, 1, end);
+            float last[3];
+            _exec_path_position(bf->path.length, last);
+            worst_end = fmax(worst_end, _distance(last, end));
+            double unit_sq = 0;
+            for (int k = 0; k < AXES; k++) { unit_sq += bf->unit[k] * bf->unit[k]; }
+            worst_unit = fmax(worst_unit, fabs(sqrt(unit_sq) - 1));
+            worst_deviation = fmax(worst_deviation, deviation);
+            worst_excess_ripple = fmax(worst_excess_ripple, ripple / c.ripple_limit);
+            printf("  %-12s length %8.3f  deviation %.1e mm  speed ripple %.2f%%\n", c.name, bf->path.length, deviation, ripple*100);
+        }
+    }
+    _check(worst_deviation < 2e-4, "spline: distance from curve (mm)", worst_deviation, 2e-4);
+    _check(worst_length < 1e-4, "spline: relative length error", worst_length, 1e-4);
+    _check(worst_excess_ripple < 1, "spline: speed ripple / case limit", worst_excess_ripple, 1);
+    _check(worst_unit < 1e-3, "spline: | |entry unit| - 1 |", worst_unit, 1e-3);
+    _check(worst_end < 1e-4, "spline: end point error (mm)", worst_end, 1e-4);
+}
+
+static void _test_arcs()
+{
+    _init_queue();
+    _set_transform(0.3, 0.01, 1.5, 1.5, 2, 3);
+    cmArc_t a = {};
+    a.plane_axis_0 = AXIS_X;
+    a.plane_axis_1 = AXIS_Y;
+    a.linear_axis = AXIS_Z;
+    a.position[AXIS_X] = 10;
+    a.radius = 10;
+    a.theta = M_PI/2;                   // x = r*sin(theta), y = r*cos(theta)
+    a.angular_travel = 3*M_PI;
+    a.linear_travel = -3;
+    copy_vector(a.gm.target, a.position);
+    a.gm.target[AXIS_X] = -10;
+    a.gm.feed_rate = 1000;
+    double start[3] = {10, 0, 0}, start_t[3];
+    _apply(start, start_t);
+    for (int k = 0; k < 3; k++) { mp->position[k] = start_t[k]; }
+    if (mp_arc(&a) != STAT_OK) {
+        printf("  mp_arc() failed\n");
+        failures++;
+        return;
+    }
+    mpBuf_t *bf = mp->q.r;
+    mr->path = bf->path;
+    copy_vector(mr->target, bf->gm.target);
+
+    auto reference = [&](double fraction, double out[3]) {
+        double angle = a.theta + a.angular_travel * fraction;
+        double m[3] = {a.radius * sin(angle), a.radius * cos(angle), a.linear_travel * fraction};
+        _apply(m, out);
+    };
+    double worst_exact = 0, worst_step = 0;
+    for (int n = 0; n <= 100; n++) {
+        float position[3];
+        double q[3];
+        _exec_path_position(bf->path.length * n / 100, position);
+        reference(n / 100.0, q);
+        worst_exact = fmax(worst_exact, _distance(position, q));
+    }
+    // segments of varying length, as a head and tail make them, with the correction cycle
+    mr->path_travel = 0;
+    mr->arc_sin = sin(a.theta);
+    mr->arc_cos = cos(a.theta);
+    mr->arc_correction_count = 1;
+    for (int n = 0; mr->path_travel < bf->path.length; n++) {
+        float segment = bf->path.length * (0.0005 + 0.002 * (0.5 + 0.5 * sin(n * 0.05)));
+        float position[3];
+        double q[3];
+        _exec_arc_step(segment, position);
+        reference(fmin(1, mr->path_travel / bf->path.length), q);
+        worst_step = fmax(worst_step, _distance(position, q));
+    }
+    _check(worst_exact < 1e-3, "arc: exact point error (mm)", worst_exact, 1e-3);
+    _check(worst_step < 1e-3, "arc: stepped point error (mm)", worst_step, 1e-3);
+}
+
+static void _test_spline_pool()
+{
+    _init_queue();
+    _set_transform(0, 0, 1, 1, 0, 0);
+    std::vector<mpBuf_t *> queued;
+    std::vector<float> expected;                    // coeff[3][X] is the start X of each spline
+    bool held_back = true, geometry_kept = true;
+    int planned = 0;
+
+    for (int round = 0; round < 300; round++) {     // enough to wrap the free running counts
+        while (!mp_planner_is_full(mp)) {
+            GCodeState_t gm = {};
+            float control_1[3] = {(float)planned + 1, 5, 0}, control_2[3] = {(float)planned + 2, 5, 0};
+            gm.target[AXIS_X] = planned + 3;
+            gm.feed_rate = 1000;
+            for (int i = 0; i < AXES; i++) { mp->position[i] = (i == AXIS_X) ? planned : 0; }
+            mpBuf_t *bf = mp->q.w;
+            if (mp_spline(&gm, control_1, control_2) != STAT_OK) {
+                held_back = false;
+                break;
+            }
+            queued.push_back(bf);
+            expected.push_back(planned);
+            planned++;
+        }
+        if (queued.size() != SPLINE_POOL_SIZE) { held_back = false; }
+        for (size_t k = 0; k < queued.size(); k++) {
+            if (queued[k]->path.spline->coeff[3][AXIS_X] != expected[k]) { geometry_kept = false; }
+        }
+        int frees = 1 + round % 3;                  // run a few, then refill
+        for (int k = 0; (k < frees) && !queued.empty(); k++) {
+            mp_free_run_buffer();
+            queued.erase(queued.begin());
+            expected.erase(expected.begin());
+        }
+    }
+    printf("  %d splines planned through a pool of %d\n", planned, SPLINE_POOL_SIZE);
+    _check(held_back, "pool: input held back when used up", !held_back, 0.5);
+    _check(geometry_kept, "pool: queued splines keep their geometry", !geometry_kept, 0.5);
+    printf("  sizeof(mpPath_t) %d bytes, sizeof(mpSpline_t) %d bytes\n", (int)sizeof(mpPath_t), (int)sizeof(mpSpline_t));
+}
+
+int main()
+{
+    cm->junction_integration_time = 0.75;
+    for (int axis = 0; axis < AXES; axis++) {
+        axes[axis].max_junction_accel = 0.1732 * pow(0.75/1000, 2) * 5000e6;
+    }
+    printf("splines\n");
+    _test_splines();
+    printf("arcs\n");
+    _test_arcs();
+    printf("spline pool\n");
+    _test_spline_pool();
+    printf(failures ? "%d FAILED\n" : "all passed\n", failures);
+    return (failures ? 1 : 0);
+}
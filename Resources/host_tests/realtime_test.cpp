@@ -0,0 +1,305 @@
+/*
+ * realtime_test.cpp - host test of '!' to feedhold latency under saturated streaming
+ * This file is part of the g2core project
+ *
+ * Builds LineRXBuffer, the realtime mailbox and _dispatch_realtime() as they are, on a host
+ * stand-in for Motate's RXBuffer that the test writes into as the USB DMA would (see
+ * rx_host.h). A simulated controller loop runs on top of it:
+ *
+ *  - each pass starts with _dispatch_realtime(), reads control lines, then reads one data line
+ *    (the planner is full, so lines are taken as fast as it frees buffers) and takes a random
+ *    time - mostly short, sometimes a long replan
+ *  - the SysTick event runs the realtime scan every millisecond
+ *  - the host sends '!' at random times, and resumes as soon as the hold is requested. Bytes
+ *    land in the RX buffer at SysTicks and between passes.
+ *
+ * Latency runs from the '!' landing in the RX buffer to cm_request_feedhold(). It is measured
+ * with the host sending nothing else (a pendant) and with the host keeping the RX buffer full
+ * of G-code, with the SysTick scan on (as the firmware runs) and off (found only when the
+ * controller reads a line). Checked:
+ *
+ *  - the latency with a full RX buffer is bounded by one SysTick plus one controller pass,
+ *    the same bound as with an empty one
+ *  - no line sent after the '!' is read before the hold is requested
+ *  - every data line is read once, in order, and no realtime character is read as data
+ *  - every '!' gets into the RX buffer - what realtime characters leave behind is let go
+ *  - '%' outside a hold is data, and in a hold flushes what was sent before it only
+ *  - '!' inside a line is data
+ *
+ * It also times the realtime scan of a full RX buffer, which is what the SysTick interrupt
+ * costs at most. Run it with run_realtime_test.sh. It exits non-zero on failure.
+ */
+
+#include "rx_host.h"
+
+enum cmFeedholdType { FEEDHOLD_TYPE_HOLD, FEEDHOLD_TYPE_ACTIONS };
+enum cmFeedholdExit { FEEDHOLD_EXIT_CYCLE = 0 };
+
+static double host_now = 0;                 // simulated time, us
+static double hold_requested_at = -1;       // when cm_request_feedhold() was last called
+static int flushes = 0;
+
+void cm_request_feedhold(cmFeedholdType type, cmFeedholdExit exit) { hold_requested_at = host_now; host_hold = true; }
+void cm_request_cycle_start() { host_hold = false; }
+void cm_request_queue_flush() { flushes++; host_hold = false; }
+void cm_request_job_kill() {}
+static void _parse_ahead_flush() {}
+void job_abort() {}
+void nv_txn_abort() {}
+void hw_hard_reset() {}
+
+#include "dispatch_realtime.inc"
+
+/**** test ****/
+
+typedef std::chrono::steady_clock host_clock;
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+static void reset_device()
+{
+    memset((void *)&device._rx_buffer, 0, sizeof(device._rx_buffer));
+    device._rx_buffer.init();
+    xio_realtime.release();
+    host_hold = false;
+}
+
+static void receive(const std::string &s)   // the host sends s, which must fit
+{
+    for (char c : s) {
+        device._rx_buffer.receive(c);
+    }
+}
+
+static std::vector<std::string> read_lines() // controller passes until there's nothing left to do
+{
+    std::vector<std::string> lines;
+    char *line;
+    uint16_t size;
+    for (int idle=0; idle < 3; idle++) {
+        _dispatch_realtime();
+        device.readline(false, size);                           // control lines
+        if (!host_hold && ((line = device.readline(true, size)) != NULL)) {  // no data lines in a hold
+            lines.push_back(std::string(line, size));
+            idle = 0;
+        }
+    }
+    return (lines);
+}
+
+static void test_characters()
+{
+    reset_device();
+    receive("G1 X1!\n%\nG1 X2\n");
+    std::vector<std::string> lines = read_lines();
+    check((lines.size() == 3) && (lines[0] == "G1 X1!") && (lines[1] == "%") && (lines[2] == "G1 X2"),
+          "'!' inside a line and '%' outside a hold are data");
+    check(hold_requested_at < 0, "neither requests a hold");
+
+    reset_device();
+    receive("N1 G1 X1\nN2 G1 X2\n!\n");
+    lines = read_lines();
+    check(host_hold && (lines.size() <= 2) && ((lines.size() == 0) || (lines[0] == "N1 G1 X1")),
+          "'!' requests a hold and is not read as data");
+    receive("N3 G1 X3\nN4 G1 X4\n%\nN5 G1 X5\n");
+    flushes = 0;
+    lines = read_lines();
+    check((flushes == 1) && (lines.size() == 1) && (lines[0] == "N5 G1 X5"), "'%' in a hold flushes what was sent before it only");
+}
+
+/*
+ * The streaming simulation. Lines are "N<k> G1 X.. Y.. F..", numbered in the order sent, so
+ * the test can tell which were sent before a '!' and which after.
+ */
+struct latencyStats {
+    int holds = 0;
+    double sum_us = 0, max_us = 0;
+    int max_passes = 0;
+    bool order_ok = true;
+    bool lines_ok = true;
+    bool stalled = false;
+};
+
+static uint32_t seed = 1;
+static uint32_t random_u32()
+{
+    seed ^= seed << 13;                     // xorshift32
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return (seed);
+}
+
+#define SYSTICK_US 1000.0
+#define PASS_MAX_US 3000.0
+
+static double pass_time()                   // most passes are short; a few replan
+{
+    return ((random_u32() % 20) == 0) ? 1000.0 + random_u32() % 2000 : 20.0 + random_u32() % 200;
+}
+
+static latencyStats stream(const bool saturated, const bool systick, const int holds)
+{
+    reset_device();
+    latencyStats stats;
+    std::string pending;                    // sent by the host, not yet in the RX buffer
+    size_t pending_at = 0;
+    int next_line = 0;                      // number of the next line the host makes
+    int expected_line = 0;                  // number of the next line the controller should read
+    bool bang_sent = false;                 // a '!' is on its way
+    int bang_after_line = -1;               // and follows this line
+    double bang_landed_at = -1;
+    int passes_since = 0;
+    double next_tick = SYSTICK_US;
+    double next_bang = 5000;
+    host_now = 0;
+    hold_requested_at = -1;
+
+    auto host_send = [&]() {                // the host writes all it has that fits
+        while (true) {
+            if (pending_at == pending.size()) {
+                pending.clear();
+                pending_at = 0;
+                if (!saturated) {
+                    return;
+                }
+                char line[48];
+                sprintf(line, "N%d G1 X%d.%03d Y%d.%03d F1200\n", next_line++, (int)(random_u32() % 400),
+                        (int)(random_u32() % 1000), (int)(random_u32() % 400), (int)(random_u32() % 1000));
+                pending = line;
+            }
+            if (device._rx_buffer.space() == 0) {
+                return;
+            }
+            char c = pending[pending_at++];
+            if ((c == '!') && (bang_landed_at < 0)) {
+                bang_landed_at = host_now;
+                passes_since = 0;
+            }
+            device._rx_buffer.receive(c);
+        }
+    };
+
+    while (stats.holds < holds) {
+        if (bang_sent && (host_now > next_bang + 100000)) {
+            stats.stalled = true;               // the '!' never got through
+            break;
+        }
+        host_send();
+        if ((host_now >= next_bang) && !bang_sent) {
+            bang_sent = true;
+            if (!saturated) {
+                pending.clear();
+                pending_at = 0;
+            }
+            bang_after_line = next_line - 1;    // the line the host is sending now is before the '!'
+            pending += "!\n";
+            host_send();
+        }
+
+        // one controller pass
+        _dispatch_realtime();
+        if (host_hold && (bang_landed_at >= 0)) {
+            double latency = hold_requested_at - bang_landed_at;
+            stats.holds++;
+            stats.sum_us += latency;
+            stats.max_us = std::max(stats.max_us, latency);
+            stats.max_passes = std::max(stats.max_passes, passes_since);
+            bang_landed_at = -1;
+            bang_sent = false;
+            cm_request_cycle_start();           // the host resumes at once, so the stream continues
+            next_bang = host_now + 2000 + random_u32() % 20000;
+        }
+        uint16_t size;
+        char *line = device.readline(false, size);      // control lines - there are none
+        stats.lines_ok &= (line == NULL);
+        if (!host_hold && ((line = device.readline(true, size)) != NULL)) {
+            int n = -1;
+            sscanf(line, "N%d", &n);
+            stats.lines_ok &= (n == expected_line++);
+            stats.order_ok &= !bang_sent || (n <= bang_after_line);
+        }
+        double end = host_now + pass_time();
+        while (next_tick <= end) {              // SysTick interrupts during the pass
+            host_now = next_tick;
+            host_send();
+            if (systick) {
+                xio.scanRealtime();
+            }
+            next_tick += SYSTICK_US;
+        }
+        host_now = end;
+        passes_since++;
+    }
+    return (stats);
+}
+
+static void test_latency()
+{
+    printf("'!' to cm_request_feedhold(), %d us SysTick, passes up to %.0f us:\n", (int)SYSTICK_US, PASS_MAX_US);
+    double bound = SYSTICK_US + PASS_MAX_US;
+    double max_empty = 0, max_full = 0;
+    const struct { const char *name; bool saturated; bool systick; } runs[] = {
+        { "'!' only,        SysTick scan", false, true },
+        { "RX buffer full,  SysTick scan", true, true },
+        { "'!' only,        no SysTick  ", false, false },
+        { "RX buffer full,  no SysTick  ", true, false },
+    };
+    for (auto &run : runs) {
+        latencyStats s = stream(run.saturated, run.systick, 2000);
+        printf("  %s  mean %6.0f us  max %6.0f us  max %d passes\n", run.name, s.sum_us / s.holds, s.max_us, s.max_passes);
+        check(!s.stalled, "every '!' gets through");
+        check(s.lines_ok, "every data line is read once, in order");
+        check(s.order_ok, "no line sent after the '!' is read before the hold");
+        if (run.systick) {
+            check(s.max_us <= bound, "latency is bounded by one SysTick and one controller pass");
+            (run.saturated ? max_full : max_empty) = s.max_us;
+        }
+    }
+    check(max_full <= max_empty + PASS_MAX_US, "a full RX buffer adds at most a pass to the latency");
+}
+
+static void benchmark_scan()
+{
+    reset_device();
+    std::string text;
+    for (int n=0; text.size() < HOST_RX_SIZE - 1; n++) {
+        char line[48];
+        sprintf(line, "N%d G1 X%d.5 Y%d.25 F1200\n", n, n % 400, n % 300);
+        text += line;
+    }
+    text.resize(HOST_RX_SIZE - 1);
+    receive(text);
+    const int rounds = 20000;
+    volatile char sink = 0;
+    host_clock::time_point start = host_clock::now();
+    for (int r=0; r < rounds; r++) {
+        device._rx_buffer._realtime_offset = device._rx_buffer._read_offset;
+        device._rx_buffer._realtime_at_start_of_line = true;
+        sink += device._rx_buffer._scanRealtime();
+    }
+    double seconds = std::chrono::duration<double>(host_clock::now() - start).count() / rounds;
+    printf("realtime scan of a full RX buffer (%d bytes): %.2f us, %.2f ns per byte\n",
+           HOST_RX_SIZE - 1, seconds * 1e6, seconds * 1e9 / (HOST_RX_SIZE - 1));
+}
+
+int main()
+{
+    test_characters();
+    test_latency();
+    benchmark_scan();
+
+    if (failures) {
+        printf("%d FAILED\n", failures);
+        return (1);
+    }
+    printf("PASS\n");
+    return (0);
+}
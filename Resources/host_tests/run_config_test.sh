@@ -0,0 +1,10 @@
+#!/bin/sh
+# run_config_test.sh - build and run the config and transaction host test (see config_test.cpp)
+set -e
+HERE=$(cd "$(dirname "$0")" && pwd)
+OUT=${TMPDIR:-/tmp}/g2core_config_test
+mkdir -p "$OUT"
+python3 "$HERE/extract.py" config "$OUT"
+: > "$OUT/MotatePins.h"                 # config.h includes it for pin types the test doesn't use
+${CXX:-g++} -std=gnu++14 -O2 -Wall -Wno-unused-function -Wno-stringop-truncation -I"$OUT" -I"$HERE/../../g2core" -o "$OUT/config_test" "$HERE/config_test.cpp" -lm
+"$OUT/config_test"
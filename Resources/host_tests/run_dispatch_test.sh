@@ -0,0 +1,9 @@
+#!/bin/sh
+# run_dispatch_test.sh - build and run the batched dispatch host test (see dispatch_test.cpp)
+set -e
+HERE=$(cd "$(dirname "$0")" && pwd)
+OUT=${TMPDIR:-/tmp}/g2core_dispatch_test
+mkdir -p "$OUT"
+python3 "$HERE/extract.py" dispatch "$OUT"
+${CXX:-g++} -std=gnu++14 -O2 -Wall -Wno-unused-function -I"$OUT" -o "$OUT/dispatch_test" "$HERE/dispatch_test.cpp" -lm
+"$OUT/dispatch_test"
@@ -0,0 +1,10 @@
+#!/bin/sh
+# run_gcode_tokenize_test.sh - build and run the Gcode tokenizer host test (see gcode_tokenize_test.cpp)
+set -e
+HERE=$(cd "$(dirname "$0")" && pwd)
+OUT=${TMPDIR:-/tmp}/g2core_gcode_tokenize_test
+mkdir -p "$OUT"
+python3 "$HERE/extract.py" gcode "$OUT"
+: > "$OUT/MotatePins.h"                 # g2core.h pulls in headers that include it
+${CXX:-g++} -std=gnu++14 -O2 -Wall -Wno-unused-function -I"$OUT" -I"$HERE/../../g2core" -o "$OUT/gcode_tokenize_test" "$HERE/gcode_tokenize_test.cpp" -lm
+"$OUT/gcode_tokenize_test"
@@ -0,0 +1,12 @@
+#!/bin/sh
+# run_json_fuzz_test.sh - build and run the JSON parser fuzz test (see json_fuzz_test.cpp)
+#   run_json_fuzz_test.sh [iterations] [seed]
+set -e
+HERE=$(cd "$(dirname "$0")" && pwd)
+OUT=${TMPDIR:-/tmp}/g2core_json_fuzz_test
+mkdir -p "$OUT"
+python3 "$HERE/extract.py" config "$OUT"
+: > "$OUT/MotatePins.h"                 # config.h includes it for pin types the test doesn't use
+${CXX:-g++} -std=gnu++14 -O1 -g -fsanitize=address,undefined -fno-sanitize-recover=all -Wall -Wno-unused-function \
+    -Wno-stringop-truncation -I"$OUT" -I"$HERE/../../g2core" -o "$OUT/json_fuzz_test" "$HERE/json_fuzz_test.cpp" -lm
+"$OUT/json_fuzz_test" "$HERE/json_corpus.txt" "$@"
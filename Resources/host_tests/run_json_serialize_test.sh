@@ -0,0 +1,11 @@
+#!/bin/sh
+# run_json_serialize_test.sh - build and run the json_serialize() bounds test (see json_serialize_test.cpp)
+set -e
+HERE=$(cd "$(dirname "$0")" && pwd)
+OUT=${TMPDIR:-/tmp}/g2core_json_serialize_test
+mkdir -p "$OUT"
+python3 "$HERE/extract.py" config "$OUT"
+: > "$OUT/MotatePins.h"                 # config.h includes it for pin types the test doesn't use
+${CXX:-g++} -std=gnu++14 -O2 -Wall -Wno-unused-function -Wno-stringop-truncation -I"$OUT" -I"$HERE/../../g2core" \
+    -o "$OUT/json_serialize_test" "$HERE/json_serialize_test.cpp" -lm
+"$OUT/json_serialize_test" "$HERE/json_corpus.txt"
@@ -0,0 +1,10 @@
+#!/bin/sh
+# run_number_test.sh - build and run the scan_number() rounding test (see number_test.cpp)
+set -e
+HERE=$(cd "$(dirname "$0")" && pwd)
+OUT=${TMPDIR:-/tmp}/g2core_number_test
+mkdir -p "$OUT"
+python3 "$HERE/extract.py" number "$OUT"
+: > "$OUT/MotatePins.h"                 # g2core.h pulls in headers that include it
+${CXX:-g++} -std=gnu++14 -O2 -Wall -I"$OUT" -I"$HERE/../../g2core" -o "$OUT/number_test" "$HERE/number_test.cpp" -lm
+"$OUT/number_test"
@@ -0,0 +1,9 @@
+#!/bin/sh
+# run_offsets_test.sh - build and run the cached work offsets host test (see offsets_test.cpp)
+set -e
+HERE=$(cd "$(dirname "$0")" && pwd)
+OUT=${TMPDIR:-/tmp}/g2core_offsets_test
+mkdir -p "$OUT"
+python3 "$HERE/extract.py" offsets "$OUT"
+${CXX:-g++} -std=gnu++14 -O2 -Wall -Wno-unused-function -I"$OUT" -o "$OUT/offsets_test" "$HERE/offsets_test.cpp" -lm
+"$OUT/offsets_test"
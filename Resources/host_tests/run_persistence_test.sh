@@ -0,0 +1,10 @@
+#!/bin/sh
+# run_persistence_test.sh - build and run the NVM record log host test (see persistence_test.cpp)
+set -e
+HERE=$(cd "$(dirname "$0")" && pwd)
+OUT=${TMPDIR:-/tmp}/g2core_persistence_test
+mkdir -p "$OUT"
+python3 "$HERE/extract.py" persistence "$OUT"
+: > "$OUT/MotatePins.h"                 # config.h includes it for pin types the test doesn't use
+${CXX:-g++} -std=gnu++14 -O2 -Wall -Wno-unused-function -I"$OUT" -I"$HERE/../../g2core" -o "$OUT/persistence_test" "$HERE/persistence_test.cpp" -lm
+OUT="$OUT" "$OUT/persistence_test"
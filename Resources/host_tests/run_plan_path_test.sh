@@ -0,0 +1,9 @@
+#!/bin/sh
+# run_plan_path_test.sh - build and run the planner path host test (see plan_path_test.cpp)
+set -e
+HERE=$(cd "$(dirname "$0")" && pwd)
+OUT=${TMPDIR:-/tmp}/g2core_plan_path_test
+mkdir -p "$OUT"
+python3 "$HERE/extract.py" plan_path "$OUT"
+${CXX:-g++} -std=gnu++11 -O2 -Wall -I"$OUT" -o "$OUT/plan_path_test" "$HERE/plan_path_test.cpp" -lm
+"$OUT/plan_path_test"
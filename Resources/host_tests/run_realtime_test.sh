@@ -0,0 +1,9 @@
+#!/bin/sh
+# run_realtime_test.sh - build and run the realtime character latency test (see realtime_test.cpp)
+set -e
+HERE=$(cd "$(dirname "$0")" && pwd)
+OUT=${TMPDIR:-/tmp}/g2core_realtime_test
+mkdir -p "$OUT"
+python3 "$HERE/extract.py" realtime "$OUT"
+${CXX:-g++} -std=gnu++14 -O2 -Wall -Wno-unused-function -I"$OUT" -o "$OUT/realtime_test" "$HERE/realtime_test.cpp" -lm
+"$OUT/realtime_test"
@@ -0,0 +1,9 @@
+#!/bin/sh
+# run_rx_checksum_test.sh - build and run the RX scan line checksum test (see rx_checksum_test.cpp)
+set -e
+HERE=$(cd "$(dirname "$0")" && pwd)
+OUT=${TMPDIR:-/tmp}/g2core_rx_checksum_test
+mkdir -p "$OUT"
+python3 "$HERE/extract.py" rx_checksum "$OUT"
+${CXX:-g++} -std=gnu++14 -O2 -Wall -Wno-unused-function -I"$OUT" -o "$OUT/rx_checksum_test" "$HERE/rx_checksum_test.cpp" -lm
+"$OUT/rx_checksum_test"
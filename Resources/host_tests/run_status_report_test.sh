@@ -0,0 +1,13 @@
+#!/bin/sh
+# run_status_report_test.sh - build and run the status report host test (see status_report_test.cpp)
+set -e
+HERE=$(cd "$(dirname "$0")" && pwd)
+OUT=${TMPDIR:-/tmp}/g2core_status_report_test
+mkdir -p "$OUT"
+python3 "$HERE/extract.py" status_report "$OUT"
+: > "$OUT/MotatePins.h"                 # config.h includes it for pin types the test doesn't use
+# report.cpp's formats are written for the ARM's 32 bit longs
+${CXX:-g++} -std=gnu++14 -O2 -Wall -Wno-unused-function -Wno-stringop-truncation \
+    -Wno-format -Wno-format-overflow -I"$OUT" -I"$HERE/../../g2core" \
+    -o "$OUT/status_report_test" "$HERE/status_report_test.cpp" -lm
+"$OUT/status_report_test"
@@ -0,0 +1,214 @@
+/*
+ * rx_checksum_test.cpp - host test and benchmark of line checksums computed in the RX scan
+ * This file is part of the g2core project
+ *
+ * Builds LineRXBuffer (see rx_host.h) and the G-code parser's _verify_checksum() as they are.
+ * Generated lines - with and without N and '*' checksums, leading white space, CR, LF and
+ * CRLF endings, blank lines, JSON controls in between and the odd line too long for the line
+ * buffer - are written into the RX buffer in random sized pieces and read back as the
+ * controller reads them. Checked:
+ *
+ *  - the checksum recorded for each data line is the one _verify_checksum() computes from
+ *    the text the parser gets, or XIO_CHECKSUM_NONE if there is no '*', or
+ *    XIO_CHECKSUM_UNKNOWN - never a different value
+ *  - a line split for being too long is UNKNOWN, so the parser checks it from the text
+ *  - how many lines have their checksum recorded, with the controller keeping up with the
+ *    host and with the RX buffer kept full, as when the planner is full
+ *
+ * The benchmark times _verify_checksum() per line with the checksum from the scan and with
+ * XIO_CHECKSUM_UNKNOWN, which computes it from the text.
+ *
+ * Run it with run_rx_checksum_test.sh. It prints the measurements and exits non-zero on failure.
+ */
+
+#include <stdlib.h>
+
+#include "rx_host.h"
+
+#define STAT_CHECKSUM_MATCH_FAILED 118              // as error.h
+#define STAT_MISSING_LINE_NUMBER_WITH_CHECKSUM 120
+
+#include "verify_checksum.inc"
+
+typedef std::chrono::steady_clock host_clock;
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+static void reset_device()
+{
+    memset((void *)&device._rx_buffer, 0, sizeof(device._rx_buffer));
+    device._rx_buffer.init();
+    xio_realtime.release();
+}
+
+static int16_t text_checksum(const char *line)  // what _verify_checksum() computes from the text
+{
+    while ((*line == ' ') || (*line == '\t')) { // the controller strips leading white space
+        line++;
+    }
+    uint8_t checksum = 0;
+    for (; (*line != NUL) && (*line != '\n') && (*line != '\r'); line++) {
+        if (*line == '*') {
+            return (checksum);
+        }
+        checksum ^= (uint8_t)*line;
+    }
+    return (XIO_CHECKSUM_NONE);
+}
+
+static uint32_t seed = 1;
+static uint32_t random_u32()
+{
+    seed ^= seed << 13;                         // xorshift32
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return (seed);
+}
+
+static std::string random_line(int &n, bool &too_long)
+{
+    static const char *endings[] = { "\n", "\r", "\r\n" };
+    std::string line;
+    char text[64];
+    too_long = false;
+    switch (random_u32() % 16) {
+        case 0:  line = "{\"sr\":n}"; break;                          // a control
+        case 1:  line = ""; break;                                      // a blank line
+        case 2:  line = std::string(RX_BUFFER_SIZE + random_u32() % 300, 'X'); too_long = true; break;
+        case 3:  sprintf(text, "G1 X%u Y%u", random_u32() % 100, random_u32() % 100); line = text; break;
+        default: sprintf(text, "N%d G1 X%u.%03u Y%u.%03u F1200", n++, random_u32() % 400, random_u32() % 1000,
+                         random_u32() % 400, random_u32() % 1000);
+                 line = text;
+                 line += "*" + std::to_string(text_checksum(text) ^ ((random_u32() % 16 == 0) ? 1 : 0));
+    }
+    if ((random_u32() % 8 == 0) && !line.empty() && (line[0] != '{')) {
+        line = ((random_u32() % 2) ? "  " : "\t") + line;
+    }
+    return (line + endings[random_u32() % 3]);
+}
+
+struct scanStats {
+    int lines = 0, known = 0, unknown = 0, wrong = 0, splits = 0, split_known = 0;
+};
+
+/*
+ * Between controller passes the host sends a USB packet or part of one, or, if 'fill', all
+ * the RX buffer takes. Each pass reads the control lines and then up to 'reads' data lines -
+ * a reader that keeps up, or one held back by a full planner.
+ */
+static scanStats stream(const int lines, const bool fill, const int reads)
+{
+    reset_device();
+    scanStats stats;
+    std::string pending;
+    size_t pending_at = 0;
+    int n = 0;
+    std::vector<bool> splits;                   // for each data line queued: too long
+    while (stats.lines < lines) {
+        int chunk = fill ? HOST_RX_SIZE : 1 + random_u32() % 64;
+        while (chunk-- && (device._rx_buffer.space() != 0)) {
+            if (pending_at == pending.size()) {
+                bool too_long;
+                pending = random_line(n, too_long);
+                pending_at = 0;
+                if (!pending.empty() && (pending[0] != '{') && (pending[0] != '\n') && (pending[0] != '\r')) {
+                    splits.push_back(too_long);
+                }
+            }
+            device._rx_buffer.receive(pending[pending_at++]);
+        }
+        uint16_t size;
+        while (device.readline(false, size) != NULL) {}     // control lines
+        for (int r=0; r < reads; r++) {
+            char *line = device.readline(true, size);
+            if (line == NULL) {
+                break;
+            }
+            int16_t got = device._rx_buffer._last_line_checksum;
+            bool split = !splits.empty() && splits.front();
+            if (!splits.empty()) {
+                splits.erase(splits.begin());
+            }
+            stats.lines++;
+            stats.splits += split ? 1 : 0;
+            if (got == XIO_CHECKSUM_UNKNOWN) {
+                stats.unknown++;
+            } else if (got == text_checksum(line)) {
+                stats.known++;
+                stats.split_known += split ? 1 : 0;
+            } else {
+                stats.wrong++;
+            }
+        }
+    }
+    return (stats);
+}
+
+static void test_scan()
+{
+    struct { const char *name; bool fill; int reads; } runs[] = {
+        { "reader keeps up     ", false, 64 },
+        { "RX buffer kept full ", true, 1 },
+    };
+    printf("line checksums recorded by the RX scan:\n");
+    for (auto &run : runs) {
+        scanStats s = stream(200000, run.fill, run.reads);
+        printf("  %s %7d lines  %5.1f%% recorded  %5.1f%% unknown (%.1f%% split for being too long)\n", run.name,
+               s.lines, 100.0 * s.known / s.lines, 100.0 * s.unknown / s.lines, 100.0 * s.splits / s.lines);
+        check(s.wrong == 0, "a recorded checksum is the one computed from the text");
+        check(s.split_known == 0, "a line split for being too long is unknown");
+    }
+}
+
+static void benchmark()
+{
+    std::vector<std::string> lines;
+    std::vector<int16_t> scanned;               // what the RX scan recorded for each
+    for (int n=0; n < 10000; n++) {
+        char text[64];
+        sprintf(text, "N%d G1 X%d.%03d Y%d.%03d F1200", n, n % 400, (n * 7) % 1000, n % 300, (n * 13) % 1000);
+        scanned.push_back(text_checksum(text));
+        lines.push_back(std::string(text) + "*" + std::to_string(scanned.back()));
+    }
+    static char bufs[10000][64];
+    const int rounds = 50;
+    double times[2] = { 0, 0 };
+    for (int unknown=0; unknown < 2; unknown++) {
+        for (int r=0; r < rounds; r++) {
+            for (size_t n=0; n < lines.size(); n++) {
+                strcpy(bufs[n], lines[n].c_str());
+            }
+            volatile int sink = 0;
+            host_clock::time_point start = host_clock::now();
+            for (size_t n=0; n < lines.size(); n++) {
+                bool has_checksum;
+                sink += _verify_checksum(bufs[n], unknown ? XIO_CHECKSUM_UNKNOWN : scanned[n], &has_checksum);
+            }
+            times[unknown] += std::chrono::duration<double>(host_clock::now() - start).count();
+        }
+    }
+    double n = (double)rounds * lines.size();
+    printf("_verify_checksum(): %.1f ns per line with the scan's checksum, %.1f ns computing it from the text\n",
+           times[0] / n * 1e9, times[1] / n * 1e9);
+}
+
+int main()
+{
+    test_scan();
+    benchmark();
+
+    if (failures) {
+        printf("%d FAILED\n", failures);
+        return (1);
+    }
+    printf("PASS\n");
+    return (0);
+}
@@ -0,0 +1,117 @@
+/*
+ * rx_host.h - LineRXBuffer and the realtime mailbox built for the host, for realtime_test.cpp
+ * and rx_checksum_test.cpp
+ * This file is part of the g2core project
+ *
+ * Compiles LineRXBuffer, the realtime mailbox and the xio realtime functions as they are (see
+ * the realtime entry in extract.py) on a host stand-in for Motate's RXBuffer, which the tests
+ * write into as the USB DMA would. It holds definitions, so each test includes it exactly once.
+ */
+#ifndef RX_HOST_H_ONCE
+#define RX_HOST_H_ONCE
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+typedef uint8_t stat_t;
+#define STAT_OK 0
+#define STAT_NOOP 3
+
+#define RX_BUFFER_SIZE 512                  // as xio.h
+#define HOST_RX_SIZE 1024                   // as LineRXBuffer<1024, Device> in xioDeviceWrapper
+
+/**** stubs for what the compiled code calls ****/
+
+static bool host_hold = false;              // the machine is in a feedhold
+bool cm_has_hold() { return (host_hold); }
+inline void debug_trap(const char *reason) {}
+
+#include "xio_defs.inc"
+
+/*
+ * RXBuffer - the part of Motate's RXBuffer that LineRXBuffer uses. receive() is the DMA:
+ * it writes at the write offset, and never into the last free byte, so a full buffer is
+ * never mistaken for an empty one.
+ */
+namespace Motate {
+template <uint16_t _size, typename owner_type, typename value_type>
+struct RXBuffer {
+    owner_type _owner;
+    value_type _data[_size];
+    volatile uint16_t _read_offset;
+    volatile uint16_t _write_offset;
+    uint16_t _last_known_write_offset;
+
+    RXBuffer(owner_type owner) : _owner{owner} {};
+
+    void init() { _read_offset = _write_offset = _last_known_write_offset = 0; }
+    uint16_t _getWriteOffset() { return (_last_known_write_offset = _write_offset); }
+    bool isEmpty() { return (_read_offset == _getWriteOffset()); }
+    bool _canBeRead(uint16_t offset) {
+        return (((offset - _read_offset) & (_size-1)) < ((_getWriteOffset() - _read_offset) & (_size-1)));
+    }
+    void _restartTransfer() {}
+    void flush() { _read_offset = _getWriteOffset(); }
+
+    uint16_t space() { return ((_read_offset - _write_offset - 1) & (_size-1)); }
+    void receive(const char c) {
+        _data[_write_offset] = c;
+        _write_offset = (_write_offset + 1) & (_size-1);
+    }
+};
+}
+using Motate::RXBuffer;
+
+struct xioDeviceWrapperBase {               // the two methods the mailbox functions call
+    virtual void takeRealtime(char c, bool accept) {};
+    virtual void flushToRealtime() {};
+};
+
+#include "xio_realtime.inc"
+
+struct HostDevice : xioDeviceWrapperBase {  // xioDeviceWrapper's realtime and readline glue
+    LineRXBuffer<HOST_RX_SIZE, HostDevice *> _rx_buffer {this};
+
+    void scanRealtime() {
+        if (!xio_realtime.isEmpty()) {
+            return;
+        }
+        char c = _rx_buffer._scanRealtime();
+        if (c != NUL) {
+            xio_realtime.post(c, this);
+        }
+    }
+    void takeRealtime(char c, bool accept) final { _rx_buffer._takeRealtime(c, accept); }
+    void flushToRealtime() final { _rx_buffer.flushToRealtime(); }
+
+    char *readline(bool data, uint16_t &size) {
+        xio_realtime.scanning = true;
+        scanRealtime();
+        xio_realtime.scanning = false;
+        return (_rx_buffer.readline(!data, size));
+    }
+};
+
+static HostDevice device;
+
+struct {                                    // xio_t::scanRealtime() and flushToRealtime() for one device
+    void scanRealtime() {
+        if (!xio_realtime.scanning && xio_realtime.isEmpty()) {
+            device.scanRealtime();
+        }
+    }
+    void flushToRealtime() {
+        if (xio_realtime.from != nullptr) {
+            xio_realtime.from->flushToRealtime();
+        }
+    }
+} xio;
+
+#include "xio_realtime_api.inc"
+
+#endif // RX_HOST_H_ONCE
@@ -0,0 +1,426 @@
+/*
+ * status_report_test.cpp - host test and benchmark of status reports tracked by change class
+ * This file is part of the g2core project
+ *
+ * Builds report.cpp as it is on the config system (see config_host.h), with the status report
+ * list set from JSON as a host would set it: the default list, a heater temperature and the
+ * spindle speed. The values it reports are the host getters' (host_value[]); the test moves
+ * them and marks their change class as the runtime, heater and spindle code do. Checked:
+ *
+ *  - each element's change class is the one its group and token give it
+ *  - with nothing marked, a filtered report calls no getters and sends nothing
+ *  - a marked class reports the values of that class that moved, and only those; values
+ *    of classes not marked are not read
+ *  - a machine state change is reported without being marked
+ *  - the precision filter still drops a marked value that didn't move
+ *  - si, sim and sit set the class intervals and the tick; streaming a job (see stream()),
+ *    no class is reported sooner than its interval, and every change is reported within
+ *    its interval and a tick - also across a SysTick wrap
+ *  - nothing is sent while TX is congested, and a class deadline or congestion window left
+ *    over from more than half the SysTick range ago doesn't hold reports back
+ *
+ * The benchmarks time a filtered report and count the getters it calls with nothing marked,
+ * with only motion marked (as on every segment), and with everything marked, which is what
+ * every filtered report read before the change classes; and stream a job with one interval
+ * for everything (si at its 100 ms minimum, as before class rates) and with class rates,
+ * over links from USB down to one the reports congest, with and without the TX backoff.
+ *
+ * Run it with run_status_report_test.sh. It prints the measurements and exits non-zero on failure.
+ */
+
+#define CONFIG_HOST_REPORT                          // report.cpp replaces the config system's stubs
+#include "config_host.h"
+#include "settings/settings_default.h"
+
+#define MAX_LONG (2147483647)                       // as util.h
+
+enum { COMBINED_PROGRAM_STOP = 3, COMBINED_PROGRAM_END = 4 };   // as canonical_machine.h
+enum { MOTION_MODE_STRAIGHT_FEED = 1, MOTION_MODE_CW_ARC, MOTION_MODE_CCW_ARC };    // as gcode.h
+
+/**** stand-ins for the machine report.cpp reads ****/
+
+static uint8_t host_machine_state = 0;
+static uint8_t host_cycle_type = 0;
+static uint8_t host_motion_state = 0;
+static uint8_t host_hold_state = 0;
+uint8_t cm_get_machine_state() { return (host_machine_state); }
+uint8_t cm_get_cycle_type() { return (host_cycle_type); }
+uint8_t cm_get_motion_state() { return (host_motion_state); }
+uint8_t cm_get_hold_state() { return (host_hold_state); }
+uint8_t cm_get_motion_mode(const GCodeState_t *gcode_state) { return (MOTION_MODE_STRAIGHT_FEED); }
+
+struct mpPlanner;
+static mpPlanner *mp = nullptr;
+uint8_t mp_get_planner_buffers(const mpPlanner *_mp) { return (0); }
+
+static bool host_phat_city = true;
+bool mp_is_phat_city_time() { return (host_phat_city); }
+
+struct { uint32_t tx_congested_until; } xio;       // set as xio.cpp sets it when a write waits
+#include "xio_congestion.inc"
+
+#include "report_source.inc"
+
+/**** test ****/
+
+typedef std::chrono::steady_clock host_clock;
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+static index_t index_of(const char *token)
+{
+    return (nv_get_index((const char *)"", token));
+}
+
+static void move(const char *token, const float value)     // as the runtime moves a value
+{
+    index_t i = index_of(token);
+    host_value_flt[i] = value;
+    host_value[i] = (uint32_t)(int32_t)value;
+}
+
+static void command(const char *json)
+{
+    char buf[RX_BUFFER_SIZE];
+    strcpy(buf, json);
+    cs.bufp = buf;
+    strcpy(cs.saved_buf, buf);
+    json_parser(buf);
+}
+
+static std::string report()                             // run a filtered report, return what it sent
+{
+    host_ms += 1000;                                    // a second after the last, so every class is due
+    host_output.clear();
+    host_capture = true;
+    sr_request_status_report(SR_REQUEST_IMMEDIATE);
+    sr_status_report_callback();
+    host_capture = false;
+    return (host_output.empty() ? "" : host_output.back());
+}
+
+static bool has(const std::string &text, const char *token)
+{
+    return (text.find(std::string("\"") + token + "\":") != std::string::npos);
+}
+
+static const char *sr_list = "{\"sr\":{\"line\":t,\"posx\":t,\"posy\":t,\"posz\":t,\"posa\":t,\"feed\":t,\"vel\":t,"
+                             "\"unit\":t,\"coor\":t,\"dist\":t,\"admo\":t,\"frmo\":t,\"momo\":t,\"stat\":t,"
+                             "\"he1t\":t,\"sps\":t}}";
+
+static void setup()
+{
+    cs.comm_mode = JSON_MODE;
+    config_init();
+    js.json_mode = JSON_MODE;
+    command("{\"sv\":1}");                              // filtered
+    command("{\"si\":250}");                            // the default intervals
+    command("{\"sim\":250}");
+    command("{\"sit\":500}");
+    command(sr_list);
+    report();                                           // everything was marked by setting the list
+}
+
+static void test_classes()
+{
+    struct { const char *token; srChangeClass change; } classes[] = {
+        { "posx", SR_CHANGE_MOTION }, { "posa", SR_CHANGE_MOTION }, { "vel", SR_CHANGE_MOTION },
+        { "line", SR_CHANGE_MODEL }, { "feed", SR_CHANGE_MODEL }, { "stat", SR_CHANGE_MODEL },
+        { "he1t", SR_CHANGE_TEMPERATURE }, { "sps", SR_CHANGE_SPINDLE },
+    };
+    int checked = 0;
+    for (auto &c : classes) {
+        for (uint8_t i=0; i < NV_STATUS_REPORT_LEN; i++) {
+            if (sr.status_report_list[i] == index_of(c.token)) {
+                check(sr.status_report_class[i] == c.change, "an element's change class follows its group and token");
+                checked++;
+            }
+        }
+    }
+    check(checked == (int)(sizeof(classes) / sizeof(classes[0])), "the elements are all in the list");
+}
+
+static void test_tracking()
+{
+    setup();
+    int gets = host_gets;
+    check(report().empty() && (host_gets == gets), "with nothing marked, no getters are called and nothing is sent");
+
+    move("posx", 12.5);
+    move("feed", 1000);                                 // moved, but its class is not marked
+    sr_mark_changed(SR_CHANGE_MOTION);
+    std::string text = report();
+    check(has(text, "posx") && !has(text, "posy") && !has(text, "feed"), "a marked class reports what moved in it, and only that");
+
+    sr_mark_changed(SR_CHANGE_MODEL);
+    text = report();
+    check(has(text, "feed") && !has(text, "posx"), "the model class reports when it is marked");
+
+    move("he1t", 205.5);
+    move("sps", 12000);
+    sr_mark_changed(SR_CHANGE_TEMPERATURE);
+    text = report();
+    check(has(text, "he1t") && !has(text, "sps"), "the temperature class reports alone");
+    sr_mark_changed(SR_CHANGE_SPINDLE);
+    check(has(report(), "sps"), "the spindle class reports alone");
+
+    host_machine_state = 2;                             // as cm->machine_state is assigned
+    move("stat", COMBINED_PROGRAM_STOP + 2);
+    check(has(report(), "stat"), "a machine state change is reported without being marked");
+
+    sr_mark_changed(SR_CHANGE_MOTION);
+    check(report().empty(), "a marked value that didn't move is filtered out");
+}
+
+/*
+ * stream() - a job run one millisecond at a time, as the controller sees it. Every segment
+ * (1 ms) moves the position and marks motion; the heater moves every 50 ms, the model every
+ * 100 ms and the spindle once a second, each marking its class. Every pass requests a timed
+ * report and runs the callback. The host link drains link_bytes per ms from a TX buffer of
+ * HOST_TX_BUFFER bytes; the rest of the traffic is a response to a Gcode line every 10 ms. A
+ * write that doesn't fit waits for the link, and marks TX congested as xio does - when
+ * 'backoff', the status report callback sees it.
+ */
+#define HOST_TX_BUFFER 1024                         // as the USB TX buffer
+
+static bool backoff = true;
+
+struct classStream {
+    const char *token;                              // the element that shows the class was reported
+    srChangeClass change;
+    int reports = 0;
+    int min_gap = INT32_MAX;                        // shortest time between two reports, ms
+    int max_latency = 0;                            // longest time a change waited to be reported, ms
+    uint32_t last_report = 0;
+    uint32_t changed_at = 0;
+    bool waiting = false;
+};
+
+struct streamResult {
+    classStream classes[SR_CHANGE_CLASSES] = {
+        { "posx", SR_CHANGE_MOTION }, { "feed", SR_CHANGE_MODEL },
+        { "he1t", SR_CHANGE_TEMPERATURE }, { "sps", SR_CHANGE_SPINDLE },
+    };
+    double report_bytes = 0;                        // per second
+    double stalled_ms = 0;                          // per second, writes waiting for the link
+    bool sent_while_congested = false;
+};
+
+static void set_rates(const int si, const int sim, const int sit)
+{
+    char json[64];
+    sprintf(json, "{\"si\":%d}", si);
+    command(json);
+    sprintf(json, "{\"sim\":%d}", sim);
+    command(json);
+    sprintf(json, "{\"sit\":%d}", sit);
+    command(json);
+}
+
+static void boot(const uint32_t at)                 // the state at power-up, with SysTick starting at 'at'
+{
+    sr.status_report_request = SR_OFF;
+    sr.status_report_systick = at;
+    for (uint8_t i=0; i < SR_CHANGE_CLASSES; i++) {
+        sr.class_systick[i] = at;
+    }
+    xio.tx_congested_until = at;
+    host_ms = at;
+}
+
+static streamResult stream(const int seconds, const double link_bytes, const uint32_t start_ms,
+                           const int si, const int sim, const int sit)
+{
+    streamResult r;
+    boot(start_ms);
+    setup();
+    set_rates(si, sim, sit);
+    double tx_queue = 0;
+    auto write = [&](const size_t bytes) {
+        if (tx_queue + bytes > HOST_TX_BUFFER) {    // the write waits for the link
+            r.stalled_ms += (tx_queue + bytes - HOST_TX_BUFFER) / link_bytes;
+            tx_queue = HOST_TX_BUFFER - bytes;
+            if (backoff) {
+                xio.tx_congested_until = host_ms + XIO_TX_CONGESTION_MS;
+            }
+        }
+        tx_queue += bytes;
+    };
+    for (int ms=0; ms < seconds * 1000; ms++) {
+        host_ms++;
+        tx_queue = max(0.0, tx_queue - link_bytes);
+
+        move("posx", ms * 0.001);
+        sr_mark_changed(SR_CHANGE_MOTION);
+        if (ms % 50 == 0)   { move("he1t", 20 + ms / 50); sr_mark_changed(SR_CHANGE_TEMPERATURE); }
+        if (ms % 100 == 0)  { move("feed", 1000 + ms / 100); sr_mark_changed(SR_CHANGE_MODEL); }
+        if (ms % 1000 == 0) { move("sps", 10000 + ms / 1000); sr_mark_changed(SR_CHANGE_SPINDLE); }
+        for (auto &c : r.classes) {
+            if (!c.waiting && sr.changed[c.change] && (ms >= 1000)) {  // once the rates set above apply
+                c.waiting = true;
+                c.changed_at = host_ms;
+            }
+        }
+        if (ms % 10 == 0) {
+            write(40);                              // {"r":{"gc":"..."},"f":[1,0,40]}
+        }
+
+        host_output.clear();
+        host_capture = true;
+        sr_request_status_report(SR_REQUEST_TIMED);
+        sr_status_report_callback();
+        host_capture = false;
+        if (host_output.empty()) {
+            continue;
+        }
+        std::string &text = host_output.back();
+        r.sent_while_congested |= xio_tx_congested();
+        r.report_bytes += text.size();
+        write(text.size());
+        for (auto &c : r.classes) {
+            if (!has(text, c.token)) {
+                continue;
+            }
+            if (c.reports++ > 0) {
+                c.min_gap = min(c.min_gap, (int)(host_ms - c.last_report));
+            }
+            c.last_report = host_ms;
+            if (c.waiting) {
+                c.max_latency = max(c.max_latency, (int)(host_ms - c.changed_at));
+                c.waiting = false;
+            }
+        }
+    }
+    r.report_bytes /= seconds;
+    r.stalled_ms /= seconds;
+    return (r);
+}
+
+static void check_rates(const streamResult &r, const bool congested)
+{
+    for (auto &c : r.classes) {
+        int interval = sr.class_interval[c.change];
+        check(c.reports > 0, "every class is reported");
+        check(c.min_gap >= interval, "no class is reported sooner than its interval");
+        if (!congested) {
+            check(c.max_latency <= interval + sr.tick_interval, "a change is reported within its interval and a tick");
+        }
+    }
+}
+
+static void test_rates()
+{
+    streamResult r = stream(10, 1000, 0, 250, 20, 500);     // a link that never congests
+    check((sr.class_interval[SR_CHANGE_MOTION] == 20) && (sr.class_interval[SR_CHANGE_TEMPERATURE] == 500) &&
+          (sr.class_interval[SR_CHANGE_MODEL] == 250) && (sr.class_interval[SR_CHANGE_SPINDLE] == 250) &&
+          (sr.tick_interval == 20), "si, sim and sit set the class intervals and the tick");
+
+    check_rates(r, false);
+    r = stream(10, 1000, 0xFFFFFFFF - 5000, 250, 20, 500);  // SysTick wraps 4 seconds in
+    check_rates(r, false);
+
+    r = stream(10, 4.2, 0, 250, 20, 500);           // a link too slow for all the reports
+    check_rates(r, true);
+    check(!r.sent_while_congested, "nothing is sent while TX is congested");
+    printf("rates: sim 20, si 250, sit 500 ms, congested link - %d/%d/%d/%d motion/model/temperature/spindle reports in 10 s\n",
+           r.classes[0].reports, r.classes[1].reports, r.classes[2].reports, r.classes[3].reports);
+}
+
+static void benchmark_rates()
+{
+    struct { const char *name; int si, sim, sit; } settings[] = {
+        { "one interval, si 100  ", 100, 100, 100 },    // the fastest positions before class rates
+        { "sim 20 si 250 sit 500 ", 250, 20, 500 },
+        { "sim 50 si 250 sit 500 ", 250, 50, 500 },
+    };
+    printf("status reports over 10 s of a job, a segment per ms:\n");
+    printf("                          link      position  report   stalled ms/s   \n");
+    printf("                          bytes/ms  Hz        bytes/s  backoff  none  \n");
+    for (double link : { 1000.0, 5.76, 4.8, 4.2 }) {   // USB, 57600 baud, slower
+        for (auto &s : settings) {
+            backoff = false;
+            streamResult none = stream(10, link, 0, s.si, s.sim, s.sit);
+            backoff = true;
+            streamResult r = stream(10, link, 0, s.si, s.sim, s.sit);
+            printf("  %s %8.1f  %8.1f  %7.0f  %7.1f  %5.1f\n", s.name, link, r.classes[0].reports / 10.0,
+                   r.report_bytes, r.stalled_ms, none.stalled_ms);
+        }
+    }
+}
+
+static void test_stale()
+{
+    setup();
+    host_ms = sr.class_systick[SR_CHANGE_TEMPERATURE] + 0x80000000u + 1000;  // idle for over half the SysTick range
+    xio.tx_congested_until = host_ms - 0x80000000u - 1000;
+    move("he1t", 150);
+    sr_mark_changed(SR_CHANGE_TEMPERATURE);
+    check(!xio_tx_congested(), "a congestion window set half the SysTick range ago has ended");
+    sr_request_status_report(SR_REQUEST_IMMEDIATE);
+    host_output.clear();
+    host_capture = true;
+    sr_status_report_callback();
+    host_capture = false;
+    check(!host_output.empty() && has(host_output.back(), "he1t"), "a class idle for half the SysTick range is due");
+}
+
+static void benchmark()
+{
+    struct { const char *name; int marks; } runs[] = {
+        { "nothing marked         ", 0 },
+        { "motion marked          ", 1 },
+        { "everything marked      ", 2 },               // every filtered report before change classes
+    };
+    const int reports = 200000;
+    int elements = 0;
+    while (sr.status_report_list[elements] != 0) {
+        elements++;
+    }
+    printf("filtered status reports, %d elements:\n", elements);
+    for (auto &run : runs) {
+        setup();
+        int gets = host_gets;
+        double seconds = 0;
+        for (int n=0; n < reports; n++) {
+            move("posx", n * 0.01);                     // the machine moves on every report
+            if (run.marks == 1) {
+                sr_mark_changed(SR_CHANGE_MOTION);
+            } else if (run.marks == 2) {
+                sr_mark_all_changed();
+            }
+            host_ms += 1000;
+            sr_request_status_report(SR_REQUEST_IMMEDIATE);
+            host_clock::time_point start = host_clock::now();
+            sr_status_report_callback();
+            seconds += std::chrono::duration<double>(host_clock::now() - start).count();
+        }
+        printf("  %s %6.0f ns per report  %5.1f getters per report\n", run.name,
+               seconds / reports * 1e9, (double)(host_gets - gets) / reports);
+    }
+}
+
+int main()
+{
+    setup();
+    test_classes();
+    test_tracking();
+    test_rates();
+    test_stale();
+    benchmark();
+    benchmark_rates();
+
+    if (failures) {
+        printf("%d FAILED\n", failures);
+        return (1);
+    }
+    printf("PASS\n");
+    return (0);
+}
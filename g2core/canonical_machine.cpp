@@ -130,6 +130,10 @@ static int8_t _axis(const nvObj_t *nv);     // return axis number from token/gro
  **** CODE ******************************************************************************
  ****************************************************************************************/
 
+static void _cm_compile_transform(cmMachine_t *_cm);
+static void _cm_cancel_scaling(cmMachine_t *_cm);
+static void _cm_cancel_rotation(cmMachine_t *_cm);
+
 /****************************************************************************************
  **** Initialization ********************************************************************
  ****************************************************************************************/
@@ -142,8 +146,8 @@ static int8_t _axis(const nvObj_t *nv);     // return axis number from token/gro
 
 void canonical_machine_inits()
 {
-    planner_init(&mp1, &mr1, mp1_queue, PLANNER_QUEUE_SIZE);
-    planner_init(&mp2, &mr2, mp2_queue, SECONDARY_QUEUE_SIZE);
+    planner_init(&mp1, &mr1, mp1_queue, PLANNER_QUEUE_SIZE, mp1_splines, SPLINE_POOL_SIZE);
+    planner_init(&mp2, &mr2, mp2_queue, SECONDARY_QUEUE_SIZE, mp2_splines, SECONDARY_SPLINE_POOL_SIZE);
     canonical_machine_init(&cm1, &mp1); // primary canonical machine
     canonical_machine_init(&cm2, &mp2); // secondary canonical machine
     cm = &cm1;                          // set global canonical machine pointer to primary machine
@@ -160,7 +164,13 @@ void canonical_machine_init(cmMachine_t *_cm, void *_mp)
 
     canonical_machine_init_assertions(_cm);         // establish assertions
     cm_arc_init(_cm);                               // setup arcs. Note: spindle and coolant inits are independent
+    cm_canned_cycle_init(_cm);                      // setup canned cycles
     _cm->mp = _mp;                                  // point to associated planner
+    _cm->mm_per_unit = 1;                           // millimeters until cm_set_units_mode() says otherwise
+    for (uint8_t axis = AXIS_X; axis <= AXIS_Z; axis++) {
+        _cm->g51_scale[axis] = 1;                   // no scaling
+    }
+    canonical_machine_reset_rotation(_cm);          // identity tram and transforms
     _cm->am = MODEL;                                // setup initial Gcode model pointer
 }
 
@@ -177,6 +187,7 @@ void canonical_machine_reset(cmMachine_t *_cm)
     cm_set_path_control(MODEL, cm->default_path_control);
     cm_set_distance_mode(cm->default_distance_mode);
     cm_set_arc_distance_mode(INCREMENTAL_DISTANCE_MODE); // always the default
+    cm_set_retract_mode(RETRACT_TO_INITIAL_LEVEL);  // G98
     cm_set_feed_rate_mode(UNITS_PER_MINUTE_MODE);   // always the default
     cm_reset_overrides();                           // set overrides to initial conditions
 
@@ -205,7 +216,9 @@ void canonical_machine_reset(cmMachine_t *_cm)
 
     cm_operation_init();                            // reset operations runner
 
-    canonical_machine_reset_rotation(_cm);
+    _cm_cancel_scaling(_cm);                        // G50
+    _cm_cancel_rotation(_cm);                       // G69
+    canonical_machine_reset_rotation(_cm);          // identity tram - also compiles the transforms
     memset(&_cm->probe_state, 0, sizeof(cmProbeState)*PROBES_STORED);
     memset(&_cm->probe_results, 0, sizeof(float)*PROBES_STORED*AXES);
 }
@@ -221,6 +234,7 @@ void canonical_machine_reset_rotation(cmMachine_t *_cm) {
     // Separately handle a z-offset so that the new plane maintains a consistent 
     // distance from the old one. We only need z, since we are rotating to the z axis.
     _cm->rotation_z_offset = 0.0;
+    _cm_compile_transform(_cm);
 }
 
 /****************************************************************************************
@@ -236,13 +250,16 @@ void canonical_machine_init_assertions(cmMachine_t *_cm)
     _cm->gmx.magic_end = MAGICNUM;
     _cm->arc.magic_start = MAGICNUM;
     _cm->arc.magic_end = MAGICNUM;
+    _cm->canned.magic_start = MAGICNUM;
+    _cm->canned.magic_end = MAGICNUM;
 }
 
 stat_t canonical_machine_test_assertions(cmMachine_t *_cm)
 {
     if ((BAD_MAGIC(_cm->magic_start))     || (BAD_MAGIC(_cm->magic_end)) ||
         (BAD_MAGIC(_cm->gmx.magic_start)) || (BAD_MAGIC(_cm->gmx.magic_end)) ||
-        (BAD_MAGIC(_cm->arc.magic_start)) || (BAD_MAGIC(_cm->arc.magic_end))) {
+        (BAD_MAGIC(_cm->arc.magic_start)) || (BAD_MAGIC(_cm->arc.magic_end)) ||
+        (BAD_MAGIC(_cm->canned.magic_start)) || (BAD_MAGIC(_cm->canned.magic_end))) {
         return(cm_panic(STAT_CANONICAL_MACHINE_ASSERTION_FAILURE, "canonical_machine_test_assertions()"));
     }
     return (STAT_OK);
@@ -258,6 +275,7 @@ void cm_set_motion_state(const cmMotionState motion_state)
 {
     cm->motion_state = motion_state;
     ACTIVE_MODEL = ((motion_state == MOTION_STOP) ? MODEL : RUNTIME);
+    sr_mark_changed(SR_CHANGE_MOTION);      // velocity and reported positions follow the active model
 }
 
 /*
@@ -338,8 +356,11 @@ void cm_set_tool_number(GCodeState_t *gcode_state, const uint8_t tool)
 
 void cm_set_absolute_override(GCodeState_t *gcode_state, const uint8_t absolute_override)
 {
+    if (gcode_state->absolute_override == (cmAbsoluteOverride)absolute_override) {
+        return;                         // called twice for every move - nothing changed
+    }
     gcode_state->absolute_override = (cmAbsoluteOverride)absolute_override;
-    cm_set_display_offsets(MODEL);      // must reset offsets if you change absolute override
+    cm_update_offsets();                // must reset offsets if you change absolute override
 }
 
 void cm_set_model_linenum(int32_t linenum)
@@ -354,10 +375,12 @@ void cm_set_model_linenum(int32_t linenum)
 
 /*
  * cm_check_linenum() - Check line number for Marlin protocol
+ *
+ *  Each checksummed line must be numbered one more than the last one accepted.
  */
 
 stat_t cm_check_linenum() {
-    if (cm->gmx.last_line_number != cm->gm.linenum) {
+    if ((cm->gmx.last_line_number + 1) != cm->gm.linenum) {
         debug_trap("line number out of sequence");
         return STAT_LINE_NUMBER_OUT_OF_SEQUENCE;
     }
@@ -371,6 +394,7 @@ stat_t cm_check_linenum() {
  * These functions are not part of the NIST defined functions
  ****************************************************************************************/
 /*
+ * cm_update_offsets()      - recompute the cached combined and display offsets
  * cm_get_combined_offset() - return the combined offsets for an axis (G53-G59, G92, Tools)
  * cm_get_display_offset()  - return the current display offset from pecified Gcode model
  * cm_set_display_offsets() - capture combined offsets from the model into absolute values 
@@ -403,11 +427,17 @@ stat_t cm_check_linenum() {
  *    - cm_get_combined_offset() puts the above together to provide a combined, active offset. 
  *      G92 offsets are only included if g92 is active (gmx.g92_offset_enable == true)
  *
+ *  Cached offsets
+ *    - The combined and display offsets are summed by cm_update_offsets() into cm->combined_offset[]
+ *      and cm->display_offset[], not on every move. Anything that changes an input - G10, G43/G49,
+ *      G54-G59, the G92 family, absolute override, $g54x-$g59c and $tofx - must call it.
+ *      Settings loads defer it to cm_apply_deferred_settings() like the other derived values.
+ *
  *  Display offsets
  *      *** Display offsets are for display only and CANNOT be used to set positions ***
- *    - cm_set_display_offsets() writes combined offsets to cm.gm.display_offset[]
- *    - cm_set_display_offsets() should be called every time underlying data would cause a change
- *    - cm_set_display_offsets() takes absolute override display rules into account
+ *    - cm_set_display_offsets() writes the cached display offsets to cm.gm.display_offset[]
+ *    - cm_update_offsets() should be called every time underlying data would cause a change
+ *    - cm_update_offsets() takes absolute override display rules into account
  *    - Use cm_get_display_offset() to return the display offset value
  */     
 /*  Absolute Override is the Gcode G53 convention to allow one and only one Gcode block 
@@ -423,16 +453,29 @@ stat_t cm_check_linenum() {
  *      move will run in absolute coordinates and POS will display using no offsets.
  */
  
-float cm_get_combined_offset(const uint8_t axis)
+void cm_update_offsets()
 {
-    if (cm->gm.absolute_override >= ABSOLUTE_OVERRIDE_ON_DISPLAY_WITH_OFFSETS) {
-        return (0);
-    }
-    float offset = cm->coord_offset[cm->gm.coord_system][axis] + cm->tool_offset[axis];
-    if (cm->gmx.g92_offset_enable == true) {
-        offset += cm->gmx.g92_offset[axis];
+    for (uint8_t axis = AXIS_X; axis < AXES; axis++) {
+        float offset = cm->coord_offset[cm->gm.coord_system][axis] + cm->tool_offset[axis];
+        if (cm->gmx.g92_offset_enable == true) {
+            offset += cm->gmx.g92_offset[axis];
+        }
+
+        // if absolute override is on the move runs in machine coordinates
+        cm->combined_offset[axis] = 
+            (cm->gm.absolute_override >= ABSOLUTE_OVERRIDE_ON_DISPLAY_WITH_OFFSETS) ? 0 : offset;
+
+        // if absolute override is on for G53 so position should be displayed with no offsets
+        // all other cases: position should be displayed with currently active offsets
+        cm->display_offset[axis] = 
+            (cm->gm.absolute_override == ABSOLUTE_OVERRIDE_ON_DISPLAY_WITH_NO_OFFSETS) ? 0 : offset;
     }
-    return (offset);
+    cm_set_display_offsets(MODEL);
+}
+
+float cm_get_combined_offset(const uint8_t axis)
+{
+    return (cm->combined_offset[axis]);
 }    
 
 float cm_get_display_offset(const GCodeState_t *gcode_state, const uint8_t axis)
@@ -442,22 +485,7 @@ float cm_get_display_offset(const GCodeState_t *gcode_state, const uint8_t axis)
 
 void cm_set_display_offsets(GCodeState_t *gcode_state)
 {
-    for (uint8_t axis = AXIS_X; axis < AXES; axis++) {
-        
-        // if absolute override is on for G53 so position should be displayed with no offsets
-        if (cm->gm.absolute_override == ABSOLUTE_OVERRIDE_ON_DISPLAY_WITH_NO_OFFSETS) {
-            gcode_state->display_offset[axis] = 0;
-        } 
-
-        // all other cases: position should be displayed with currently active offsets
-        else {
-            gcode_state->display_offset[axis] = cm->coord_offset[cm->gm.coord_system][axis] + 
-                                                cm->tool_offset[axis];
-            if (cm->gmx.g92_offset_enable == true) {
-                gcode_state->display_offset[axis] += cm->gmx.g92_offset[axis];
-            }
-        }
-    }
+    copy_vector(gcode_state->display_offset, cm->display_offset);
 }
 
 /*
@@ -531,6 +559,7 @@ stat_t cm_deferred_write_callback()
     if ((cm->cycle_type == CYCLE_NONE) && (cm->deferred_write_flag == true)) {
         cm->deferred_write_flag = false;
         nvObj_t nv;
+        nv.value_int = 0;           // both values are persisted - keep the unused one constant
         for (uint8_t i=1; i<=COORDS; i++) {
             for (uint8_t j=0; j<AXES; j++) {
                 sprintf((char *)nv.token, "g%2d%c", 53+i, ("xyzuvwabc")[j]);
@@ -654,6 +683,7 @@ stat_t cm_set_tram(nvObj_t *nv)
     cm->rotation_z_offset = (n_x*cm->probe_results[1][0] + 
                              n_y*cm->probe_results[1][1]) / 
                              n_z + cm->probe_results[1][2];
+    cm_update_transform();
     return (STAT_OK);
 }
 
@@ -726,7 +756,7 @@ void cm_set_model_target(const float target[], const bool flags[])
             continue;        // skip axis if not flagged for update or its disabled
         } else if ((cm->a[axis].axis_mode == AXIS_STANDARD) || (cm->a[axis].axis_mode == AXIS_INHIBITED)) {
             if (cm->gm.distance_mode == ABSOLUTE_DISTANCE_MODE) {
-                cm->gm.target[axis] = cm_get_combined_offset(axis) + _to_millimeters(target[axis]);
+                cm->gm.target[axis] = cm->combined_offset[axis] + _to_millimeters(target[axis]);
             } else {
                 cm->gm.target[axis] += _to_millimeters(target[axis]);
             }
@@ -749,7 +779,7 @@ void cm_set_model_target(const float target[], const bool flags[])
                 cm->gm.target[axis] += tmp;
             }
             else { // if (cm.gmx.extruder_mode == EXTRUDER_MOVES_NORMAL)
-                cm->gm.target[axis] = tmp + cm_get_combined_offset(axis);
+                cm->gm.target[axis] = tmp + cm->combined_offset[axis];
             }
             // TODO - volumetric filament conversion
 //            else {
@@ -760,7 +790,7 @@ void cm_set_model_target(const float target[], const bool flags[])
 #endif // MARLIN_COMPAT_ENABLED
 
         if (cm->gm.distance_mode == ABSOLUTE_DISTANCE_MODE) {
-            cm->gm.target[axis] = tmp + cm_get_combined_offset(axis); // sacidu93's fix to Issue #22
+            cm->gm.target[axis] = tmp + cm->combined_offset[axis]; // sacidu93's fix to Issue #22
         }
         else {
             cm->gm.target[axis] += tmp;
@@ -829,6 +859,7 @@ stat_t cm_test_soft_limits(const float target[])
  *  cm_set_units_mode()         - G20, G21
  *  cm_set_distance_mode()      - G90, G91
  *  cm_set_arc_distance_mode()  - G90.1, G91.1
+ *  cm_set_retract_mode()       - G98, G99
  *  cm_set_g10_data()           - G10 (delayed persistence)
  *
  *  These functions assume input validation occurred upstream, most likely in gcode parser.
@@ -843,6 +874,7 @@ stat_t cm_select_plane(const uint8_t plane)
 stat_t cm_set_units_mode(const uint8_t mode)
 {
     cm->gm.units_mode = (cmUnitsMode)mode;               // 0 = inches, 1 = mm.
+    cm->mm_per_unit = (mode == INCHES) ? MM_PER_INCH : 1;
     return(STAT_OK);
 }
 
@@ -858,6 +890,12 @@ stat_t cm_set_arc_distance_mode(const uint8_t mode)
     return (STAT_OK);
 }
 
+stat_t cm_set_retract_mode(const uint8_t mode)
+{
+    cm->gmx.retract_mode = (cmRetractMode)mode;          // 0 = initial level, 1 = R plane
+    return (STAT_OK);
+}
+
 /****************************************************************************************
  * cm_set_g10_data() - G10 L1/L2/L10/L20 Pn (affects MODEL only)
  *
@@ -915,7 +953,7 @@ stat_t cm_set_g10_data(const uint8_t P_word, const bool P_flag,
     else {
         return (STAT_L_WORD_IS_INVALID);
     }
-    cm_set_display_offsets(MODEL);
+    cm_update_offsets();
     return (STAT_OK);
 }
 
@@ -963,7 +1001,7 @@ stat_t cm_set_tl_offset(const uint8_t H_word, const bool H_flag, const bool appl
             cm->tool_offset[axis] = tt.tt_offset[tool][axis];
         }
     }
-    cm_set_display_offsets(MODEL);                      // display new offsets in the model right now
+    cm_update_offsets();                                // display new offsets in the model right now
 
     float value[] = { (float)cm->gm.coord_system };     // pass coordinate system in value[0] element
     mp_queue_command(_exec_offset, value, nullptr);     // second vector (flags) is not used, so fake it
@@ -975,7 +1013,7 @@ stat_t cm_cancel_tl_offset()
     for (uint8_t axis = AXIS_X; axis < AXES; axis++) {
         cm->tool_offset[axis] = 0;
     }
-    cm_set_display_offsets(MODEL);                      // display new offsets in the model right now
+    cm_update_offsets();                                // display new offsets in the model right now
 
     float value[] = { (float)cm->gm.coord_system };
     mp_queue_command(_exec_offset, value, nullptr);     // changes it in the runtime when executed
@@ -985,7 +1023,7 @@ stat_t cm_cancel_tl_offset()
 stat_t cm_set_coord_system(const uint8_t coord_system)  // set coordinate system sync'd with planner
 {
     cm->gm.coord_system = (cmCoordSystem)coord_system;
-    cm_set_display_offsets(MODEL);                      // must reset display offsets if you change coordinate system
+    cm_update_offsets();                                // must reset display offsets if you change coordinate system
 
     float value[] = { (float)coord_system };
     mp_queue_command(_exec_offset, value, nullptr);
@@ -1026,9 +1064,15 @@ void cm_set_position_by_axis(const uint8_t axis, const float position)
 void cm_reset_position_to_absolute_position(cmMachine_t *_cm)
 {
     mpPlanner_t *_mp = (mpPlanner_t *)_cm->mp;
-    for (uint8_t axis = AXIS_X; axis < AXES; axis++) {
-        cm_set_position_by_axis(axis, mp_get_runtime_absolute_position(_mp->mr, axis));
-    }
+    float position[AXES];
+
+    // the model is untransformed, the planner and runtime are not - see cm_get_transform()
+    mp_get_runtime_model_position(_mp->mr, position);
+    copy_vector(_cm->gmx.position, position);
+    copy_vector(_cm->gm.target, position);
+    copy_vector(_mp->position, _mp->mr->position);
+    mp_set_steps_to_runtime_position();
+    sr_mark_changed(SR_CHANGE_MOTION);
 }
 
 /*
@@ -1097,7 +1141,7 @@ stat_t cm_set_g92_offsets(const float offset[], const bool flag[])
     // now pass the offset to the callback - setting the coordinate system also applies the offsets
     float value[] = { (float)cm->gm.coord_system }; // pass coordinate system in value[0] element
     mp_queue_command(_exec_offset, value, nullptr);
-    cm_set_display_offsets(MODEL);
+    cm_update_offsets();
     return (STAT_OK);
 }
 
@@ -1109,7 +1153,7 @@ stat_t cm_reset_g92_offsets()
     }
     float value[] = { (float)cm->gm.coord_system };
     mp_queue_command(_exec_offset, value, nullptr);
-    cm_set_display_offsets(MODEL);
+    cm_update_offsets();
     return (STAT_OK);
 }
 
@@ -1118,7 +1162,7 @@ stat_t cm_suspend_g92_offsets()
     cm->gmx.g92_offset_enable = false;
     float value[] = { (float)cm->gm.coord_system };
     mp_queue_command(_exec_offset, value, nullptr);
-    cm_set_display_offsets(MODEL);
+    cm_update_offsets();
     return (STAT_OK);
 }
 
@@ -1127,7 +1171,197 @@ stat_t cm_resume_g92_offsets()
     cm->gmx.g92_offset_enable = true;
     float value[] = { (float)cm->gm.coord_system };
     mp_queue_command(_exec_offset, value, nullptr);
-    cm_set_display_offsets(MODEL);
+    cm_update_offsets();
+    return (STAT_OK);
+}
+
+/******************************************************************************************
+ * Work coordinate transform - scaling and rotation (G50, G51, G68, G69) and bed tram
+ *
+ * cm_update_transform() - compile the tram, G68 and G51 into the transforms used by mp_aline()
+ * cm_get_transform()    - return the transform (or its inverse) that applies to a Gcode state
+ * cm_set_scaling()      - G51 - scale about a center. P scales all axes, I,J,K scale X,Y,Z
+ * cm_cancel_scaling()   - G50
+ * cm_set_rotation()     - G68 - rotate R degrees about a center in the selected plane
+ * cm_cancel_rotation()  - G69
+ *
+ *  The Gcode model (gm.target, gmx.position) stays in untransformed machine coordinates:
+ *  work offsets are added in cm_set_model_target() and incremental moves and arcs are
+ *  computed as programmed. mp_aline() applies one affine transform to the XYZ target on its
+ *  way into the planner, so tramming, rotation and scaling cost one 3x4 multiply per move
+ *  however many of them are active. Arcs stay arcs under rotation because every segment
+ *  endpoint goes through the same transform; unequal scale factors turn them into ellipses.
+ *
+ *  Moves in machine coordinates (G53, homing, jogging, probing, G28/G30) use the tram alone.
+ *  G68 and G51 centers are converted to machine coordinates when they are programmed, so
+ *  changing work offsets afterwards doesn't move them. An omitted center word uses the
+ *  current position. UVW and ABC are never transformed.
+ *
+ *  Program end and reset cancel G51 and G68. The tram is only reset by homing or {tram:f}.
+ */
+
+// Invert an affine transform: the matrix by its adjugate, then the offset through the inverse
+static void _transform_invert(cmTransform_t *out, const cmTransform_t *in)
+{
+    const float (*m)[3] = in->matrix;
+    out->matrix[0][0] = m[1][1]*m[2][2] - m[1][2]*m[2][1];
+    out->matrix[0][1] = m[0][2]*m[2][1] - m[0][1]*m[2][2];
+    out->matrix[0][2] = m[0][1]*m[1][2] - m[0][2]*m[1][1];
+    out->matrix[1][0] = m[1][2]*m[2][0] - m[1][0]*m[2][2];
+    out->matrix[1][1] = m[0][0]*m[2][2] - m[0][2]*m[2][0];
+    out->matrix[1][2] = m[0][2]*m[1][0] - m[0][0]*m[1][2];
+    out->matrix[2][0] = m[1][0]*m[2][1] - m[1][1]*m[2][0];
+    out->matrix[2][1] = m[0][1]*m[2][0] - m[0][0]*m[2][1];
+    out->matrix[2][2] = m[0][0]*m[1][1] - m[0][1]*m[1][0];
+
+    float det_inv = 1 / (m[0][0]*out->matrix[0][0] + m[0][1]*out->matrix[1][0] + m[0][2]*out->matrix[2][0]);
+    for (uint8_t i=0; i<3; i++) {
+        for (uint8_t j=0; j<3; j++) {
+            out->matrix[i][j] *= det_inv;
+        }
+    }
+    for (uint8_t i=0; i<3; i++) {
+        out->offset[i] = -(out->matrix[i][0] * in->offset[0] + 
+                           out->matrix[i][1] * in->offset[1] + 
+                           out->matrix[i][2] * in->offset[2]);
+    }
+}
+
+static void _cm_compile_transform(cmMachine_t *_cm)
+{
+    cmTransform_t *mt = &_cm->machine_transform;
+    cmTransform_t *wt = &_cm->work_transform;
+
+    // the tram is a rotation with a Z offset
+    memcpy(mt->matrix, _cm->rotation_matrix, sizeof(mt->matrix));
+    mt->offset[AXIS_X] = 0;
+    mt->offset[AXIS_Y] = 0;
+    mt->offset[AXIS_Z] = _cm->rotation_z_offset;
+
+    if (fp_ZERO(_cm->g68_angle) && 
+        fp_EQ(_cm->g51_scale[AXIS_X], 1) && fp_EQ(_cm->g51_scale[AXIS_Y], 1) && fp_EQ(_cm->g51_scale[AXIS_Z], 1)) {
+        memcpy(wt, mt, sizeof(cmTransform_t));          // no work transform - same as the tram
+    } else {
+        // G68 rotation in the plane it was programmed in: axes a0, a1 and the normal are right handed
+        uint8_t a0 = AXIS_X, a1 = AXIS_Y;                                   // G17
+        if (_cm->g68_plane == CANON_PLANE_XZ) { a0 = AXIS_Z; a1 = AXIS_X; } // G18
+        if (_cm->g68_plane == CANON_PLANE_YZ) { a0 = AXIS_Y; a1 = AXIS_Z; } // G19
+        float theta = _cm->g68_angle * (M_PI / 180);
+        float r[3][3] = {{1,0,0}, {0,1,0}, {0,0,1}};
+        r[a0][a0] = cos(theta);  r[a0][a1] = -sin(theta);
+        r[a1][a0] = sin(theta);  r[a1][a1] = cos(theta);
+
+        // work = rotate about the G68 center after scaling about the G51 center
+        float w[3][3];
+        float w_offset[3];
+        float scaled[3];                                // G51 center offset: c - s*c
+        for (uint8_t i=0; i<3; i++) {
+            scaled[i] = _cm->g51_center[i] - _cm->g51_scale[i] * _cm->g51_center[i];
+        }
+        for (uint8_t i=0; i<3; i++) {
+            for (uint8_t j=0; j<3; j++) {
+                w[i][j] = r[i][j] * _cm->g51_scale[j];
+            }
+            w_offset[i] = _cm->g68_center[i] + 
+                          r[i][0] * (scaled[0] - _cm->g68_center[0]) +
+                          r[i][1] * (scaled[1] - _cm->g68_center[1]) +
+                          r[i][2] * (scaled[2] - _cm->g68_center[2]);
+        }
+
+        // then the tram
+        for (uint8_t i=0; i<3; i++) {
+            for (uint8_t j=0; j<3; j++) {
+                wt->matrix[i][j] = mt->matrix[i][0] * w[0][j] + mt->matrix[i][1] * w[1][j] + mt->matrix[i][2] * w[2][j];
+            }
+            wt->offset[i] = mt->matrix[i][0] * w_offset[0] + mt->matrix[i][1] * w_offset[1] + 
+                            mt->matrix[i][2] * w_offset[2] + mt->offset[i];
+        }
+    }
+    _transform_invert(&_cm->machine_inverse, mt);
+    _transform_invert(&_cm->work_inverse, wt);
+}
+
+void cm_update_transform() { _cm_compile_transform(cm); }
+
+const cmTransform_t *cm_get_transform(const GCodeState_t *gcode_state, const bool inverse)
+{
+    if ((gcode_state->absolute_override != ABSOLUTE_OVERRIDE_OFF) || (gcode_state->coord_system == ABSOLUTE_COORDS)) {
+        return (inverse ? &cm->machine_inverse : &cm->machine_transform);
+    }
+    return (inverse ? &cm->work_inverse : &cm->work_transform);
+}
+
+// Resolve center words to machine coordinates. Omitted words use the current position.
+static void _get_transform_center(float center_out[], const float center[], const bool center_f[])
+{
+    for (uint8_t axis = AXIS_X; axis <= AXIS_Z; axis++) {
+        if (center_f[axis]) {
+            center_out[axis] = _to_millimeters(center[axis]) + cm->combined_offset[axis];
+        } else {
+            center_out[axis] = cm->gmx.position[axis];
+        }
+    }
+}
+
+stat_t cm_set_scaling(const float center[], const bool center_f[],
+                      const float scale[], const bool scale_f[],
+                      const float P_word, const bool P_flag)
+{
+    if (!(P_flag || scale_f[AXIS_X] || scale_f[AXIS_Y] || scale_f[AXIS_Z])) {
+        return (STAT_P_WORD_IS_MISSING);
+    }
+    float factor[3];
+    for (uint8_t axis = AXIS_X; axis <= AXIS_Z; axis++) {
+        factor[axis] = scale_f[axis] ? scale[axis] : (P_flag ? P_word : 1);
+        if (fp_ZERO(factor[axis])) {
+            return (STAT_INPUT_VALUE_RANGE_ERROR);      // a zero scale would flatten the axis
+        }
+    }
+    _get_transform_center(cm->g51_center, center, center_f);
+    copy_vector(cm->g51_scale, factor);
+    cm_update_transform();
+    return (STAT_OK);
+}
+
+static void _cm_cancel_scaling(cmMachine_t *_cm)
+{
+    for (uint8_t axis = AXIS_X; axis <= AXIS_Z; axis++) {
+        _cm->g51_scale[axis] = 1;
+        _cm->g51_center[axis] = 0;
+    }
+}
+
+stat_t cm_cancel_scaling()
+{
+    _cm_cancel_scaling(cm);
+    cm_update_transform();
+    return (STAT_OK);
+}
+
+stat_t cm_set_rotation(const float center[], const bool center_f[], const float angle, const bool angle_f)
+{
+    if (!angle_f) {
+        return (STAT_R_WORD_IS_MISSING);
+    }
+    _get_transform_center(cm->g68_center, center, center_f);
+    cm->g68_plane = cm->gm.select_plane;
+    cm->g68_angle = angle;
+    cm_update_transform();
+    return (STAT_OK);
+}
+
+static void _cm_cancel_rotation(cmMachine_t *_cm)
+{
+    _cm->g68_angle = 0;
+    for (uint8_t axis = AXIS_X; axis <= AXIS_Z; axis++) {
+        _cm->g68_center[axis] = 0;
+    }
+}
+
+stat_t cm_cancel_rotation()
+{
+    _cm_cancel_rotation(cm);
+    cm_update_transform();
     return (STAT_OK);
 }
 
@@ -1324,6 +1558,103 @@ stat_t cm_straight_feed(const float *target, const bool *flags, const uint8_t mo
     return (status);
 }
 
+/****************************************************************************************
+ * cm_spline_feed() - G5, G5.1
+ *
+ *  G5 is a cubic Bezier curve in the XY plane from the current position to the target.
+ *  I,J place the first control point relative to the start, P,Q the second control point
+ *  relative to the target. A G5 that follows another G5 may leave out I,J; the first control
+ *  point is then the last one reflected through the start, so the curves join smoothly.
+ *  G5.1 is a quadratic curve with I,J its control point relative to the start, and is queued
+ *  as the equivalent cubic. Offsets are always incremental. Z and the other axes move along
+ *  with the curve, as they would in a helix.
+ *
+ *  The curve lies inside its control points, so soft limits are tested on those.
+ */
+
+stat_t cm_spline_feed(const float target[], const bool target_f[],     // target endpoint
+                      const float offset[], const bool offset_f[],     // IJ first control point
+                      const float P_word, const bool P_word_f,         // PQ second control point
+                      const float Q_word, const bool Q_word_f,
+                      const cmMotionMode motion_mode)                  // cubic or quadratic
+{
+    // trap zero feed rate condition
+    if (fp_ZERO(cm->gm.feed_rate)) {
+        return (STAT_FEEDRATE_NOT_SPECIFIED);
+    }
+
+    // G5 motion mode persists, so a block with no axis words is not a move (as for G1)
+    if (!(target_f[AXIS_X] | target_f[AXIS_Y] | target_f[AXIS_Z] |
+          target_f[AXIS_U] | target_f[AXIS_V] | target_f[AXIS_W] |
+          target_f[AXIS_A] | target_f[AXIS_B] | target_f[AXIS_C])) {
+        return(STAT_OK);
+    }
+    if (cm->gm.select_plane != CANON_PLANE_XY) {
+        return (STAT_ACTIVE_PLANE_IS_INVALID);
+    }
+
+    float start_offset[2];                          // first control point relative to the start
+    bool offset_given = offset_f[OFS_I] || offset_f[OFS_J];
+    if (offset_given) {
+        start_offset[0] = _to_millimeters(offset[OFS_I]);
+        start_offset[1] = _to_millimeters(offset[OFS_J]);
+    } else if ((motion_mode == MOTION_MODE_CUBIC_SPLINE) &&
+               (cm->gm.motion_mode == MOTION_MODE_CUBIC_SPLINE)) {
+        start_offset[0] = -cm->spline_offset[0];
+        start_offset[1] = -cm->spline_offset[1];
+    } else {
+        return (STAT_ARC_OFFSETS_MISSING_FOR_SELECTED_PLANE);
+    }
+    if (motion_mode == MOTION_MODE_CUBIC_SPLINE) {
+        if (!P_word_f) {
+            return (STAT_P_WORD_IS_MISSING);
+        }
+        if (!Q_word_f) {
+            return (STAT_Q_WORD_IS_MISSING);
+        }
+    }
+
+    cm_set_model_target(target, target_f);
+    const float *start = cm->gmx.position;
+    const float *end = cm->gm.target;
+    float control_1[AXES];                          // inner control points, all axes for soft limits
+    float control_2[AXES];
+    copy_vector(control_1, end);
+    copy_vector(control_2, end);
+    if (motion_mode == MOTION_MODE_CUBIC_SPLINE) {
+        cm->spline_offset[0] = _to_millimeters(P_word);
+        cm->spline_offset[1] = _to_millimeters(Q_word);
+        control_1[AXIS_X] = start[AXIS_X] + start_offset[0];
+        control_1[AXIS_Y] = start[AXIS_Y] + start_offset[1];
+        control_2[AXIS_X] = end[AXIS_X] + cm->spline_offset[0];
+        control_2[AXIS_Y] = end[AXIS_Y] + cm->spline_offset[1];
+    } else {                                        // quadratic control point raised to cubic
+        for (uint8_t i = 0; i < 2; i++) {
+            control_1[i] = start[i] + start_offset[i] * (2.0/3.0);
+            control_2[i] = end[i] + (start[i] + start_offset[i] - end[i]) * (2.0/3.0);
+        }
+    }
+    control_1[AXIS_Z] = start[AXIS_Z] + (end[AXIS_Z] - start[AXIS_Z]) * (1.0/3.0);
+    control_2[AXIS_Z] = start[AXIS_Z] + (end[AXIS_Z] - start[AXIS_Z]) * (2.0/3.0);
+
+    ritorno (cm_test_soft_limits(control_1));       // test soft limits; exit if thrown
+    ritorno (cm_test_soft_limits(control_2));
+    ritorno (cm_test_soft_limits(cm->gm.target));
+    cm->gm.motion_mode = motion_mode;
+    cm_set_display_offsets(&cm->gm);                // capture the fully resolved offsets to the state
+    cm_cycle_start();                               // if not already started
+    stat_t status = mp_spline(&cm->gm, control_1, control_2);
+    cm_update_model_position();
+
+    if (status == STAT_MINIMUM_LENGTH_MOVE) {       // same as cm_straight_feed()
+        if (!mp_has_runnable_buffer(mp)) {
+            cm_cycle_end();
+        }
+        status = STAT_OK;
+    }
+    return (status);
+}
+
 /****************************************************************************************
  **** Spindle Functions (4.3.7) *********************************************************
  ****************************************************************************************/
@@ -1604,10 +1935,13 @@ static void _exec_program_finalize(float *value, bool *flag)
     // perform the following resets if it's a program END
     if (machine_state == MACHINE_PROGRAM_END) {
         cm_suspend_g92_offsets();                           // G92.2 - as per NIST
+        cm_cancel_scaling();                                // G50
+        cm_cancel_rotation();                               // G69
         cm_set_coord_system(cm->default_coord_system);      // reset to default coordinate system
         cm_select_plane(cm->default_select_plane);          // reset to default arc plane
         cm_set_distance_mode(cm->default_distance_mode);    // reset to default distance mode
         cm_set_arc_distance_mode(INCREMENTAL_DISTANCE_MODE);// always the default
+        cm_set_retract_mode(RETRACT_TO_INITIAL_LEVEL);      // G98
 //        toolhead.control_immediate(TOOLHEAD_OFF);         // M5
         spindle_control_immediate(SPINDLE_OFF);             // M5
         coolant_control_immediate(COOLANT_OFF,COOLANT_BOTH);// M9
@@ -1949,7 +2283,21 @@ static const char msg_g01[] = "G1  - linear feed";
 static const char msg_g02[] = "G2  - clockwise arc feed";
 static const char msg_g03[] = "G3  - counter clockwise arc feed";
 static const char msg_g80[] = "G80 - cancel motion mode (none active)";
-static const char *const msg_momo[] = { msg_g00, msg_g01, msg_g02, msg_g03, msg_g80 };
+static const char msg_g382[] = "G38.2 - straight probe";
+static const char msg_g81[] = "G81 - drilling";
+static const char msg_g82[] = "G82 - drilling with dwell";
+static const char msg_g83[] = "G83 - peck drilling";
+static const char msg_g84[] = "G84 - right hand tapping";
+static const char msg_g85[] = "G85 - boring, feed out";
+static const char msg_g86[] = "G86 - boring, spindle stop, rapid out";
+static const char msg_g87[] = "G87 - back boring";
+static const char msg_g88[] = "G88 - boring, spindle stop, manual out";
+static const char msg_g89[] = "G89 - boring, dwell, feed out";
+static const char msg_g05[] = "G5  - cubic spline feed";
+static const char msg_g051[] = "G5.1 - quadratic spline feed";
+static const char *const msg_momo[] = { msg_g00, msg_g01, msg_g02, msg_g03, msg_g80, msg_g382,
+                                        msg_g81, msg_g82, msg_g83, msg_g84, msg_g85,
+                                        msg_g86, msg_g87, msg_g88, msg_g89, msg_g05, msg_g051 };
 
 static const char msg_g17[] = "G17 - XY plane";
 static const char msg_g18[] = "G18 - XZ plane";
@@ -2050,8 +2398,25 @@ stat_t cm_get_hom(nvObj_t *nv)  { return (get_integer(nv, cm->homed[_axis(nv)]))
 stat_t cm_get_prob(nvObj_t *nv) { return(_get_msg_helper(nv, msg_probe, cm_get_probe_state())); }
 stat_t cm_get_prb(nvObj_t *nv)  { return (get_float(nv, cm->probe_results[0][_axis(nv)])); }
 
+// $g54x-$g59c and $tofx feed the cached offsets - recompute them once when a settings load ends
+static bool _offsets_deferred = false;
+
+static void _cm_offsets_changed()
+{
+    if (nv_deferring_derived()) {
+        _offsets_deferred = true;
+        return;
+    }
+    cm_update_offsets();
+}
+
 stat_t cm_get_coord(nvObj_t *nv) { return (get_float(nv, cm->coord_offset[_coord(nv)][_axis(nv)])); }
-stat_t cm_set_coord(nvObj_t *nv) { return (set_float(nv, cm->coord_offset[_coord(nv)][_axis(nv)])); }
+stat_t cm_set_coord(nvObj_t *nv)
+{
+    ritorno(set_float(nv, cm->coord_offset[_coord(nv)][_axis(nv)]));
+    _cm_offsets_changed();
+    return (STAT_OK);
+}
 
 stat_t cm_get_g92e(nvObj_t *nv)  { return (get_integer(nv, cm->gmx.g92_offset_enable)); }
 stat_t cm_get_g92(nvObj_t *nv)   { return (get_float(nv, cm->gmx.g92_offset[_axis(nv)])); }
@@ -2071,7 +2436,12 @@ static uint8_t _tool(nvObj_t *nv)
 }
 
 stat_t cm_get_tof(nvObj_t *nv) { return (get_float(nv, cm->tool_offset[_axis(nv)])); }
-stat_t cm_set_tof(nvObj_t *nv) { return (set_float(nv, cm->tool_offset[_axis(nv)])); }
+stat_t cm_set_tof(nvObj_t *nv)
+{
+    ritorno(set_float(nv, cm->tool_offset[_axis(nv)]));
+    _cm_offsets_changed();
+    return (STAT_OK);
+}
 
 stat_t cm_get_tt(nvObj_t *nv)
 {   
@@ -2138,6 +2508,7 @@ stat_t cm_set_ra(nvObj_t *nv) { return (set_float_range(nv, cm->a[_axis(nv)].rad
 /**** Axis Jerk Primitives
  * cm_get_axis_jerk() - returns max jerk for an axis
  * cm_set_axis_jerk() - sets the jerk for an axis, including reciprocal and cached values
+ * cm_apply_deferred_settings() - recompute values deferred by nv_defer_derived()
  */
 float cm_get_axis_jerk(const uint8_t axis) { return (cm->a[axis].jerk_max); }
 
@@ -2145,9 +2516,15 @@ float cm_get_axis_jerk(const uint8_t axis) { return (cm->a[axis].jerk_max); }
 // See plan_line.cpp -> _calculate_junction_vmax() notes for details.
 static const float _junction_accel_multiplier = sqrt(3.0)/10.0;
 
+static uint16_t _junction_accel_deferred = 0;   // axes awaiting recalc - one bit per axis
+
 // Important note: Actual jerk is stored jerk * JERK_MULTIPLIER, and
 // Time Quanta is junction_integration_time / 1000.
 void _cm_recalc_junction_accel(const uint8_t axis) {
+    if (nv_deferring_derived()) {               // recalc once when deferring ends
+        _junction_accel_deferred |= (1 << axis);
+        return;
+    }
     float T = cm->junction_integration_time / 1000.0;
     float T2 = T*T;
     cm->a[axis].max_junction_accel = _junction_accel_multiplier * T2 * (cm->a[axis].jerk_max * JERK_MULTIPLIER);
@@ -2166,6 +2543,20 @@ void cm_set_axis_high_jerk(const uint8_t axis, const float jerk)
     _cm_recalc_junction_accel(axis);    // Must recalculate the max_junction_accel now that the jerk has changed.
 }
 
+void cm_apply_deferred_settings()
+{
+    for (uint8_t axis=0; axis<AXES; axis++) {
+        if (_junction_accel_deferred & (1 << axis)) {
+            _cm_recalc_junction_accel(axis);
+        }
+    }
+    _junction_accel_deferred = 0;
+    if (_offsets_deferred) {
+        _offsets_deferred = false;
+        cm_update_offsets();
+    }
+}
+
 /**** Axis Velocity and Jerk Settings
  *
  * cm_get_vm() - get velocity max value - called from dispatch table
@@ -2257,6 +2648,8 @@ stat_t cm_set_zb(nvObj_t *nv) { return (set_float(nv, cm->a[_axis(nv)].zero_back
  * cm_set_jt()  - set junction integration time
  * cm_get_ct()  - get chordal tolerance
  * cm_set_ct()  - set chordal tolerance
+ * cm_get_ab()  - get arc block enable
+ * cm_set_ab()  - set arc block enable
  * cm_get_sl()  - get soft limit enable
  * cm_set_sl()  - set soft limit enable
  * cm_get_lim() - get hard limit enable
@@ -2280,6 +2673,9 @@ stat_t cm_set_jt(nvObj_t *nv)
 stat_t cm_get_ct(nvObj_t *nv) { return(get_float(nv, cm->chordal_tolerance)); }
 stat_t cm_set_ct(nvObj_t *nv) { return(set_float_range(nv, cm->chordal_tolerance, CHORDAL_TOLERANCE_MIN, 10000000)); }
 
+stat_t cm_get_ab(nvObj_t *nv) { return(get_integer(nv, cm->arc_block_enable)); }
+stat_t cm_set_ab(nvObj_t *nv) { return(set_integer(nv, (uint8_t &)cm->arc_block_enable, 0, 1)); }
+
 stat_t cm_get_zl(nvObj_t *nv) { return(get_float(nv, cm->feedhold_z_lift)); }
 stat_t cm_set_zl(nvObj_t *nv) { return(set_float(nv, cm->feedhold_z_lift)); }
 
@@ -2416,6 +2812,7 @@ void cm_print_gdi(nvObj_t *nv) { text_print(nv, fmt_gdi);}  // TYPE_INT
 
 static const char fmt_jt[] = "[jt]  junction integration time%7.2f\n";
 static const char fmt_ct[] = "[ct]  chordal tolerance%17.4f%s\n";
+static const char fmt_ab[] = "[ab]  arc block enable%13d [0=chord segments,1=arc blocks]\n";
 static const char fmt_zl[] = "[zl]  Z lift on feedhold%16.3f%s\n";
 static const char fmt_sl[] = "[sl]  soft limit enable%12d [0=disable,1=enable]\n";
 static const char fmt_lim[] ="[lim] limit switch enable%10d [0=disable,1=enable]\n";
@@ -2423,6 +2820,7 @@ static const char fmt_saf[] ="[saf] safety interlock enable%6d [0=disable,1=enab
 
 void cm_print_jt(nvObj_t *nv) { text_print(nv, fmt_jt);}        // TYPE FLOAT
 void cm_print_ct(nvObj_t *nv) { text_print_flt_units(nv, fmt_ct, GET_UNITS(ACTIVE_MODEL));}
+void cm_print_ab(nvObj_t *nv) { text_print(nv, fmt_ab);}        // TYPE_INT
 void cm_print_zl(nvObj_t *nv) { text_print_flt_units(nv, fmt_zl, GET_UNITS(ACTIVE_MODEL));}
 void cm_print_sl(nvObj_t *nv) { text_print(nv, fmt_sl);}        // TYPE_INT
 void cm_print_lim(nvObj_t *nv){ text_print(nv, fmt_lim);}       // TYPE_INT
@@ -47,7 +47,7 @@
 #define RUNTIME (GCodeState_t *)&mr->gm     // absolute pointer from runtime mm struct
 #define ACTIVE_MODEL cm->am                 // active model pointer is maintained by cm_set_motion_state()
 
-#define _to_millimeters(a)  ((cm->gm.units_mode == INCHES) ? ((float)a * (float)MM_PER_INCH) : (float)a)
+#define _to_millimeters(a)  ((float)(a) * cm->mm_per_unit)   // set by cm_set_units_mode()
 #define _to_inches(a)       ((cm->gm.units_mode == INCHES) ? ((float)a * (float)(1/MM_PER_INCH)) : (float)a)
 
 #define DISABLE_SOFT_LIMIT  (999999)
@@ -223,6 +223,11 @@ typedef struct cmAxis {
     float zero_backoff;                     // backoff from switches for machine zero
 } cfgAxis_t;
 
+typedef struct cmTransform {                // affine transform of XYZ: out = matrix * in + offset
+    float matrix[3][3];
+    float offset[3];
+} cmTransform_t;
+
 typedef struct cmArc {                      // planner and runtime variables for arc generation
     magic_t magic_start;
     uint8_t run_state;                      // runtime state machine sequence
@@ -249,11 +254,46 @@ typedef struct cmArc {                      // planner and runtime variables for
     float   segment_linear_travel;          // linear motion per segment
     float   center_0;                       // center of circle at plane axis 0 (e.g. X for G17)
     float   center_1;                       // center of circle at plane axis 1 (e.g. Y for G17)
+    float   radius_0;                       // center to current point at plane axis 0: sin(theta) * radius
+    float   radius_1;                       // center to current point at plane axis 1: cos(theta) * radius
+    float   segment_sin;                    // sin(segment_theta) - rotates the radius vector by one segment
+    float   segment_cos;                    // cos(segment_theta)
+    uint8_t correction_count;               // segments until the radius vector is recomputed exactly
 
     GCodeState_t gm;                        // Gcode state struct is passed for each arc segment.
     magic_t magic_end;
 } cmArc_t;
 
+typedef struct cmCanned {                   // canned cycle (G81-G89) words and hole generation
+    magic_t magic_start;
+    uint8_t run_state;                      // BLOCK_ACTIVE while a block's holes are being queued
+    uint8_t step;                           // next move of the current hole (see cycle_drilling.cpp)
+    uint8_t repeats;                        // holes left to drill in this block (L word)
+
+    bool  R_word_f;                         // sticky words - held from block to block in a series
+    bool  Z_word_f;                         //   of canned cycles and cleared on leaving it
+    bool  P_word_f;
+    bool  Q_word_f;
+    float R_word;                           // as given - converted when each block is set up
+    float Z_word;
+    float P_word;
+    float Q_word;
+
+    float initial_z;                        // Z the series was entered at - the G98 retract level
+    float clear_z;                          // Z to move between holes at
+    float r_plane;                          // R plane (machine coordinates, mm)
+    float bottom;                           // bottom of the hole
+    float depth;                            // depth reached so far by G83 pecks
+    float peck;                             // G83 peck increment (mm)
+    float dwell;                            // G82, G89 dwell at the bottom (seconds)
+    bool  feed_out;                         // G85, G89 feed back out to the R plane
+    float hole[2];                          // XY of the current hole
+    float hole_step[2];                     // XY increment between repeats (G91 only)
+
+    GCodeState_t gm;                        // Gcode state struct is passed for each generated move
+    magic_t magic_end;
+} cmCanned_t;
+
 typedef struct cmMachine {                  // struct to manage canonical machine globals and state
     magic_t magic_start;                    // magic number to test memory integrity
 
@@ -262,6 +302,7 @@ typedef struct cmMachine {                  // struct to manage canonical machin
     // System group settings
     float junction_integration_time;        // how aggressively will the machine corner? 1.6 or so is about the upper limit
     float chordal_tolerance;                // arc chordal accuracy setting in mm
+    bool arc_block_enable;                  // true to queue arcs as single planner blocks, false for chord segments
     float feedhold_z_lift;                  // mm to move Z axis on feedhold, or 0 to disable
     bool soft_limit_enable;                 // true to enable soft limit testing on Gcode inputs
     bool limit_enable;                      // true to enable limit switches (disabled is same as override)
@@ -319,14 +360,32 @@ typedef struct cmMachine {                  // struct to manage canonical machin
     cmProbeState probe_state[PROBES_STORED];  // probing state machine (simple)
     float probe_results[PROBES_STORED][AXES]; // probing results
 
-    float rotation_matrix[3][3];            // three-by-three rotation matrix. We ignore UVW and ABC axes
+    float rotation_matrix[3][3];            // three-by-three tram rotation matrix. We ignore UVW and ABC axes
     float rotation_z_offset;                // separately handle a z-offset to maintain consistent distance to bed
 
+    // Work coordinate transform (G68, G51) - compiled with the tram by cm_update_transform()
+    cmCanonicalPlane g68_plane;             // plane the G68 rotation was programmed in
+    float g68_angle;                        // G68 rotation in degrees about the plane normal, 0 = off
+    float g68_center[3];                    // G68 center of rotation (XYZ, machine coordinates)
+    float g51_scale[3];                     // G51 scale factors (XYZ), negative mirrors, 1 = off
+    float g51_center[3];                    // G51 center of scaling (XYZ, machine coordinates)
+    cmTransform_t machine_transform;        // tram only - for moves in machine coordinates
+    cmTransform_t work_transform;           // tram * G68 * G51 - for moves in work coordinates
+    cmTransform_t machine_inverse;          // inverses of the above for runtime position displays
+    cmTransform_t work_inverse;
+
     float jogging_dest;                     // jogging destination as a relative move from current position
 
+    // Offsets and units cached for the move path - see cm_update_offsets()
+    float combined_offset[AXES];            // G54-G59 + G92 + tool offsets, or 0 in absolute override
+    float display_offset[AXES];             // the same for display - 0 only in G53 override
+    float mm_per_unit;                      // 25.4 in G20, 1 in G21 - see _to_millimeters()
+
   /**** Model state structures ****/
     void *mp;                               // linked mpPlanner_t - use a void pointer to avoid circular header files
     cmArc_t arc;                            // arc parameters
+    cmCanned_t canned;                      // canned cycle parameters
+    float spline_offset[2];                 // P,Q of the last G5 - reflected for a G5 without I,J
     GCodeState_t *am;                       // active Gcode model is maintained by state management
     GCodeState_t  gm;                       // core gcode model state
     GCodeStateX_t gmx;                      // extended gcode model state
@@ -385,6 +444,7 @@ void cm_set_model_linenum(int32_t linenum);
 stat_t cm_check_linenum();
 
 // Coordinate systems and offsets
+void cm_update_offsets(void);
 float cm_get_combined_offset(const uint8_t axis);
 float cm_get_display_offset(const GCodeState_t *gcode_state, const uint8_t axis);
 void cm_set_display_offsets(GCodeState_t *gcode_state);
@@ -415,6 +475,7 @@ stat_t cm_select_plane(const uint8_t plane);                                // G
 stat_t cm_set_units_mode(const uint8_t mode);                               // G20, G21
 stat_t cm_set_distance_mode(const uint8_t mode);                            // G90, G91
 stat_t cm_set_arc_distance_mode(const uint8_t mode);                        // G90.1, G91.1
+stat_t cm_set_retract_mode(const uint8_t mode);                             // G98, G99
 stat_t cm_set_tl_offset(const uint8_t H_word, const bool H_flag,            // G43, G43.2
                         const bool apply_additional);
 stat_t cm_cancel_tl_offset(void);                                           // G49
@@ -433,6 +494,16 @@ stat_t cm_reset_g92_offsets(void);                                          // G
 stat_t cm_suspend_g92_offsets(void);                                        // G92.2
 stat_t cm_resume_g92_offsets(void);                                         // G92.3
 
+void cm_update_transform(void);                                             // compile tram, G68 and G51
+const cmTransform_t *cm_get_transform(const GCodeState_t *gcode_state, const bool inverse);
+stat_t cm_set_scaling(const float center[], const bool center_f[],          // G51
+                      const float scale[], const bool scale_f[],
+                      const float P_word, const bool P_flag);
+stat_t cm_cancel_scaling(void);                                             // G50
+stat_t cm_set_rotation(const float center[], const bool center_f[],         // G68
+                       const float angle, const bool angle_f);
+stat_t cm_cancel_rotation(void);                                            // G69
+
 // Free Space Motion (4.3.4)
 stat_t cm_straight_traverse(const float *target, const bool *flags, const uint8_t motion_profile); // G0
 stat_t cm_set_g28_position(void);                                           // G28.1
@@ -456,6 +527,12 @@ stat_t cm_arc_feed(const float target[], const bool target_f[],             // G
                    const bool modal_g1_f,                                   // modal group flag for motion group
                    const cmMotionMode motion_mode);                         // defined motion mode
 
+stat_t cm_spline_feed(const float target[], const bool target_f[],          // G5/G5.1 - target endpoint
+                      const float offset[], const bool offset_f[],          // IJ first control point
+                      const float P_word, const bool P_word_f,              // PQ second control point
+                      const float Q_word, const bool Q_word_f,
+                      const cmMotionMode motion_mode);                      // cubic or quadratic
+
 // Spindle Functions (4.3.7)
 // see spindle.h for spindle functions - which would go right here
 
@@ -514,6 +591,17 @@ stat_t cm_probing_cycle_callback(void);                         // G38.x main lo
 stat_t cm_get_prbr(nvObj_t *nv);                                // enable/disable probe report
 stat_t cm_set_prbr(nvObj_t *nv);
 
+// Canned drilling cycles (cycle_drilling.cpp)
+void cm_canned_cycle_init(cmMachine_t *_cm);
+stat_t cm_canned_cycle(const float target[], const bool target_f[],         // G81-G89 - hole XY and Z depth
+                       const float R_word, const bool R_word_f,             // R plane
+                       const float P_word, const bool P_word_f,             // dwell
+                       const float Q_word, const bool Q_word_f,             // peck increment
+                       const uint8_t L_word, const bool L_word_f,           // repeats
+                       const cmMotionMode motion_mode);                     // G81-G89
+stat_t cm_canned_cycle_callback(cmMachine_t *_cm);                          // G81-G89 main loop callback
+void cm_abort_canned_cycle(cmMachine_t *_cm);
+
 // Jogging cycle (cycle_jogging.cpp)
 stat_t cm_jogging_cycle_callback(void);                         // jogging cycle main loop
 stat_t cm_jogging_cycle_start(uint8_t axis);                    // {"jogx":-100.3}
@@ -601,6 +689,7 @@ stat_t cm_set_ra(nvObj_t *nv);          // set radius
 float cm_get_axis_jerk(const uint8_t axis);
 void cm_set_axis_max_jerk(const uint8_t axis, const float jerk);
 void cm_set_axis_high_jerk(const uint8_t axis, const float jerk);
+void cm_apply_deferred_settings(void);
 
 stat_t cm_get_vm(nvObj_t *nv);          // get velocity max
 stat_t cm_set_vm(nvObj_t *nv);          // set velocity max and reciprocal
@@ -628,6 +717,8 @@ stat_t cm_get_jt(nvObj_t *nv);          // get junction integration time constan
 stat_t cm_set_jt(nvObj_t *nv);          // set junction integration time constant
 stat_t cm_get_ct(nvObj_t *nv);          // get chordal tolerance
 stat_t cm_set_ct(nvObj_t *nv);          // set chordal tolerance
+stat_t cm_get_ab(nvObj_t *nv);          // get arc block enable
+stat_t cm_set_ab(nvObj_t *nv);          // set arc block enable
 stat_t cm_get_zl(nvObj_t *nv);          // get feedhold Z lift
 stat_t cm_set_zl(nvObj_t *nv);          // set feedhold Z lift
 stat_t cm_get_sl(nvObj_t *nv);          // get soft limit enable
@@ -705,6 +796,7 @@ stat_t cm_set_gdi(nvObj_t *nv);         // set gcode default distance mode
 
     void cm_print_jt(nvObj_t *nv);          // global CM settings
     void cm_print_ct(nvObj_t *nv);
+    void cm_print_ab(nvObj_t *nv);
     void cm_print_zl(nvObj_t *nv);
     void cm_print_sl(nvObj_t *nv);
     void cm_print_lim(nvObj_t *nv);
@@ -773,6 +865,7 @@ stat_t cm_set_gdi(nvObj_t *nv);         // set gcode default distance mode
 
     #define cm_print_jt tx_print_stub       // global CM settings
     #define cm_print_ct tx_print_stub
+    #define cm_print_ab tx_print_stub
     #define cm_print_zl tx_print_stub
     #define cm_print_sl tx_print_stub
     #define cm_print_lim tx_print_stub
@@ -33,6 +33,7 @@
 #include "report.h"
 #include "controller.h"
 #include "canonical_machine.h"
+#include "stepper.h"
 #include "json_parser.h"
 #include "text_parser.h"
 #include "persistence.h"
@@ -41,7 +42,9 @@
 #include "util.h"
 #include "xio.h"
 
-static void _set_defa(nvObj_t *nv, bool print);
+static void _set_defa(nvObj_t *nv, bool print, bool restore);
+static bool _set_target(const nvObj_t *nv);
+static stat_t _txn_set(nvObj_t *nv);
 
 /***********************************************************************************
  **** STRUCTURE ALLOCATIONS ********************************************************
@@ -49,6 +52,7 @@ static void _set_defa(nvObj_t *nv, bool print);
 
 nvStr_t nvStr;
 nvList_t nvl;
+nvTransaction_t txn;
 
 /***********************************************************************************
  **** CODE *************************************************************************
@@ -67,6 +71,11 @@ stat_t nv_set(nvObj_t *nv)
     if (nv->index >= nv_index_max()) {
         return(STAT_INTERNAL_RANGE_ERROR);
     }
+    if ((txn.state == TXN_OPEN) && (cfgArray[nv->index].set != set_txn) && (cfgArray[nv->index].set != set_dump) &&
+        (cfgArray[nv->index].set != set_defaults) && nv_index_is_single(nv->index)) {
+        return (_txn_set(nv));              // groups fall through and set each child
+    }
+    sr_mark_all_changed();                  // settings can change how any value is reported
     return (((fptrCmd)cfgArray[nv->index].set)(nv));
 }
 
@@ -91,6 +100,9 @@ stat_t nv_persist(nvObj_t *nv)
     if (nv_index_lt_groups(nv->index) == false) {
         return(STAT_INTERNAL_RANGE_ERROR);
     }
+    if (txn.state == TXN_OPEN) {            // values are persisted when the transaction commits
+        return (STAT_OK);
+    }
     if (GET_TABLE_BYTE(flags) & F_PERSIST) {
         return(write_persistent_value(nv));
     }
@@ -100,9 +112,9 @@ stat_t nv_persist(nvObj_t *nv)
 /************************************************************************************
  * config_init() - called once on hard reset
  *
- * Performs one of 2 actions:
- *  (1) if persistence is set up or out-of-rev load RAM and NVM with settings.h defaults
- *  (2) if persistence is set up and at current config version use NVM data for config
+ * Loads each setting from NVM if it has been persisted, otherwise from the settings.h
+ * defaults. persistence_init() has already replayed the NVM log (or started a fresh one
+ * if the table layout changed), so this is one pass over cfgArray.
  *
  *  You can assume the cfg struct has been zeroed by a hard reset.
  *  Do not clear it as the version and build numbers have already been set by tg_init()
@@ -114,34 +126,69 @@ void config_init()
     nvObj_t *nv = nv_reset_nv_list();
     config_init_assertions();
     js.json_mode = JSON_MODE;                    // initial value until persistence is read
-    _set_defa(nv, false);
+    _set_defa(nv, false, true);
     rpt_print_loading_configs_message();
 }
 
 /*
  * set_defaults() - reset persistence with default values for machine profile
  * _set_defa() - helper function and called directly from config_init()
+ * _set_target() - write a value straight to the target of a generic binding
+ *
+ *  Defaults are no longer written to NVM - an index with no record reads as its default.
+ *
+ *  Most of cfgArray is bound to set_flt(), set_int32() or set_data(), which only store the
+ *  value in the target. Those are written directly with no nvObj set-up. Entries with their
+ *  own setters still run them, but with derived values deferred so junction accel and steps
+ *  per unit are computed once per axis and motor at the end instead of after every entry.
+ *  The end state is the same as running every setter in table order.
  */
 
-static void _set_defa(nvObj_t *nv, bool print)
+static bool _set_target(const nvObj_t *nv)
+{
+    const cfgItem_t *item = &cfgArray[nv->index];
+    if (item->target == nullptr) {
+        return (false);
+    }
+    if (item->set == set_flt) {
+        *((float *)item->target) = nv->value_flt;
+    } else if (item->set == (fptrCmd)set_int32) {   // set_int32 is overloaded
+        *((int32_t *)item->target) = nv->value_int;
+    } else if (item->set == set_data) {
+        memcpy(item->target, &nv->value_flt, sizeof(uint32_t));  // blind cast, as set_data()
+    } else {
+        return (false);
+    }
+    return (true);
+}
+
+static void _set_defa(nvObj_t *nv, bool print, bool restore)
 {
     cm_set_units_mode(MILLIMETERS);             // must do inits in MM mode
+    nv_defer_derived(true);
     for (nv->index=0; nv_index_is_single(nv->index); nv->index++) {
-        if (cfgArray[nv->index].flags & F_INITIALIZE) {
+        if (restore && (cfgArray[nv->index].flags & F_PERSIST) && (read_persistent_value(nv) == STAT_OK)) {
+            // value_int and value_flt were both loaded from NVM
+        } else if (cfgArray[nv->index].flags & F_INITIALIZE) {
             if ((cfgArray[nv->index].flags & TYPE_INTEGER) ||
                 (cfgArray[nv->index].flags & TYPE_BOOLEAN)) {    // Fix for Issue #357
                 nv->value_int = cfgArray[nv->index].def_value;
             } else {
                 nv->value_flt = cfgArray[nv->index].def_value;
             }
-            strncpy(nv->token, cfgArray[nv->index].token, TOKEN_LEN);
-            cfgArray[nv->index].set(nv);        // run the set method, nv_set(nv);
-            if (cfgArray[nv->index].flags & F_PERSIST) {
-                nv_persist(nv);
-            }            
+        } else {
+            continue;
         }
+        if (_set_target(nv)) {
+            continue;
+        }
+        strncpy(nv->token, cfgArray[nv->index].token, TOKEN_LEN);
+        cfgArray[nv->index].set(nv);            // run the set method, nv_set(nv);
+    }
+    nv_defer_derived(false);                    // one pass over the derived values
+    if (!(restore && sr_restore_status_report())) {
+        sr_init_status_report();                // reset status reports
     }
-    sr_init_status_report();                    // reset status reports
     if (print) {
         rpt_print_initializing_message();       // don't start TX until all the NVM persistence is done
     }
@@ -153,7 +200,9 @@ stat_t set_defaults(nvObj_t *nv)
     if (!nv->value_int) { 
         return(help_defa(nv));
     }
-    _set_defa(nv, true);
+    nv_txn_abort();                             // defaults replace whatever it set
+    persistence_reset();                        // discard everything that was persisted
+    _set_defa(nv, true, false);
 
     // The nvlist was used for the initialize message so the values are all garbage
     // Mark the nv as $defa so it displays nicely in the response
@@ -364,6 +413,349 @@ stat_t set_grp(nvObj_t *nv)
     return (STAT_OK);
 }
 
+/*
+ * Streaming dumps
+ *
+ * set_dump()          - {"dump":"pattern"} or $dump=pattern streams every setting whose token matches the pattern
+ * get_dump()          - {"dump":n} or $dump streams every setting
+ * nv_dump_callback()  - send the next chunk of a running dump (main loop)
+ * nv_dump_is_running() - true until the dump's closing response has been sent
+ * _nv_match()         - wildcard match. '*' matches any run of characters, '?' any one character
+ *
+ *  Examples: "*" is the whole configuration, "1*" is motor 1, "?vm" is velocity max for
+ *  every axis, "di*" is every digital input. Matching is on the full token (group prefix
+ *  included). Only settings are streamed (F_INITIALIZE or F_PERSIST) - GETs on commands
+ *  have side effects, and groups are made of the same settings anyway.
+ *
+ *  get_grp() fills the nvList with a whole group, so anything bigger than NV_BODY_LEN has
+ *  to be split by the host into many requests. Here the request only records the pattern
+ *  and returns STAT_COMPLETE, so the parser sends no response. nv_dump_callback() then walks
+ *  cfgArray from where it left off and prints one {"dump":{...}} chunk of up to NV_DUMP_CHUNK
+ *  values per main loop pass, so a dump never holds the loop for more than one chunk. The
+ *  request is closed by the normal response carrying the number of values sent, e.g.
+ *  {"r":{"dump":312},"f":[1,0,12]}. Control and data lines are not read until it has been
+ *  sent (see _dispatch_control() and _dispatch_command()), so responses stay in order.
+ *
+ *  The dump uses the nvList for each chunk, so it must be the only pair in its request.
+ */
+
+static struct nvDump {
+    bool running;                           // a dump has been requested and not yet closed
+    index_t next;                           // cfgArray index to resume from
+    int32_t count;                          // values sent so far
+    char pattern[NV_DUMP_PATTERN_LEN+1];
+} nv_dump;
+
+static bool _nv_match(const char *pattern, const char *token)
+{
+    if (*pattern == NUL) {
+        return (*token == NUL);
+    }
+    if (*pattern == '*') {
+        do {
+            if (_nv_match(pattern+1, token)) {
+                return (true);
+            }
+        } while (*token++ != NUL);
+        return (false);
+    }
+    if ((*token == NUL) || ((*pattern != '?') && (*pattern != *token))) {
+        return (false);
+    }
+    return (_nv_match(pattern+1, token+1));
+}
+
+static stat_t _nv_dump_start(nvObj_t *nv, const char *pattern)
+{
+    if ((nv != nv_body) || (nv->nx->valuetype != TYPE_EMPTY)) {
+        return (STAT_JSON_TOO_MANY_PAIRS);          // the dump reuses the nvList
+    }
+    strcpy(nv_dump.pattern, pattern);
+    nv_dump.next = 0;
+    nv_dump.count = 0;
+    nv_dump.running = true;
+    return (STAT_COMPLETE);                         // nv_dump_callback() sends the response
+}
+
+stat_t nv_dump_callback()
+{
+    if (!nv_dump.running) {
+        return (STAT_NOOP);
+    }
+    nvObj_t *nv = nv_reset_nv_list();
+    strcpy(nv->token, "dump");
+    nv->index = nv_get_index((const char *)"", nv->token);
+
+    uint8_t chunk = 0;
+    nvObj_t *child = nv->nx;
+    index_t i = nv_dump.next;
+    for ( ; nv_index_is_single(i) && (chunk < NV_DUMP_CHUNK); i++) {
+        if (!(cfgArray[i].flags & (F_INITIALIZE | F_PERSIST)) || !_nv_match(nv_dump.pattern, cfgArray[i].token)) {
+            continue;
+        }
+        child->index = i;
+        nv_get_nvObj(child);
+        strcpy(child->token, cfgArray[i].token);    // flatten out groups (as status reports do)
+        child->group[0] = NUL;
+        child = child->nx;
+        chunk++;
+    }
+    nv_dump.next = i;
+    nv_dump.count += chunk;
+    if (chunk > 0) {
+        nv->valuetype = TYPE_PARENT;
+        nv_print_list(STAT_OK, TEXT_MULTILINE_FORMATTED, JSON_OBJECT_FORMAT);
+        return (STAT_OK);                           // one chunk per pass - the end is found next pass
+    }
+    nv->valuetype = TYPE_INTEGER;                   // the response carries the count
+    nv->value_int = nv_dump.count;
+    nv_dump.running = false;
+    nv_print_list(STAT_OK, TEXT_MULTILINE_FORMATTED, JSON_RESPONSE_FORMAT);
+    return (STAT_OK);
+}
+
+bool nv_dump_is_running() { return (nv_dump.running); }
+
+stat_t set_dump(nvObj_t *nv)
+{
+    if (nv->valuetype != TYPE_STRING) {
+        return (STAT_UNSUPPORTED_TYPE);
+    }
+    if (strlen(*nv->stringp) > NV_DUMP_PATTERN_LEN) {
+        return (STAT_INPUT_EXCEEDS_MAX_LENGTH);
+    }
+    return (_nv_dump_start(nv, *nv->stringp));
+}
+
+stat_t get_dump(nvObj_t *nv) { return (_nv_dump_start(nv, "*")); }
+
+/*
+ * Configuration transactions
+ *
+ * set_txn()  - {txn:1} begins a transaction, {txn:0} commits it, {txn:-1} aborts it
+ * get_txn()  - returns the number of settings set in the open transaction
+ * _txn_set() - called from nv_set() for every single-valued set while a transaction is open
+ *
+ *  Loading a profile is hundreds of individual sets, and setters like cm_set_jm() and
+ *  st_set_sa() recompute derived values (junction accel, steps per unit) on every one.
+ *  Inside a transaction each set is applied as it arrives, but with derived values deferred
+ *  and nothing persisted. The first time a transaction sets a setting, the value it had
+ *  before is saved in that setting's slot (see config_app.cpp). Every setting has a slot,
+ *  so a transaction can hold a whole profile. Each line still gets its normal response so
+ *  host flow control is unchanged.
+ *
+ *  Commit recomputes the derived values once per axis or motor, persists every setting the
+ *  transaction set and responds with their number. If any set in the transaction failed -
+ *  a setter rejected its value, or the token was not a setting - commit restores the saved
+ *  values instead, recomputes the derived values from them and fails with the first error.
+ *  Nothing is persisted. Abort restores the saved values without an error.
+ *
+ *  Only settings (F_INITIALIZE) can be set while a transaction is open. Commands and
+ *  strings are refused and fail the transaction, except $defa, which aborts it first.
+ *  Gcode is refused too: {gc:...} here, and raw Gcode lines by the controller, so no
+ *  motion runs while derived values are deferred. Raw lines are refused without failing
+ *  the transaction, as they never reach nv_set().
+ *
+ *  A transaction is also aborted when the host disconnects, on a job kill (^D), and by
+ *  nv_txn_callback() if no set arrives for NV_TXN_TIMEOUT_MS - so a host that goes away
+ *  can't leave the machine half configured with derived values deferred. A hard reset
+ *  clears it with the rest of RAM, and nothing in it was persisted.
+ */
+
+#define TXN_BEGIN   1
+#define TXN_COMMIT  0
+#define TXN_ABORT   -1
+
+static bool _txn_touched(const index_t slot)
+{
+    return (nv_txn_touched[slot >> 3] & (1 << (slot & 7)));
+}
+
+static bool _txn_is_float(const index_t index)      // float and data settings save value_flt
+{
+    valueType type = (valueType)(cfgArray[index].flags & F_TYPE_MASK);
+    return ((type == TYPE_FLOAT) || (type == TYPE_DATA));
+}
+
+static void _txn_get(nvObj_t *nv, const index_t index)  // reads the current value
+{
+    nv->pv = NULL;
+    nv->nx = NULL;
+    nv->index = index;
+    nv_get_nvObj(nv);                               // sets token and group the way the setters expect
+}
+
+static void _txn_object(nvObj_t *nv, const index_t index, const valueType type, const int32_t value_int, const float value_flt)
+{
+    _txn_get(nv, index);
+    nv->valuetype = type;
+    nv->value_int = value_int;
+    nv->value_flt = value_flt;
+}
+
+static stat_t _txn_set(nvObj_t *nv)
+{
+    stat_t status;
+    index_t slot = nv_setting_slot[nv->index];
+
+    if (slot == NO_MATCH) {
+        status = STAT_COMMAND_NOT_ACCEPTED;         // only settings can be set
+    } else if ((nv->valuetype != TYPE_INTEGER) && (nv->valuetype != TYPE_FLOAT) && (nv->valuetype != TYPE_BOOLEAN)) {
+        status = STAT_UNSUPPORTED_TYPE;
+    } else {
+        if (!_txn_touched(slot)) {                  // save the value from before the transaction
+            nvObj_t item;
+            _txn_get(&item, nv->index);
+            bool got_float = ((item.valuetype == TYPE_FLOAT) || (item.valuetype == TYPE_DATA));
+            if (_txn_is_float(nv->index)) {
+                nv_txn_prior[slot].value_flt = got_float ? item.value_flt : (float)item.value_int;
+            } else {
+                nv_txn_prior[slot].value_int = got_float ? (int32_t)item.value_flt : item.value_int;
+            }
+            nv_txn_touched[slot >> 3] |= (1 << (slot & 7));
+            txn.count++;
+        }
+        txn.last_set = SysTickTimer_getValue();
+        sr_mark_all_changed();
+        status = ((fptrCmd)cfgArray[nv->index].set)(nv);
+    }
+    if ((status != STAT_OK) && (txn.status == STAT_OK)) {
+        txn.status = status;                        // remember the first failure for the commit
+        txn.failed = nv->index;
+    }
+    return (status);
+}
+
+/*
+ * _txn_close() - commit or roll back the open transaction
+ *
+ *  Saved values are canonical (mm), so they are restored in millimeter mode the way
+ *  _set_defa() loads them. Each touched slot is visited once and cleared for the next
+ *  transaction.
+ */
+static stat_t _txn_close(nvObj_t *nv, const bool commit)
+{
+    stat_t status = (commit ? txn.status : STAT_OK);
+    bool rollback = (!commit || (status != STAT_OK));
+    uint8_t units_mode = cm_get_units_mode(MODEL);
+    nvObj_t item;
+
+    txn.state = TXN_CLOSED;
+    if (status != STAT_OK) {
+        char message[NV_MESSAGE_LEN];
+        sprintf(message, "txn rolled back at %s", cfgArray[txn.failed].token);
+        nv_add_conditional_message(message);
+    }
+    if (rollback) {
+        cm_set_units_mode(MILLIMETERS);
+        for (index_t i = nv_index_max(); i > 0; i--) {  // undo in reverse table order
+            index_t slot = nv_setting_slot[i-1];
+            if ((slot == NO_MATCH) || !_txn_touched(slot)) {
+                continue;
+            }
+            valueType type = (valueType)(cfgArray[i-1].flags & F_TYPE_MASK);
+            if (_txn_is_float(i-1)) {
+                _txn_object(&item, i-1, type, 0, nv_txn_prior[slot].value_flt);
+            } else {
+                _txn_object(&item, i-1, type, nv_txn_prior[slot].value_int, 0);
+            }
+            if (!_set_target(&item)) {
+                ((fptrCmd)cfgArray[i-1].set)(&item);
+            }
+            nv_txn_touched[slot >> 3] &= ~(1 << (slot & 7));
+        }
+        cm_set_units_mode(units_mode);
+    }
+    nv_defer_derived(false);                        // derived values - once per axis and motor
+
+    if (!rollback) {
+        for (index_t i=0; i < nv_index_max(); i++) {
+            index_t slot = nv_setting_slot[i];
+            if ((slot == NO_MATCH) || !_txn_touched(slot)) {
+                continue;
+            }
+            _txn_get(&item, i);                     // persist what the setter actually stored
+            nv_persist(&item);
+            nv_txn_touched[slot >> 3] &= ~(1 << (slot & 7));
+        }
+        nv->value_int = txn.count;
+    }
+    return (status);
+}
+
+stat_t set_txn(nvObj_t *nv)
+{
+    stat_t status = STAT_OK;
+
+    if (nv->value_int == TXN_BEGIN) {
+        if (txn.state != TXN_CLOSED) {
+            return (STAT_COMMAND_NOT_ACCEPTED);
+        }
+        txn.count = 0;
+        txn.status = STAT_OK;
+        txn.last_set = SysTickTimer_getValue();
+        txn.state = TXN_OPEN;
+        nv_defer_derived(true);
+    } else if (nv->value_int == TXN_COMMIT) {
+        if (txn.state != TXN_OPEN) {
+            return (STAT_COMMAND_NOT_ACCEPTED);
+        }
+        status = _txn_close(nv, true);
+    } else if (nv->value_int == TXN_ABORT) {
+        nv_txn_abort();
+    } else {
+        return (STAT_INPUT_VALUE_RANGE_ERROR);
+    }
+    nv->valuetype = TYPE_INTEGER;
+    return (status);
+}
+
+stat_t get_txn(nvObj_t *nv)
+{
+    nv->value_int = (txn.state == TXN_OPEN) ? txn.count : 0;
+    nv->valuetype = TYPE_INTEGER;
+    return (STAT_OK);
+}
+
+void nv_txn_abort()
+{
+    if (txn.state == TXN_OPEN) {
+        nvObj_t nv;
+        _txn_close(&nv, false);
+    }
+}
+
+stat_t nv_txn_callback()
+{
+    if ((txn.state == TXN_OPEN) && ((int32_t)(SysTickTimer_getValue() - txn.last_set) >= NV_TXN_TIMEOUT_MS)) {
+        nv_txn_abort();
+        rpt_exception(STAT_COMMAND_NOT_ACCEPTED, "txn aborted - idle timeout");
+    }
+    return (STAT_OK);
+}
+
+/*
+ * nv_defer_derived()     - start or end deferring derived values; ending applies them
+ * nv_deferring_derived() - setters check this before recomputing derived values
+ *
+ *  Setters whose value feeds a derived one (jerk -> junction accel, sa/tr/mi -> steps per
+ *  unit) mark the axis or motor instead of recomputing while this is on. Used by
+ *  transaction commits and by the defaults/NVM load in config_init() and $defa.
+ */
+
+static bool nv_deferring = false;
+
+void nv_defer_derived(bool defer)
+{
+    nv_deferring = defer;
+    if (!defer) {
+        cm_apply_deferred_settings();
+        st_apply_deferred_settings();
+    }
+}
+
+bool nv_deferring_derived() { return (nv_deferring); }
+
 /***********************************************************************************
  ***** nvObj functions ************************************************************
  ***********************************************************************************/
@@ -374,9 +766,14 @@ stat_t set_grp(nvObj_t *nv)
 
 /* nv_get_index() - get index from mnenonic token + group
  *
- * nv_get_index() is the most expensive routine in the whole config. It does a
- * linear table scan of the strings, which of course could be further
- * optimized with indexes or hashing.
+ * nv_get_index() used to be the most expensive routine in the whole config - a linear
+ * scan of the ~1000 strings in cfgArray for every JSON key, $ command and status report
+ * token. It now hashes the token and only compares the entries in its bucket, usually
+ * one or two.
+ *
+ * Tokens match on at most their first 5 characters, so only those are hashed (see
+ * nv_hash_token()). The bucket heads and chains are const tables computed from cfgArray
+ * at compile time in config_app.cpp, so they take no RAM.
  */
 index_t nv_get_index(const char *group, const char *token)
 {
@@ -386,9 +783,7 @@ index_t nv_get_index(const char *group, const char *token)
     strncat(str, token, TOKEN_LEN+1);
 
     index_t i;
-    index_t index_max = nv_index_max();
-
-    for (i=0; i < index_max; i++) {
+    for (i = nv_hash_head[nv_hash_token(str)]; i != NO_MATCH; i = nv_hash_next[i]) {
         if ((c = GET_TOKEN_BYTE(token[0])) != str[0]) {    continue; }              // 1st character mismatch
         if ((c = GET_TOKEN_BYTE(token[1])) == NUL) { if (str[1] == NUL) return(i);} // one character match
         if (c != str[1]) continue;                                                  // 2nd character mismatch
@@ -485,7 +880,8 @@ void nv_get_nvObj(nvObj_t *nv)
         if (cfgArray[nv->index].flags & F_NOSTRIP) {
             nv->group[0] = NUL;
         } else {
-            strcpy(nv->token, &nv->token[strlen(nv->group)]); // strip group from the token
+            char *tail = &nv->token[strlen(nv->group)];   // strip group from the token
+            memmove(nv->token, tail, strlen(tail)+1);     // the strings overlap, so not strcpy()
         }
     }
     ((fptrCmd)cfgArray[nv->index].get)(nv);     // populate the value
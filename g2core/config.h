@@ -191,7 +191,11 @@ typedef uint16_t index_t;               // use this if there are > 255 indexed o
 #define NV_LIST_LEN (NV_BODY_LEN+2)     // +2 allows for a header and a footer
 #define NV_EXEC_FIRST (NV_BODY_LEN+2)   // index of the first EXEC nv
 #define NV_MAX_OBJECTS (NV_BODY_LEN-1)  // maximum number of objects in a body string
+#define NV_DUMP_CHUNK 16                // values per line in a streamed dump - must serialize within OUTPUT_BUFFER_LEN
+#define NV_DUMP_PATTERN_LEN 16          // longest wildcard pattern accepted by set_dump()
 #define NO_MATCH (index_t)0xFFFF
+#define NV_HASH_BUCKETS 256             // token hash table size for nv_get_index(). Must be 2^N
+#define NV_TXN_TIMEOUT_MS 10000         // an open transaction with no sets for this long is aborted
 
 typedef enum {
     TEXT_MODE = 0,                      // sticky text mode
@@ -329,10 +333,29 @@ typedef struct cfgItem {
     float def_value;                    // default value for config item
 } cfgItem_t;
 
+typedef enum {                          // configuration transaction states (see set_txn())
+    TXN_CLOSED = 0,                     // sets are applied as they arrive
+    TXN_OPEN                            // sets are applied with derived values deferred and can be rolled back
+} nvTxnState;
+
+typedef union nvTxnPrior {              // value a setting had before a transaction first set it
+    int32_t value_int;                  // integer and boolean settings
+    float value_flt;                    // float and data settings
+} nvTxnPrior_t;
+
+typedef struct nvTransaction {
+    nvTxnState state;
+    stat_t status;                      // first error - a failed transaction rolls back on commit
+    index_t failed;                     // cfgArray index of the set that failed
+    uint16_t count;                     // settings set in the transaction
+    uint32_t last_set;                  // SysTick time of the latest set, for the idle timeout
+} nvTransaction_t;
+
 /**** static allocation and definitions ****/
 
 extern nvStr_t nvStr;
 extern nvList_t nvl;
+extern nvTransaction_t txn;
 extern const cfgItem_t cfgArray[];
 
 //#define nv_header nv.list
@@ -361,8 +384,24 @@ index_t nv_index_max(void);             // (see config_app.c)
 bool nv_index_is_single(index_t index); // (see config_app.c)
 bool nv_index_is_group(index_t index);  // (see config_app.c)
 bool nv_index_lt_groups(index_t index); // (see config_app.c)
+extern const index_t *const nv_hash_head;  // (see config_app.c)
+extern const index_t *const nv_hash_next;  // (see config_app.c)
+extern const index_t *const nv_setting_slot; // (see config_app.c)
+extern nvTxnPrior_t nv_txn_prior[];     // (see config_app.c)
+extern uint8_t nv_txn_touched[];        // (see config_app.c)
 bool nv_group_is_prefixed(char *group);
 
+// token hash for nv_get_index() - FNV-1a over the significant (first 5) characters.
+// constexpr so config_app.cpp can chain cfgArray into buckets at compile time.
+constexpr uint16_t nv_hash_token(const char *str)
+{
+    uint32_t hash = 2166136261;
+    for (uint8_t i=0; (i < 5) && (str[i] != '\0'); i++) {
+        hash = (hash ^ (uint8_t)str[i]) * 16777619;
+    }
+    return (hash & (NV_HASH_BUCKETS-1));
+}
+
 // generic internal functions and accessors
 stat_t get_nul(nvObj_t *nv);            // get null value type
 stat_t get_int32(nvObj_t *nv);          // get int32_t integer value
@@ -379,6 +418,18 @@ stat_t set_data(nvObj_t *nv);           // set uint32_t integer value blind cast
 stat_t set_grp(nvObj_t *nv);            // set data for a group
 stat_t get_grp(nvObj_t *nv);            // get data for a group
 
+stat_t set_dump(nvObj_t *nv);           // stream all settings matching a wildcard pattern
+stat_t get_dump(nvObj_t *nv);           // stream all settings
+stat_t nv_dump_callback(void);          // send the next chunk of a running dump
+bool nv_dump_is_running(void);
+
+stat_t set_txn(nvObj_t *nv);            // begin, commit or abort a configuration transaction
+stat_t get_txn(nvObj_t *nv);            // get number of settings set in the open transaction
+void nv_txn_abort(void);                // roll back an open transaction - on disconnect, job kill and $defa
+stat_t nv_txn_callback(void);           // abort a transaction that has been idle too long
+void nv_defer_derived(bool defer);      // defer derived values - false applies them
+bool nv_deferring_derived(void);        // true while derived values should be deferred
+
 // nvObj and list functions
 void nv_get_nvObj(nvObj_t *nv);
 nvObj_t *nv_reset_nv(nvObj_t *nv);
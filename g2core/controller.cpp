@@ -45,6 +45,8 @@
 #include "util.h"
 #include "xio.h"
 #include "settings.h"
+#include "persistence.h"
+#include "job.h"
 
 #include "MotatePower.h"
 
@@ -58,6 +60,28 @@
 
 controller_t cs;        // controller state structure
 
+/*
+ * Parse-ahead queue - data lines read and tokenized while the planner is full.
+ * See _parse_ahead()
+ */
+
+typedef struct parseAheadLine {
+    devflags_t flags;                   // flags of the channel the line was read from
+    bool tokenized;                     // tokens are valid - otherwise dispatch the text as usual
+    uint16_t linelen;                   // length of the line text
+    int16_t checksum;                   // checksum computed as the line was received
+    char line[RX_BUFFER_SIZE];          // the line text, followed by the normalized block if tokenized
+    gcTokens_t tokens;
+} parseAheadLine_t;
+
+typedef struct parseAheadQueue {
+    uint8_t rd;                         // index of the next line to dispatch
+    uint8_t count;                      // lines in the queue
+    parseAheadLine_t lines[PARSE_AHEAD_DEPTH];
+} parseAheadQueue_t;
+
+static parseAheadQueue_t pa;
+
 /****************************************************************************************
  **** STATICS AND LOCALS ****************************************************************
  ****************************************************************************************/
@@ -74,9 +98,12 @@ static stat_t _test_system_assertions(void);
 
 static stat_t _sync_to_planner(void);
 static stat_t _sync_to_tx_buffer(void);
+static stat_t _dispatch_realtime(void);
 static stat_t _dispatch_command(void);
 static stat_t _dispatch_control(void);
-static void _dispatch_kernel(const devflags_t flags);
+static void _dispatch_kernel(const devflags_t flags, gcTokens_t *tokens = nullptr);
+static stat_t _parse_ahead(void);
+static void _parse_ahead_flush(void);
 static stat_t _controller_state(void);          // manage controller state transitions
 
 static Motate::OutputPin<Motate::kOutputSAFE_PinNumber> safe_pin;
@@ -149,6 +176,7 @@ static void _controller_HSM()
 
     // Order is important, and line breaks indicate dependency groups
 
+    DISPATCH(_dispatch_realtime());             // act on realtime characters (!~%^d^x) before anything else
     DISPATCH(hardware_periodic());              // give the hardware a chance to do stuff
     DISPATCH(_led_indicator());                 // blink LEDs at the current rate
     DISPATCH(_shutdown_handler());              // invoke shutdown
@@ -157,6 +185,8 @@ static void _controller_HSM()
     DISPATCH(_limit_switch_handler());          // invoke limit switch
     DISPATCH(_controller_state());              // controller state management
     DISPATCH(_test_system_assertions());        // system integrity assertions
+    DISPATCH(nv_dump_callback());               // stream a settings dump, a chunk per pass
+    DISPATCH(nv_txn_callback());                // abort a configuration transaction left idle
     DISPATCH(_dispatch_control());              // read any control messages prior to executing cycles
 
 //----- planner hierarchy for gcode and cycles ---------------------------------------//
@@ -165,15 +195,17 @@ static void _controller_HSM()
     DISPATCH(sr_status_report_callback());      // conditionally send status report
     DISPATCH(qr_queue_report_callback());       // conditionally send queue report
 
-    // these 3 must be in this exact order:
+    // these 4 must be in this exact order:
     DISPATCH(mp_planner_callback());            // motion planner
     DISPATCH(cm_operation_runner_callback());   // operation action runner
     DISPATCH(cm_arc_callback(cm));              // arc generation runs as a cycle above lines
+    DISPATCH(cm_canned_cycle_callback(cm));     // canned cycle (G81-G89) holes, likewise
 
     DISPATCH(cm_homing_cycle_callback());       // homing cycle operation (G28.2)
     DISPATCH(cm_probing_cycle_callback());      // probing cycle operation (G38.2)
     DISPATCH(cm_jogging_cycle_callback());      // jog cycle operation
     DISPATCH(cm_deferred_write_callback());     // persist G10 changes when not in machining cycle
+    DISPATCH(persistence_callback());           // write settings held back during the machining cycle
 
     DISPATCH(cm_feedhold_command_blocker());    // blocks new Gcode from arriving while in feedhold
 #if MARLIN_COMPAT_ENABLED == true
@@ -182,6 +214,7 @@ static void _controller_HSM()
 
 //----- command readers and parsers --------------------------------------------------//
 
+    DISPATCH(_parse_ahead());                   // read and tokenize data lines while the planner is full
     DISPATCH(_sync_to_planner());               // ensure there is at least one free buffer in planning queue
     DISPATCH(_sync_to_tx_buffer());             // sync with TX buffer (pseudo-blocking)
     DISPATCH(_dispatch_command());              // MUST BE LAST - read and execute next command
@@ -189,39 +222,177 @@ static void _controller_HSM()
 
 /****************************************************************************************
  * command dispatchers
+ * _dispatch_realtime - entry point for realtime characters posted by xio
  * _dispatch_control - entry point for control-only dispatches
  * _dispatch_command - entry point for control and data dispatches
  * _dispatch_kernel - core dispatch routines
  *
  *  Reads next command line and dispatches to relevant parser or action
  *
- *  Note: The dispatchers must only read and process a single line from the
- *        RX queue before returning control to the main loop.
+ *  Note: _dispatch_control must only read and process a single line from the
+ *        RX queue before returning control to the main loop. _dispatch_command may
+ *        process a batch of lines - see _dispatch_batch_can_continue()
  */
 
+static stat_t _dispatch_realtime()
+{
+    char c = xio_get_realtime();
+    if (c == NUL) {
+        return (STAT_NOOP);
+    }
+    if ((c == CHAR_QUEUE_FLUSH) && !cm_has_hold()) {        // '%' is only a flush in a hold...
+        xio_reject_realtime();                              // ...otherwise it's data for the line scan
+        return (STAT_OK);
+    }
+    xio_accept_realtime();                                  // take it out of the RX buffer
+    if      (c == '!') { cm_request_feedhold(FEEDHOLD_TYPE_ACTIONS, FEEDHOLD_EXIT_CYCLE); }
+    else if (c == '~') { cm_request_cycle_start(); }
+    else if (c == '%') { cm_request_queue_flush(); xio_flush_to_realtime(); _parse_ahead_flush(); job_abort(); }
+    else if (c == EOT) { cm_request_job_kill(); xio_flush_to_realtime(); _parse_ahead_flush(); job_abort(); nv_txn_abort(); }
+    else if (c == CAN) { hw_hard_reset(); }                 // reset immediately
+    xio_release_realtime();
+    return (STAT_OK);
+}
+
 static stat_t _dispatch_control()
 {
-    if (cs.controller_state != CONTROLLER_PAUSED) {
+    if ((cs.controller_state != CONTROLLER_PAUSED) && !nv_dump_is_running()) {
         devflags_t flags = DEV_IS_CTRL;
         if ((cs.bufp = xio_readline(flags, cs.linelen)) != NULL) {
+            cs.line_checksum = xio_get_line_checksum();
             _dispatch_kernel(flags);
         }
     }
     return (STAT_OK);
 }
 
+/*
+ * _dispatch_batch_can_continue() - true if another line may be dispatched in this pass
+ *
+ *  Running a full controller pass per line is wasted work when the planner has plenty
+ *  of time queued and the host has sent a burst of short lines. So _dispatch_command()
+ *  keeps reading lines until the batch or time slice is used up, or until the last line
+ *  started something that needs the callbacks above it to run before the next line -
+ *  an arc, a homing/probing/jogging cycle, a feedhold, a settings dump, or Marlin
+ *  temperature waits.
+ *  When the planner is short of time the batch is a single line, as before.
+ */
+
+static bool _dispatch_batch_can_continue()
+{
+    return ((cs.controller_state != CONTROLLER_PAUSED) &&
+            (xio_get_realtime() == NUL) &&
+            (!nv_dump_is_running()) &&
+            (!mp_planner_is_full(mp)) &&
+            (cm->arc.run_state == BLOCK_INACTIVE) &&
+            (cm->canned.run_state == BLOCK_INACTIVE) &&
+            (cm1.hold_state == FEEDHOLD_OFF) &&
+            ((cm->cycle_type == CYCLE_NONE) || (cm->cycle_type == CYCLE_MACHINING)) &&
+            (js.json_mode != MARLIN_COMM_MODE));
+}
+
 static stat_t _dispatch_command()
 {
-    if (cs.controller_state != CONTROLLER_PAUSED) {
-        devflags_t flags = DEV_IS_BOTH | DEV_IS_MUTED; // expressly state we'll handle muted devices
-        if ((!mp_planner_is_full(mp)) && (cs.bufp = xio_readline(flags, cs.linelen)) != NULL) {
-            _dispatch_kernel(flags);
+    if ((cs.controller_state != CONTROLLER_PAUSED) && !nv_dump_is_running()) {
+        uint8_t batch = mp_is_phat_city_time() ? DISPATCH_BATCH_LINES : 1;
+        uint32_t slice_end = SysTickTimer_getValue() + DISPATCH_BATCH_MS;
+        while (!mp_planner_is_full(mp)) {
+            if (pa.count != 0) {                        // lines that were read ahead go first
+                parseAheadLine_t *line = &pa.lines[pa.rd];
+                pa.rd = (pa.rd + 1) % PARSE_AHEAD_DEPTH;
+                pa.count--;
+                cs.bufp = line->line;
+                cs.linelen = line->linelen;
+                cs.line_checksum = line->checksum;
+                _dispatch_kernel(line->flags, line->tokenized ? &line->tokens : nullptr);
+            } else if (job_is_running()) {              // a pre-parsed job replaces data lines
+                if (job_dispatch() == STAT_EAGAIN) {
+                    break;                              // waiting on the job's source
+                }
+            } else {
+                devflags_t flags = DEV_IS_BOTH | DEV_IS_MUTED; // expressly state we'll handle muted devices
+                if ((cs.bufp = xio_readline(flags, cs.linelen)) == NULL) {
+                    break;
+                }
+                cs.line_checksum = xio_get_line_checksum();
+                _dispatch_kernel(flags);
+            }
+            if ((--batch == 0) || ((int32_t)(SysTickTimer_getValue() - slice_end) >= 0) || !_dispatch_batch_can_continue()) {
+                break;
+            }
         }
     }
     return (STAT_OK);
 }
 
-static void _dispatch_kernel(const devflags_t flags)
+/*
+ * _parse_ahead() - read and tokenize data lines while waiting for room in the planner
+ * _parse_ahead_flush() - discard lines that were read ahead (queue flush, job kill, disconnect)
+ *
+ *  When the planner is full the main loop would otherwise idle until a buffer frees up.
+ *  Instead the next few data lines are read and run through gcode_tokenize() (checksum,
+ *  normalization, word extraction) so that only the machine-state dependent part of the
+ *  parse is left to do when they are dispatched. Parsing then overlaps with planning and
+ *  execution rather than adding to the time between blocks.
+ *
+ *  Lines are dispatched strictly in the order read. Controls (JSON and single character
+ *  commands) are never queued - they are dispatched immediately as _dispatch_control()
+ *  would have done, so the control channel stays low latency. Text mode commands and
+ *  lines that can't be tokenized are queued as text. Nothing is read ahead in Marlin mode,
+ *  as its line protocol and temperature waits depend on strict request-response pacing,
+ *  or while a pre-parsed job is running, as data lines wait for the job to finish.
+ */
+
+static stat_t _parse_ahead()
+{
+    if ((cs.controller_state == CONTROLLER_PAUSED) || (pa.count == PARSE_AHEAD_DEPTH) || nv_dump_is_running() ||
+        (!mp_planner_is_full(mp)) || (js.json_mode == MARLIN_COMM_MODE) || job_is_running()) {
+        return (STAT_NOOP);
+    }
+    devflags_t flags = DEV_IS_BOTH | DEV_IS_MUTED;
+    char *bufp;
+    uint16_t linelen;
+    if ((bufp = xio_readline(flags, linelen)) == NULL) {
+        return (STAT_NOOP);
+    }
+    while ((*bufp == SPC) || (*bufp == TAB)) {          // position past any leading whitespace
+        bufp++;
+    }
+    if ((*bufp == '{') || (*bufp == ENQ) || xio_is_control_char(*bufp) || (flags & DEV_IS_MUTED)) {
+        cs.bufp = bufp;
+        cs.linelen = linelen;
+        cs.line_checksum = xio_get_line_checksum();
+        _dispatch_kernel(flags);
+        return (STAT_OK);
+    }
+
+    parseAheadLine_t *line = &pa.lines[(pa.rd + pa.count) % PARSE_AHEAD_DEPTH];
+    pa.count++;
+    line->flags = flags;
+    line->linelen = linelen;
+    line->checksum = xio_get_line_checksum();
+    strncpy(line->line, bufp, RX_BUFFER_SIZE-1);
+    line->line[RX_BUFFER_SIZE-1] = NUL;
+    line->tokenized = false;
+
+    // Tokenize a copy placed after the text, which is kept for responses. Normalization
+    // can lengthen a block a little (MSG comments), so only short lines get this treatment.
+    uint16_t len = strlen(line->line);
+    if ((len != 0) && (len < (RX_BUFFER_SIZE / 3)) && (strchr("$?Hh", *line->line) == NULL)) {
+        char *block = line->line + len + 1;
+        strcpy(block, line->line);
+        line->tokenized = gcode_tokenize(block, &line->tokens, line->checksum);
+    }
+    return (STAT_OK);
+}
+
+static void _parse_ahead_flush()
+{
+    pa.rd = 0;
+    pa.count = 0;
+}
+
+static void _dispatch_kernel(const devflags_t flags, gcTokens_t *tokens)
 {
     stat_t status;
 
@@ -260,8 +431,8 @@ static void _dispatch_kernel(const devflags_t flags)
     // trap single character commands
     if      (*cs.bufp == '!') { cm_request_feedhold(FEEDHOLD_TYPE_ACTIONS, FEEDHOLD_EXIT_CYCLE); }
     else if (*cs.bufp == '~') { cm_request_cycle_start(); }
-    else if (*cs.bufp == '%') { cm_request_queue_flush(); xio_flush_to_command(); }
-    else if (*cs.bufp == EOT) { cm_request_job_kill(); xio_flush_to_command(); }
+    else if (*cs.bufp == '%') { cm_request_queue_flush(); xio_flush_to_command(); _parse_ahead_flush(); job_abort(); }
+    else if (*cs.bufp == EOT) { cm_request_job_kill(); xio_flush_to_command(); _parse_ahead_flush(); job_abort(); nv_txn_abort(); }
     else if (*cs.bufp == ENQ) { controller_request_enquiry(); }
     else if (*cs.bufp == CAN) { hw_hard_reset(); }          // reset immediately
 
@@ -272,6 +443,18 @@ static void _dispatch_kernel(const devflags_t flags)
         cs.comm_request_mode = JSON_MODE;                   // mode of this command
         json_parser(cs.bufp);
     }
+    else if ((txn.state == TXN_OPEN) && (*cs.bufp != NUL) && (strchr("$?Hh", *cs.bufp) == NULL)) {
+        // Gcode is refused while a configuration transaction is open (see set_txn())
+        if (js.json_mode == TEXT_MODE) {
+            text_response(STAT_COMMAND_NOT_ACCEPTED, cs.saved_buf);
+        } else {
+            nvObj_t *nv = nv_reset_nv_list();               // echo the block as the Gcode path below does
+            strcpy(nv->token, "gc");
+            nv_copy_string(nv, cs.bufp);
+            nv->valuetype = TYPE_STRING;
+            nv_print_list(STAT_COMMAND_NOT_ACCEPTED, TEXT_NO_PRINT, JSON_RESPONSE_FORMAT);
+        }
+    }
 #ifdef __TEXT_MODE
     else if (strchr("$?Hh", *cs.bufp) != NULL) {            // process as text mode
         if (cs.comm_mode == AUTO_MODE) { js.json_mode = TEXT_MODE; } // switch to text mode
@@ -283,14 +466,14 @@ static void _dispatch_kernel(const devflags_t flags)
     }
     else if (js.json_mode == TEXT_MODE) {                   // anything else is interpreted as Gcode
         cs.comm_request_mode = TEXT_MODE;                   // mode of this command
-        text_response(gcode_parser(cs.bufp), cs.saved_buf);
+        text_response(tokens ? gcode_parser_tokens(tokens) : gcode_parser(cs.bufp, cs.line_checksum), cs.saved_buf);
     }
 #endif
 
 #if MARLIN_COMPAT_ENABLED == true
     else if (js.json_mode == MARLIN_COMM_MODE) {            // handle marlin-specific protocol gcode
         cs.comm_request_mode = MARLIN_COMM_MODE;            // mode of this command
-        marlin_response(gcode_parser(cs.bufp), cs.saved_buf);
+        marlin_response(tokens ? gcode_parser_tokens(tokens) : gcode_parser(cs.bufp, cs.line_checksum), cs.saved_buf);
     }
 #endif
     else {  // anything else is interpreted as Gcode
@@ -301,7 +484,7 @@ static void _dispatch_kernel(const devflags_t flags)
         strcpy(nv->token, "gc");                            // label is as a Gcode block (do not get an index - not necessary)
         nv_copy_string(nv, cs.bufp);                        // copy the Gcode line
         nv->valuetype = TYPE_STRING;
-        status = gcode_parser(cs.bufp);
+        status = tokens ? gcode_parser_tokens(tokens) : gcode_parser(cs.bufp, cs.line_checksum);
         
 #if MARLIN_COMPAT_ENABLED == true
         if (js.json_mode == MARLIN_COMM_MODE) {             // in case a marlin-specific M-code was found
@@ -378,6 +561,8 @@ void controller_set_connected(bool is_connected) {
     if (is_connected) {
         cs.controller_state = CONTROLLER_CONNECTED; // we JUST connected
     } else {  // we just disconnected from the last device, we'll expect a banner again
+        _parse_ahead_flush();
+        nv_txn_abort();                             // nobody is left to commit it
         _reset_comms_mode();
         cs.controller_state = CONTROLLER_NOT_CONNECTED;
     }
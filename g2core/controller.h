@@ -34,6 +34,10 @@
 #define SAVED_BUFFER_LEN RX_BUFFER_SIZE // saved buffer size (for reporting only)
 #define OUTPUT_BUFFER_LEN 512           // text buffer size
 
+#define DISPATCH_BATCH_LINES 8          // max command lines dispatched per controller pass when planner time is plentiful
+#define DISPATCH_BATCH_MS 2             // max time spent dispatching a batch (in ms)
+#define PARSE_AHEAD_DEPTH 4             // data lines that may be read and tokenized ahead of dispatch
+
 #define LED_NORMAL_BLINK_RATE 3000      // blink rate for normal operation (in ms)
 #define LED_ALARM_BLINK_RATE 750        // blink rate for alarm state (in ms)
 #define LED_SHUTDOWN_BLINK_RATE 300     // blink rate for shutdown state (in ms)
@@ -72,6 +76,7 @@ typedef struct controllerSingleton {    // main TG controller struct
     // controller serial buffers
     char *bufp;                         // pointer to primary or secondary in buffer
     uint16_t linelen;                   // length of currently processing line
+    int16_t line_checksum;              // checksum computed as the line was received - see xio_get_line_checksum()
     char out_buf[OUTPUT_BUFFER_LEN];    // output buffer
     char saved_buf[SAVED_BUFFER_LEN];   // save the input buffer
 
@@ -0,0 +1,359 @@
+/*
+ * cycle_drilling.cpp - canned drilling cycles (G81-G89) extension to canonical_machine.cpp
+ * This file is part of the g2core project
+ *
+ * This file ("the software") is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 as published by the
+ * Free Software Foundation. You should have received a copy of the GNU General Public
+ * License, version 2 along with the software.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, you may use this file as part of a software library without
+ * restriction. Specifically, if other files instantiate templates or use macros or
+ * inline functions from this file, or you compile this file and link it with  other
+ * files to produce an executable, this file does not by itself cause the resulting
+ * executable to be covered by the GNU General Public License. This exception does not
+ * however invalidate any other reasons why the executable file might be covered by the
+ * GNU General Public License.
+ *
+ * THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ * WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ * SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "g2core.h"
+#include "config.h"
+#include "canonical_machine.h"
+#include "planner.h"
+#include "util.h"
+
+#define CANNED_PECK_CLEARANCE ((float)0.254)    // G83 comes back down to this far above the last peck (0.010")
+
+typedef enum {                  // moves that make up a hole, in the order they are queued
+    CANNED_TO_HOLE = 0,         // traverse XY to the hole (first raising Z to the R plane if it's below it)
+    CANNED_TO_R_PLANE,          // traverse Z down to the R plane
+    CANNED_FEED_IN,             // feed Z to the bottom - or to the next peck depth for G83
+    CANNED_PECK_OUT,            // G83: traverse Z up to the R plane to clear chips
+    CANNED_PECK_IN,             // G83: traverse Z back down to just above the last peck depth
+    CANNED_DWELL,               // G82, G89: dwell at the bottom
+    CANNED_FEED_OUT,            // G85, G89: feed Z back up to the R plane
+    CANNED_RETRACT              // traverse Z to the clearance level, then on to the next hole
+} cmCannedStep;
+
+static bool _is_canned_cycle(const cmMotionMode motion_mode);
+static stat_t _canned_move(cmMachine_t *_cm, const float z, const cmMotionMode motion_mode);
+static stat_t _test_canned_soft_limits(const float hole[], const float top);
+
+/*****************************************************************************
+ * Canned drilling cycles
+ *
+ *  A drilling pattern is a G81-G89 block followed by blocks that are just the next hole's
+ *  X and Y. Each block is expanded here into the moves of its hole(s), which are queued to
+ *  the planner from the main loop the same way arc segments are, so a pattern costs one
+ *  short line per hole over the wire instead of four or more.
+ *
+ *  For each hole:
+ *    - traverse to XY at the clearance level (raising Z to the R plane first if below it)
+ *    - traverse down to the R plane
+ *    - feed to the Z depth. G83 pecks down Q at a time, traversing up to the R plane and
+ *      back down to just above the last depth between pecks
+ *    - dwell P seconds (G82, G89)
+ *    - feed back up to the R plane (G85, G89), otherwise traverse
+ *    - traverse up to the Z the series was entered at (G98) or stay at the R plane (G99)
+ *
+ *  R, Z, P and Q are sticky for as long as the motion mode stays in G81-G89. In G91 R is
+ *  measured from the Z at the start of the block, Z from the R plane, and the L word
+ *  repeats the hole L times stepping by the X and Y increments. Only the XY plane (G17) is
+ *  supported. G84, G86, G87 and G88 need the spindle stopped, reversed or oriented in step
+ *  with the moves and are not supported.
+ *
+ * cm_canned_cycle_init()     - initialize canned cycle structures
+ * cm_canned_cycle()          - canonical machine entry point for G81-G89
+ * cm_canned_cycle_callback() - main-loop callback that queues the moves
+ * cm_abort_canned_cycle()    - stop a canned cycle in process
+ */
+
+/*
+ * cm_canned_cycle_init() - initialize canned cycle structures
+ */
+void cm_canned_cycle_init(cmMachine_t *_cm)
+{
+    _cm->canned.magic_start = MAGICNUM;
+    _cm->canned.magic_end = MAGICNUM;
+}
+
+/*
+ * cm_abort_canned_cycle() - stop hole generation without maintaining position
+ *
+ *  OK to call if no canned cycle is running
+ */
+void cm_abort_canned_cycle(cmMachine_t *_cm)
+{
+    _cm->canned.run_state = BLOCK_INACTIVE;
+}
+
+/*
+ * cm_canned_cycle() - G81, G82, G83, G85, G89
+ *
+ *  Checks the block and sets up its holes. The model position is advanced to the end of
+ *  the last hole right away; cm_canned_cycle_callback() does the queuing.
+ */
+stat_t cm_canned_cycle(const float target[], const bool target_f[],
+                       const float R_word, const bool R_word_f,
+                       const float P_word, const bool P_word_f,
+                       const float Q_word, const bool Q_word_f,
+                       const uint8_t L_word, const bool L_word_f,
+                       const cmMotionMode motion_mode)
+{
+    cmCanned_t *c = &cm->canned;
+
+    if ((motion_mode == MOTION_MODE_CANNED_CYCLE_84) || (motion_mode == MOTION_MODE_CANNED_CYCLE_86) ||
+        (motion_mode == MOTION_MODE_CANNED_CYCLE_87) || (motion_mode == MOTION_MODE_CANNED_CYCLE_88)) {
+        return (STAT_GCODE_COMMAND_UNSUPPORTED);
+    }
+
+    // Entering a series of canned cycles: forget the last series' words and note the G98 level
+    if (!_is_canned_cycle(cm->gm.motion_mode)) {
+        c->R_word_f = false;
+        c->Z_word_f = false;
+        c->P_word_f = false;
+        c->Q_word_f = false;
+        c->initial_z = cm->gmx.position[AXIS_Z];
+    }
+    cm->gm.motion_mode = motion_mode;
+
+    if (R_word_f)         { c->R_word = R_word;          c->R_word_f = true; }
+    if (target_f[AXIS_Z]) { c->Z_word = target[AXIS_Z]; c->Z_word_f = true; }
+    if (P_word_f)         { c->P_word = P_word;          c->P_word_f = true; }
+    if (Q_word_f)         { c->Q_word = Q_word;          c->Q_word_f = true; }
+
+    // As with G1, a block that only carries F, S or other non-motion words drills nothing
+    if (!(target_f[AXIS_X] | target_f[AXIS_Y] | target_f[AXIS_Z] | R_word_f)) {
+        return (STAT_OK);
+    }
+
+    // trap specification errors
+    if (cm->gm.select_plane != CANON_PLANE_XY) {
+        return (STAT_ACTIVE_PLANE_IS_INVALID);
+    }
+    if (cm->gm.feed_rate_mode == INVERSE_TIME_MODE) {
+        return (STAT_INVERSE_TIME_MODE_CANNOT_BE_USED);
+    }
+    if (fp_ZERO(cm->gm.feed_rate)) {
+        return (STAT_FEEDRATE_NOT_SPECIFIED);
+    }
+    if (!c->R_word_f) {
+        return (STAT_R_WORD_IS_MISSING);
+    }
+    if (!c->Z_word_f) {
+        return (STAT_AXIS_IS_MISSING);
+    }
+    if (L_word_f && (L_word == 0)) {
+        return (STAT_L_WORD_IS_INVALID);
+    }
+    c->peck = 0;
+    if (motion_mode == MOTION_MODE_CANNED_CYCLE_83) {
+        if (!c->Q_word_f) {
+            return (STAT_Q_WORD_IS_MISSING);
+        }
+        if (c->Q_word <= 0) {
+            return (STAT_Q_WORD_IS_INVALID);
+        }
+        c->peck = _to_millimeters(c->Q_word);
+    }
+    c->dwell = 0;
+    if ((motion_mode == MOTION_MODE_CANNED_CYCLE_82) || (motion_mode == MOTION_MODE_CANNED_CYCLE_89)) {
+        if (c->P_word_f) {
+            if (c->P_word < 0) {
+                return (STAT_P_WORD_IS_NEGATIVE);
+            }
+            c->dwell = c->P_word;
+        }
+    }
+    c->feed_out = ((motion_mode == MOTION_MODE_CANNED_CYCLE_85) || (motion_mode == MOTION_MODE_CANNED_CYCLE_89));
+
+    // R plane and bottom of the hole
+    float z = cm->gmx.position[AXIS_Z];
+    if (cm->gm.distance_mode == ABSOLUTE_DISTANCE_MODE) {
+        c->r_plane = cm->combined_offset[AXIS_Z] + _to_millimeters(c->R_word);
+        c->bottom = cm->combined_offset[AXIS_Z] + _to_millimeters(c->Z_word);
+    } else {
+        c->r_plane = z + _to_millimeters(c->R_word);
+        c->bottom = c->r_plane + _to_millimeters(c->Z_word);
+    }
+    if (c->bottom > c->r_plane) {               // the R plane must be at or above the bottom
+        return (STAT_R_WORD_IS_INVALID);
+    }
+    if (cm->gmx.retract_mode == RETRACT_TO_INITIAL_LEVEL) {
+        c->clear_z = max(c->initial_z, c->r_plane);
+    } else {
+        c->clear_z = c->r_plane;
+    }
+
+    // first hole, and the step to each repeat
+    bool hole_f[AXES] = { false };
+    hole_f[AXIS_X] = target_f[AXIS_X];
+    hole_f[AXIS_Y] = target_f[AXIS_Y];
+    cm_set_model_target(target, hole_f);
+    for (uint8_t i=0; i<2; i++) {
+        c->hole[i] = cm->gm.target[AXIS_X+i];
+        if (cm->gm.distance_mode == INCREMENTAL_DISTANCE_MODE) {
+            c->hole_step[i] = cm->gm.target[AXIS_X+i] - cm->gmx.position[AXIS_X+i];
+        } else {
+            c->hole_step[i] = 0;
+        }
+    }
+    c->repeats = L_word_f ? L_word : 1;
+
+    // Soft limits are boxes, so the first and last holes bound everything in between
+    float last[2];
+    last[0] = c->hole[0] + c->hole_step[0] * (c->repeats - 1);
+    last[1] = c->hole[1] + c->hole_step[1] * (c->repeats - 1);
+    float top = max(z, c->clear_z);
+    ritorno(_test_canned_soft_limits(c->hole, top));
+    ritorno(_test_canned_soft_limits(last, top));
+
+    // set up the generator and move the model to the end of the last hole
+    cm_set_display_offsets(&cm->gm);                        // capture the fully resolved offsets to gm
+    memcpy(&(c->gm), &cm->gm, sizeof(GCodeState_t));        // copy Gcode context - target and motion mode set per move
+    copy_vector(c->gm.target, cm->gmx.position);            // moves start from the model position
+    c->step = CANNED_TO_HOLE;
+    c->run_state = BLOCK_ACTIVE;
+
+    cm->gm.target[AXIS_X] = last[0];
+    cm->gm.target[AXIS_Y] = last[1];
+    cm->gm.target[AXIS_Z] = c->clear_z;
+    cm_cycle_start();                                       // if not already started
+    cm_update_model_position();
+    return (STAT_OK);
+}
+
+/*
+ * cm_canned_cycle_callback() - queue the moves of the holes
+ *
+ *  Called from the controller main loop. Queues one move or dwell per call while there is
+ *  room in the planner, and blocks further input (STAT_EAGAIN) until the block's last hole
+ *  has been queued. Deep G83 holes are many moves, so like arcs they are spooled out
+ *  rather than queued all at once.
+ */
+stat_t cm_canned_cycle_callback(cmMachine_t *_cm)
+{
+    cmCanned_t *c = &_cm->canned;
+
+    if (c->run_state == BLOCK_INACTIVE) {
+        return (STAT_NOOP);
+    }
+    if (mp_planner_is_full(mp)) {
+        return (STAT_EAGAIN);
+    }
+    float z = c->gm.target[AXIS_Z];
+
+    switch (c->step) {
+        case CANNED_TO_HOLE: {
+            if (z < c->r_plane) {               // only possible before the first hole
+                _canned_move(_cm, c->r_plane, MOTION_MODE_STRAIGHT_TRAVERSE);
+                break;
+            }
+            c->gm.target[AXIS_X] = c->hole[0];
+            c->gm.target[AXIS_Y] = c->hole[1];
+            _canned_move(_cm, z, MOTION_MODE_STRAIGHT_TRAVERSE);
+            c->step = CANNED_TO_R_PLANE;
+            break;
+        }
+        case CANNED_TO_R_PLANE: {
+            _canned_move(_cm, c->r_plane, MOTION_MODE_STRAIGHT_TRAVERSE);
+            c->depth = c->r_plane;
+            c->step = CANNED_FEED_IN;
+            break;
+        }
+        case CANNED_FEED_IN: {
+            c->depth = (c->peck > 0) ? max(c->bottom, c->depth - c->peck) : c->bottom;
+            _canned_move(_cm, c->depth, MOTION_MODE_STRAIGHT_FEED);
+            if (c->depth > c->bottom) {
+                c->step = CANNED_PECK_OUT;
+            } else if (c->dwell > 0) {
+                c->step = CANNED_DWELL;
+            } else if (c->feed_out) {
+                c->step = CANNED_FEED_OUT;
+            } else {
+                c->step = CANNED_RETRACT;
+            }
+            break;
+        }
+        case CANNED_PECK_OUT: {
+            _canned_move(_cm, c->r_plane, MOTION_MODE_STRAIGHT_TRAVERSE);
+            c->step = CANNED_PECK_IN;
+            break;
+        }
+        case CANNED_PECK_IN: {
+            _canned_move(_cm, min(c->depth + CANNED_PECK_CLEARANCE, c->r_plane), MOTION_MODE_STRAIGHT_TRAVERSE);
+            c->step = CANNED_FEED_IN;
+            break;
+        }
+        case CANNED_DWELL: {
+            mp_dwell(c->dwell);
+            c->step = c->feed_out ? CANNED_FEED_OUT : CANNED_RETRACT;
+            break;
+        }
+        case CANNED_FEED_OUT: {
+            _canned_move(_cm, c->r_plane, MOTION_MODE_STRAIGHT_FEED);
+            c->step = CANNED_RETRACT;
+            break;
+        }
+        case CANNED_RETRACT: {
+            stat_t status = _canned_move(_cm, max(z, c->clear_z), MOTION_MODE_STRAIGHT_TRAVERSE);
+            if (--(c->repeats) == 0) {
+                c->run_state = BLOCK_INACTIVE;
+                if ((status == STAT_MINIMUM_LENGTH_MOVE) && (!mp_has_runnable_buffer(mp))) {
+                    cm_cycle_end();             // same as cm_straight_feed() - or the cycle won't end
+                }
+                return (STAT_OK);
+            }
+            c->hole[0] += c->hole_step[0];
+            c->hole[1] += c->hole_step[1];
+            c->step = CANNED_TO_HOLE;
+            break;
+        }
+    }
+    return (STAT_EAGAIN);
+}
+
+/*
+ * _is_canned_cycle() - true for G81-G89
+ */
+static bool _is_canned_cycle(const cmMotionMode motion_mode)
+{
+    return ((motion_mode >= MOTION_MODE_CANNED_CYCLE_81) && (motion_mode <= MOTION_MODE_CANNED_CYCLE_89));
+}
+
+/*
+ * _canned_move() - queue a traverse or feed of Z (and of XY if the hole target changed)
+ *
+ *  Zero length moves are dropped by the planner (STAT_MINIMUM_LENGTH_MOVE), e.g. the retract
+ *  in G99 after G85 has fed back out to the R plane.
+ */
+static stat_t _canned_move(cmMachine_t *_cm, const float z, const cmMotionMode motion_mode)
+{
+    _cm->canned.gm.target[AXIS_Z] = z;
+    _cm->canned.gm.motion_mode = motion_mode;
+    cm_cycle_start();                           // in case the queue ran dry during a dwell
+    return (mp_aline(&(_cm->canned.gm)));
+}
+
+/*
+ * _test_canned_soft_limits() - test a hole from the bottom up to the top of its moves
+ */
+static stat_t _test_canned_soft_limits(const float hole[], const float top)
+{
+    float target[AXES];
+
+    copy_vector(target, cm->gmx.position);
+    target[AXIS_X] = hole[0];
+    target[AXIS_Y] = hole[1];
+    target[AXIS_Z] = cm->canned.bottom;
+    ritorno(cm_test_soft_limits(target));
+    target[AXIS_Z] = top;
+    return (cm_test_soft_limits(target));
+}
@@ -410,6 +410,7 @@ static void _start_queue_flush()
 static stat_t _run_queue_flush()            // typically runs from cm1 planner
 {
     cm_abort_arc(cm);                       // kill arcs so they don't just create more alines
+    cm_abort_canned_cycle(cm);              // ...and the same for canned cycle holes
     planner_reset((mpPlanner_t *)cm->mp);   // reset primary planner. also resets the mr under the planner
     cm_reset_position_to_absolute_position(cm);
     cm1.queue_flush_state = QUEUE_FLUSH_OFF;
@@ -454,10 +455,13 @@ static stat_t _run_job_kill()
         mp = (mpPlanner_t *)cm->mp;                     // cm->mp is a void pointer
         mr = mp->mr;
         
-        copy_vector(cm1.gmx.position, mr2.position);    // transfer actual position back to p1
-        copy_vector(cm1.gm.target, mr2.position);
+        float position[AXES];                           // transfer actual position back to p1
+        mp_get_runtime_model_position(&mr2, position);  // ...untransformed for the model
+        copy_vector(cm1.gmx.position, position);
+        copy_vector(cm1.gm.target, position);
         copy_vector(mp1.position, mr2.position);
         copy_vector(mr1.position, mr2.position);
+        mr1.inverse = mr2.inverse;
     }
 
     _run_queue_flush();
@@ -585,6 +589,7 @@ static void _enter_p2()
     cm2.queue_flush_state = QUEUE_FLUSH_OFF;
     cm2.gm.feed_rate = 0;
     cm2.arc.run_state = BLOCK_INACTIVE;     // Stop a running p1 arc from continuing to execute in p2
+    cm2.canned.run_state = BLOCK_INACTIVE;  // ...or a running p1 canned cycle
 
     // Set mp planner to p2 and reset it
     cm2.mp = &mp2;
@@ -595,9 +600,10 @@ static void _enter_p2()
     memset(&(cm2.gm.target), 0, sizeof(cm2.gm.target));
     memset(&(cm2.gm.target_comp), 0, sizeof(cm2.gm.target_comp)); // zero Kahan compensation
 
-    copy_vector(cm2.gmx.position, mr1.position);
+    mp_get_runtime_model_position(&mr1, cm2.gmx.position);    // the model is untransformed
     copy_vector(mp2.position, mr1.position);
     copy_vector(mr2.position, mr1.position);
+    mr2.inverse = mr1.inverse;
 
     // Copy MR position and encoder terms - needed for following error correction state
     copy_vector(mr2.target_steps, mr1.target_steps);
@@ -609,6 +615,7 @@ static void _enter_p2()
     cm = &cm2;
     mp = (mpPlanner_t *)cm2.mp;     // mp is a void pointer
     mr = mp2.mr;
+    cm_update_offsets();            // absolute override was cleared above
 }
 
 static void _exit_p2()
@@ -107,7 +107,7 @@ char *get_status_message(stat_t status);
 #define STAT_FAILED_GET_PLANNER_BUFFER 36
 
 #define STAT_ERROR_37 37
-#define STAT_ERROR_38 38
+#define STAT_JOB_FORMAT_ERROR 38
 #define STAT_ERROR_39 39
 
 #define STAT_ERROR_40 40
@@ -417,7 +417,7 @@ static const char stat_35[] = "Bad status report setting";
 static const char stat_36[] = "Failed to get planner buffer";
 
 static const char stat_37[] = "Backplan hit running buffer";
-static const char stat_38[] = "38";
+static const char stat_38[] = "Pre-parsed job format error";
 static const char stat_39[] = "39";
 
 static const char stat_40[] = "40";
@@ -0,0 +1,328 @@
+/*
+ * file_store.cpp - a Gcode file kept in on-chip flash and run through xio
+ * This file is part of the g2core project
+ *
+ * This file ("the software") is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 as published by the
+ * Free Software Foundation. You should have received a copy of the GNU General Public
+ * License, version 2 along with the software.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, you may use this file as part of a software library without
+ * restriction. Specifically, if other files instantiate templates or use macros or
+ * inline functions from this file, or you compile this file and link it with  other
+ * files to produce an executable, this file does not by itself cause the resulting
+ * executable to be covered by the GNU General Public License. This exception does not
+ * however invalidate any other reasons why the executable file might be covered by the
+ * GNU General Public License.
+ *
+ * THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ * WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ * SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "g2core.h"
+#include "config.h"
+#include "file_store.h"
+#include "persistence.h"
+#include "report.h"
+#include "canonical_machine.h"
+#include "xio.h"
+#include "job.h"
+#include "util.h"
+
+/***********************************************************************************
+ **** STRUCTURE ALLOCATIONS ********************************************************
+ ***********************************************************************************/
+
+fsSingleton_t fs;
+fsBlockSource fs_source;
+xio_block_file<FS_PAGE_SIZE> fs_gcode_file {fs_source};    // the stored file as seen by DEV_FLASH_FILE
+
+/***********************************************************************************
+ **** CODE *************************************************************************
+ ***********************************************************************************/
+
+/*
+ * file_store_init() - read the header of the stored file, if there is one
+ */
+
+void file_store_init()
+{
+    fsHeader_t h;
+
+    memset(&fs, 0, sizeof(fs));
+    if (fs_flash_init() != STAT_OK) {
+        return;                                         // no file store on this board
+    }
+    fs.enabled = true;
+    fs_flash_read(0, &h, sizeof(h));
+    if ((h.magic == FS_MAGIC) && (h.check == ~h.length) && (h.length <= FS_DATA_SIZE)) {
+        fs.length = h.length;
+    }
+}
+
+/*
+ * fsBlockSource::startRead() - reads are synchronous and stop at the end of the file
+ */
+
+bool fsBlockSource::startRead(char *buffer, uint32_t offset, uint16_t length)
+{
+    if (!fs.enabled || fs.writing) {
+        return (false);
+    }
+    if (offset > fs.length) {
+        offset = fs.length;
+    }
+    _result = min((uint32_t)length, fs.length - offset);
+    fs_flash_read(FS_PAGE_SIZE + offset, buffer, _result);
+    return (true);
+}
+
+/*
+ * _fs_running() - the stored file is being sent as Gcode or run as a job
+ * _fs_busy()    - the file may not be changed while it is being run or while machining
+ */
+
+static bool _fs_running()
+{
+    return (xio_file_is_sending() || job_is_running());
+}
+
+static bool _fs_busy()
+{
+    return ((cm->cycle_type != CYCLE_NONE) || _fs_running());
+}
+
+static stat_t _write_page()
+{
+    stat_t status_code;
+    memset(&fs.page[fs.page_fill], 0xFF, FS_PAGE_SIZE - fs.page_fill);
+    ritorno(fs_flash_write_page(1 + (fs.length - fs.page_fill) / FS_PAGE_SIZE, fs.page));
+    fs.page_fill = 0;
+    return (STAT_OK);
+}
+
+static int8_t _hex_digit(const char c)
+{
+    if ((c >= '0') && (c <= '9')) { return (c - '0'); }
+    if ((c >= 'a') && (c <= 'f')) { return (c - 'a' + 10); }
+    if ((c >= 'A') && (c <= 'F')) { return (c - 'A' + 10); }
+    return (-1);
+}
+
+/*
+ * fs_set_fsn() - start a new file. The old header is erased first, so the old file is gone.
+ *                The file is only open for fsw once that erase has succeeded.
+ * fs_set_fsw() - append hex encoded bytes to the file. Responds with the length so far.
+ * fs_set_fsc() - write the last partial page, then the header
+ * fs_get_fsl() - length of the stored file
+ * fs_set_fsr() - run the stored file as Gcode on the DEV_FLASH_FILE device
+ * fs_set_fsj() - run the stored file as a pre-parsed job
+ *
+ *  Data is hex encoded so any file survives the JSON parser and the line-oriented RX path.
+ *  A whole string is checked before any of it is taken, so a rejected fsw changes nothing.
+ */
+
+stat_t fs_set_fsn(nvObj_t *nv)
+{
+    stat_t status_code;
+
+    if (!fs.enabled) {
+        return (STAT_FILE_NOT_OPEN);
+    }
+    if (_fs_busy()) {
+        return (STAT_COMMAND_NOT_ACCEPTED);
+    }
+    fs.writing = false;                                 // not open until the old header is erased
+    fs.length = 0;                                      // the old file is gone, even if the erase fails
+    fs.page_fill = 0;
+    memset(fs.page, 0xFF, FS_PAGE_SIZE);
+    ritorno(fs_flash_write_page(0, fs.page));
+    fs.writing = true;
+    return (STAT_OK);
+}
+
+stat_t fs_set_fsw(nvObj_t *nv)
+{
+    stat_t status_code;
+
+    if (nv->valuetype != TYPE_STRING) {
+        return (STAT_UNSUPPORTED_TYPE);
+    }
+    if (!fs.writing) {
+        return (STAT_FILE_NOT_OPEN);
+    }
+    if (_fs_busy()) {
+        return (STAT_COMMAND_NOT_ACCEPTED);             // no flash programming while machining
+    }
+    const char *hex = *nv->stringp;
+    uint16_t hex_length = strlen(hex);
+    if (hex_length & 1) {
+        return (STAT_INPUT_VALUE_RANGE_ERROR);
+    }
+    for (uint16_t i=0; i < hex_length; i++) {
+        if (_hex_digit(hex[i]) < 0) {
+            return (STAT_INPUT_VALUE_RANGE_ERROR);
+        }
+    }
+    if (fs.length + hex_length/2 > FS_DATA_SIZE) {
+        return (STAT_FILE_SIZE_EXCEEDED);
+    }
+    for (uint16_t i=0; i < hex_length; i += 2) {
+        fs.page[fs.page_fill++] = (_hex_digit(hex[i]) << 4) | _hex_digit(hex[i+1]);
+        fs.length++;
+        if (fs.page_fill == FS_PAGE_SIZE) {
+            ritorno(_write_page());
+        }
+    }
+    nv->valuetype = TYPE_INTEGER;
+    nv->value_int = fs.length;
+    return (STAT_OK);
+}
+
+stat_t fs_set_fsc(nvObj_t *nv)
+{
+    stat_t status_code;
+
+    if (!fs.writing) {
+        return (STAT_FILE_NOT_OPEN);
+    }
+    if (fs.page_fill > 0) {
+        ritorno(_write_page());
+    }
+    fsHeader_t h;
+    h.magic = FS_MAGIC;
+    h.length = fs.length;
+    h.check = ~fs.length;
+    memset(fs.page, 0xFF, FS_PAGE_SIZE);                // the page buffer is free once flushed
+    memcpy(fs.page, &h, sizeof(h));
+    ritorno(fs_flash_write_page(0, fs.page));           // header goes last - see file_store.h
+    fs.writing = false;
+    return (STAT_OK);
+}
+
+stat_t fs_get_fsl(nvObj_t *nv)
+{
+    nv->value_int = fs.length;
+    nv->valuetype = TYPE_INTEGER;
+    return (STAT_OK);
+}
+
+stat_t fs_set_fsr(nvObj_t *nv)
+{
+    if (!fs.enabled || fs.writing || (fs.length == 0)) {
+        return (STAT_FILE_NOT_OPEN);
+    }
+    if (job_is_running() || !xio_send_file(fs_gcode_file)) {
+        return (STAT_COMMAND_NOT_ACCEPTED);             // a file or job is already running
+    }
+    return (STAT_OK);
+}
+
+stat_t fs_set_fsj(nvObj_t *nv)
+{
+    if (!fs.enabled || fs.writing || (fs.length == 0)) {
+        return (STAT_FILE_NOT_OPEN);
+    }
+    if (_fs_running() || !job_start(fs_source)) {
+        return (STAT_COMMAND_NOT_ACCEPTED);
+    }
+    return (STAT_OK);
+}
+
+/***********************************************************************************
+ **** FLASH PAGE DRIVERS ***********************************************************
+ ***********************************************************************************/
+/*
+ *  fs_flash_init()       - prepare the file store region. Returns an error if there is none.
+ *  fs_flash_read()       - read bytes at an offset into the region
+ *  fs_flash_write_page() - erase one page and write it in a single operation
+ */
+
+#if defined(__SAM3X8E__) || defined(__SAM3X8C__)
+
+/*
+ *  SAM3X: the file store sits directly below the NVM log at the top of flash bank 1, so it
+ *  is programmed without stalling the firmware running from bank 0. Erase-and-write-page
+ *  means pages never need a separate erase pass.
+ */
+
+#define FS_FLASH_BASE   (IFLASH1_ADDR + IFLASH1_SIZE - NVM_SIZE - FS_SIZE)
+#define FS_FLASH_PAGE0  ((FS_FLASH_BASE - IFLASH1_ADDR) / IFLASH1_PAGE_SIZE)
+#define EEFC_CMD_EWP    0x03            // erase page and write page
+
+stat_t fs_flash_init()
+{
+    if (!nvm_flash_image_below(FS_FLASH_BASE)) {   // see nvm_flash_image_below() in persistence.cpp
+        return (rpt_exception(STAT_PERSISTENCE_ERROR, "firmware image overlaps the file store - disabled"));
+    }
+    return (STAT_OK);
+}
+
+void fs_flash_read(uint32_t offset, void *dst, uint16_t length)
+{
+    memcpy(dst, (const void *)(FS_FLASH_BASE + offset), length);
+}
+
+stat_t fs_flash_write_page(uint16_t page, const void *src)
+{
+    uint32_t status;
+    const uint8_t *s = (const uint8_t *)src;
+    volatile uint32_t *latch = (volatile uint32_t *)(FS_FLASH_BASE + (uint32_t)page * FS_PAGE_SIZE);
+    for (uint16_t i=0; i < FS_PAGE_SIZE; i += 4) {
+        uint32_t word;
+        memcpy(&word, s + i, 4);
+        *latch++ = word;
+    }
+    EFC1->EEFC_FCR = EEFC_FCR_FKEY(0x5A) | EEFC_FCR_FARG(FS_FLASH_PAGE0 + page) | EEFC_FCR_FCMD(EEFC_CMD_EWP);
+    while (!((status = EFC1->EEFC_FSR) & EEFC_FSR_FRDY));
+    return ((status & (EEFC_FSR_FCMDE | EEFC_FSR_FLOCKE)) ? STAT_PERSISTENCE_ERROR : STAT_OK);
+}
+
+#elif defined(__FS_FILE)
+
+/*
+ *  File-backed emulator for host builds. Define __FS_FILE as the file name,
+ *  e.g. -D__FS_FILE=\"g2core_fs.bin\"
+ */
+
+#include <stdio.h>
+
+static FILE *fs_file;
+
+stat_t fs_flash_init()
+{
+    if ((fs_file = fopen(__FS_FILE, "r+b")) == NULL) {
+        if ((fs_file = fopen(__FS_FILE, "w+b")) == NULL) {
+            return (STAT_PERSISTENCE_ERROR);
+        }
+    }
+    return (STAT_OK);
+}
+
+void fs_flash_read(uint32_t offset, void *dst, uint16_t length)
+{
+    fseek(fs_file, offset, SEEK_SET);
+    uint16_t got = fread(dst, 1, length, fs_file);
+    memset((uint8_t *)dst + got, 0xFF, length - got);   // unwritten flash reads as erased
+}
+
+stat_t fs_flash_write_page(uint16_t page, const void *src)
+{
+    fseek(fs_file, (uint32_t)page * FS_PAGE_SIZE, SEEK_SET);
+    if (fwrite(src, 1, FS_PAGE_SIZE, fs_file) != FS_PAGE_SIZE) {
+        return (STAT_PERSISTENCE_ERROR);
+    }
+    fflush(fs_file);
+    return (STAT_OK);
+}
+
+#else // no file store driver for this board
+
+stat_t fs_flash_init() { return (STAT_PERSISTENCE_ERROR); }
+void fs_flash_read(uint32_t offset, void *dst, uint16_t length) { memset(dst, 0xFF, length); }
+stat_t fs_flash_write_page(uint16_t page, const void *src) { return (STAT_PERSISTENCE_ERROR); }
+
+#endif
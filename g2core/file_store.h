@@ -0,0 +1,96 @@
+/*
+ * file_store.h - a Gcode file kept in on-chip flash and run through xio
+ * This file is part of the g2core project
+ *
+ * This file ("the software") is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 as published by the
+ * Free Software Foundation. You should have received a copy of the GNU General Public
+ * License, version 2 along with the software.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, you may use this file as part of a software library without
+ * restriction. Specifically, if other files instantiate templates or use macros or
+ * inline functions from this file, or you compile this file and link it with  other
+ * files to produce an executable, this file does not by itself cause the resulting
+ * executable to be covered by the GNU General Public License. This exception does not
+ * however invalidate any other reasons why the executable file might be covered by the
+ * GNU General Public License.
+ *
+ * THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ * WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ * SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef FILE_STORE_H_ONCE
+#define FILE_STORE_H_ONCE
+
+#include "config.h"
+#include "xio.h"
+
+/**** Flash file store ****
+ *
+ *  One file, uploaded over JSON and kept in a flash region below the NVM log. Page 0 holds
+ *  a header with the file length; the data follows from page 1. The file is written a page
+ *  at a time from a RAM page buffer and the header is written last, so a file is only
+ *  visible once it has been closed. The stored file is read back through fs_source, which
+ *  feeds a xio_block_file on the DEV_FLASH_FILE device.
+ *
+ *    {"fsn":1}           start a new file (the old one is discarded)
+ *    {"fsw":"4731...."}  append bytes, hex encoded - returns the length so far
+ *    {"fsc":1}           close the file
+ *    {"fsl":n}           get the length of the stored file
+ *    {"fsr":1}           run the stored file as Gcode
+ *    {"fsj":1}           run the stored file as a pre-parsed job (see job.h)
+ */
+
+#define FS_PAGE_SIZE        256                 // flash page size in bytes
+#define FS_PAGES            512                 // 128 KB, header page included
+#define FS_SIZE             (FS_PAGE_SIZE * FS_PAGES)
+#define FS_DATA_SIZE        (FS_SIZE - FS_PAGE_SIZE)
+#define FS_MAGIC            0x53463247          // header magic number ("G2FS")
+
+typedef struct fsHeader {           // occupies the start of page 0
+    uint32_t magic;                 // FS_MAGIC
+    uint32_t length;                // file length in bytes
+    uint32_t check;                 // ~length - catches a torn header
+} fsHeader_t;
+
+typedef struct fsSingleton {
+    bool enabled;                   // false if the board has no file store driver
+    bool writing;                   // a file has been started and not yet closed
+    uint32_t length;                // bytes in the file (written so far, while writing)
+    uint16_t page_fill;             // bytes held in page[]
+    uint8_t page[FS_PAGE_SIZE];     // page being assembled while writing
+} fsSingleton_t;
+
+//**** xio source over the stored file ****
+
+struct fsBlockSource : xio_block_source {
+    int32_t _result = 0;
+
+    bool startRead(char *buffer, uint32_t offset, uint16_t length) override;
+    int32_t readResult() override { return _result; };
+};
+
+extern fsSingleton_t fs;
+extern fsBlockSource fs_source;
+
+//**** function prototypes ****
+
+void file_store_init(void);
+
+stat_t fs_set_fsn(nvObj_t *nv);
+stat_t fs_set_fsw(nvObj_t *nv);
+stat_t fs_set_fsc(nvObj_t *nv);
+stat_t fs_get_fsl(nvObj_t *nv);
+stat_t fs_set_fsr(nvObj_t *nv);
+stat_t fs_set_fsj(nvObj_t *nv);
+
+// flash page driver - see file_store.cpp
+stat_t fs_flash_init(void);
+void fs_flash_read(uint32_t offset, void *dst, uint16_t length);
+stat_t fs_flash_write_page(uint16_t page, const void *src);
+
+#endif  // End of include guard: FILE_STORE_H_ONCE
@@ -39,7 +39,9 @@ typedef enum {                          // G Modal Group 1
     MOTION_MODE_CANNED_CYCLE_86,        // G86 - boring, spindle stop, rapid out
     MOTION_MODE_CANNED_CYCLE_87,        // G87 - back boring
     MOTION_MODE_CANNED_CYCLE_88,        // G88 - boring, spindle stop, manual out
-    MOTION_MODE_CANNED_CYCLE_89         // G89 - boring, dwell, feed out
+    MOTION_MODE_CANNED_CYCLE_89,        // G89 - boring, dwell, feed out
+    MOTION_MODE_CUBIC_SPLINE,           // G5 - cubic spline feed
+    MOTION_MODE_QUADRATIC_SPLINE        // G5.1 - quadratic spline feed
 } cmMotionMode;
 
 typedef enum {              // canonical plane - translates to:
@@ -83,6 +85,11 @@ typedef enum {
     INCREMENTAL_DISTANCE_MODE   // G91 / G91.1
 } cmDistanceMode;
 
+typedef enum {                  // G Modal Group 10
+    RETRACT_TO_INITIAL_LEVEL = 0,   // G98 - canned cycles retract to the Z they were entered at
+    RETRACT_TO_R_PLANE              // G99 - canned cycles retract to the R plane
+} cmRetractMode;
+
 typedef enum {
     INVERSE_TIME_MODE = 0,   // G93
     UNITS_PER_MINUTE_MODE,   // G94
@@ -160,7 +167,7 @@ typedef enum {              // axis modes (ordered: see _cm_get_feed_time())
 
 typedef struct GCodeState {             // Gcode model state - used by model, planning and runtime
     int32_t linenum;                    // Gcode block line number
-    cmMotionMode motion_mode;           // Group1: G0, G1, G2, G3, G38.2, G80, G81, G82
+    cmMotionMode motion_mode;           // Group1: G0, G1, G2, G3, G5, G5.1, G38.2, G80, G81, G82
                                         //         G83, G84, G85, G86, G87, G88, G89
 
     float target[AXES];                 // XYZABC target where the move should go
@@ -212,6 +219,7 @@ typedef struct GCodeStateExtended {     // Gcode dynamic state extensions - used
     uint8_t next_action;                // handles G modal group 1 moves & non-modals
     uint8_t program_flow;               // used only by the gcode_parser
     int32_t last_line_number;           // used with line checksums
+    uint8_t retract_mode;               // G98, G99 - see cmRetractMode
 
     float position[AXES];               // XYZABC model position (Note: not used in gn or gf)
     float g92_offset[AXES];             // XYZABC G92 offsets (aka origin offsets) (Note: not used in gn or gf)
@@ -231,11 +239,36 @@ typedef struct GCodeStateExtended {     // Gcode dynamic state extensions - used
     uint16_t magic_end;
 } GCodeStateX_t;
 
+/*
+ * Tokenized Gcode blocks - see gcode_tokenize()
+ */
+#define GCODE_MAX_WORDS 20                  // max words in a block that can be tokenized ahead of parsing
+
+typedef struct GCodeWord {
+    char letter;                            // word letter, e.g. G or X
+    uint16_t rest;                          // offset into the block of the character after this word
+    float value;                            // word value
+    int32_t value_int;                      // integer value - needed for line numbers
+} gcWord_t;
+
+typedef struct GCodeTokens {                // a block that has been checked, normalized and split into words
+    stat_t status;                          // deferred result of checksum verification
+    bool checksum;                          // block had a valid checksum
+    uint8_t block_delete;                   // block delete flag from normalization
+    uint8_t word_count;                     // words in words[]
+    char *block;                            // the normalized block
+    char *active_comment;                   // active comment or NUL string
+    gcWord_t words[GCODE_MAX_WORDS];
+} gcTokens_t;
+
 /*
  * Global Scope Functions
  */
 void gcode_parser_init(void);
 stat_t gcode_parser(char* block);
+stat_t gcode_parser(char* block, int16_t checksum);
+bool gcode_tokenize(char* block, gcTokens_t* tokens, int16_t checksum);
+stat_t gcode_parser_tokens(gcTokens_t* tokens);
 stat_t gc_get_gc(nvObj_t* nv);
 stat_t gc_run_gc(nvObj_t* nv);
 
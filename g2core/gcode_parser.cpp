@@ -25,6 +25,7 @@
 #include "settings.h"
 #include "spindle.h"
 #include "coolant.h"
+#include "report.h"
 #include "util.h"
 #include "xio.h"                    // for char definitions
 
@@ -87,6 +88,10 @@ typedef enum {                                  // these are in order to optimiz
     NEXT_ACTION_RESET_G92_OFFSETS,              // G92.1
     NEXT_ACTION_SUSPEND_G92_OFFSETS,            // G92.2
     NEXT_ACTION_RESUME_G92_OFFSETS,             // G92.3
+    NEXT_ACTION_CANCEL_SCALING,                 // G50
+    NEXT_ACTION_SET_SCALING,                    // G51
+    NEXT_ACTION_SET_ROTATION,                   // G68
+    NEXT_ACTION_CANCEL_ROTATION,                // G69
     NEXT_ACTION_JSON_COMMAND_SYNC,              // M100
     NEXT_ACTION_JSON_COMMAND_ASYNC,             // M100.1
     NEXT_ACTION_JSON_WAIT,                      // M101
@@ -115,18 +120,19 @@ typedef enum {                                  // these are in order to optimiz
 typedef struct GCodeInputValue {    // Gcode inputs - meaning depends on context
 
     gpNextAction next_action;       // handles G modal group 1 moves & non-modals
-    cmMotionMode motion_mode;       // Group1: G0, G1, G2, G3, G38.2, G80, G81, G82, G83, G84, G85, G86, G87, G88, G89
+    cmMotionMode motion_mode;       // Group1: G0, G1, G2, G3, G5, G5.1, G38.2, G80, G81, G82, G83, G84, G85, G86, G87, G88, G89
     uint8_t program_flow;           // used only by the gcode_parser
     uint32_t linenum;               // gcode N word
 
     float target[AXES];             // XYZABC where the move should go
     float arc_offset[3];            // IJK - used by arc commands
-    float arc_radius;               // R word - radius value in arc radius mode
+    float arc_radius;               // R word - radius value in arc radius mode, R plane in canned cycles
     float F_word;                   // F word - feedrate as present in the F word (will be normalized later)
     float P_word;                   // P word - parameter used for dwell time in seconds, G10 commands
+    float Q_word;                   // Q word - used by G5 splines and G83 pecks
     float S_word;                   // S word - usually in RPM
     uint8_t H_word;                 // H word - used by G43s
-    uint8_t L_word;                 // L word - used by G10s
+    uint8_t L_word;                 // L word - used by G10s and canned cycle repeats
 
     uint8_t feed_rate_mode;         // See cmFeedRateMode for settings
     uint8_t select_plane;           // G17,G18,G19 - values to set plane to
@@ -135,6 +141,7 @@ typedef struct GCodeInputValue {    // Gcode inputs - meaning depends on context
     uint8_t path_control;           // G61... EXACT_PATH, EXACT_STOP, CONTINUOUS
     uint8_t distance_mode;          // G91   0=use absolute coords(G90), 1=incremental movement
     uint8_t arc_distance_mode;      // G90.1=use absolute IJK offsets, G91.1=incremental IJK offsets
+    uint8_t retract_mode;           // G98=retract to initial level, G99=retract to R plane
     uint8_t origin_offset_mode;     // G92...TRUE=in origin offset mode
     uint8_t absolute_override;      // G53 TRUE = move using machine coordinates - this block only (G53)
     
@@ -171,6 +178,7 @@ typedef struct GCodeFlags {         // Gcode input flags
 
     bool F_word;
     bool P_word;
+    bool Q_word;
     bool S_word;
     bool H_word;
     bool L_word;
@@ -182,6 +190,7 @@ typedef struct GCodeFlags {         // Gcode input flags
     bool path_control;
     bool distance_mode;
     bool arc_distance_mode;
+    bool retract_mode;
     bool origin_offset_mode;
     bool absolute_override;
 
@@ -217,12 +226,15 @@ GCodeValue_t gv;    // gcode input values
 GCodeFlag_t gf;     // gcode input flags
 
 // local helper functions and macros
-static void _normalize_gcode_block(char *str, char **active_comment, uint8_t *block_delete_flag);
+static bool _lex_gcode_block(char *str, gcTokens_t *tokens);
 static stat_t _get_next_gcode_word(char **pstr, char *letter, float *value, int32_t *value_int);
 static stat_t _point(float value);
-static stat_t _verify_checksum(char *str);
+static stat_t _verify_checksum(char *str, int16_t checksum, bool *has_checksum);
 static stat_t _validate_gcode_block(char *active_comment);
-static stat_t _parse_gcode_block(char *line, char *active_comment); // Parse the block into the GN/GF structs
+static void _init_gcode_block(bool checksum);
+static stat_t _parse_gcode_word(const char letter, const float value, const int32_t value_int, char *pstr);
+static stat_t _parse_gcode_block(char *line, char *active_comment, bool checksum); // Parse the block into the GN/GF structs
+static stat_t _parse_gcode_tokens(gcTokens_t *tokens);             // Parse a tokenized block into the GN/GF structs
 static stat_t _execute_gcode_block(char *active_comment);           // Execute the gcode block
 
 #define SET_MODAL(m,parm,val) ({gv.parm=val; gf.parm=true; gp.modals[m]=true; break;})
@@ -243,58 +255,124 @@ void gcode_parser_init()
  * gcode_parser() - parse a block (line) of gcode
  *
  *  Top level of gcode parser. Normalizes block and looks for special cases
+ *
+ *  'checksum' is the line checksum computed by xio as the line was received
+ *  (see xio_get_line_checksum()), so the parser need only compare it to the one
+ *  sent with the line. Use XIO_CHECKSUM_UNKNOWN (or the 1 arg form) for lines
+ *  that didn't come straight from xio_readline().
+ *
+ *  The words are captured as the block is normalized. Blocks whose words couldn't be
+ *  captured are parsed from the normalized text, which reports the error.
  */
 
+static gcTokens_t _block_tokens;            // words of the block being parsed by gcode_parser()
+
 stat_t gcode_parser(char *block)
 {
-    char *str = block;                      // gcode command or NUL string
-    char none = NUL;
-    char *active_comment = &none;           // gcode comment or NUL string
-    uint8_t block_delete_flag;
-
-    stat_t check_ret = _verify_checksum(str);
-    if (check_ret != STAT_OK) {
-        return check_ret;
-    }
+    return (gcode_parser(block, XIO_CHECKSUM_UNKNOWN));
+}
 
-    _normalize_gcode_block(str, &active_comment, &block_delete_flag);
+stat_t gcode_parser(char *block, int16_t checksum)
+{
+    gcTokens_t *tokens = &_block_tokens;
 
     // TODO, now MSG is put in the active comment, handle that.
 
-    if (str[0] == NUL) {                    // normalization returned null string
+    if (gcode_tokenize(block, tokens, checksum)) {
+        return (gcode_parser_tokens(tokens));
+    }
+    if (block[0] == NUL) {                  // normalization returned null string
         return (STAT_OK);                   // most likely a comment line
     }
 
     // Trap M30 and M2 as $clear conditions. This has no effect if not in ALARM or SHUTDOWN
-    cm_parse_clear(str);                    // parse Gcode and clear alarms if M30 or M2 is found
+    cm_parse_clear(block);                  // parse Gcode and clear alarms if M30 or M2 is found
     ritorno(cm_is_alarmed());               // return error status if in alarm, shutdown or panic
 
     // Block delete omits the line if a / char is present in the first space
     // For now this is unconditional and will always delete
-//  if ((block_delete_flag == true) && (cm_get_block_delete_switch() == true)) {
-    if (block_delete_flag == true) {
+//  if ((tokens->block_delete == true) && (cm_get_block_delete_switch() == true)) {
+    if (tokens->block_delete == true) {
+        return (STAT_NOOP);
+    }
+    return(_parse_gcode_block(block, tokens->active_comment, tokens->checksum));
+}
+
+/*
+ * gcode_tokenize() - check, normalize and split a block into words ahead of parsing
+ * gcode_parser_tokens() - parse a tokenized block
+ *
+ *  Together these do the same as gcode_parser(), but the first half depends only on the
+ *  text of the block and not on machine state, so it can be run ahead of time - e.g.
+ *  on lines waiting for room in the planner. The block is normalized in place.
+ *
+ *  Checksum failures are recorded in the tokens and returned when the block is parsed.
+ *  gcode_tokenize() returns false if the block can't be tokenized (too many words, or
+ *  a malformed word). The caller should then pass the original text to gcode_parser(),
+ *  which reports errors exactly as it always has.
+ */
+
+bool gcode_tokenize(char *block, gcTokens_t *tokens, int16_t checksum)
+{
+    tokens->word_count = 0;
+    tokens->block = block;
+    tokens->active_comment = block + strlen(block);     // NUL string
+    tokens->block_delete = false;
+
+    if ((tokens->status = _verify_checksum(block, checksum, &tokens->checksum)) != STAT_OK) {
+        return (true);
+    }
+    return (_lex_gcode_block(block, tokens));
+}
+
+stat_t gcode_parser_tokens(gcTokens_t *tokens)
+{
+    ritorno(tokens->status);                // checksum failure
+
+    if (tokens->block[0] == NUL) {          // normalization returned null string
+        return (STAT_OK);                   // most likely a comment line
+    }
+    cm_parse_clear(tokens->block);          // parse Gcode and clear alarms if M30 or M2 is found
+    ritorno(cm_is_alarmed());               // return error status if in alarm, shutdown or panic
+
+    if (tokens->block_delete == true) {
         return (STAT_NOOP);
     }
-    return(_parse_gcode_block(block, active_comment));
+    return(_parse_gcode_tokens(tokens));
 }
 
 /*
  * _verify_checksum() - ensure that, if there is a checksum, that it's valid
  *
+ *  If the checksum was computed when the line was received only the '*' needs to be
+ *  found, otherwise it's computed here. 'has_checksum' is set if a checksum was present.
+ *
  * Returns STAT_OK is it's valid.
  * Returns STAT_CHECKSUM_MATCH_FAILED if the checksum doesn't match.
  */
-static stat_t _verify_checksum(char *str)
+static stat_t _verify_checksum(char *str, int16_t checksum, bool *has_checksum)
 {
     bool has_line_number = false; // -1 means we don't have one
     if (*str == 'N') {
         has_line_number = true;
     }
+    *has_checksum = false;
 
-    char checksum = 0;
-    char c = *str++;
-    while (c && (c != '*') && (c != '\n') && (c != '\r')) {
-        checksum ^= c;
+    if (checksum == XIO_CHECKSUM_NONE) {
+        return STAT_OK;
+    }
+    char c;
+    if (checksum == XIO_CHECKSUM_UNKNOWN) {
+        checksum = 0;
+        c = *str++;
+        while (c && (c != '*') && (c != '\n') && (c != '\r')) {
+            checksum ^= (uint8_t)c;
+            c = *str++;
+        }
+    } else {
+        if ((str = strchr(str, '*')) == NULL) {
+            return STAT_OK;
+        }
         c = *str++;
     }
 
@@ -302,7 +380,7 @@ static stat_t _verify_checksum(char *str)
 
     if (c == '*') {
         *(str-1) = 0; // null terminate, the parser won't like this * here!
-        gf.checksum = true;
+        *has_checksum = true;
         if (strtol(str, NULL, 10) != checksum) {
             debug_trap("checksum failure");
             return STAT_CHECKSUM_MATCH_FAILED;
@@ -316,18 +394,26 @@ static stat_t _verify_checksum(char *str)
 }
 
 /****************************************************************************************
- * _normalize_gcode_block() - normalize a block (line) of gcode in place
+ * _lex_gcode_block() - normalize a block (line) of gcode in place and split it into words
+ * _lex_comment()     - skip a comment, or copy an active comment to the comment buffer
  *
- *  Baseline normalization functions:
+ *  One pass over the block does all of the following:
  *   - Isolate comments. See below.
  *   The rest of this applies just to the GCODE string itself (not the comments):
  *   - Remove white space, control and other invalid characters
  *   - Convert all letters to upper case
  *   - Remove (erroneous) leading zeros that might be taken to mean Octal
  *   - Signal if a block-delete character (/) was encountered in the first space
+ *   - Split the normalized block into words, reading each value with scan_number() as soon
+ *     as the next letter (or the end of the block) closes the word
  *   - NOTE: Assumes no leading whitespace as this was removed at the controller dispatch level
  *
- *  So this: "g1 x100 Y100 f400" becomes this: "G1X100Y100F400"
+ *  So this: "g1 x100 Y100 f400" becomes this: "G1X100Y100F400" and 4 words.
+ *
+ *  Characters are classified through _gc_class[] so each is looked at once, with no calls
+ *  to the ctype functions. The normalized block is written over the input - it can only
+ *  be shorter - so there is no scratch copy. Only active comments are collected in a
+ *  buffer, as they are moved to the end.
  *
  *  Comment, active comment and message handling:
  *   - Comment fields start with a '(' char or alternately a semicolon ';' or percent '%'
@@ -341,10 +427,10 @@ static stat_t _verify_checksum(char *str)
  *     - Only ONE MSG comment will be accepted
  *   - Other "plain" comments are discarded
  *
- *  Returns:
- *   - com points to comment string or to NUL if no comment
- *   - msg points to message string or to NUL if no comment
- *   - block_delete_flag is set true if block delete encountered, false otherwise
+ *  Fills in tokens->active_comment (or points it to a NUL string), tokens->block_delete and
+ *  the words. Returns false if the words could not all be captured - too many of them, or a
+ *  word that isn't a letter followed by exactly one number. The block is still normalized,
+ *  and the caller parses it as text with _get_next_gcode_word(), which reports the error.
  */
 /* Active comment notes:
  *
@@ -358,200 +444,203 @@ static stat_t _verify_checksum(char *str)
  *   NOTES: multiple active comments merged, stripped of (), and actual comments ignored.
  */
 
-char _normalize_scratch[RX_BUFFER_SIZE];
-
-void _normalize_gcode_block(char *str, char **active_comment, uint8_t *block_delete_flag)
+enum gcCharClass {                      // character classes for the lexer
+    GC_SKIP = 0,                        // white space, control and other invalid characters
+    GC_END,                             // end of block: NUL, or a ';' or '%' comment
+    GC_COMMENT,                         // '('
+    GC_LETTER,
+    GC_DIGIT,
+    GC_POINT,
+    GC_MINUS
+};
+
+#define __  GC_SKIP
+#define _E  GC_END
+#define _C  GC_COMMENT
+#define _L  GC_LETTER
+#define _D  GC_DIGIT
+#define _P  GC_POINT
+#define _M  GC_MINUS
+
+static const uint8_t _gc_class[256] = {
+    _E, __, __, __, __, __, __, __, __, __, __, __, __, __, __, __,   // 0x00
+    __, __, __, __, __, __, __, __, __, __, __, __, __, __, __, __,   // 0x10
+    __, __, __, __, __, _E, __, __, _C, __, __, __, __, _M, _P, __,   // 0x20
+    _D, _D, _D, _D, _D, _D, _D, _D, _D, _D, __, _E, __, __, __, __,   // 0x30
+    __, _L, _L, _L, _L, _L, _L, _L, _L, _L, _L, _L, _L, _L, _L, _L,   // 0x40
+    _L, _L, _L, _L, _L, _L, _L, _L, _L, _L, _L, __, __, __, __, __,   // 0x50
+    __, _L, _L, _L, _L, _L, _L, _L, _L, _L, _L, _L, _L, _L, _L, _L,   // 0x60
+    _L, _L, _L, _L, _L, _L, _L, _L, _L, _L, _L, __, __, __, __, __,   // 0x70
+    __, __, __, __, __, __, __, __, __, __, __, __, __, __, __, __,   // 0x80
+    __, __, __, __, __, __, __, __, __, __, __, __, __, __, __, __,   // 0x90
+    __, __, __, __, __, __, __, __, __, __, __, __, __, __, __, __,   // 0xA0
+    __, __, __, __, __, __, __, __, __, __, __, __, __, __, __, __,   // 0xB0
+    __, __, __, __, __, __, __, __, __, __, __, __, __, __, __, __,   // 0xC0
+    __, __, __, __, __, __, __, __, __, __, __, __, __, __, __, __,   // 0xD0
+    __, __, __, __, __, __, __, __, __, __, __, __, __, __, __, __,   // 0xE0
+    __, __, __, __, __, __, __, __, __, __, __, __, __, __, __, __,   // 0xF0
+};
+
+#undef __
+#undef _E
+#undef _C
+#undef _L
+#undef _D
+#undef _P
+#undef _M
+
+char _normalize_scratch[RX_BUFFER_SIZE];    // active comments, collected as the block is lexed
+
+static char *_lex_comment(char *rd, char **ac_wr)
 {
-    _normalize_scratch[0] = 0;
-
-    char *gc_rd = str;                  // read pointer
-    char *gc_wr = _normalize_scratch;   // write pointer
-    char *ac_rd = str;                  // Active Comment read pointer
-    char *ac_wr = _normalize_scratch;   // Active Comment write pointer
-    bool last_char_was_digit = false;   // used for octal stripping
+    char *ac = *ac_wr;
+    bool in_msg = false;
 
-    // Move the ac_wr point forward one for every non-AC character we KEEP (plus one for a NULL in between)
-    ac_wr++;                            // account for the in-between NULL
+    rd++;                                   // skip the '('
+    if (((* rd    == 'm') || (* rd    == 'M')) &&
+        ((*(rd+1) == 's') || (*(rd+1) == 'S')) &&
+        ((*(rd+2) == 'g') || (*(rd+2) == 'G'))) {
 
-    // mark block deletes
-    if (*gc_rd == '/') {
-        *block_delete_flag = true;
-        gc_rd++;
-    } else {
-        *block_delete_flag = false;
+        rd += 3;
+        if (*rd == ' ') {
+            rd++;                           // skip the first space.
+        }
+        if ((ac > _normalize_scratch) && (*(ac-1) == '}')) {
+            *(ac-1) = ',';
+        } else {
+            *(ac++) = '{';
+        }
+        *(ac++) = 'm';
+        *(ac++) = 's';
+        *(ac++) = 'g';
+        *(ac++) = ':';
+        *(ac++) = '"';
+
+        // TODO - FIX BUFFER OVERFLOW POTENTIAL
+        // "(msg)" is four characters. "{msg:" is five. If the write buffer is full, we'll overflow.
+        // Also " is MSG will be quoted, making one character into two.
+        in_msg = true;
+
+    } else if (*rd == '{') {
+        if ((ac > _normalize_scratch) && (*(ac-1) == '}')) {    // merge json comments
+            *(ac-1) = ',';
+            rd++;                           // don't copy the '{'
+        }
+    } else {                                // plain comment - discard it
+        while ((*rd != NUL) && (*rd != ')')) {
+            rd++;
+        }
+        return (rd);
     }
 
-    while (*gc_rd != 0) {
-        if ((*gc_rd == ';') || (*gc_rd == '%')) {   // check for ';' or '%' comments that end the line
-            *gc_rd = 0;                             // go ahead and snap the string off cleanly here
+    // copy the comment, handling strings carefully
+    bool in_string = false;
+    bool escaped = false;
+    while (*rd != NUL) {
+        if (in_string && (*rd == '\\')) {
+            escaped = true;
+        } else if (!escaped && (*rd == '"')) {
+            if (in_msg) {                   // In msg comments, we have to escape "
+                *(ac++) = '\\';
+            } else {
+                in_string = !in_string;
+            }
+        } else if (!in_string && (*rd == ')')) {
+            if (in_msg) {
+                *(ac++) = '"';
+                *(ac++) = '}';
+            }
             break;
+        } else {
+            escaped = false;
         }
+        if (in_string || in_msg || (*rd != ' ')) { // Skip spaces if we're not in a string or msg (implicit string)
+            *(ac++) = *rd;
+        }
+        rd++;
+    }
+    *ac_wr = ac;
+    return (rd);                            // points to the ')' or the NUL
+}
 
-        // check for comment '('
-        else if (*gc_rd == '(') {
-            // We only care if it's a "({" in order to handle string-skipping properly
-            gc_rd++;
-            if ((*gc_rd == '{') || (((* gc_rd    == 'm') || (* gc_rd    == 'M')) &&
-                                    ((*(gc_rd+1) == 's') || (*(gc_rd+1) == 'S')) &&
-                                    ((*(gc_rd+2) == 'g') || (*(gc_rd+2) == 'G'))
-                )) {
-                if (ac_rd == nullptr) {
-                    ac_rd = gc_rd;      // note the start of the first AC
-                }
+static bool _lex_gcode_block(char *str, gcTokens_t *tokens)
+{
+    char *rd = str;                         // read pointer
+    char *wr = str;                         // write pointer - never passes the read pointer
+    char *ac = _normalize_scratch;          // active comment write pointer
+    char *value = NULL;                     // start of the value of the word being read
+    bool last_char_was_digit = false;       // used for octal stripping
+    bool words_ok = true;
+    numberScan_t n;
+
+    tokens->word_count = 0;
+    tokens->block_delete = false;
+    if (*rd == '/') {                       // mark block deletes
+        tokens->block_delete = true;
+        rd++;
+    }
+    for (;; rd++) {
+        char c = *rd;
+        uint8_t cls = _gc_class[(uint8_t)c];
 
-                // skip the comment, handling strings carefully
-                bool in_string = false;
-                while (*(++gc_rd) != 0) {
-                    if (*gc_rd=='"') {
-                        in_string = true;
-                    } else if (in_string) {
-                        if ((*gc_rd == '\\') && (*(gc_rd+1) != 0)) {
-                            gc_rd++; // Skip it, it's escaped.
-                        }
-                    } else if ((*gc_rd == ')')) {
-                        break;
-                    }
-                }
-                if (*gc_rd == 0) {      // We don't want the rd++ later to skip the NULL if we're at one
-                    break;
-                }
+        if (cls == GC_SKIP) {
+            continue;
+        }
+        if (cls == GC_COMMENT) {
+            rd = _lex_comment(rd, &ac);
+            if (*rd == NUL) {
+                cls = GC_END;
             } else {
-                *(gc_rd-1) = ' ';       // Change the '(' to a space to simplify the comment copy later
-                while ((*gc_rd != 0) && (*gc_rd != ')')) {  // skip ahead until we find a ')' (or NULL)
-                    gc_rd++;
+                continue;
+            }
+        }
+        if ((cls == GC_END) || (cls == GC_LETTER)) {
+            *wr = NUL;                      // c is saved, so this is safe even if wr == rd
+            if (value != NULL) {            // close out the previous word
+                char *end = scan_number(value, &n, false);  // no exponents - E is a word letter
+                if ((end == value) || (end != wr) || (tokens->word_count == GCODE_MAX_WORDS)) {
+                    words_ok = false;
+                } else {
+                    gcWord_t *word = &tokens->words[tokens->word_count++];
+                    word->letter = *(value-1);
+                    word->rest = wr - str;
+                    word->value = n.value;
+                    word->value_int = n.value_int;
                 }
+            } else if (wr != str) {
+                words_ok = false;           // the block doesn't start with a letter
             }
-        } else if (!isspace(*gc_rd)) {
-            bool do_copy = false;
-
+            if (cls == GC_END) {
+                break;
+            }
+            *(wr++) = c & ~0x20;            // upper case
+            value = wr;
+            last_char_was_digit = false;
+            continue;
+        }
+        if ((cls == GC_DIGIT) || (cls == GC_POINT)) {   // treat '.' as a digit so we don't strip after one
             // Perform Octal stripping - remove invalid leading zeros in number strings
             // Otherwise number conversions can fail, as Gcode does not support octal but C libs do
             // Change 0123.004 to 123.004, or -0234.003 to -234.003
-            if (isdigit(*gc_rd) || (*gc_rd == '.')) { // treat '.' as a digit so we don't strip after one
-                if (last_char_was_digit || (*gc_rd != '0') || !isdigit(*(gc_rd+1))) {
-                    do_copy = true;
-                }
-                last_char_was_digit = true;
-            }
-            else if ((isalnum((char)*gc_rd)) || (strchr("-.", *gc_rd))) { // all valid characters
-                last_char_was_digit = false;
-                do_copy = true;
-            }
-            if (do_copy) {
-                *(gc_wr++) = toupper(*gc_rd);
-                ac_wr++; // move the ac start position
+            if (last_char_was_digit || (c != '0') || (_gc_class[(uint8_t)*(rd+1)] != GC_DIGIT)) {
+                *(wr++) = c;
             }
+            last_char_was_digit = true;
+            continue;
         }
-        gc_rd++;
+        *(wr++) = c;                        // GC_MINUS
+        last_char_was_digit = false;
     }
 
-    // Enforce null termination
-    *gc_wr = 0;
-    char *comment_start = ac_wr;    // note the beginning of the comments
-    if (ac_rd != nullptr) {
-
-        // Now we'll copy the comments to the scratch
-        while (*ac_rd != 0) {
-            // check for comment '('
-            // Remember: we're only "counting characters" at this point, no more.
-            if (*ac_rd == '(') {
-                // We only care if it's a "({" in order to handle string-skipping properly
-                ac_rd++;
-
-                bool do_copy = false;
-                bool in_msg = false;
-                if (((* ac_rd    == 'm') || (* ac_rd    == 'M')) &&
-                    ((*(ac_rd+1) == 's') || (*(ac_rd+1) == 'S')) &&
-                    ((*(ac_rd+2) == 'g') || (*(ac_rd+2) == 'G'))
-                    ) {
-
-                    ac_rd += 3;
-                    if (*ac_rd == ' ') {
-                        ac_rd++; // skip the first space.
-                    }
-
-                    if (*(ac_wr-1) == '}') {
-                        *(ac_wr-1) = ',';
-                    } else {
-                        *(ac_wr++) = '{';
-                    }
-                    *(ac_wr++) = 'm';
-                    *(ac_wr++) = 's';
-                    *(ac_wr++) = 'g';
-                    *(ac_wr++) = ':';
-                    *(ac_wr++) = '"';
-
-                    // TODO - FIX BUFFER OVERFLOW POTENTIAL
-                    // "(msg)" is four characters. "{msg:" is five. If the write buffer is full, we'll overflow.
-                    // Also " is MSG will be quoted, making one character into two.
-
-                    in_msg = true;
-                    do_copy = true;
-                }
-
-                else if (*ac_rd == '{') {
-                    // merge json comments
-                    if (*(ac_wr-1) == '}') {
-                        *(ac_wr-1) = ',';
-
-                        // don't copy the '{'
-                        ac_rd++;
-                    }
-
-                    do_copy = true;
-                }
-
-                if (do_copy) {
-                    // skip the comment, handling strings carefully
-                    bool in_string = false;
-                    bool escaped = false;
-                    while (*ac_rd != 0) {
-                        if (in_string && (*ac_rd == '\\')) {
-                            escaped = true;
-                        } else if (!escaped && (*ac_rd == '"')) {
-                            // In msg comments, we have to escape "
-                            if (in_msg) {
-                                *(ac_wr++) = '\\';
-                            } else {
-                                in_string = !in_string;
-                            }
-                        } else if (!in_string && (*ac_rd == ')')) {
-                            ac_rd++;
-                            if (in_msg) {
-                                *(ac_wr++) = '"';
-                                *(ac_wr++) = '}';
-                            }
-                            break;
-                        } else {
-                            escaped = false;
-                        }
-
-                        // Skip spaces if we're not in a string or msg (implicit string)
-                        if (in_string || in_msg || (*ac_rd != ' ')) {
-                            *ac_wr = *ac_rd;
-                            ac_wr++;
-                        }
-
-                        ac_rd++;
-                    }
-                }
-
-                // We don't want the rd++ later to skip the NULL if we're at one
-                if (*ac_rd == 0) {
-                    break;
-                }
-            }
-            ac_rd++;
-        }
+    // move the active comments to the end, after the NUL
+    if (ac == _normalize_scratch) {
+        tokens->active_comment = wr;        // NUL string
+    } else {
+        *ac = NUL;
+        tokens->active_comment = wr + 1;
+        memcpy(wr + 1, _normalize_scratch, (ac - _normalize_scratch) + 1);
     }
-
-    // Enforce null termination
-    *ac_wr = 0;
-
-    // Now copy it all back
-    memcpy(str, _normalize_scratch, (ac_wr-_normalize_scratch)+1);
-
-    *active_comment = str + (comment_start - _normalize_scratch);
+    return (words_ok);
 }
 
 /****************************************************************************************
@@ -586,10 +675,11 @@ static stat_t _get_next_gcode_word(char **pstr, char *letter, float *value, int3
 //    *value_int = atol(*pstr);                       // needed to get an accurate line number for N > 8,388,608
 //    *value = strtof(*pstr, &end);
 
-    // get-value general case
-    char *end = *pstr;
-    *value = c_atof(end);
-    *value_int = atol(*pstr);                       // needed to get an accurate line number for N > 8,388,608
+    // get-value general case - one scan gives both the float and the exact integer part
+    numberScan_t n;
+    char *end = scan_number(*pstr, &n, false);      // no exponents - E is a word letter
+    *value = n.value;
+    *value_int = n.value_int;                       // needed to get an accurate line number for N > 8,388,608
 
     if (end == *pstr) {
 #if MARLIN_COMPAT_ENABLED == true
@@ -642,13 +732,16 @@ static stat_t _validate_gcode_block(char *active_comment)
 
 /****************************************************************************************
  * _parse_gcode_block() - parses one line of NULL terminated G-Code.
+ * _parse_gcode_tokens() - parses one tokenized line of G-Code (see gcode_tokenize())
+ * _init_gcode_block() - set initial parser state for a new block
+ * _parse_gcode_word() - parse a single word into the GN/GF structs
  *
  *  All the parser does is load the state values in gn (next model state) and set flags
  *  in gf (model state flags). The execute routine applies them. The buffer is assumed to
  *  contain only uppercase characters and signed floats (no whitespace).
  */
 
-static stat_t _parse_gcode_block(char *buf, char *active_comment)
+static stat_t _parse_gcode_block(char *buf, char *active_comment, bool checksum)
 {
     char *pstr = (char *)buf;                   // persistent pointer into gcode block for parsing words
     char letter;                                // parsed letter, eg.g. G or X or Y
@@ -656,9 +749,40 @@ static stat_t _parse_gcode_block(char *buf, char *active_comment)
     int32_t value_int = 0;                      // integer value parsed from letter - needed for line numbers
     stat_t status = STAT_OK;
 
+    _init_gcode_block(checksum);
+
+    // extract commands and parameters
+    while((status = _get_next_gcode_word(&pstr, &letter, &value, &value_int)) == STAT_OK) {
+        status = _parse_gcode_word(letter, value, value_int, pstr);
+        if(status != STAT_OK) break;
+    }
+    if ((status != STAT_OK) && (status != STAT_COMPLETE)) return (status);
+    ritorno(_validate_gcode_block(active_comment));
+    return (_execute_gcode_block(active_comment));        // if successful execute the block
+}
+
+static stat_t _parse_gcode_tokens(gcTokens_t *tokens)
+{
+    stat_t status = STAT_OK;
+
+    _init_gcode_block(tokens->checksum);
+
+    for (uint8_t i = 0; i < tokens->word_count; i++) {
+        gcWord_t *word = &tokens->words[i];
+        status = _parse_gcode_word(word->letter, word->value, word->value_int, tokens->block + word->rest);
+        if(status != STAT_OK) break;
+    }
+    if ((status != STAT_OK) && (status != STAT_COMPLETE)) return (status);
+    ritorno(_validate_gcode_block(tokens->active_comment));
+    return (_execute_gcode_block(tokens->active_comment));  // if successful execute the block
+}
+
+static void _init_gcode_block(bool checksum)
+{
     // set initial state for new move
     memset(&gv, 0, sizeof(GCodeValue_t));       // clear all next-state values
     memset(&gf, 0, sizeof(GCodeFlag_t));        // clear all next-state flags
+    gf.checksum = checksum;                     // found by _verify_checksum() before the block was cleared
     gv.motion_mode = cm_get_motion_mode(MODEL); // get motion mode from previous block
 
     // Causes a later exception if
@@ -668,215 +792,238 @@ static stat_t _parse_gcode_block(char *buf, char *active_comment)
         gv.F_word = 0;
         gf.F_word = true;
     }
+}
 
-    // extract commands and parameters
-    while((status = _get_next_gcode_word(&pstr, &letter, &value, &value_int)) == STAT_OK) {
-        switch(letter) {
-            case 'G':
-            switch((uint8_t)value) {
-                case 0:  SET_MODAL (MODAL_GROUP_G1, motion_mode, MOTION_MODE_STRAIGHT_TRAVERSE);
-                case 1:  SET_MODAL (MODAL_GROUP_G1, motion_mode, MOTION_MODE_STRAIGHT_FEED);
-                case 2:  SET_MODAL (MODAL_GROUP_G1, motion_mode, MOTION_MODE_CW_ARC);
-                case 3:  SET_MODAL (MODAL_GROUP_G1, motion_mode, MOTION_MODE_CCW_ARC);
-                case 4:  SET_NON_MODAL (next_action, NEXT_ACTION_DWELL);
-                case 10: SET_MODAL (MODAL_GROUP_G0, next_action, NEXT_ACTION_SET_G10_DATA);
-                case 17: SET_MODAL (MODAL_GROUP_G2, select_plane, CANON_PLANE_XY);
-                case 18: SET_MODAL (MODAL_GROUP_G2, select_plane, CANON_PLANE_XZ);
-                case 19: SET_MODAL (MODAL_GROUP_G2, select_plane, CANON_PLANE_YZ);
-                case 20: SET_MODAL (MODAL_GROUP_G6, units_mode, INCHES);
-                case 21: SET_MODAL (MODAL_GROUP_G6, units_mode, MILLIMETERS);
-                case 28: {
-                    switch (_point(value)) {
-                        case 0: SET_MODAL (MODAL_GROUP_G0, next_action, NEXT_ACTION_GOTO_G28_POSITION);
-                        case 1: SET_MODAL (MODAL_GROUP_G0, next_action, NEXT_ACTION_SET_G28_POSITION);
-                        case 2: SET_NON_MODAL (next_action, NEXT_ACTION_SEARCH_HOME);
-                        case 3: SET_NON_MODAL (next_action, NEXT_ACTION_SET_ABSOLUTE_ORIGIN);
-                        case 4: SET_NON_MODAL (next_action, NEXT_ACTION_HOMING_NO_SET);
-                        default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
-                    }
-                    break;
+static stat_t _parse_gcode_word(const char letter, const float value, const int32_t value_int, char *pstr)
+{
+    stat_t status = STAT_OK;
+
+    switch(letter) {
+        case 'G':
+        switch((uint8_t)value) {
+            case 0:  SET_MODAL (MODAL_GROUP_G1, motion_mode, MOTION_MODE_STRAIGHT_TRAVERSE);
+            case 1:  SET_MODAL (MODAL_GROUP_G1, motion_mode, MOTION_MODE_STRAIGHT_FEED);
+            case 2:  SET_MODAL (MODAL_GROUP_G1, motion_mode, MOTION_MODE_CW_ARC);
+            case 3:  SET_MODAL (MODAL_GROUP_G1, motion_mode, MOTION_MODE_CCW_ARC);
+            case 4:  SET_NON_MODAL (next_action, NEXT_ACTION_DWELL);
+            case 5: {
+                switch (_point(value)) {
+                    case 0: SET_MODAL (MODAL_GROUP_G1, motion_mode, MOTION_MODE_CUBIC_SPLINE);
+                    case 1: SET_MODAL (MODAL_GROUP_G1, motion_mode, MOTION_MODE_QUADRATIC_SPLINE);
+                    default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
+                }
+                break;
+            }
+            case 10: SET_MODAL (MODAL_GROUP_G0, next_action, NEXT_ACTION_SET_G10_DATA);
+            case 17: SET_MODAL (MODAL_GROUP_G2, select_plane, CANON_PLANE_XY);
+            case 18: SET_MODAL (MODAL_GROUP_G2, select_plane, CANON_PLANE_XZ);
+            case 19: SET_MODAL (MODAL_GROUP_G2, select_plane, CANON_PLANE_YZ);
+            case 20: SET_MODAL (MODAL_GROUP_G6, units_mode, INCHES);
+            case 21: SET_MODAL (MODAL_GROUP_G6, units_mode, MILLIMETERS);
+            case 28: {
+                switch (_point(value)) {
+                    case 0: SET_MODAL (MODAL_GROUP_G0, next_action, NEXT_ACTION_GOTO_G28_POSITION);
+                    case 1: SET_MODAL (MODAL_GROUP_G0, next_action, NEXT_ACTION_SET_G28_POSITION);
+                    case 2: SET_NON_MODAL (next_action, NEXT_ACTION_SEARCH_HOME);
+                    case 3: SET_NON_MODAL (next_action, NEXT_ACTION_SET_ABSOLUTE_ORIGIN);
+                    case 4: SET_NON_MODAL (next_action, NEXT_ACTION_HOMING_NO_SET);
+                    default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
                 }
+                break;
+            }
 #if MARLIN_COMPAT_ENABLED == true
-                case 29: SET_NON_MODAL (next_action, NEXT_ACTION_MARLIN_TRAM_BED);
+            case 29: SET_NON_MODAL (next_action, NEXT_ACTION_MARLIN_TRAM_BED);
 #endif
-                case 30: {
-                    switch (_point(value)) {
-                        case 0: SET_MODAL (MODAL_GROUP_G0, next_action, NEXT_ACTION_GOTO_G30_POSITION);
-                        case 1: SET_MODAL (MODAL_GROUP_G0, next_action, NEXT_ACTION_SET_G30_POSITION);
-                        default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
-                    }
-                    break;
+            case 30: {
+                switch (_point(value)) {
+                    case 0: SET_MODAL (MODAL_GROUP_G0, next_action, NEXT_ACTION_GOTO_G30_POSITION);
+                    case 1: SET_MODAL (MODAL_GROUP_G0, next_action, NEXT_ACTION_SET_G30_POSITION);
+                    default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
                 }
-                case 38: {
-                    switch (_point(value)) {
-                        case 2: SET_NON_MODAL (next_action, NEXT_ACTION_STRAIGHT_PROBE_ERR);
-                        case 3: SET_NON_MODAL (next_action, NEXT_ACTION_STRAIGHT_PROBE);
-                        case 4: SET_NON_MODAL (next_action, NEXT_ACTION_STRAIGHT_PROBE_AWAY_ERR);
-                        case 5: SET_NON_MODAL (next_action, NEXT_ACTION_STRAIGHT_PROBE_AWAY);
-                        default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
-                    }
-                    break;
+                break;
+            }
+            case 38: {
+                switch (_point(value)) {
+                    case 2: SET_NON_MODAL (next_action, NEXT_ACTION_STRAIGHT_PROBE_ERR);
+                    case 3: SET_NON_MODAL (next_action, NEXT_ACTION_STRAIGHT_PROBE);
+                    case 4: SET_NON_MODAL (next_action, NEXT_ACTION_STRAIGHT_PROBE_AWAY_ERR);
+                    case 5: SET_NON_MODAL (next_action, NEXT_ACTION_STRAIGHT_PROBE_AWAY);
+                    default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
                 }
-                case 40: break;    // ignore cancel cutter radius compensation. But don't fail G40s.
-                case 43: {
-                    switch (_point(value)) {
-                        case 0: SET_NON_MODAL (next_action, NEXT_ACTION_SET_TL_OFFSET);
-                        case 2: SET_NON_MODAL (next_action, NEXT_ACTION_SET_ADDITIONAL_TL_OFFSET);
-                        default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
-                    }
-                    break;
+                break;
+            }
+            case 40: break;    // ignore cancel cutter radius compensation. But don't fail G40s.
+            case 43: {
+                switch (_point(value)) {
+                    case 0: SET_NON_MODAL (next_action, NEXT_ACTION_SET_TL_OFFSET);
+                    case 2: SET_NON_MODAL (next_action, NEXT_ACTION_SET_ADDITIONAL_TL_OFFSET);
+                    default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
                 }
+                break;
+            }
 				case 49: SET_NON_MODAL (next_action, NEXT_ACTION_CANCEL_TL_OFFSET);
-                case 53: SET_NON_MODAL (absolute_override, ABSOLUTE_OVERRIDE_ON_DISPLAY_WITH_NO_OFFSETS);
-                case 54: SET_MODAL (MODAL_GROUP_G12, coord_system, G54);
-                case 55: SET_MODAL (MODAL_GROUP_G12, coord_system, G55);
-                case 56: SET_MODAL (MODAL_GROUP_G12, coord_system, G56);
-                case 57: SET_MODAL (MODAL_GROUP_G12, coord_system, G57);
-                case 58: SET_MODAL (MODAL_GROUP_G12, coord_system, G58);
-                case 59: SET_MODAL (MODAL_GROUP_G12, coord_system, G59);
-                case 61: {
-                    switch (_point(value)) {
-                        case 0: SET_MODAL (MODAL_GROUP_G13, path_control, PATH_EXACT_PATH);
-                        case 1: SET_MODAL (MODAL_GROUP_G13, path_control, PATH_EXACT_STOP);
-                        default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
-                    }
-                    break;
+            case 50: SET_NON_MODAL (next_action, NEXT_ACTION_CANCEL_SCALING);
+            case 51: SET_MODAL (MODAL_GROUP_G0, next_action, NEXT_ACTION_SET_SCALING);
+            case 53: SET_NON_MODAL (absolute_override, ABSOLUTE_OVERRIDE_ON_DISPLAY_WITH_NO_OFFSETS);
+            case 54: SET_MODAL (MODAL_GROUP_G12, coord_system, G54);
+            case 55: SET_MODAL (MODAL_GROUP_G12, coord_system, G55);
+            case 56: SET_MODAL (MODAL_GROUP_G12, coord_system, G56);
+            case 57: SET_MODAL (MODAL_GROUP_G12, coord_system, G57);
+            case 58: SET_MODAL (MODAL_GROUP_G12, coord_system, G58);
+            case 59: SET_MODAL (MODAL_GROUP_G12, coord_system, G59);
+            case 61: {
+                switch (_point(value)) {
+                    case 0: SET_MODAL (MODAL_GROUP_G13, path_control, PATH_EXACT_PATH);
+                    case 1: SET_MODAL (MODAL_GROUP_G13, path_control, PATH_EXACT_STOP);
+                    default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
                 }
-                case 64: SET_MODAL (MODAL_GROUP_G13,path_control, PATH_CONTINUOUS);
-                case 80: SET_MODAL (MODAL_GROUP_G1, motion_mode,  MOTION_MODE_CANCEL_MOTION_MODE);
-                case 90: {
-                    switch (_point(value)) {
-                        case 0: SET_MODAL (MODAL_GROUP_G3, distance_mode, ABSOLUTE_DISTANCE_MODE);
-                        case 1: SET_MODAL (MODAL_GROUP_G3, arc_distance_mode, ABSOLUTE_DISTANCE_MODE);
-                        default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
-                    }
-                    break;
+                break;
+            }
+            case 64: SET_MODAL (MODAL_GROUP_G13,path_control, PATH_CONTINUOUS);
+            case 68: SET_MODAL (MODAL_GROUP_G0, next_action, NEXT_ACTION_SET_ROTATION);
+            case 69: SET_NON_MODAL (next_action, NEXT_ACTION_CANCEL_ROTATION);
+            case 80: SET_MODAL (MODAL_GROUP_G1, motion_mode,  MOTION_MODE_CANCEL_MOTION_MODE);
+            case 81: SET_MODAL (MODAL_GROUP_G1, motion_mode,  MOTION_MODE_CANNED_CYCLE_81);
+            case 82: SET_MODAL (MODAL_GROUP_G1, motion_mode,  MOTION_MODE_CANNED_CYCLE_82);
+            case 83: SET_MODAL (MODAL_GROUP_G1, motion_mode,  MOTION_MODE_CANNED_CYCLE_83);
+            case 84: SET_MODAL (MODAL_GROUP_G1, motion_mode,  MOTION_MODE_CANNED_CYCLE_84);
+            case 85: SET_MODAL (MODAL_GROUP_G1, motion_mode,  MOTION_MODE_CANNED_CYCLE_85);
+            case 86: SET_MODAL (MODAL_GROUP_G1, motion_mode,  MOTION_MODE_CANNED_CYCLE_86);
+            case 87: SET_MODAL (MODAL_GROUP_G1, motion_mode,  MOTION_MODE_CANNED_CYCLE_87);
+            case 88: SET_MODAL (MODAL_GROUP_G1, motion_mode,  MOTION_MODE_CANNED_CYCLE_88);
+            case 89: SET_MODAL (MODAL_GROUP_G1, motion_mode,  MOTION_MODE_CANNED_CYCLE_89);
+            case 90: {
+                switch (_point(value)) {
+                    case 0: SET_MODAL (MODAL_GROUP_G3, distance_mode, ABSOLUTE_DISTANCE_MODE);
+                    case 1: SET_MODAL (MODAL_GROUP_G3, arc_distance_mode, ABSOLUTE_DISTANCE_MODE);
+                    default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
                 }
-                case 91: {
-                    switch (_point(value)) {
-                        case 0: SET_MODAL (MODAL_GROUP_G3, distance_mode, INCREMENTAL_DISTANCE_MODE);
-                        case 1: SET_MODAL (MODAL_GROUP_G3, arc_distance_mode, INCREMENTAL_DISTANCE_MODE);
-                        default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
-                    }
-                    break;
+                break;
+            }
+            case 91: {
+                switch (_point(value)) {
+                    case 0: SET_MODAL (MODAL_GROUP_G3, distance_mode, INCREMENTAL_DISTANCE_MODE);
+                    case 1: SET_MODAL (MODAL_GROUP_G3, arc_distance_mode, INCREMENTAL_DISTANCE_MODE);
+                    default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
                 }
-                case 92: {
-                    switch (_point(value)) {
-                        case 0: SET_MODAL (MODAL_GROUP_G0, next_action, NEXT_ACTION_SET_G92_OFFSETS);
-                        case 1: SET_NON_MODAL (next_action, NEXT_ACTION_RESET_G92_OFFSETS);
-                        case 2: SET_NON_MODAL (next_action, NEXT_ACTION_SUSPEND_G92_OFFSETS);
-                        case 3: SET_NON_MODAL (next_action, NEXT_ACTION_RESUME_G92_OFFSETS);
-                        default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
-                    }
-                    break;
+                break;
+            }
+            case 92: {
+                switch (_point(value)) {
+                    case 0: SET_MODAL (MODAL_GROUP_G0, next_action, NEXT_ACTION_SET_G92_OFFSETS);
+                    case 1: SET_NON_MODAL (next_action, NEXT_ACTION_RESET_G92_OFFSETS);
+                    case 2: SET_NON_MODAL (next_action, NEXT_ACTION_SUSPEND_G92_OFFSETS);
+                    case 3: SET_NON_MODAL (next_action, NEXT_ACTION_RESUME_G92_OFFSETS);
+                    default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
                 }
-                case 93: SET_MODAL (MODAL_GROUP_G5, feed_rate_mode, INVERSE_TIME_MODE);
-                case 94: SET_MODAL (MODAL_GROUP_G5, feed_rate_mode, UNITS_PER_MINUTE_MODE);
+                break;
+            }
+            case 93: SET_MODAL (MODAL_GROUP_G5, feed_rate_mode, INVERSE_TIME_MODE);
+            case 94: SET_MODAL (MODAL_GROUP_G5, feed_rate_mode, UNITS_PER_MINUTE_MODE);
 //              case 95: SET_MODAL (MODAL_GROUP_G5, feed_rate_mode, UNITS_PER_REVOLUTION_MODE);
+            case 98: SET_MODAL (MODAL_GROUP_G9, retract_mode, RETRACT_TO_INITIAL_LEVEL);
+            case 99: SET_MODAL (MODAL_GROUP_G9, retract_mode, RETRACT_TO_R_PLANE);
 
-                default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
-            }
-            break;
+            default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
+        }
+        break;
 
-            case 'M':
-            switch((uint8_t)value) {
-                case 0: case 1: case 60:
-                        SET_MODAL (MODAL_GROUP_M4, program_flow, PROGRAM_STOP);
-                case 2: case 30:
-                        SET_MODAL (MODAL_GROUP_M4, program_flow, PROGRAM_END);
-                case 3: SET_MODAL (MODAL_GROUP_M7, spindle_control, SPINDLE_CW);
-                case 4: SET_MODAL (MODAL_GROUP_M7, spindle_control, SPINDLE_CCW);
-                case 5: SET_MODAL (MODAL_GROUP_M7, spindle_control, SPINDLE_OFF);
-                case 6: SET_NON_MODAL (tool_change, true);
-                case 7: SET_MODAL (MODAL_GROUP_M8, coolant_mist,  COOLANT_ON);
-                case 8: SET_MODAL (MODAL_GROUP_M8, coolant_flood, COOLANT_ON);
-                case 9: SET_MODAL (MODAL_GROUP_M8, coolant_off,   COOLANT_OFF);
-                case 48: SET_MODAL (MODAL_GROUP_M9, m48_enable, true);
-                case 49: SET_MODAL (MODAL_GROUP_M9, m48_enable, false);
-                case 50:
-                    switch (_point(value)) {
-                        case 0: SET_MODAL (MODAL_GROUP_M9, fro_control, true);
-                        case 1: SET_MODAL (MODAL_GROUP_M9, tro_control, true);
-                        default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
-                    }
-                    break;
-                case 51: SET_MODAL (MODAL_GROUP_M9, spo_control, true);
-                case 100:
-                    switch (_point(value)) {
-                        case 0: SET_NON_MODAL (next_action, NEXT_ACTION_JSON_COMMAND_SYNC);
-                        case 1: SET_NON_MODAL (next_action, NEXT_ACTION_JSON_COMMAND_ASYNC);
-                        default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
-                    }
-                    break;
-                case 101: SET_NON_MODAL (next_action, NEXT_ACTION_JSON_WAIT);
+        case 'M':
+        switch((uint8_t)value) {
+            case 0: case 1: case 60:
+                    SET_MODAL (MODAL_GROUP_M4, program_flow, PROGRAM_STOP);
+            case 2: case 30:
+                    SET_MODAL (MODAL_GROUP_M4, program_flow, PROGRAM_END);
+            case 3: SET_MODAL (MODAL_GROUP_M7, spindle_control, SPINDLE_CW);
+            case 4: SET_MODAL (MODAL_GROUP_M7, spindle_control, SPINDLE_CCW);
+            case 5: SET_MODAL (MODAL_GROUP_M7, spindle_control, SPINDLE_OFF);
+            case 6: SET_NON_MODAL (tool_change, true);
+            case 7: SET_MODAL (MODAL_GROUP_M8, coolant_mist,  COOLANT_ON);
+            case 8: SET_MODAL (MODAL_GROUP_M8, coolant_flood, COOLANT_ON);
+            case 9: SET_MODAL (MODAL_GROUP_M8, coolant_off,   COOLANT_OFF);
+            case 48: SET_MODAL (MODAL_GROUP_M9, m48_enable, true);
+            case 49: SET_MODAL (MODAL_GROUP_M9, m48_enable, false);
+            case 50:
+                switch (_point(value)) {
+                    case 0: SET_MODAL (MODAL_GROUP_M9, fro_control, true);
+                    case 1: SET_MODAL (MODAL_GROUP_M9, tro_control, true);
+                    default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
+                }
+                break;
+            case 51: SET_MODAL (MODAL_GROUP_M9, spo_control, true);
+            case 100:
+                switch (_point(value)) {
+                    case 0: SET_NON_MODAL (next_action, NEXT_ACTION_JSON_COMMAND_SYNC);
+                    case 1: SET_NON_MODAL (next_action, NEXT_ACTION_JSON_COMMAND_ASYNC);
+                    default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
+                }
+                break;
+            case 101: SET_NON_MODAL (next_action, NEXT_ACTION_JSON_WAIT);
 
 #if MARLIN_COMPAT_ENABLED == true   // Note: case ordering and presence/absence of break;s is very important
-                case 20:marlin_list_sd_response();        status = STAT_COMPLETE; break;    // List SD card
-                case 21:                                                                    // Initialize SD card
-                case 22:                                  status = STAT_COMPLETE; break;    // Release SD card
-                case 23: marlin_select_sd_response(pstr); status = STAT_COMPLETE; break;    // Select SD file
+            case 20:marlin_list_sd_response();        status = STAT_COMPLETE; break;    // List SD card
+            case 21:                                                                    // Initialize SD card
+            case 22:                                  status = STAT_COMPLETE; break;    // Release SD card
+            case 23: marlin_select_sd_response(pstr); status = STAT_COMPLETE; break;    // Select SD file
 
-                case 82: SET_NON_MODAL (marlin_relative_extruder_mode, false);              // set relative extruder mode off
-                case 83: SET_NON_MODAL (marlin_relative_extruder_mode, true);               // set relative extruder mode on
+            case 82: SET_NON_MODAL (marlin_relative_extruder_mode, false);              // set relative extruder mode off
+            case 83: SET_NON_MODAL (marlin_relative_extruder_mode, true);               // set relative extruder mode on
 
-                case 18:                                                                    // compatibility alias for M84
-                case 84: SET_NON_MODAL (next_action, NEXT_ACTION_MARLIN_DISABLE_MOTORS);    // disable all motors
-                case 85: SET_NON_MODAL (next_action, NEXT_ACTION_MARLIN_SET_MT);            // set motor timeout
+            case 18:                                                                    // compatibility alias for M84
+            case 84: SET_NON_MODAL (next_action, NEXT_ACTION_MARLIN_DISABLE_MOTORS);    // disable all motors
+            case 85: SET_NON_MODAL (next_action, NEXT_ACTION_MARLIN_SET_MT);            // set motor timeout
 
-                case 105: SET_NON_MODAL (next_action, NEXT_ACTION_MARLIN_PRINT_TEMPERATURES);// request temperature report
-                case 106: SET_NON_MODAL (next_action, NEXT_ACTION_MARLIN_SET_FAN_SPEED);    // set fan speed range 0 - 255
-                case 107: SET_NON_MODAL (next_action, NEXT_ACTION_MARLIN_STOP_FAN);         // stop fan (speed = 0)
-                case 108: SET_NON_MODAL (next_action, NEXT_ACTION_MARLIN_CANCEL_WAIT_TEMP); // cancel wait for temperature
-                case 114: SET_NON_MODAL (next_action, NEXT_ACTION_MARLIN_PRINT_POSITION);   // request position report
+            case 105: SET_NON_MODAL (next_action, NEXT_ACTION_MARLIN_PRINT_TEMPERATURES);// request temperature report
+            case 106: SET_NON_MODAL (next_action, NEXT_ACTION_MARLIN_SET_FAN_SPEED);    // set fan speed range 0 - 255
+            case 107: SET_NON_MODAL (next_action, NEXT_ACTION_MARLIN_STOP_FAN);         // stop fan (speed = 0)
+            case 108: SET_NON_MODAL (next_action, NEXT_ACTION_MARLIN_CANCEL_WAIT_TEMP); // cancel wait for temperature
+            case 114: SET_NON_MODAL (next_action, NEXT_ACTION_MARLIN_PRINT_POSITION);   // request position report
 
-                case 109:                gf.marlin_wait_for_temp = true; // NO break!       // set wait for temp and execute M104
-                case 104: SET_NON_MODAL (next_action, NEXT_ACTION_MARLIN_SET_EXTRUDER_TEMP);// set extruder temperature
+            case 109:                gf.marlin_wait_for_temp = true; // NO break!       // set wait for temp and execute M104
+            case 104: SET_NON_MODAL (next_action, NEXT_ACTION_MARLIN_SET_EXTRUDER_TEMP);// set extruder temperature
 
-                case 190:                gf.marlin_wait_for_temp = true; // NO break!       // set wait for temp and execute M140
-                case 140: SET_NON_MODAL (next_action, NEXT_ACTION_MARLIN_SET_BED_TEMP);     // set heated bed temperature
+            case 190:                gf.marlin_wait_for_temp = true; // NO break!       // set wait for temp and execute M140
+            case 140: SET_NON_MODAL (next_action, NEXT_ACTION_MARLIN_SET_BED_TEMP);     // set heated bed temperature
 
-                case 110: SET_NON_MODAL (next_action, NEXT_ACTION_MARLIN_RESET_LINE_NUMBERS);// reset line numbers
-                case 111: status = STAT_COMPLETE; break; // ignore M111 Marlin debug statements. Don't process contents of the line further
+            case 110: SET_NON_MODAL (next_action, NEXT_ACTION_MARLIN_RESET_LINE_NUMBERS);// reset line numbers
+            case 111: status = STAT_COMPLETE; break; // ignore M111 Marlin debug statements. Don't process contents of the line further
 
-                case 115: SET_NON_MODAL (next_action, NEXT_ACTION_MARLIN_REPORT_VERSION);   // report version information
-                case 117: status = STAT_COMPLETE; break;  //SET_NON_MODAL (next_action, NEXT_ACTION_MARLIN_DISPLAY_ON_SCREEN);
+            case 115: SET_NON_MODAL (next_action, NEXT_ACTION_MARLIN_REPORT_VERSION);   // report version information
+            case 117: status = STAT_COMPLETE; break;  //SET_NON_MODAL (next_action, NEXT_ACTION_MARLIN_DISPLAY_ON_SCREEN);
 #endif // MARLIN_COMPAT_ENABLED
 
-                default: status = STAT_MCODE_COMMAND_UNSUPPORTED;
-            }
-            break;
+            default: status = STAT_MCODE_COMMAND_UNSUPPORTED;
+        }
+        break;
 
-            case 'T': SET_NON_MODAL (tool_select, (uint8_t)trunc(value));
-            case 'F': SET_NON_MODAL (F_word, value);
-            case 'P': SET_NON_MODAL (P_word, value);                // used for dwell time, G10 coord select
-            case 'S': SET_NON_MODAL (S_word, value);
-            case 'X': SET_NON_MODAL (target[AXIS_X], value);
-            case 'Y': SET_NON_MODAL (target[AXIS_Y], value);
-            case 'Z': SET_NON_MODAL (target[AXIS_Z], value);
-            case 'A': SET_NON_MODAL (target[AXIS_A], value);
-            case 'B': SET_NON_MODAL (target[AXIS_B], value);
-            case 'C': SET_NON_MODAL (target[AXIS_C], value);
-            case 'U': SET_NON_MODAL (target[AXIS_U], value);
-            case 'V': SET_NON_MODAL (target[AXIS_V], value);
-            case 'W': SET_NON_MODAL (target[AXIS_W], value);
-            case 'H': SET_NON_MODAL (H_word, value);
-            case 'I': SET_NON_MODAL (arc_offset[0], value);
-            case 'J': SET_NON_MODAL (arc_offset[1], value);
-            case 'K': SET_NON_MODAL (arc_offset[2], value);
-            case 'L': SET_NON_MODAL (L_word, value);
-            case 'R': SET_NON_MODAL (arc_radius, value);
-            case 'N': SET_NON_MODAL (linenum, value_int);           // line number handled as special case to preserve integer value
-            
+        case 'T': SET_NON_MODAL (tool_select, (uint8_t)trunc(value));
+        case 'F': SET_NON_MODAL (F_word, value);
+        case 'P': SET_NON_MODAL (P_word, value);                // used for dwell time, G10 coord select
+        case 'Q': SET_NON_MODAL (Q_word, value);                // used for G5 control points
+        case 'S': SET_NON_MODAL (S_word, value);
+        case 'X': SET_NON_MODAL (target[AXIS_X], value);
+        case 'Y': SET_NON_MODAL (target[AXIS_Y], value);
+        case 'Z': SET_NON_MODAL (target[AXIS_Z], value);
+        case 'A': SET_NON_MODAL (target[AXIS_A], value);
+        case 'B': SET_NON_MODAL (target[AXIS_B], value);
+        case 'C': SET_NON_MODAL (target[AXIS_C], value);
+        case 'U': SET_NON_MODAL (target[AXIS_U], value);
+        case 'V': SET_NON_MODAL (target[AXIS_V], value);
+        case 'W': SET_NON_MODAL (target[AXIS_W], value);
+        case 'H': SET_NON_MODAL (H_word, value);
+        case 'I': SET_NON_MODAL (arc_offset[0], value);
+        case 'J': SET_NON_MODAL (arc_offset[1], value);
+        case 'K': SET_NON_MODAL (arc_offset[2], value);
+        case 'L': SET_NON_MODAL (L_word, value);
+        case 'R': SET_NON_MODAL (arc_radius, value);
+        case 'N': SET_NON_MODAL (linenum, value_int);           // line number handled as special case to preserve integer value
+        
 #if MARLIN_COMPAT_ENABLED == true
-            case 'E': SET_NON_MODAL (E_word, value);                // extruder value
+        case 'E': SET_NON_MODAL (E_word, value);                // extruder value
 #endif
-            default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
-        }
-        if(status != STAT_OK) break;
+        default: status = STAT_GCODE_COMMAND_UNSUPPORTED;
     }
-    if ((status != STAT_OK) && (status != STAT_COMPLETE)) return (status);
-    ritorno(_validate_gcode_block(active_comment));
-    return (_execute_gcode_block(active_comment));        // if successful execute the block
+    return (status);
 }
 
 /****************************************************************************************
@@ -926,6 +1073,8 @@ stat_t _execute_gcode_block(char *active_comment)
 {
     stat_t status = STAT_OK;
 
+    sr_mark_all_changed();                                  // a block can change anything in the model
+
     if (gf.linenum) {
         cm_set_model_linenum(gv.linenum);
     }
@@ -997,7 +1146,7 @@ stat_t _execute_gcode_block(char *active_comment)
 
     EXEC_FUNC(cm_set_distance_mode, distance_mode);         // G90, G91
     EXEC_FUNC(cm_set_arc_distance_mode, arc_distance_mode); // G90.1, G91.1
-    //--> set retract mode goes here
+    EXEC_FUNC(cm_set_retract_mode, retract_mode);           // G98, G99
 
     switch (gv.next_action) {
         case NEXT_ACTION_SET_G28_POSITION:  { status = cm_set_g28_position(); break;}                               // G28.1
@@ -1023,6 +1172,14 @@ stat_t _execute_gcode_block(char *active_comment)
         case NEXT_ACTION_SUSPEND_G92_OFFSETS: { status = cm_suspend_g92_offsets(); break;}                      // G92.2
         case NEXT_ACTION_RESUME_G92_OFFSETS:  { status = cm_resume_g92_offsets(); break;}                       // G92.3
 
+        case NEXT_ACTION_CANCEL_SCALING:      { status = cm_cancel_scaling(); break;}                           // G50
+        case NEXT_ACTION_SET_SCALING:         { status = cm_set_scaling(gv.target, gf.target,                   // G51
+                                                                        gv.arc_offset, gf.arc_offset,
+                                                                        gv.P_word, gf.P_word); break;}
+        case NEXT_ACTION_SET_ROTATION:        { status = cm_set_rotation(gv.target, gf.target,                  // G68
+                                                                         gv.arc_radius, gf.arc_radius); break;}
+        case NEXT_ACTION_CANCEL_ROTATION:     { status = cm_cancel_rotation(); break;}                          // G69
+
         case NEXT_ACTION_JSON_COMMAND_SYNC:       { status = cm_json_command(active_comment); break;}               // M100.0
         case NEXT_ACTION_JSON_COMMAND_ASYNC:      { status = cm_json_command_immediate(active_comment); break;}     // M100.1
         case NEXT_ACTION_JSON_WAIT:               { status = cm_json_wait(active_comment); break;}                  // M101
@@ -1042,6 +1199,30 @@ stat_t _execute_gcode_block(char *active_comment)
                                                                  gv.motion_mode);
                                             break;
                                           }
+                case MOTION_MODE_CUBIC_SPLINE:                                                                      // G5
+                case MOTION_MODE_QUADRATIC_SPLINE: { status = cm_spline_feed(gv.target, gf.target,                  // G5.1
+                                                                             gv.arc_offset, gf.arc_offset,
+                                                                             gv.P_word, gf.P_word,
+                                                                             gv.Q_word, gf.Q_word,
+                                                                             gv.motion_mode);
+                                                     break;
+                                                   }
+                case MOTION_MODE_CANNED_CYCLE_81:                                                                   // G81
+                case MOTION_MODE_CANNED_CYCLE_82:                                                                   // G82
+                case MOTION_MODE_CANNED_CYCLE_83:                                                                   // G83
+                case MOTION_MODE_CANNED_CYCLE_84:                                                                   // G84
+                case MOTION_MODE_CANNED_CYCLE_85:                                                                   // G85
+                case MOTION_MODE_CANNED_CYCLE_86:                                                                   // G86
+                case MOTION_MODE_CANNED_CYCLE_87:                                                                   // G87
+                case MOTION_MODE_CANNED_CYCLE_88:                                                                   // G88
+                case MOTION_MODE_CANNED_CYCLE_89: { status = cm_canned_cycle(gv.target, gf.target,                  // G89
+                                                                             gv.arc_radius, gf.arc_radius,
+                                                                             gv.P_word, gf.P_word,
+                                                                             gv.Q_word, gf.Q_word,
+                                                                             gv.L_word, gf.L_word,
+                                                                             gv.motion_mode);
+                                                    break;
+                                                  }
                 default: break;
             }
             cm_set_absolute_override(MODEL, ABSOLUTE_OVERRIDE_OFF);  // un-set absolute override once the move is planned
@@ -214,6 +214,7 @@ struct ioDigitalInputExt {
                 cm->safety_interlock_reengaged = ext_pin_number;
             }
         }
+        sr_mark_changed(SR_CHANGE_MODEL);
         sr_request_status_report(SR_REQUEST_TIMED);
     };
 };
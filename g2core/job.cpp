@@ -0,0 +1,362 @@
+/*
+ * job.cpp - pre-parsed (binary) job reader
+ * This file is part of the g2core project
+ *
+ * This file ("the software") is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 as published by the
+ * Free Software Foundation. You should have received a copy of the GNU General Public
+ * License, version 2 along with the software.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, you may use this file as part of a software library without
+ * restriction. Specifically, if other files instantiate templates or use macros or
+ * inline functions from this file, or you compile this file and link it with  other
+ * files to produce an executable, this file does not by itself cause the resulting
+ * executable to be covered by the GNU General Public License. This exception does not
+ * however invalidate any other reasons why the executable file might be covered by the
+ * GNU General Public License.
+ *
+ * THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ * WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ * SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+/*
+ *  A pre-parsed job replays the canonical machine calls that _execute_gcode_block() would
+ *  have made for each block of the original program, without normalizing, scanning numbers,
+ *  converting units or tracking modal state on the controller. See job.h for the format.
+ *
+ *  Records are read from a xio_block_source (SD card, host file, memory image) into a
+ *  buffer that holds two blocks - while records are run out of one the next is being read.
+ *  job_dispatch() runs one record per call, and is called by the controller's command
+ *  dispatcher in place of reading a data line, so it is paced by the planner and stops
+ *  for feedholds, arcs and cycles exactly as Gcode text does. Control lines (JSON, !~%)
+ *  are still read from the serial channels while a job is running.
+ *
+ *  Errors are reported as exception reports and end the job. A summary is sent when the
+ *  job ends: {"job":{"st":0,"rec":1234,"byt":23456,"src":61234}} - the status, records run,
+ *  job bytes read and the size of the Gcode text the job was made from.
+ */
+
+#include "g2core.h"
+#include "config.h"
+#include "job.h"
+#include "gcode.h"
+#include "canonical_machine.h"
+#include "spindle.h"
+#include "coolant.h"
+#include "report.h"
+#include "xio.h"
+
+/***********************************************************************************
+ **** STRUCTURE ALLOCATIONS ********************************************************
+ ***********************************************************************************/
+
+jobSingleton_t job;
+static char _text[RX_BUFFER_SIZE];             // text records are run from here
+
+/***********************************************************************************
+ **** STATIC FUNCTIONS *************************************************************
+ ***********************************************************************************/
+
+static float _get_float(uint8_t *&p)
+{
+    float value;
+    memcpy(&value, p, sizeof(float));           // records are packed - floats may be unaligned
+    p += sizeof(float);
+    return (value);
+}
+
+static uint16_t _get_u16(uint8_t *&p)
+{
+    uint16_t value = p[0] | (p[1] << 8);
+    p += 2;
+    return (value);
+}
+
+/*
+ * _read_ahead() - collect a completed read and start the next one
+ *
+ *  Consumed bytes are moved out of the front of the buffer once a whole block has been
+ *  used, so there is always room to read the next block while the rest is run.
+ */
+
+static void _read_ahead()
+{
+    if (job.read_pending) {
+        int32_t result = job.source->readResult();
+        if (result < 0) {
+            return;                                 // still in flight
+        }
+        job.read_pending = false;
+        job.length += result;
+        job.file_offset += result;
+        if (result < JOB_BLOCK_SIZE) {
+            job.source_eof = true;
+        }
+    }
+    if (job.source_eof) {
+        return;
+    }
+    if (job.rd >= JOB_BLOCK_SIZE) {
+        memmove(job.buffer, job.buffer + job.rd, job.length - job.rd);
+        job.length -= job.rd;
+        job.rd = 0;
+    }
+    if (job.length <= (JOB_BUFFER_SIZE - JOB_BLOCK_SIZE)) {
+        if (!job.source->startRead((char *)job.buffer + job.length, job.file_offset, JOB_BLOCK_SIZE)) {
+            job.source_eof = true;                  // treat a failed read as the end of the file
+            return;
+        }
+        job.read_pending = true;
+        _read_ahead();                              // synchronous sources complete immediately
+    }
+}
+
+static void _job_end(stat_t status)
+{
+    char buffer[96];
+    sprintf(buffer, "{\"job\":{\"st\":%d,\"rec\":%lu,\"byt\":%lu,\"src\":%lu}}\n", status,
+            (unsigned long)job.records, (unsigned long)job.bytes, (unsigned long)job.header.source_bytes);
+    xio_writeline(buffer);
+    job.state = JOB_IDLE;
+    job.source = nullptr;
+}
+
+static void _set_modes(const uint8_t modes)
+{
+    cm_set_units_mode(MILLIMETERS);                 // lengths were converted when the job was made
+    cm_set_distance_mode((modes & JOB_MODE_INCREMENTAL) ? INCREMENTAL_DISTANCE_MODE : ABSOLUTE_DISTANCE_MODE);
+    cm_set_arc_distance_mode((modes & JOB_MODE_ARC_ABSOLUTE) ? ABSOLUTE_DISTANCE_MODE : INCREMENTAL_DISTANCE_MODE);
+    cm_set_feed_rate_mode((modes & JOB_MODE_INVERSE_TIME) ? INVERSE_TIME_MODE : UNITS_PER_MINUTE_MODE);
+}
+
+static void _get_axes(uint8_t *&p, const uint16_t axes, float target[], bool flags[])
+{
+    for (uint8_t axis=0; axis<AXES; axis++) {
+        flags[axis] = (axes >> axis) & 1;
+        target[axis] = flags[axis] ? _get_float(p) : 0;
+    }
+}
+
+/*
+ * _run_record() - make the canonical machine calls for one record
+ *
+ *  The payload length is checked against the fields it claims to hold before anything
+ *  is read, so a damaged file can't run a half-read record.
+ */
+
+static stat_t _run_record(const uint8_t op, uint8_t *p, const uint8_t length)
+{
+    float target[AXES];
+    bool flags[AXES];
+
+    switch (op) {
+        case JOB_LINE: {
+            if (length != 4) { return (STAT_JOB_FORMAT_ERROR); }
+            int32_t linenum;
+            memcpy(&linenum, p, sizeof(linenum));
+            cm_set_model_linenum(linenum);
+            return (STAT_OK);
+        }
+        case JOB_TRAVERSE:
+        case JOB_FEED: {
+            if (length < 3) { return (STAT_JOB_FORMAT_ERROR); }
+            uint8_t modes = *p++;
+            uint16_t axes = _get_u16(p);
+            if ((axes >> AXES) ||
+                (length != 3 + 4 * (__builtin_popcount(axes) + ((modes & JOB_MODE_FEED) ? 1 : 0)))) {
+                return (STAT_JOB_FORMAT_ERROR);
+            }
+            _set_modes(modes);
+            if (modes & JOB_MODE_FEED) {
+                ritorno(cm_set_feed_rate(_get_float(p)));
+            }
+            if (axes == 0) {
+                return (STAT_OK);                   // F alone
+            }
+            _get_axes(p, axes, target, flags);
+            if (op == JOB_TRAVERSE) {
+                return (cm_straight_traverse(target, flags, PROFILE_NORMAL));
+            }
+            return (cm_straight_feed(target, flags, PROFILE_NORMAL));
+        }
+        case JOB_ARC: {
+            if (length < 5) { return (STAT_JOB_FORMAT_ERROR); }
+            uint8_t modes = *p++;
+            uint8_t plane = *p++;
+            uint16_t axes = _get_u16(p);
+            uint8_t offsets = *p++;
+            uint8_t floats = __builtin_popcount(axes) + __builtin_popcount(offsets) +
+                             ((modes & JOB_MODE_FEED) ? 1 : 0) + ((modes & JOB_MODE_RADIUS) ? 1 : 0) +
+                             ((modes & JOB_MODE_TURNS) ? 1 : 0);
+            if ((axes >> AXES) || (offsets >> 3) || (plane > CANON_PLANE_YZ) || (length != 5 + 4 * floats)) {
+                return (STAT_JOB_FORMAT_ERROR);
+            }
+            _set_modes(modes);
+            cm_select_plane(plane);
+            if (modes & JOB_MODE_FEED) {
+                ritorno(cm_set_feed_rate(_get_float(p)));
+            }
+            float offset[3];
+            bool offset_f[3];
+            _get_axes(p, axes, target, flags);
+            for (uint8_t i=0; i<3; i++) {
+                offset_f[i] = (offsets >> i) & 1;
+                offset[i] = offset_f[i] ? _get_float(p) : 0;
+            }
+            float radius = (modes & JOB_MODE_RADIUS) ? _get_float(p) : 0;
+            float turns = (modes & JOB_MODE_TURNS) ? _get_float(p) : 0;
+            return (cm_arc_feed(target, flags, offset, offset_f, radius, (modes & JOB_MODE_RADIUS),
+                                turns, (modes & JOB_MODE_TURNS), (modes & JOB_MODE_MOTION_WORD),
+                                (modes & JOB_MODE_CCW) ? MOTION_MODE_CCW_ARC : MOTION_MODE_CW_ARC));
+        }
+        case JOB_DWELL: {
+            if (length != 4) { return (STAT_JOB_FORMAT_ERROR); }
+            return (cm_dwell(_get_float(p)));
+        }
+        case JOB_SPINDLE: {
+            if (length != 6) { return (STAT_JOB_FORMAT_ERROR); }
+            uint8_t spindle_flags = p[0];
+            spControl control = (spControl)p[1];
+            p += 2;
+            float speed = _get_float(p);
+            if (spindle_flags & JOB_SPINDLE_SPEED) {
+                ritorno(spindle_speed_sync(speed));
+            }
+            if (spindle_flags & JOB_SPINDLE_CONTROL) {
+                ritorno(spindle_control_sync(control));
+            }
+            return (STAT_OK);
+        }
+        case JOB_COOLANT: {
+            if (length != 2) { return (STAT_JOB_FORMAT_ERROR); }
+            return (coolant_control_sync((coControl)p[0], (coSelect)p[1]));
+        }
+        case JOB_JSON:
+        case JOB_GCODE: {
+            if ((length == 0) || (p[length-1] != NUL)) { return (STAT_JOB_FORMAT_ERROR); }
+            memcpy(_text, p, length);               // both parsers work in place, and a block can grow
+            if (op == JOB_JSON) {                   //...(MSG comments), so don't run them in the buffer
+                return (cm_json_command(_text));
+            }
+            return (gcode_parser(_text));
+        }
+        case JOB_STOP: {
+            if (length != 1) { return (STAT_JOB_FORMAT_ERROR); }
+            if (p[0] == PROGRAM_STOP) {
+                cm_program_stop();
+            } else {
+                cm_program_end();
+            }
+            return (STAT_OK);
+        }
+        default: {
+            return (STAT_JOB_FORMAT_ERROR);         // not this version's format - see job.h
+        }
+    }
+}
+
+/***********************************************************************************
+ **** CODE *************************************************************************
+ ***********************************************************************************/
+
+/*
+ * job_start() - start running a pre-parsed job - returns false if one is already running
+ * job_abort() - drop the running job (queue flush, job kill)
+ * job_is_running() - true if records are being run in place of data lines
+ */
+
+bool job_start(xio_block_source &source)
+{
+    if (job.state != JOB_IDLE) {
+        return (false);
+    }
+    job.source = &source;
+    job.source->reset();
+    job.file_offset = 0;
+    job.read_pending = false;
+    job.source_eof = false;
+    job.rd = 0;
+    job.length = 0;
+    job.records = 0;
+    job.bytes = 0;
+    job.header.source_bytes = 0;
+    job.state = JOB_HEADER;
+    _read_ahead();
+    return (true);
+}
+
+void job_abort()
+{
+    if (job.state != JOB_IDLE) {
+        _job_end(STAT_KILL_JOB);
+    }
+}
+
+bool job_is_running() { return (job.state != JOB_IDLE); }
+
+/*
+ * job_dispatch() - run the next record of the job
+ *
+ *  Returns STAT_EAGAIN if the next record hasn't been read yet, otherwise STAT_OK.
+ *  The job is ended (and reported) on an error, a damaged record or the end of the file.
+ */
+
+stat_t job_dispatch()
+{
+    _read_ahead();
+    uint16_t available = job.length - job.rd;
+    uint8_t *record = job.buffer + job.rd;
+
+    if (job.state == JOB_HEADER) {
+        if (available < sizeof(jobHeader_t)) {
+            if (job.source_eof && !job.read_pending) {
+                _job_end(STAT_JOB_FORMAT_ERROR);
+                return (STAT_OK);
+            }
+            return (STAT_EAGAIN);
+        }
+        memcpy(&job.header, record, sizeof(jobHeader_t));
+        if ((job.header.magic != JOB_MAGIC) || (job.header.version != JOB_VERSION) ||
+            (job.header.header_size < sizeof(jobHeader_t)) || (job.header.header_size > JOB_BLOCK_SIZE) ||
+            ((available < job.header.header_size) && job.source_eof && !job.read_pending)) {
+            job.header.source_bytes = 0;
+            _job_end(STAT_JOB_FORMAT_ERROR);
+            return (STAT_OK);
+        }
+        if (available < job.header.header_size) {
+            return (STAT_EAGAIN);
+        }
+        job.rd += job.header.header_size;
+        job.bytes += job.header.header_size;
+        job.state = JOB_RUNNING;
+        return (STAT_OK);
+    }
+
+    if ((available < 2) || (available < 2 + record[1])) {
+        if (job.source_eof && !job.read_pending) {
+            _job_end((available == 0) ? STAT_OK : STAT_JOB_FORMAT_ERROR);   // a partial record is damage
+            return (STAT_OK);
+        }
+        return (STAT_EAGAIN);
+    }
+    stat_t status = cm_is_alarmed();                // as gcode_parser() does for each block
+    if (status != STAT_OK) {
+        _job_end(status);
+        return (STAT_OK);
+    }
+    uint8_t length = record[1];
+    job.rd += 2 + length;
+    job.bytes += 2 + length;
+    job.records++;
+
+    sr_mark_all_changed();                          // as _execute_gcode_block() does
+    status = _run_record(record[0], record + 2, length);
+    if ((status != STAT_OK) && (status != STAT_NOOP) && (status != STAT_COMPLETE)) {
+        rpt_exception(status, "pre-parsed job record failed");
+        _job_end(status);
+    }
+    return (STAT_OK);
+}
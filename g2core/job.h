@@ -0,0 +1,133 @@
+/*
+ * job.h - pre-parsed (binary) job reader
+ * This file is part of the g2core project
+ *
+ * This file ("the software") is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2 as published by the
+ * Free Software Foundation. You should have received a copy of the GNU General Public
+ * License, version 2 along with the software.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * As a special exception, you may use this file as part of a software library without
+ * restriction. Specifically, if other files instantiate templates or use macros or
+ * inline functions from this file, or you compile this file and link it with  other
+ * files to produce an executable, this file does not by itself cause the resulting
+ * executable to be covered by the GNU General Public License. This exception does not
+ * however invalidate any other reasons why the executable file might be covered by the
+ * GNU General Public License.
+ *
+ * THE SOFTWARE IS DISTRIBUTED IN THE HOPE THAT IT WILL BE USEFUL, BUT WITHOUT ANY
+ * WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT
+ * SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+ * OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef JOB_H_ONCE
+#define JOB_H_ONCE
+
+#include "xio.h"
+
+/**** Pre-parsed job format ****
+ *
+ *  A job is a Gcode program that has been run through normalization, word parsing and
+ *  modal state tracking ahead of time (see Resources/g2job.py), leaving a stream of
+ *  canonical machine operations. Lengths and feed rates are already in millimeters.
+ *  All values are little-endian; floats are IEEE single precision.
+ *
+ *  The file starts with a jobHeader_t, followed by records of the form:
+ *
+ *      [op:1][length:1][payload:length]
+ *
+ *  An op the reader doesn't know ends the job with STAT_JOB_FORMAT_ERROR - adding ops means
+ *  bumping JOB_VERSION, so an older controller rejects the header instead of running part
+ *  of the job. Payloads by op (u8/u16/i32/f32):
+ *
+ *    JOB_LINE      i32 line number
+ *    JOB_TRAVERSE  u8 modes, u16 axes, f32 per axis in axes                      G0
+ *    JOB_FEED      u8 modes, u16 axes, [f32 F], f32 per axis in axes             G1 (or F alone)
+ *    JOB_ARC       u8 modes, u8 plane, u16 axes, u8 offsets, [f32 F],            G2, G3
+ *                  f32 per axis, f32 per offset (IJK), [f32 R], [f32 P]
+ *    JOB_DWELL     f32 seconds                                                   G4
+ *    JOB_SPINDLE   u8 flags, u8 spControl, f32 speed                             S, M3, M4, M5
+ *    JOB_COOLANT   u8 coControl, u8 coSelect                                     M7, M8, M9
+ *    JOB_JSON      NUL terminated active comment                                 M100
+ *    JOB_GCODE     NUL terminated Gcode block, run through gcode_parser()
+ *    JOB_STOP      u8 PROGRAM_STOP or PROGRAM_END                                M0, M1, M60 / M2, M30
+ *
+ *  Blocks the host tool can't reduce to these are sent as JOB_GCODE text, prefixed with
+ *  the units and distance modes in effect, so they run exactly as they would have as text.
+ */
+
+#define JOB_MAGIC           0x424A3247          // "G2JB"
+#define JOB_VERSION         1
+#define JOB_BLOCK_SIZE      512                 // bytes requested from the block source per read
+#define JOB_BUFFER_SIZE     (JOB_BLOCK_SIZE * 2) // one block being run, one being read ahead
+
+typedef struct jobHeader {          // 16 bytes
+    uint32_t magic;                 // JOB_MAGIC
+    uint8_t version;                // JOB_VERSION
+    uint8_t reserved;
+    uint16_t header_size;           // offset of the first record
+    uint32_t records;               // number of records that follow
+    uint32_t source_bytes;          // size of the Gcode text the job was made from
+} jobHeader_t;
+
+typedef enum {                      // record op codes
+    JOB_END = 0,                    // not used in files
+    JOB_LINE,
+    JOB_TRAVERSE,
+    JOB_FEED,
+    JOB_ARC,
+    JOB_DWELL,
+    JOB_SPINDLE,
+    JOB_COOLANT,
+    JOB_JSON,
+    JOB_GCODE,
+    JOB_STOP
+} jobOp;
+
+// modes byte of motion records
+#define JOB_MODE_INCREMENTAL    0x01    // G91 - otherwise G90
+#define JOB_MODE_ARC_ABSOLUTE   0x02    // G90.1 - otherwise G91.1
+#define JOB_MODE_INVERSE_TIME   0x04    // G93 - otherwise G94
+#define JOB_MODE_FEED           0x08    // F is present
+#define JOB_MODE_CCW            0x10    // G3 - otherwise G2
+#define JOB_MODE_RADIUS         0x20    // R is present
+#define JOB_MODE_TURNS          0x40    // P is present
+#define JOB_MODE_MOTION_WORD    0x80    // G2 or G3 was given in the block
+
+// flags byte of spindle records
+#define JOB_SPINDLE_SPEED       0x01    // S is present
+#define JOB_SPINDLE_CONTROL     0x02    // M3, M4 or M5 is present
+
+typedef enum {
+    JOB_IDLE = 0,                   // no job loaded
+    JOB_HEADER,                     // waiting for the header
+    JOB_RUNNING                     // running records
+} jobState;
+
+typedef struct jobSingleton {
+    jobState state;
+    xio_block_source *source;
+    uint32_t file_offset;           // offset of the next block to request
+    bool read_pending;              // a read into buffer[length] is in flight
+    bool source_eof;                // the source returned a short block
+    uint16_t rd;                    // next unread byte in buffer
+    uint16_t length;                // valid bytes in buffer
+    uint32_t records;               // records run so far
+    uint32_t bytes;                 // bytes consumed so far
+    jobHeader_t header;
+    uint8_t buffer[JOB_BUFFER_SIZE];
+} jobSingleton_t;
+
+extern jobSingleton_t job;
+
+/**** function prototypes ****/
+
+bool job_start(xio_block_source &source);
+void job_abort(void);
+bool job_is_running(void);
+stat_t job_dispatch(void);
+
+#endif // End of include guard: JOB_H_ONCE
@@ -44,14 +44,13 @@ jsSingleton_t js;
 
 static stat_t _json_parser_kernal(nvObj_t *nv, char *str);
 static stat_t _json_parser_execute(nvObj_t *nv);
-static stat_t _normalize_json_string(char *str, uint16_t size);
-static stat_t _get_nv_pair(nvObj_t *nv, char **pstr, int8_t *depth);
+static stat_t _get_nv_pair(nvObj_t *nv, char **pstr, int8_t *depth, const char *str_max);
+static stat_t _get_json_number(nvObj_t *nv, char **pstr);
 
 /****************************************************************************
  * json_parser() - exposed part of JSON parser
  * _json_parser_kernal()
- * _normalize_json_string()
- * _get_nv_pair_strict()
+ * _get_nv_pair()
  *
  *  This is a dumbed down JSON parser to fit in limited memory with no malloc
  *  or practical way to do recursion ("depth" tracks parent/child levels).
@@ -73,6 +72,7 @@ static stat_t _get_nv_pair(nvObj_t *nv, char **pstr, int8_t *depth);
  *    - hexadecimal or other non-decimal number bases are not supported
  *
  *  The parser:
+ *    - walks the input string once, normalizing as it goes (see _get_nv_pair())
  *    - extracts an array of one or more JSON object structs from the input string
  *    - once the array is built it executes the object(s) in order in the array
  *    - passes the executed array to the response handler to generate the response string
@@ -150,12 +150,7 @@ static stat_t _json_parser_kernal(nvObj_t *nv, char *str)
     int8_t depth;
     char group[GROUP_LEN+1] = {""};                 // group identifier - starts as NUL
     int8_t i = NV_BODY_LEN;
-
-    status = _normalize_json_string(str, JSON_INPUT_STRING_MAX);
-    if (status != STAT_OK) {
-        nv->valuetype = TYPE_NULL;
-        return (status);
-    }
+    const char *str_max = str + JSON_INPUT_STRING_MAX;
 
     // parse the JSON command into the nv body
     do {
@@ -164,7 +159,7 @@ static stat_t _json_parser_kernal(nvObj_t *nv, char *str)
         }
         // Use relaxed parser. Will read either strict or relaxed mode. To use strict-only parser refer
         // to build earlier than 407.03. Substitute _get_nv_pair_strict() for _get_nv_pair()
-        if ((status = _get_nv_pair(nv, &str, &depth)) > STAT_EAGAIN) { // erred out
+        if ((status = _get_nv_pair(nv, &str, &depth, str_max)) > STAT_EAGAIN) { // erred out
             nv->valuetype = TYPE_NULL;
             return (status);
         }
@@ -172,8 +167,9 @@ static stat_t _json_parser_kernal(nvObj_t *nv, char *str)
         if (group[0] != NUL) {
             strncpy(nv->group, group, GROUP_LEN);   // copy the parent's group to this child
         }
-        // validate the token and get the index
-        if ((nv->index = nv_get_index(nv->group, nv->token)) == NO_MATCH) {
+        // validate the token and get the index - an empty name would match its own parent group
+        if ((nv->token[0] == NUL) || ((nv->index = nv_get_index(nv->group, nv->token)) == NO_MATCH)) {
+            nv->index = NO_MATCH;
             nv->valuetype = TYPE_NULL;
             return (STAT_UNRECOGNIZED_NAME);
         }
@@ -189,49 +185,27 @@ static stat_t _json_parser_kernal(nvObj_t *nv, char *str)
     return (STAT_OK);                               // only successful commands exit through this point
 }
 
-/*
- * _normalize_json_string - normalize a JSON string in place
- *
- *  Validate string size limits, remove all whitespace and convert
- *  to lower case, with the exception of gcode comments
- */
-
-static stat_t _normalize_json_string(char *str, uint16_t size)
-{
-    char *wr;                                       // write pointer
-    uint8_t in_comment = false;
-
-    if (strlen(str) > size) {
-        return (STAT_INPUT_EXCEEDS_MAX_LENGTH);
-    }
-    for (wr = str; *str != NUL; str++) {
-        if (!in_comment) {                          // normal processing
-            if (*str == '(') in_comment = true;
-            if ((*str <= ' ') || (*str == DEL)) continue; // toss ctrls, WS & DEL
-            *wr++ = tolower(*str);
-        } else {                                    // Gcode comment processing
-            if (*str == ')') in_comment = false;
-            *wr++ = *str;
-        }
-    }
-    *wr = NUL;
-    return (STAT_OK);
-}
-
 /*
  * _get_nv_pair() - get the next name-value pair w/relaxed JSON rules. Also parses strict JSON.
+ * _skip_json_whitespace() - advance past whitespace, control characters and DEL
+ * _get_json_number() - parse a number value
  *
  *  Parse the next statement and populate the command object (nvObj).
  *
  *  Leaves string pointer (str) on the first character following the object.
- *  Which is the character just past the ',' separator if it's a multi-valued
- *  object or the terminating NUL if single object or the last in a multi.
+ *  Which is the ',' separator if it's a multi-valued object or the terminating
+ *  NUL (or the closing quote or curly) if single object or the last in a multi.
  *
  *  Keeps track of tree depth and closing braces as much as it has to.
  *  If this were to be extended to track multiple parents or more than two
  *  levels deep it would have to track closing curlies - which it does not.
  *
- *  ASSUMES INPUT STRING HAS FIRST BEEN NORMALIZED BY _normalize_json_string()
+ *  The input is walked once. Whitespace, control characters and DEL are skipped and
+ *  names and values are taken as lower case - as a separate normalization pass used to
+ *  do. String values are normalized in place (Gcode comments are left as they are) and
+ *  the nvObj points to them in the input string rather than taking a copy, so the input
+ *  must outlive the nv list, which it does for all callers. Numbers are parsed once,
+ *  into both the integer and float values.
  *
  *  If a group prefix is passed in it will be pre-pended to any name parsed
  *  to form a token string. For example, if "x" is provided as a group and
@@ -246,23 +220,26 @@ static stat_t _normalize_json_string(char *str, uint16_t size)
  *  See build 406.xx or earlier for strict JSON parser - deleted in 407.03
  */
 
-static stat_t _get_nv_pair(nvObj_t *nv, char **pstr, int8_t *depth)
+static inline char *_skip_json_whitespace(char *str)
+{
+    while ((*str != NUL) && ((*str <= ' ') || (*str == DEL))) {
+        str++;
+    }
+    return (str);
+}
+
+static stat_t _get_nv_pair(nvObj_t *nv, char **pstr, int8_t *depth, const char *str_max)
 {
     uint8_t i;
-    char *tmp;
-    char leaders[] = {"{,\""};      // open curly, quote and leading comma
-    char separators[] = {":\""};    // colon and quote
-    char terminators[] = {"},\""};  // close curly, comma and quote
-    char value[] = {"{\".-+"};      // open curly, quote, period, minus and plus
+    char *str = *pstr;
 
     nv_reset_nv(nv);                // wipes the object and sets the depth
 
     // --- Process name part ---
-    // Find, terminate and set pointers for the name. Allow for leading and trailing name quotes.
-    char * name = *pstr;
-    for (i=0; true; i++, (*pstr)++) {
-        if (strchr(leaders, (int)**pstr) == NULL) {     // find leading character of name
-            name = (*pstr)++;
+    // Skip leading curlies, commas and quotes. Allow for leading and trailing name quotes.
+    for (i=0; true; i++, str++) {
+        str = _skip_json_whitespace(str);
+        if ((*str != '{') && (*str != ',') && (*str != '\"')) {
             break;
         }
         if (i == MAX_PAD_CHARS) {
@@ -270,85 +247,109 @@ static stat_t _get_nv_pair(nvObj_t *nv, char **pstr, int8_t *depth)
         }
     }
 
-    // Find the end of name, NUL terminate and copy token
-    for (i=0; true; i++, (*pstr)++) {
-        if (strchr(separators, (int)**pstr) != NULL) {
-            *(*pstr)++ = NUL;
-            strncpy(nv->token, name, TOKEN_LEN+1);      // copy the string to the token
+    // Copy the name to the token up to the separator (colon or quote)
+    for (i=0; true; str++) {
+        char c = *str;
+        if ((c == ':') || (c == '\"')) {
+            str++;
             break;
         }
+        if (c == NUL) {
+            return (STAT_JSON_SYNTAX_ERROR);
+        }
+        if ((c <= ' ') || (c == DEL)) {
+            continue;
+        }
         if (i == TOKEN_LEN) {
             return (STAT_INPUT_EXCEEDS_MAX_LENGTH);
         }
+        nv->token[i++] = tolower(c);
     }
+    nv->token[i] = NUL;
 
     // --- Process value part ---  (organized from most to least frequently encountered)
 
     // Find the start of the value part
-    for (i=0; true; i++, (*pstr)++) {
-        if (isalnum((int)**pstr)) break;
-        if (strchr(value, (int)**pstr) != NULL) break;
-        if (i == MAX_PAD_CHARS) {
+    for (i=0; true; i++, str++) {
+        str = _skip_json_whitespace(str);
+        if (isalnum((int)*str)) break;
+        if ((*str == '{') || (*str == '\"') || (*str == '[') ||
+            (*str == '.') || (*str == '-') || (*str == '+')) break;
+        if ((*str == NUL) || (i == MAX_PAD_CHARS)) {
             return (STAT_JSON_SYNTAX_ERROR);
         }
     }
+    char c = tolower(*str);
 
     // nulls (gets)
-    if ((**pstr == 'n') || ((**pstr == '\"') && (*(*pstr+1) == '\"'))) { // process null value
+    if ((c == 'n') || ((c == '\"') && (*(str+1) == '\"'))) { // process null value
         nv->valuetype = TYPE_NULL;
         nv->value_int = TYPE_NULL;
+        if (c == '\"') {
+            str += 2;                                   // past the empty string
+        }
 
     // numbers
-    } else if (isdigit(**pstr) || (**pstr == '-')) {    // value is a number
-        nv->value_int = atol(*pstr);                    // get the number as an integer
-        nv->value_flt = (float)strtod(*pstr, &tmp);     // get the number as a float - tmp is the end pointer
-
-        if ((tmp == *pstr) ||                           // if start pointer equals end the conversion failed
-            (strchr(terminators, *tmp) == NULL)) {      // terminators are the only legal chars at the end of a number
+    } else if (isdigit(c) || (c == '-')) {              // value is a number
+        stat_t status = _get_json_number(nv, &str);
+        str = _skip_json_whitespace(str);
+        if ((status != STAT_OK) ||                      // terminators are the only legal chars at the end of a number
+            ((*str != '}') && (*str != ',') && (*str != '\"'))) {
             nv->valuetype = TYPE_NULL;                  // report back an error
             return (STAT_BAD_NUMBER_FORMAT);
         }
-        nv->valuetype = TYPE_FLOAT;
 
     // object parent
-    } else if (**pstr == '{') {
+    } else if (c == '{') {
         nv->valuetype = TYPE_PARENT;
 //        *depth += 1;                                  // nv_reset_nv() sets the next object's level so this is redundant
-        (*pstr)++;
+        *pstr = str+1;
         return(STAT_EAGAIN);                            // signal that there is more to parse
 
     // strings
-    } else if (**pstr == '\"') {                        // value is a string
-        (*pstr)++;
-        nv->valuetype = TYPE_STRING;
-        if ((tmp = strchr(*pstr, '\"')) == NULL) {
-            return (STAT_JSON_SYNTAX_ERROR);            // find the end of the string
+    } else if (c == '\"') {                             // value is a string - normalize it in place
+        char *value = ++str;
+        char *wr = value;
+        bool in_comment = false;
+        for (; *str != '\"'; str++) {
+            if (*str == NUL) {
+                return (STAT_JSON_SYNTAX_ERROR);        // no closing quote
+            }
+            if (!in_comment) {                          // normal processing
+                if (*str == '(') in_comment = true;
+                if ((*str <= ' ') || (*str == DEL)) continue; // toss ctrls, WS & DEL
+                *wr++ = tolower(*str);
+            } else {                                    // Gcode comment processing
+                if (*str == ')') in_comment = false;
+                *wr++ = *str;
+            }
         }
-        *tmp = NUL;
+        *wr = NUL;                                      // may overwrite the closing quote
+        str++;
+        nv->valuetype = TYPE_STRING;
 
         // if string begins with 0x it might be data, needs to be at least 3 chars long
-        if( strlen(*pstr)>=3 && (*pstr)[0]=='0' && (*pstr)[1]=='x')
+        if ((wr - value) >= 3 && value[0]=='0' && value[1]=='x')
         {
             uint32_t *v = (uint32_t*)&nv->value_flt;
-            *v = strtoul((const char *)*pstr, 0L, 0);
+            *v = strtoul((const char *)value, 0L, 0);
             nv->valuetype = TYPE_DATA;
         } else {
-            ritorno(nv_copy_string(nv, *pstr));
+            nv->stringp = (char (*)[])value;            // no copy - the string stays in the input
         }
-        *pstr = ++tmp;
 
     // boolean true/false
-    } else if (**pstr == 't') {
+    } else if (c == 't') {
         nv->valuetype = TYPE_BOOLEAN;
         nv->value_int = true;
-    } else if (**pstr == 'f') {
+    } else if (c == 'f') {
         nv->valuetype = TYPE_BOOLEAN;
         nv->value_int = false;
 
     // arrays
-    } else if (**pstr == '[') {
+    } else if (c == '[') {
         nv->valuetype = TYPE_ARRAY;
-        ritorno(nv_copy_string(nv, *pstr));     // copy array into string for error displays
+        nv->stringp = (char (*)[])str;          // point at the array for error displays
         return (STAT_VALUE_TYPE_ERROR);         // return error as the parser doesn't do input arrays yet
 
     // general error condition
@@ -357,20 +358,123 @@ static stat_t _get_nv_pair(nvObj_t *nv, char **pstr, int8_t *depth)
     }
 
     // process comma separators and end curlies
-    if ((*pstr = strpbrk(*pstr, terminators)) == NULL) { // advance to terminator or err out
-        return (STAT_JSON_SYNTAX_ERROR);
+    while ((*str != '}') && (*str != ',') && (*str != '\"')) { // advance to terminator or err out
+        if (*str++ == NUL) {
+            return (STAT_JSON_SYNTAX_ERROR);
+        }
     }
-    if (**pstr == '}') {
+    if (str > str_max) {
+        return (STAT_INPUT_EXCEEDS_MAX_LENGTH);
+    }
+    if (*str == '}') {
         *depth -= 1;                            // pop up a nesting level
-        (*pstr)++;                              // advance to comma or whatever follows
+        str = _skip_json_whitespace(str+1);     // advance to comma or whatever follows
     }
-    if (**pstr == ',') {
+    *pstr = str;
+    if (*str == ',') {
         return (STAT_EAGAIN);                   // signal that there is more to parse
     }
-    (*pstr)++;
     return (STAT_OK);                           // signal that parsing is complete
 }
 
+/*
+ *  Numbers are scanned once by scan_number() (see util.cpp): the integer part gives value_int
+ *  (as atol() would) and value_flt is correctly rounded (as strtof() would).
+ *  Leaves the string pointer on the first character after the number.
+ */
+
+static stat_t _get_json_number(nvObj_t *nv, char **pstr)
+{
+    numberScan_t n;
+    char *end = scan_number(*pstr, &n, true);
+
+    if (end == *pstr) {
+        return (STAT_BAD_NUMBER_FORMAT);
+    }
+    nv->value_int = n.value_int;
+    nv->value_flt = n.value;
+    nv->valuetype = TYPE_FLOAT;
+    *pstr = end;
+    return (STAT_OK);
+}
+
+/*
+ * Output helpers for json_serialize()
+ *
+ *  Each appends at the cursor (str) and returns false, without writing past str_max, if
+ *  the text won't fit. Numbers are formatted directly into the output buffer when there
+ *  is room for the longest possible result, which is nearly always.
+ */
+
+#define JSON_NUMBER_MAX_CHARS 20        // longest number any of the formatters can write, plus margin
+
+static inline bool _json_put_char(char *&str, const char *str_max, const char c)
+{
+    if (str >= str_max) {
+        return (false);
+    }
+    *str++ = c;
+    return (true);
+}
+
+static inline bool _json_put_string(char *&str, const char *str_max, const char *src)
+{
+    while (*src != NUL) {
+        if (str >= str_max) {
+            return (false);
+        }
+        *str++ = *src++;
+    }
+    return (true);
+}
+
+static bool _json_put_number(char *&str, const char *str_max, const char *number, uint8_t length)
+{
+    if ((str + length) > str_max) {
+        return (false);
+    }
+    memcpy(str, number, length);
+    str += length;
+    return (true);
+}
+
+static bool _json_put_integer(char *&str, const char *str_max, const int32_t n)
+{
+    char digits[12];                    // written backwards from the end
+    char *p = digits + sizeof(digits);
+    uint32_t u = (n < 0) ? -(uint32_t)n : (uint32_t)n;
+    do {
+        uint32_t q = u / 10;
+        *--p = '0' + (u - (q * 10));
+        u = q;
+    } while (u != 0);
+    if (n < 0) {
+        *--p = '-';
+    }
+    return (_json_put_number(str, str_max, p, (digits + sizeof(digits)) - p));
+}
+
+static bool _json_put_hex(char *&str, const char *str_max, uint32_t u)
+{
+    char digits[8];                     // written backwards from the end
+    char *p = digits + sizeof(digits);
+    do {
+        *--p = "0123456789abcdef"[u & 0x0F];
+        u >>= 4;
+    } while (u != 0);
+    return (_json_put_number(str, str_max, p, (digits + sizeof(digits)) - p));
+}
+
+static bool _json_put_float(char *&str, const char *str_max, const float value, const int8_t precision)
+{
+    if ((str_max - str) > JSON_NUMBER_MAX_CHARS) {
+        str += floattoa(str, value, precision);
+        return (true);
+    }
+    char number[JSON_NUMBER_MAX_CHARS+1];
+    return (_json_put_number(str, str_max, number, floattoa(number, value, precision)));
+}
+
 /****************************************************************************
  * json_serialize() - make a JSON object string from JSON object array
  *
@@ -392,8 +496,12 @@ static stat_t _get_nv_pair(nvObj_t *nv, char **pstr, int8_t *depth)
  *    - The list must have a terminating nvObj where nv->nx == NULL.
  *      The terminating object may or may not have data (empty or not empty).
  *
+ *    - Output is written through a single cursor and every write is checked against
+ *      the buffer size, so nothing is ever written past out_buf + size.
+ *
  *  Returns:
- *      Returns length of string, or -1 if there's been an error
+ *      Returns length of string, or -1 if there's been an error. On error out_buf
+ *      is left as an empty string.
  *
  *  Desired behaviors:
  *    - Allow self-referential elements that would otherwise cause a recursive loop
@@ -403,105 +511,280 @@ static stat_t _get_nv_pair(nvObj_t *nv, char **pstr, int8_t *depth)
  *    - If a JSON object is empty omit the object altogether (no curlies)
  */
 
-uint16_t json_serialize(nvObj_t *nv, char *out_buf, uint16_t size)
+int16_t json_serialize(nvObj_t *nv, char *out_buf, uint16_t size)
 {
     char *str = out_buf;
-    char *str_max = out_buf + size;
+    const char *str_max = out_buf + size - 1;       // leave room for the NUL
     int8_t initial_depth = nv->depth;
     int8_t prev_depth = 0;
     uint8_t need_a_comma = false;
+    bool ok = _json_put_char(str, str_max, '{');    // write opening curly
 
-    *str++ = '{';                                 // write opening curly
-
-    while (true) {
+    while (ok) {
         if (nv->valuetype != TYPE_EMPTY) {
-            if (need_a_comma) { *str++ = ',';}
+            if (need_a_comma) { ok &= _json_put_char(str, str_max, ','); }
             need_a_comma = true;
-            strcpy(str++, "\"");
-            strcpy(str, nv->token); str += strlen(nv->token);
-            strcpy(str++, "\":"); str++;
+            ok &= _json_put_char(str, str_max, '"');
+            ok &= _json_put_string(str, str_max, nv->token);
+            ok &= _json_put_string(str, str_max, "\":");
 
             switch (nv->valuetype)  {
                 case (TYPE_EMPTY):  {   break; }
-                case (TYPE_NULL):   {   strcpy(str, "null");
-                                        str += 4;
+                case (TYPE_NULL):   {   ok &= _json_put_string(str, str_max, "null");
                                         break;
                                     }
-                case (TYPE_PARENT): {   *str++ = '{';
+                case (TYPE_PARENT): {   ok &= _json_put_char(str, str_max, '{');
                                         need_a_comma = false;
                                         break;
                                     }
                 case (TYPE_FLOAT):  {   convert_outgoing_float(nv);
-                                        str += floattoa(str, nv->value_flt, nv->precision);
+                                        ok &= _json_put_float(str, str_max, nv->value_flt, nv->precision);
                                         break;
                                     }
-//                case (TYPE_INT):    {   // str += inttoa(str, (int)nv->value); // doesn't handle negative numbers
-//                                        str += sprintf(str, "%d", (int)nv->value);
-//                                        break;
-//                                    }
-                case (TYPE_INTEGER):{   str += sprintf(str, "%d", (int)nv->value_int);
+                case (TYPE_INTEGER):{   ok &= _json_put_integer(str, str_max, nv->value_int);
                                         break;
                                     }
-                case (TYPE_STRING): {   *str++ = '"';
-                                        strcpy(str, *nv->stringp);
-                                        str += strlen(*nv->stringp);
-                                        *str++ = '"';
+                case (TYPE_STRING): {   ok &= _json_put_char(str, str_max, '"');
+                                        ok &= _json_put_string(str, str_max, *nv->stringp);
+                                        ok &= _json_put_char(str, str_max, '"');
                                         break;
                                     }
-                case (TYPE_BOOLEAN):{   if (nv->value_int) {
-                                            strcpy(str, "false");
-                                            str += 5;
-                                        } else {
-                                            strcpy(str, "true");
-                                            str += 4;
-                                        }
+                case (TYPE_BOOLEAN):{   ok &= _json_put_string(str, str_max, (nv->value_int) ? "false" : "true");
                                         break;
                                     }
                 case (TYPE_DATA):   {   uint32_t *v = (uint32_t*)&nv->value_flt;
-                                        str += sprintf(str, "\"0x%lx\"", *v);
+                                        ok &= _json_put_string(str, str_max, "\"0x");
+                                        ok &= _json_put_hex(str, str_max, *v);
+                                        ok &= _json_put_char(str, str_max, '"');
                                         break;
                                     }
-                case (TYPE_ARRAY):  {   strcpy(str++, "[");
-                                        strcpy(str, *nv->stringp);
-                                        str += strlen(*nv->stringp);
-                                        strcpy(str++, "]");
+                case (TYPE_ARRAY):  {   ok &= _json_put_char(str, str_max, '[');
+                                        ok &= _json_put_string(str, str_max, *nv->stringp);
+                                        ok &= _json_put_char(str, str_max, ']');
                                         break;
                                     }
                 default: {}
             }
         }
-        if (str >= str_max) { return (-1);}     // signal buffer overrun
         if ((nv = nv->nx) == NULL) { break;}    // end of the list
 
         while (nv->depth < prev_depth--) {      // iterate the closing curlies
             need_a_comma = true;
-            *str++ = '}';
+            ok &= _json_put_char(str, str_max, '}');
         }
         prev_depth = nv->depth;
     }
 
     // closing curlies and NEWLINE
     while (prev_depth-- > initial_depth) {
-        *str++ = '}';
+        ok &= _json_put_char(str, str_max, '}');
     }
-    str += sprintf((char *)str, "}\n");         // using sprintf for this last one ensures a NUL termination
-    if (str > out_buf + size) {
+    ok &= _json_put_string(str, str_max, "}\n");
+    if (!ok) {
+        *out_buf = NUL;                         // signal buffer overrun
         return (-1);
     }
+    *str = NUL;
     return (str - out_buf);
 }
 
+/****************************************************************************
+ * cbor_serialize() - make a CBOR (RFC 7049) frame from the nv list
+ *
+ *  Binary counterpart to json_serialize(), selected by $jb=1 while in JSON mode.
+ *  Walks the list exactly the same way and produces the same object tree:
+ *
+ *    - each frame starts with the self-describe tag 55799 (D9 D9 F7) so hosts can
+ *      tell binary frames from the JSON text exception reports still sent as text
+ *    - objects are indefinite-length maps (BF ... FF), arrays indefinite-length arrays
+ *    - floats are sent as IEEE single precision after convert_outgoing_float(),
+ *      so there is no floattoa() and no rounding - hosts apply the precision
+ *    - booleans carry the same sense json_serialize() prints
+ *    - TYPE_DATA is sent as an unsigned integer rather than a "0x..." string
+ *
+ *  If index_keys is true nested leaf objects are keyed by their cfgArray index
+ *  instead of their token. This is only used for status reports, whose keys are announced
+ *  once in an "srk" map (see report.cpp). Everything else is keyed by token.
+ *
+ *  Returns the frame length, or -1 if it did not fit in size bytes.
+ */
+
+#define CBOR_MAJOR_UINT     0x00
+#define CBOR_MAJOR_NEGINT   0x20
+#define CBOR_MAJOR_TEXT     0x60
+#define CBOR_MAP_START      0xBF        // indefinite length map
+#define CBOR_ARRAY_START    0x9F        // indefinite length array
+#define CBOR_BREAK          0xFF
+#define CBOR_FALSE          0xF4
+#define CBOR_TRUE           0xF5
+#define CBOR_NULL           0xF6
+#define CBOR_FLOAT32        0xFA
+
+static bool _cbor_put_byte(char *&str, const char *str_max, const uint8_t b)
+{
+    if (str >= str_max) {
+        return (false);
+    }
+    *str++ = (char)b;
+    return (true);
+}
+
+static bool _cbor_put_head(char *&str, const char *str_max, const uint8_t major, const uint32_t value)
+{
+    uint8_t bytes;
+    if (value < 24) {
+        return (_cbor_put_byte(str, str_max, major | value));
+    } else if (value <= 0xFF) {
+        bytes = 1;
+    } else if (value <= 0xFFFF) {
+        bytes = 2;
+    } else {
+        bytes = 4;
+    }
+    if ((str + bytes + 1) > str_max) {
+        return (false);
+    }
+    *str++ = (char)(major | ((bytes == 1) ? 24 : ((bytes == 2) ? 25 : 26)));
+    while (bytes--) {
+        *str++ = (char)(value >> (bytes * 8));      // big-endian
+    }
+    return (true);
+}
+
+static bool _cbor_put_integer(char *&str, const char *str_max, const int32_t n)
+{
+    if (n < 0) {
+        return (_cbor_put_head(str, str_max, CBOR_MAJOR_NEGINT, (uint32_t)(-1 - n)));
+    }
+    return (_cbor_put_head(str, str_max, CBOR_MAJOR_UINT, (uint32_t)n));
+}
+
+static bool _cbor_put_float(char *&str, const char *str_max, const float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    if ((str + 5) > str_max) {
+        return (false);
+    }
+    *str++ = (char)CBOR_FLOAT32;
+    for (int8_t shift = 24; shift >= 0; shift -= 8) {
+        *str++ = (char)(bits >> shift);
+    }
+    return (true);
+}
+
+static bool _cbor_put_text(char *&str, const char *str_max, const char *text)
+{
+    uint16_t length = strlen(text);
+    if (!_cbor_put_head(str, str_max, CBOR_MAJOR_TEXT, length) || ((str + length) > str_max)) {
+        return (false);
+    }
+    memcpy(str, text, length);
+    str += length;
+    return (true);
+}
+
+static bool _cbor_put_array(char *&str, const char *str_max, const char *elements)
+{
+    // arrays are carried as comma separated numbers (e.g. the footer "1,0,12")
+    bool ok = _cbor_put_byte(str, str_max, CBOR_ARRAY_START);
+    char *end;
+    while (ok && (*elements != NUL)) {
+        int32_t n = strtol(elements, &end, 10);
+        if (*end == '.') {
+            ok &= _cbor_put_float(str, str_max, strtof(elements, &end));
+        } else {
+            ok &= _cbor_put_integer(str, str_max, n);
+        }
+        if (end == elements) {                      // not a number - give up on the rest
+            break;
+        }
+        elements = (*end == ',') ? end+1 : end;
+    }
+    return (ok && _cbor_put_byte(str, str_max, CBOR_BREAK));
+}
+
+int16_t cbor_serialize(nvObj_t *nv, char *out_buf, uint16_t size, const bool index_keys)
+{
+    char *str = out_buf;
+    const char *str_max = out_buf + size;
+    int8_t initial_depth = nv->depth;
+    int8_t prev_depth = 0;
+    bool ok = _cbor_put_byte(str, str_max, 0xD9) &&  // self-describe tag 55799
+              _cbor_put_byte(str, str_max, 0xD9) &&
+              _cbor_put_byte(str, str_max, 0xF7) &&
+              _cbor_put_byte(str, str_max, CBOR_MAP_START);
+
+    while (ok) {
+        if (nv->valuetype != TYPE_EMPTY) {
+            if (index_keys && (nv->depth > initial_depth) && (nv->valuetype != TYPE_PARENT) &&
+                (nv->index < nv_index_max())) {
+                ok &= _cbor_put_integer(str, str_max, nv->index);
+            } else {
+                ok &= _cbor_put_text(str, str_max, nv->token);
+            }
+
+            switch (nv->valuetype)  {
+                case (TYPE_NULL):   { ok &= _cbor_put_byte(str, str_max, CBOR_NULL); break; }
+                case (TYPE_PARENT): { ok &= _cbor_put_byte(str, str_max, CBOR_MAP_START); break; }
+                case (TYPE_FLOAT):  { convert_outgoing_float(nv);
+                                      ok &= _cbor_put_float(str, str_max, nv->value_flt);
+                                      break;
+                                    }
+                case (TYPE_INTEGER):{ ok &= _cbor_put_integer(str, str_max, nv->value_int); break; }
+                case (TYPE_STRING): { ok &= _cbor_put_text(str, str_max, *nv->stringp); break; }
+                case (TYPE_BOOLEAN):{ ok &= _cbor_put_byte(str, str_max, (nv->value_int) ? CBOR_FALSE : CBOR_TRUE); break; }
+                case (TYPE_DATA):   { uint32_t *v = (uint32_t*)&nv->value_flt;
+                                      ok &= _cbor_put_head(str, str_max, CBOR_MAJOR_UINT, *v);
+                                      break;
+                                    }
+                case (TYPE_ARRAY):  { ok &= _cbor_put_array(str, str_max, *nv->stringp); break; }
+                default:            { ok &= _cbor_put_byte(str, str_max, CBOR_NULL); }
+            }
+        }
+        if ((nv = nv->nx) == NULL) { break;}    // end of the list
+
+        while (nv->depth < prev_depth--) {      // close the maps
+            ok &= _cbor_put_byte(str, str_max, CBOR_BREAK);
+        }
+        prev_depth = nv->depth;
+    }
+
+    while (prev_depth-- > initial_depth) {
+        ok &= _cbor_put_byte(str, str_max, CBOR_BREAK);
+    }
+    ok &= _cbor_put_byte(str, str_max, CBOR_BREAK);
+    return (ok ? (str - out_buf) : -1);
+}
+
+/*
+ * _json_write() - serialize the list in the selected encoding and send it
+ */
+static void _json_write(nvObj_t *nv, const bool index_keys, const bool only_to_muted)
+{
+    if ((js.json_encoding == JSON_ENCODING_CBOR) && (js.json_mode == JSON_MODE)) {
+        int16_t length = cbor_serialize(nv, cs.out_buf, sizeof(cs.out_buf), index_keys);
+        if (length > 0) {
+            xio_write(cs.out_buf, length, only_to_muted);
+        }
+        return;
+    }
+    if (json_serialize(nv, cs.out_buf, sizeof(cs.out_buf)) >= 0) {
+        xio_writeline(cs.out_buf, only_to_muted);
+    }
+}
+
 /*
  * json_print_object() - serialize and print the nvObj array directly (w/o header & footer)
  *
  *  Ignores JSON verbosity settings and everything else - just serializes the list & prints
  *  Useful for reports and other simple output.
  *  Object list should be terminated by nv->nx == NULL
+ *  Status reports ("sr" objects) are keyed by cfgArray index when sent as CBOR.
  */
 void json_print_object(nvObj_t *nv)
 {
-    json_serialize(nv, cs.out_buf, sizeof(cs.out_buf));
-    xio_writeline(cs.out_buf);
+    _json_write(nv, (strcmp(nv->token, "sr") == 0), false);
 }
 
 /*
@@ -555,7 +838,7 @@ void json_print_response(uint8_t status, const bool only_to_muted /*= false*/)
     nvObj_t *nv = nv_body;
     if (status == STAT_JSON_SYNTAX_ERROR) {
         nv_reset_nv_list();
-        nv_add_string((const char *)"err", escape_string(cs.bufp, cs.saved_buf));
+        nv_add_string((const char *)"err", escape_string(cs.out_buf, cs.saved_buf, sizeof(cs.out_buf)));  // out_buf is free until the response is serialized
 
     } else if ((cm->machine_state != MACHINE_INITIALIZING) || (status == STAT_INITIALIZING)) { // always do full echo during startup
         uint8_t nv_type;
@@ -617,9 +900,7 @@ void json_print_response(uint8_t status, const bool only_to_muted /*= false*/)
     nv->nx = NULL;                                          // terminate the list
 
     // serialize the JSON response and print it if there were no errors
-    if (json_serialize(nv_header, cs.out_buf, sizeof(cs.out_buf)) >= 0) {
-        xio_writeline(cs.out_buf, only_to_muted);
-    }
+    _json_write(nv_header, false, only_to_muted);
 }
 
 /***********************************************************************************
@@ -649,6 +930,21 @@ stat_t js_set_ej(nvObj_t *nv)
     return (STAT_OK);
 }
 
+/*
+ * js_get_jb() - get JSON output encoding
+ * js_set_jb() - set JSON output encoding (0=text, 1=CBOR)
+ *
+ *  Switching to CBOR makes the next status report announce its keys again.
+ */
+
+stat_t js_get_jb(nvObj_t *nv) { return(get_integer(nv, js.json_encoding)); }
+stat_t js_set_jb(nvObj_t *nv)
+{
+    ritorno (set_integer(nv, (uint8_t &)js.json_encoding, JSON_ENCODING_TEXT, JSON_ENCODING_MAX));
+    sr.keys_pending = true;
+    return (STAT_OK);
+}
+
 /*
  * js_get_jv() - get JSON verbosity
  * js_set_jv() - set JSON verbosity and related flags
@@ -711,17 +1007,20 @@ stat_t json_set_ej(nvObj_t *nv)
 
 /*
  * js_print_ej()
+ * js_print_jb()
  * js_print_jv()
  * js_print_js()
  * js_print_jf()
  */
 
 static const char fmt_ej[] = "[ej]  enable json mode%13d [0=text,1=JSON,2=auto]\n";
+static const char fmt_jb[] = "[jb]  json binary encoding%9d [0=text,1=CBOR]\n";
 static const char fmt_jv[] = "[jv]  json verbosity%15d [0=silent,1=footer,2=messages,3=configs,4=linenum,5=verbose]\n";
 static const char fmt_js[] = "[js]  json serialize style%9d [0=relaxed,1=strict]\n";
 static const char fmt_jf[] = "[jf]  json footer style%12d [1=checksum,2=window report]\n";
 
 void js_print_ej(nvObj_t *nv) { text_print(nv, fmt_ej);}    // TYPE_INT
+void js_print_jb(nvObj_t *nv) { text_print(nv, fmt_jb);}    // TYPE_INT
 void js_print_jv(nvObj_t *nv) { text_print(nv, fmt_jv);}    // TYPE_INT
 void js_print_js(nvObj_t *nv) { text_print(nv, fmt_js);}    // TYPE_INT
 void js_print_jf(nvObj_t *nv) { text_print(nv, fmt_jf);}    // TYPE_INT
@@ -54,6 +54,12 @@ typedef enum {
 } jsonVerbosity;
 #define JV_MAX_VALUE JV_STATUS_COUNT
 
+typedef enum {                      // json output encodings
+    JSON_ENCODING_TEXT = 0,         // [0] JSON text
+    JSON_ENCODING_CBOR              // [1] CBOR binary frames - see cbor_serialize()
+} jsonEncoding;
+#define JSON_ENCODING_MAX JSON_ENCODING_CBOR
+
 typedef enum {                      // json output print modes
     JSON_NO_PRINT = 0,              // don't print anything if you find yourself in JSON mode
     JSON_OBJECT_FORMAT,             // print just the body as a json object
@@ -66,6 +72,7 @@ typedef struct jsSingleton {
     /*** config values (PUBLIC) ***/
     commMode json_mode;             // 0=text mode, 1=JSON mode (loaded from cs.comm_mode)
     jsonVerbosity json_verbosity;   // see enum in this file for settings
+    jsonEncoding json_encoding;     // JSON text or CBOR binary output (JSON mode only)
     bool echo_json_footer;          // flags for JSON responses serialization
     bool echo_json_messages;
     bool echo_json_configs;
@@ -84,19 +91,23 @@ extern jsSingleton_t js;
 
 stat_t json_parser(char *str, bool suppress_response = false);
 void json_parse_for_exec(char *str, bool execute);
-uint16_t json_serialize(nvObj_t *nv, char *out_buf, uint16_t size);
+int16_t json_serialize(nvObj_t *nv, char *out_buf, uint16_t size);
+int16_t cbor_serialize(nvObj_t *nv, char *out_buf, uint16_t size, const bool index_keys);
 void json_print_object(nvObj_t *nv);
 void json_print_response(uint8_t status, const bool only_to_muted = false);
 void json_print_list(stat_t status, uint8_t flags);
 
 stat_t js_get_ej(nvObj_t *nv);
 stat_t js_set_ej(nvObj_t *nv);
+stat_t js_get_jb(nvObj_t *nv);
+stat_t js_set_jb(nvObj_t *nv);
 stat_t js_get_jv(nvObj_t *nv);
 stat_t js_set_jv(nvObj_t *nv);
 
 #ifdef __TEXT_MODE
 
     void js_print_ej(nvObj_t *nv);
+    void js_print_jb(nvObj_t *nv);
     void js_print_jv(nvObj_t *nv);
     void js_print_js(nvObj_t *nv);
     void js_print_jf(nvObj_t *nv);
@@ -104,6 +115,7 @@ stat_t js_set_jv(nvObj_t *nv);
 #else
 
     #define js_print_ej tx_print_stub
+    #define js_print_jb tx_print_stub
     #define js_print_jv tx_print_stub
     #define js_print_js tx_print_stub
     #define js_print_jf tx_print_stub
@@ -24,6 +24,7 @@
 #include "config.h"  // #2
 #include "hardware.h"
 #include "persistence.h"
+#include "file_store.h"
 #include "controller.h"
 #include "canonical_machine.h"
 #include "json_parser.h"			// required for unit tests only
@@ -99,6 +100,7 @@ void application_init_services(void)
     hardware_init();				    // system hardware setup 			- must be first
     persistence_init();				    // set up EEPROM or other NVM		- must be second
     xio_init();						    // xtended io subsystem				- must be third
+    file_store_init();                  // flash file store (after persistence_init())
 }
 
 void application_init_machine(void)
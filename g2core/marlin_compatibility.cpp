@@ -68,6 +68,7 @@ MarlinStateExtended_t mst;       // Marlin state object
 
 bool temperature_requested = false;
 bool position_requested = false;
+int32_t resend_requested_line = -1;     // line number of the outstanding "Resend:" request, or -1 if none
 
 // State machine to handle marlin temperature controls
 enum class MarlinSetTempState {
@@ -486,6 +487,23 @@ stat_t marlin_callback()
     return STAT_OK;
 }
 
+/***********************************************************************************
+ * _resend_already_requested() - true if a failed line is part of a run already covered by a resend request
+ *
+ *  Hosts that keep several lines in flight will follow a bad line with good lines that
+ *  then fail the sequence check. A resend from the first bad line covers all of them,
+ *  so only one "Resend:" is sent and the rest of the run is dropped without a response
+ *  (Marlin drops them by flushing its serial buffer). A line numbered at or before the
+ *  requested one is the host retrying, and is answered again.
+ */
+static bool _resend_already_requested(const char *buf)
+{
+    if ((resend_requested_line < 0) || (toupper(*buf) != 'N')) {
+        return (false);
+    }
+    return (strtol(buf+1, NULL, 10) > resend_requested_line);
+}
+
 /***********************************************************************************
  * marlin_response() - marlin mirror of text_response(), called from _dispatch_kernel() in controller.cpp
  */
@@ -500,6 +518,14 @@ void marlin_response(const stat_t status, char *buf)
         return;
     }
 
+    if ((status == STAT_CHECKSUM_MATCH_FAILED) || (status == STAT_LINE_NUMBER_OUT_OF_SEQUENCE)) {
+        if (_resend_already_requested(buf)) {
+            return;
+        }
+    } else {
+        resend_requested_line = -1;         // any other response ends the run of bad lines
+    }
+
     if ((status == STAT_OK) || (status == STAT_EAGAIN) || (status == STAT_NOOP)) {
         str_concat(str, "ok");
 
@@ -544,9 +570,10 @@ void marlin_response(const stat_t status, char *buf)
 
 
     if (request_resend) {
+        resend_requested_line = cm->gmx.last_line_number+1;
         str = buffer;
         str_concat(str, "Resend: ");
-        str += inttoa(str, cm->gmx.last_line_number+1);
+        str += inttoa(str, resend_requested_line);
         *str++ = '\n';
         *str++ = 0;
         xio_writeline(buffer);
@@ -28,7 +28,9 @@
 #include "persistence.h"
 #include "canonical_machine.h"
 #include "report.h"
-//#include "util.h"
+#include "hardware.h"
+#include "file_store.h"
+#include "util.h"
 
 /***********************************************************************************
  **** STRUCTURE ALLOCATIONS ********************************************************
@@ -39,26 +41,320 @@ nvmSingleton_t nvm;
 /***********************************************************************************
  **** GENERIC STATIC FUNCTIONS AND VARIABLES ***************************************
  ***********************************************************************************/
+/*
+ *  Log format
+ *
+ *    Each segment starts with an nvmHeader_t in record slot 0, followed by nvmRecord_t's
+ *    in the order they were written. Flash is only ever programmed from erased (1) to 0,
+ *    so an erased slot (index == 0xFFFF) marks the end of the log. Records are 12 bytes
+ *    and may straddle a page boundary - the driver splits the write.
+ *
+ *    The active segment is the one with a valid header and the highest sequence number.
+ *    Compaction erases the other segment, copies the latest record for each index into
+ *    it, and only then writes its header. A power loss during compaction leaves the old
+ *    segment active and intact. A torn record fails its CRC and is skipped on replay.
+ *
+ *  Boot replay
+ *
+ *    persistence_init() reads the active segment once, front to back, and records the
+ *    slot of the last good record for each index in nvm_slot[]. Reads then go straight
+ *    to that slot. Nothing is decoded until config_init() asks for it.
+ *
+ *  Write coalescing
+ *
+ *    Writes made while a machining cycle is running are held in nvm.pending[] (one entry
+ *    per index - a later write replaces an earlier one) and flushed by persistence_callback()
+ *    once the cycle ends. Values that have not changed are never written. Flash is never
+ *    programmed during a cycle: if pending[] is full a write for a new index is dropped -
+ *    the setting takes effect but is not persisted - and counted in nvm.dropped_writes.
+ */
+
+static uint16_t _nvm_crc(const uint8_t *data, uint8_t length)  // CRC-16/CCITT
+{
+    uint16_t crc = 0xFFFF;
+    while (length--) {
+        crc ^= (uint16_t)(*data++) << 8;
+        for (uint8_t bit=0; bit<8; bit++) {
+            crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+        }
+    }
+    return (crc);
+}
+
+static uint16_t _record_crc(const nvmRecord_t *r)
+{
+    return (_nvm_crc((const uint8_t *)&r->value_int, sizeof(nvmRecord_t) - 4) ^ r->index);
+}
+
+static uint16_t _header_crc(const nvmHeader_t *h)
+{
+    return (_nvm_crc((const uint8_t *)&h->sequence, sizeof(nvmHeader_t) - 4));
+}
+
+/*
+ * _nvm_signature() - FNV-1a over every token in cfgArray
+ *
+ *  Records are keyed by index, so any change to the table layout must invalidate the log.
+ */
+static uint32_t _nvm_signature()
+{
+    uint32_t hash = 2166136261UL;
+    for (index_t i=0; i < nv_index_max(); i++) {
+        for (const char *c = cfgArray[i].token; *c != NUL; c++) {
+            hash = (hash ^ (uint8_t)*c) * 16777619UL;
+        }
+        hash = (hash ^ ',') * 16777619UL;
+    }
+    return (hash);
+}
+
+static uint32_t _slot_offset(const uint8_t segment, const uint16_t slot)
+{
+    return ((uint32_t)segment * NVM_SEGMENT_SIZE + (uint32_t)slot * sizeof(nvmRecord_t));
+}
+
+static bool _read_header(const uint8_t segment, nvmHeader_t *h)
+{
+    nvm_flash_read(_slot_offset(segment, 0), h, sizeof(nvmHeader_t));
+    return ((h->magic == NVM_MAGIC) && (h->crc == _header_crc(h)) && (h->signature == nvm.signature));
+}
+
+static stat_t _erase_segment(const uint8_t segment)
+{
+    stat_t status_code;
+    for (uint16_t page=0; page < NVM_SEGMENT_PAGES; page++) {
+        ritorno(nvm_flash_erase(segment * NVM_SEGMENT_PAGES + page));
+    }
+    return (STAT_OK);
+}
+
+static stat_t _write_header(const uint8_t segment, const uint32_t sequence)
+{
+    nvmHeader_t h;
+    h.magic = NVM_MAGIC;
+    h.sequence = sequence;
+    h.signature = nvm.signature;
+    h.crc = _header_crc(&h);
+    return (nvm_flash_program(_slot_offset(segment, 0), &h, sizeof(h)));
+}
 
+static void _read_record(const uint16_t slot, nvmRecord_t *r)
+{
+    nvm_flash_read(_slot_offset(nvm.segment, slot), r, sizeof(nvmRecord_t));
+}
+
+/*
+ * _disable() - stop using NVM after a flash failure, and report it once
+ *
+ *  Settings still take effect, they just aren't persisted. Nothing is retried - a page
+ *  that fails would otherwise be erased and programmed again on every write and on every
+ *  pass of persistence_callback().
+ */
+static stat_t _disable(const char *msg)
+{
+    nvm.enabled = false;
+    nvm.pending_count = 0;
+    return (rpt_exception(STAT_PERSISTENCE_ERROR, msg));
+}
+
+/*
+ * _compact() - copy the latest value of each index to the other segment and switch to it
+ */
+static stat_t _compact()
+{
+    stat_t status_code;
+    uint8_t target = (nvm.segment + 1) % NVM_SEGMENTS;
+    uint16_t slot = 1;
+    nvmRecord_t r;
+
+    ritorno(_erase_segment(target));
+    for (index_t i=0; i < nv_index_max(); i++) {
+        if (nvm_slot[i] == NVM_NO_SLOT) {
+            continue;
+        }
+        _read_record(nvm_slot[i], &r);
+        ritorno(nvm_flash_program(_slot_offset(target, slot++), &r, sizeof(r)));
+        nvm.records_copied++;
+    }
+    ritorno(_write_header(target, nvm.sequence + 1));   // header goes last - see Log format
+
+    // nvm_slot[] still points into the old segment until here, so a failure above leaves it
+    // consistent. The copy was made in index order, so the new slots follow the same order.
+    slot = 1;
+    for (index_t i=0; i < nv_index_max(); i++) {
+        if (nvm_slot[i] != NVM_NO_SLOT) {
+            nvm_slot[i] = slot++;
+        }
+    }
+    nvm.segment = target;
+    nvm.sequence++;
+    nvm.next_slot = slot;
+    nvm.compactions++;
+    return (STAT_OK);
+}
+
+/*
+ * _append() - write a record to the end of the log, compacting first if it is full
+ */
+static stat_t _append(const index_t index, const int32_t value_int, const float value_flt)
+{
+    nvmRecord_t r;
+
+    if (nvm.next_slot >= NVM_SLOTS) {
+        if (_compact() != STAT_OK) {
+            return (_disable("NVM disabled - compaction failed"));
+        }
+        if (nvm.next_slot >= NVM_SLOTS) {               // every slot is live - nothing can be done
+            return (_disable("NVM disabled - log is full"));
+        }
+    }
+    r.index = index;
+    r.value_int = value_int;
+    r.value_flt = value_flt;
+    r.crc = _record_crc(&r);
+    if (nvm_flash_program(_slot_offset(nvm.segment, nvm.next_slot), &r, sizeof(r)) != STAT_OK) {
+        return (_disable("NVM disabled - flash program failed"));
+    }
+    nvm_slot[index] = nvm.next_slot++;
+    nvm.records_written++;
+    return (STAT_OK);
+}
+
+static nvmPending_t *_find_pending(const index_t index)
+{
+    for (uint8_t i=0; i < nvm.pending_count; i++) {
+        if (nvm.pending[i].index == index) {
+            return (&nvm.pending[i]);
+        }
+    }
+    return (NULL);
+}
+
+static stat_t _flush_pending()
+{
+    stat_t status_code;
+    while (nvm.pending_count > 0) {
+        nvmPending_t *p = &nvm.pending[nvm.pending_count-1];
+        ritorno(_append(p->index, p->value_int, p->value_flt));  // a failure disables NVM and empties pending[]
+        nvm.pending_count--;
+    }
+    return (STAT_OK);
+}
 
 /***********************************************************************************
  **** CODE *************************************************************************
  ***********************************************************************************/
 
+/*
+ * persistence_init() - find the active segment and replay it into nvm_slot[]
+ */
+
 void persistence_init()
 {
-    return;
+    nvmHeader_t h[NVM_SEGMENTS];
+    bool valid[NVM_SEGMENTS];
+    nvmRecord_t r;
+
+    memset(&nvm, 0, sizeof(nvm));
+    for (index_t i=0; i < nv_index_max(); i++) {
+        nvm_slot[i] = NVM_NO_SLOT;
+    }
+    if (nvm_flash_init() != STAT_OK) {
+        return;                                         // no NVM - run on defaults
+    }
+    nvm.signature = _nvm_signature();
+    nvm.enabled = true;
+
+    // the active segment is the valid one with the highest sequence number
+    bool found = false;
+    for (uint8_t s=0; s < NVM_SEGMENTS; s++) {
+        valid[s] = _read_header(s, &h[s]);
+        if (valid[s] && (!found || (h[s].sequence > nvm.sequence))) {
+            nvm.segment = s;
+            nvm.sequence = h[s].sequence;
+            found = true;
+        }
+    }
+    if (!found) {                                       // blank, corrupt or from another table
+        persistence_reset();
+        return;
+    }
+
+    // one pass over the log - later records supersede earlier ones
+    for (nvm.next_slot = 1; nvm.next_slot < NVM_SLOTS; nvm.next_slot++) {
+        _read_record(nvm.next_slot, &r);
+        if (r.index == NVM_ERASED_INDEX) {
+            if ((r.crc == 0xFFFF) && (r.value_int == -1)) {
+                break;                                  // end of the log
+            }
+            nvm.bad_records++;                          // torn write
+            continue;
+        }
+        if ((r.index >= nv_index_max()) || (r.crc != _record_crc(&r))) {
+            nvm.bad_records++;
+            continue;
+        }
+        nvm_slot[r.index] = nvm.next_slot;
+    }
+}
+
+/*
+ * persistence_reset() - discard every persisted value and start an empty log
+ *
+ *  Used on first boot, when the cfgArray layout changes, and by $defa.
+ */
+
+void persistence_reset()
+{
+    if (!nvm.enabled) {
+        return;
+    }
+    for (index_t i=0; i < nv_index_max(); i++) {
+        nvm_slot[i] = NVM_NO_SLOT;
+    }
+    nvm.pending_count = 0;
+    nvm.segment = (nvm.segment + 1) % NVM_SEGMENTS;     // use the other segment - spreads the wear
+    nvm.sequence++;
+    nvm.next_slot = 1;
+    if ((_erase_segment(nvm.segment) != STAT_OK) || (_write_header(nvm.segment, nvm.sequence) != STAT_OK)) {
+        _disable("persistence_reset() could not initialize NVM");
+    }
+}
+
+/*
+ * persistence_callback() - write coalesced values once the machining cycle is over
+ */
+
+stat_t persistence_callback()
+{
+    if ((nvm.pending_count == 0) || (cm->cycle_type != CYCLE_NONE)) {
+        return (STAT_NOOP);
+    }
+    return (_flush_pending());
 }
 
 /*
- * read_persistent_value()	- return value (as float) by index
+ * read_persistent_value()	- return the persisted value by index
  *
+ *	Returns STAT_NOOP and leaves nv untouched if nothing has been persisted for the index.
  *	It's the responsibility of the caller to make sure the index does not exceed range
  */
 
 stat_t read_persistent_value(nvObj_t *nv)
 {
-    nv->value_flt = 0;
+    nvmPending_t *p = _find_pending(nv->index);
+    if (p != NULL) {
+        nv->value_int = p->value_int;
+        nv->value_flt = p->value_flt;
+        return (STAT_OK);
+    }
+    if ((!nvm.enabled) || (nvm_slot[nv->index] == NVM_NO_SLOT)) {
+        return (STAT_NOOP);
+    }
+    nvmRecord_t r;
+    _read_record(nvm_slot[nv->index], &r);
+    nv->value_int = r.value_int;
+    nv->value_flt = r.value_flt;
     return (STAT_OK);
 }
 
@@ -67,12 +363,206 @@ stat_t read_persistent_value(nvObj_t *nv)
  *
  *	It's the responsibility of the caller to make sure the index does not exceed range
  *	Note: Removed NAN and INF checks on floats - not needed
+ *	Writes made during a machining cycle are held and coalesced - see persistence_callback()
  */
 
 stat_t write_persistent_value(nvObj_t *nv)
 {
-//    if (cm->cycle_state != CYCLE_OFF) { // can't write when machine is moving
-//        return(rpt_exception(STAT_FILE_NOT_OPEN, "write_persistent_value() can't write when machine is in cycle"));
-//    }
+    if (!nvm.enabled) {
+        return (STAT_OK);
+    }
+    nvObj_t current;
+    current.index = nv->index;
+    if ((read_persistent_value(&current) == STAT_OK) &&
+        (current.value_int == nv->value_int) &&
+        (memcmp(&current.value_flt, &nv->value_flt, sizeof(float)) == 0)) {
+        return (STAT_OK);                               // unchanged
+    }
+    if (cm->cycle_type != CYCLE_NONE) {                 // never program flash while machining
+        nvmPending_t *p = _find_pending(nv->index);
+        if ((p == NULL) && (nvm.pending_count < NVM_PENDING_MAX)) {
+            p = &nvm.pending[nvm.pending_count++];
+        }
+        if (p == NULL) {
+            nvm.dropped_writes++;                       // the value still applies, it just isn't saved
+            return (rpt_exception(STAT_PERSISTENCE_ERROR, "setting not persisted - too many changes during cycle"));
+        }
+        p->index = nv->index;
+        p->value_int = nv->value_int;
+        p->value_flt = nv->value_flt;
+        return (STAT_OK);
+    }
+    return (_append(nv->index, nv->value_int, nv->value_flt));
+}
+
+/***********************************************************************************
+ **** FLASH PAGE DRIVERS ***********************************************************
+ ***********************************************************************************/
+/*
+ *  nvm_flash_init()    - prepare the NVM region. Returns an error if there is none.
+ *  nvm_flash_read()    - read bytes at an offset into the NVM region
+ *  nvm_flash_program() - program bytes; may only change bits from 1 to 0 (NOR semantics)
+ *  nvm_flash_erase()   - erase one page (all bits to 1)
+ *
+ *  Offsets are relative to the start of the NVM region. Programs are word aligned and a
+ *  multiple of 4 bytes long, but may cross a page boundary.
+ */
+
+#if defined(__SAM3X8E__) || defined(__SAM3X8C__)
+
+/*
+ *  SAM3X: the NVM region is the top NVM_SIZE bytes of flash bank 1. The firmware runs
+ *  from bank 0, so it keeps executing while bank 1 is programmed. The EEFC has no plain
+ *  page erase - erasing is "erase and write page" with an all-ones latch buffer.
+ */
+
+#define NVM_FLASH_BASE  (IFLASH1_ADDR + IFLASH1_SIZE - NVM_SIZE)
+#define NVM_FLASH_PAGE0 ((NVM_FLASH_BASE - IFLASH1_ADDR) / IFLASH1_PAGE_SIZE)
+#define EEFC_CMD_WP     0x01            // write page
+#define EEFC_CMD_EWP    0x03            // erase page and write page
+
+/*
+ *  Nothing in the linker script reserves the NVM log or the file store below it (see
+ *  file_store.cpp), so an image that grew into them would be overwritten by the first
+ *  write. Both drivers refuse to start unless the image - code, then the initial values
+ *  of initialized data, which the linker places at _etext - ends below their region.
+ */
+
+extern uint32_t _etext, _srelocate, _erelocate;     // from the linker script
+
+bool nvm_flash_image_below(const uint32_t address)
+{
+    uint32_t image_end = (uint32_t)&_etext + ((uint32_t)&_erelocate - (uint32_t)&_srelocate);
+    return (image_end <= address);
+}
+
+static stat_t _eefc_command(const uint32_t command, const uint16_t page)
+{
+    uint32_t status;
+    EFC1->EEFC_FCR = EEFC_FCR_FKEY(0x5A) | EEFC_FCR_FARG(NVM_FLASH_PAGE0 + page) | EEFC_FCR_FCMD(command);
+    while (!((status = EFC1->EEFC_FSR) & EEFC_FSR_FRDY));
+    return ((status & (EEFC_FSR_FCMDE | EEFC_FSR_FLOCKE)) ? STAT_PERSISTENCE_ERROR : STAT_OK);
+}
+
+stat_t nvm_flash_init()
+{
+    if (!nvm_flash_image_below(NVM_FLASH_BASE - FS_SIZE)) {   // the file store's pages too
+        return (rpt_exception(STAT_PERSISTENCE_ERROR, "firmware image overlaps NVM - settings will not be persisted"));
+    }
+    return (STAT_OK);
+}
+
+void nvm_flash_read(uint32_t offset, void *dst, uint16_t length)
+{
+    memcpy(dst, (const void *)(NVM_FLASH_BASE + offset), length);
+}
+
+stat_t nvm_flash_program(uint32_t offset, const void *src, uint16_t length)
+{
+    stat_t status_code;
+    const uint8_t *s = (const uint8_t *)src;
+    while (length > 0) {
+        uint16_t page = offset / NVM_PAGE_SIZE;
+        uint16_t chunk = min((uint32_t)length, ((uint32_t)page + 1) * NVM_PAGE_SIZE - offset);
+        volatile uint32_t *latch = (volatile uint32_t *)(NVM_FLASH_BASE + offset);
+        for (uint16_t i=0; i < chunk; i += 4) { // untouched latch words stay all-ones
+            uint32_t word;
+            memcpy(&word, s + i, 4);
+            *latch++ = word;
+        }
+        ritorno(_eefc_command(EEFC_CMD_WP, page));
+        offset += chunk;
+        s += chunk;
+        length -= chunk;
+    }
+    return (STAT_OK);
+}
+
+stat_t nvm_flash_erase(uint16_t page)
+{
+    volatile uint32_t *latch = (volatile uint32_t *)(NVM_FLASH_BASE + (uint32_t)page * NVM_PAGE_SIZE);
+    for (uint16_t i=0; i < NVM_PAGE_SIZE; i += 4) {
+        *latch++ = 0xFFFFFFFF;
+    }
+    return (_eefc_command(EEFC_CMD_EWP, page));
+}
+
+#elif defined(__NVM_FILE)
+
+/*
+ *  File-backed flash emulator for host builds. Keeps flash semantics - programming can
+ *  only clear bits, erasing sets a whole page - so the log behaves as it does on a chip.
+ *  Define __NVM_FILE as the file name, e.g. -D__NVM_FILE=\"g2core_nvm.bin\"
+ */
+
+#include <stdio.h>
+
+static FILE *nvm_file;
+
+stat_t nvm_flash_init()
+{
+    if ((nvm_file = fopen(__NVM_FILE, "r+b")) == NULL) {
+        if ((nvm_file = fopen(__NVM_FILE, "w+b")) == NULL) {
+            return (STAT_PERSISTENCE_ERROR);
+        }
+        for (uint16_t page=0; page < (NVM_SIZE / NVM_PAGE_SIZE); page++) {
+            if (nvm_flash_erase(page) != STAT_OK) {
+                return (STAT_PERSISTENCE_ERROR);
+            }
+        }
+    }
     return (STAT_OK);
 }
+
+void nvm_flash_read(uint32_t offset, void *dst, uint16_t length)
+{
+    fseek(nvm_file, offset, SEEK_SET);
+    if (fread(dst, 1, length, nvm_file) != length) {
+        memset(dst, 0xFF, length);
+    }
+}
+
+stat_t nvm_flash_program(uint32_t offset, const void *src, uint16_t length)
+{
+    uint8_t cells[sizeof(nvmRecord_t)];
+    const uint8_t *s = (const uint8_t *)src;
+    while (length > 0) {
+        uint16_t chunk = min(length, (uint16_t)sizeof(cells));
+        nvm_flash_read(offset, cells, chunk);
+        for (uint16_t i=0; i < chunk; i++) {
+            cells[i] &= s[i];                   // NOR flash can only clear bits
+        }
+        fseek(nvm_file, offset, SEEK_SET);
+        if (fwrite(cells, 1, chunk, nvm_file) != chunk) {
+            return (STAT_PERSISTENCE_ERROR);
+        }
+        offset += chunk;
+        s += chunk;
+        length -= chunk;
+    }
+    return ((fflush(nvm_file) == 0) ? STAT_OK : STAT_PERSISTENCE_ERROR);
+}
+
+stat_t nvm_flash_erase(uint16_t page)
+{
+    uint8_t cells[NVM_PAGE_SIZE];
+    memset(cells, 0xFF, sizeof(cells));
+    fseek(nvm_file, (uint32_t)page * NVM_PAGE_SIZE, SEEK_SET);
+    if (fwrite(cells, 1, sizeof(cells), nvm_file) != sizeof(cells)) {
+        return (STAT_PERSISTENCE_ERROR);
+    }
+    return ((fflush(nvm_file) == 0) ? STAT_OK : STAT_PERSISTENCE_ERROR);
+}
+
+#else
+
+/*
+ *  No NVM driver for this chip - settings come from the profile on every boot.
+ */
+
+stat_t nvm_flash_init() { return (STAT_PERSISTENCE_ERROR); }
+void nvm_flash_read(uint32_t offset, void *dst, uint16_t length) { memset(dst, 0xFF, length); }
+stat_t nvm_flash_program(uint32_t offset, const void *src, uint16_t length) { return (STAT_PERSISTENCE_ERROR); }
+stat_t nvm_flash_erase(uint16_t page) { return (STAT_PERSISTENCE_ERROR); }
+
+#endif
@@ -30,23 +30,81 @@
 
 #include "config.h"  // needed for nvObj_t definition
 
-#define NVM_VALUE_LEN 4       // NVM value length (float, fixed length)
-#define NVM_BASE_ADDR 0x0000  // base address of usable NVM
+/**** NVM record log ****
+ *
+ *  Settings are kept in an append-only log of CRC-checked records keyed by cfgArray index.
+ *  The NVM region is split into two segments of flash pages. One segment is active and
+ *  takes appends; when it fills, the latest value of every index is copied into the other
+ *  segment, which then becomes active. Segments alternate, so all pages wear evenly.
+ *  See persistence.cpp for the details and the flash drivers.
+ */
+
+#define NVM_PAGE_SIZE       256                 // flash page size in bytes
+#define NVM_SEGMENT_PAGES   64                  // pages per segment (16 KB)
+#define NVM_SEGMENTS        2                   // segments alternate on compaction
+#define NVM_SEGMENT_SIZE    (NVM_PAGE_SIZE * NVM_SEGMENT_PAGES)
+#define NVM_SIZE            (NVM_SEGMENT_SIZE * NVM_SEGMENTS)
+#define NVM_SLOTS           (NVM_SEGMENT_SIZE / sizeof(nvmRecord_t)) // record slots per segment (0 is the header)
+#define NVM_PENDING_MAX     16                  // writes coalesced while a machining cycle is running
+#define NVM_NO_SLOT         0xFFFF              // index has no record - use the default
+#define NVM_ERASED_INDEX    0xFFFF              // index field of an erased record slot
+#define NVM_MAGIC           0x4732              // segment header magic number ("G2")
+
+typedef struct nvmRecord {          // one setting - 12 bytes, word aligned
+    uint16_t index;                 // cfgArray index
+    uint16_t crc;                   // CRC-16 over index and values
+    int32_t value_int;              // nvObj values as they were persisted - both are
+    float value_flt;                //...kept as the table type doesn't say which one is used
+} nvmRecord_t;
+
+typedef struct nvmHeader {          // segment header - occupies record slot 0
+    uint16_t magic;                 // NVM_MAGIC
+    uint16_t crc;                   // CRC-16 over sequence and signature
+    uint32_t sequence;              // incremented on every compaction - highest wins
+    uint32_t signature;             // cfgArray signature - a changed table invalidates the log
+} nvmHeader_t;
+
+typedef struct nvmPending {         // a write held back during a machining cycle
+    index_t index;
+    int32_t value_int;
+    float value_flt;
+} nvmPending_t;
 
 //**** persistence singleton ****
 
 typedef struct nvmSingleton {
-    uint16_t base_addr;     // NVM base address
-    uint16_t profile_base;  // NVM base address of current profile]
-    uint16_t address;
-    float    tmp_value;
-    int8_t   byte_array[NVM_VALUE_LEN];
+    bool enabled;                   // false if the board has no NVM driver or the flash failed
+    uint8_t segment;                // active segment
+    uint32_t sequence;              // sequence number of the active segment
+    uint32_t signature;             // cfgArray signature for this firmware
+    uint16_t next_slot;             // next free record slot in the active segment
+    uint8_t pending_count;
+    nvmPending_t pending[NVM_PENDING_MAX];
+
+    // statistics - to measure write amplification
+    uint32_t records_written;       // records requested by nv_persist() and written
+    uint32_t records_copied;        // records rewritten by compaction
+    uint32_t bad_records;           // records skipped on replay (CRC failures)
+    uint32_t dropped_writes;        // writes lost to a full pending[] during a cycle
+    uint16_t compactions;
 } nvmSingleton_t;
 
+extern nvmSingleton_t nvm;
+extern uint16_t nvm_slot[];         // latest record slot for each cfgArray index (see config_app.cpp)
+
 //**** persistence function prototypes ****
 
 void persistence_init(void);
+void persistence_reset(void);
+stat_t persistence_callback(void);
 stat_t read_persistent_value(nvObj_t* nv);
 stat_t write_persistent_value(nvObj_t* nv);
 
+// flash page driver - see persistence.cpp
+stat_t nvm_flash_init(void);
+void nvm_flash_read(uint32_t offset, void *dst, uint16_t length);
+stat_t nvm_flash_program(uint32_t offset, const void *src, uint16_t length);
+stat_t nvm_flash_erase(uint16_t page);
+bool nvm_flash_image_below(const uint32_t address);    // SAM3X - true if the firmware image ends below address
+
 #endif  // End of include guard: PERSISTENCE_H_ONCE
@@ -29,6 +29,7 @@
 static stat_t _compute_arc(const bool radius_f);
 static void _compute_arc_offsets_from_radius(void);
 static float _estimate_arc_time (float arc_time);
+static float _get_arc_segment_length(const float arc_time);
 static stat_t _test_arc_soft_limits(void);
 
 /*****************************************************************************
@@ -65,6 +66,12 @@ void cm_abort_arc(cmMachine_t *_cm)
  *
  *  cm_arc_cycle_callback() is called from the controller main loop. Each time it's called
  *  it queues as many arc segments (lines) as it can before it blocks, then returns.
+ *
+ *  Segment endpoints come from rotating the center-to-point vector by segment_theta, which
+ *  is 4 multiplies and 2 adds instead of a sin() and a cos(). The float rounding in the
+ *  rotation drifts the radius by about an ulp per segment, so every ARC_CORRECTION_SEGMENTS
+ *  segments, and on the last one, the vector is recomputed exactly from the start angle.
+ *  That keeps the radial error well under a micron for any radius the machine can cut.
  */
 
 stat_t cm_arc_callback(cmMachine_t *_cm)
@@ -75,9 +82,19 @@ stat_t cm_arc_callback(cmMachine_t *_cm)
     if (mp_planner_is_full(mp)) {
         return (STAT_EAGAIN);
     }
-    _cm->arc.theta += _cm->arc.segment_theta;
-    _cm->arc.gm.target[_cm->arc.plane_axis_0] = _cm->arc.center_0 + sin(_cm->arc.theta) * _cm->arc.radius;
-    _cm->arc.gm.target[_cm->arc.plane_axis_1] = _cm->arc.center_1 + cos(_cm->arc.theta) * _cm->arc.radius;
+    if ((--(_cm->arc.correction_count) == 0) || (_cm->arc.segment_count == 1)) {
+        float theta = _cm->arc.theta +
+                      _cm->arc.segment_theta * (_cm->arc.segments - _cm->arc.segment_count + 1);
+        _cm->arc.radius_0 = sin(theta) * _cm->arc.radius;
+        _cm->arc.radius_1 = cos(theta) * _cm->arc.radius;
+        _cm->arc.correction_count = ARC_CORRECTION_SEGMENTS;
+    } else {
+        float radius_0 = _cm->arc.radius_0;
+        _cm->arc.radius_0 = radius_0 * _cm->arc.segment_cos + _cm->arc.radius_1 * _cm->arc.segment_sin;
+        _cm->arc.radius_1 = _cm->arc.radius_1 * _cm->arc.segment_cos - radius_0 * _cm->arc.segment_sin;
+    }
+    _cm->arc.gm.target[_cm->arc.plane_axis_0] = _cm->arc.center_0 + _cm->arc.radius_0;
+    _cm->arc.gm.target[_cm->arc.plane_axis_1] = _cm->arc.center_1 + _cm->arc.radius_1;
     _cm->arc.gm.target[_cm->arc.linear_axis] += _cm->arc.segment_linear_travel;
 
     mp_aline(&(_cm->arc.gm));                            // run the line
@@ -93,8 +110,9 @@ stat_t cm_arc_callback(cmMachine_t *_cm)
 /*
  * cm_arc_feed() - canonical machine entry point for arcs
  *
- * Generates an arc by queuing line segments to the move buffer. The arc is
- * approximated by generating a large number of tiny, linear segments.
+ * Queues the arc to the planner as a single arc block (see mp_arc()). If arc blocks are
+ * disabled ($ab=0), or the active transform would distort the arc, the arc is instead
+ * approximated by queuing a large number of tiny, linear segments from cm_arc_callback().
  */
 
 stat_t cm_arc_feed(const float target[], const bool target_f[],     // target endpoint
@@ -251,6 +269,22 @@ stat_t cm_arc_feed(const float target[], const bool target_f[],     // target en
     }
 
     cm_cycle_start();                                       // if not already started
+    if (cm->arc_block_enable) {
+        status = mp_arc(&cm->arc);                          // queue the arc as one planner block...
+        if (status != STAT_NOOP) {
+            cm_update_model_position();
+            if (status == STAT_MINIMUM_LENGTH_MOVE) {       // same as cm_straight_feed()
+                if (!mp_has_runnable_buffer(mp)) {
+                    cm_cycle_end();
+                }
+                status = STAT_OK;
+            }
+            return (status);
+        }
+    }
+    if (cm->arc.gm.feed_rate_mode == INVERSE_TIME_MODE) {  //...or as segments
+        cm->arc.gm.feed_rate /= cm->arc.segments;
+    }
     cm->arc.run_state = BLOCK_ACTIVE;                       // enable arc to be run from the callback
     cm_update_model_position();
     return (STAT_OK);
@@ -304,6 +338,13 @@ static stat_t _compute_arc(const bool radius_f)
         return (STAT_ARC_HAS_IMPOSSIBLE_CENTER_POINT);
     }
 
+    // A radius arc too short to reach the target was given the closest real center (see
+    // _compute_arc_offsets_from_radius()). From here on use the radius to that center, so
+    // the segments and arc blocks both start on the current position.
+    if (radius_f) {
+        cm->arc.radius = hypotf(-cm->arc.ijk_offset[cm->arc.plane_axis_0], -cm->arc.ijk_offset[cm->arc.plane_axis_1]);
+    }
+
     // Compute the angular travel
     // Calculate the theta angle of the current position (theta is also needed for calculating center point)
     // Note: gcc atan2 reverses args, i.e.: atan2(Y,X)
@@ -340,23 +381,22 @@ static stat_t _compute_arc(const bool radius_f)
     cm->arc.planar_travel = cm->arc.angular_travel * cm->arc.radius;
     cm->arc.length = hypotf(cm->arc.planar_travel, fabs(cm->arc.linear_travel));
 
-    // Find the minimum number of segments that meet accuracy and time constraints...
-    // Note: removed segment_length test as segment_time accounts for this (build 083.37)
-    float arc_time;
-    float segments_for_minimum_time = _estimate_arc_time(arc_time) * (MICROSECONDS_PER_MINUTE / MIN_ARC_SEGMENT_USEC);
-    float segments_for_chordal_accuracy = cm->arc.length / sqrt(4*cm->chordal_tolerance * (2 * cm->arc.radius - cm->chordal_tolerance));
-    cm->arc.segments = floor(min(segments_for_chordal_accuracy, segments_for_minimum_time));
+    // Find the number of segments that meet accuracy without throttling the planner...
+    float arc_time = _estimate_arc_time(0);
+    cm->arc.segments = floor(cm->arc.length / _get_arc_segment_length(arc_time));
     cm->arc.segments = max(cm->arc.segments, (float)1.0);        //...but is at least 1 segment
 
-    if (cm->arc.gm.feed_rate_mode == INVERSE_TIME_MODE) {
-        cm->arc.gm.feed_rate /= cm->arc.segments;
-    }
     // setup the rest of the arc parameters
     cm->arc.segment_count = (int32_t)cm->arc.segments;
     cm->arc.segment_theta = cm->arc.angular_travel / cm->arc.segments;
     cm->arc.segment_linear_travel = cm->arc.linear_travel / cm->arc.segments;
-    cm->arc.center_0 = cm->arc.position[cm->arc.plane_axis_0] - sin(cm->arc.theta) * cm->arc.radius;
-    cm->arc.center_1 = cm->arc.position[cm->arc.plane_axis_1] - cos(cm->arc.theta) * cm->arc.radius;
+    cm->arc.radius_0 = -cm->arc.ijk_offset[cm->arc.plane_axis_0];  // sin(theta) * radius, without the trig
+    cm->arc.radius_1 = -cm->arc.ijk_offset[cm->arc.plane_axis_1];  // cos(theta) * radius
+    cm->arc.center_0 = cm->arc.position[cm->arc.plane_axis_0] - cm->arc.radius_0;
+    cm->arc.center_1 = cm->arc.position[cm->arc.plane_axis_1] - cm->arc.radius_1;
+    cm->arc.segment_sin = sin(cm->arc.segment_theta);
+    cm->arc.segment_cos = cos(cm->arc.segment_theta);
+    cm->arc.correction_count = ARC_CORRECTION_SEGMENTS;
     cm->arc.gm.target[cm->arc.linear_axis] = cm->arc.position[cm->arc.linear_axis];    // initialize the linear target
     return (STAT_OK);
 }
@@ -505,6 +545,49 @@ static float _estimate_arc_time (float arc_time)
     return (arc_time);
 }
 
+/*
+ * _get_arc_segment_length() - length of the lines an arc is cut into
+ *
+ *  Segments are as long as chordal accuracy allows, then adjusted for the velocity they
+ *  will actually run at and what the planner can take:
+ *
+ *  - Each junction between segments turns by segment_length/radius, which the junction
+ *    model takes at max_junction_accel * radius / segment_length. Segments too long to run
+ *    at the requested feed are shortened so the arc isn't cornering-limited.
+ *
+ *  - Each segment is a planner block, so it lasts at least MIN_ARC_SEGMENT_USEC (the time
+ *    to plan it) and never less than MIN_BLOCK_TIME. That in turn caps the velocity
+ *    through the junctions at sqrt(max_junction_accel * radius / segment_time).
+ *
+ *  - The planner only runs as fast as it can stop within the blocks it holds. Stopping
+ *    from V takes q*sqrt(V/J) at an average of V/2 (see mp_get_target_length()). While the
+ *    arc runs the active planner holds queue_size - PLANNER_BUFFER_HEADROOM segments, so
+ *    they are lengthened until that many cover the stopping distance. This uses the queue
+ *    size, not the buffers free right now; those fill with segments as the arc runs.
+ */
+static float _get_arc_segment_length(const float arc_time)
+{
+    const float q = 2.40281141413;          // (sqrt(10)/(3^(1/4))), as in _calculate_jerk()
+    float junction_accel = min(cm->a[cm->arc.plane_axis_0].max_junction_accel,
+                               cm->a[cm->arc.plane_axis_1].max_junction_accel);
+    float jerk = min(cm->a[cm->arc.plane_axis_0].jerk_max,
+                     cm->a[cm->arc.plane_axis_1].jerk_max) * JERK_MULTIPLIER;
+    float feed_velocity = cm->arc.length / arc_time;
+
+    // shortest segment time the planner can take, and the velocity that allows
+    float segment_time = max(MIN_ARC_SEGMENT_USEC / MICROSECONDS_PER_MINUTE, MIN_BLOCK_TIME);
+    float velocity = min(feed_velocity, (float)sqrt(junction_accel * cm->arc.radius / segment_time));
+
+    // lengthen segments so the queued ones cover the stopping distance
+    float stop_time = q * sqrt(velocity / jerk) / 2;    // time at velocity to cover it
+    segment_time = max(segment_time, stop_time / (mp->q.queue_size - PLANNER_BUFFER_HEADROOM));
+    velocity = min(feed_velocity, (float)sqrt(junction_accel * cm->arc.radius / segment_time));
+
+    float chordal_length = sqrt(4*cm->chordal_tolerance * (2 * cm->arc.radius - cm->chordal_tolerance));
+    float junction_length = junction_accel * cm->arc.radius / feed_velocity;
+    return (max(min(chordal_length, junction_length), velocity * segment_time));
+}
+
 /*
  * _test_arc_soft_limits() - return error code if soft limit is exceeded
  *
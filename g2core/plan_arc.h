@@ -22,7 +22,8 @@
 
 #define MIN_ARC_RADIUS ((float)0.1)             // min radius that can be executed
 #define MIN_ARC_SEGMENT_LENGTH ((float)0.05)    // Arc segment size (mm).(0.03)
-#define MIN_ARC_SEGMENT_USEC ((float)10000)     // minimum arc segment time
+#define MIN_ARC_SEGMENT_USEC ((float)10000)     // minimum arc segment time (see _get_arc_segment_length())
+#define ARC_CORRECTION_SEGMENTS 16              // segments between exact sin/cos corrections (see cm_arc_callback())
 
 // Arc radius tests. See http://linuxcnc.org/docs/html/gcode/gcode.html#sec:G2-G3-Arc
 //#define ARC_RADIUS_ERROR_MAX ((float)0.5)     // max allowable mm between start and end radius
@@ -45,6 +45,10 @@ static stat_t _exec_aline_tail(mpBuf_t *bf);
 static stat_t _exec_aline_segment(void);
 static void   _exec_aline_normalize_block(mpBlockRuntimeBuf_t *b);
 static stat_t _exec_aline_feedhold(mpBuf_t *bf);
+static void   _exec_path_position(const float travel, float position[]);
+static void   _exec_arc_step(const float segment_length, float position[]);
+static float  _exec_spline_speed(const float t);
+static float  _exec_remaining_length(void);
 
 static void _init_forward_diffs(float v_0, float v_1);
 
@@ -438,6 +442,8 @@ stat_t mp_exec_aline(mpBuf_t *bf)
 
         // Start a new move by setting up the runtime singleton (mr)
         memcpy(&mr->gm, &(bf->gm), sizeof(GCodeState_t));   // copy in the gcode model state
+        mr->inverse = bf->inverse;                          // ...and the transform it was planned with
+        sr_mark_changed(SR_CHANGE_MODEL);                   // runtime line number, feed, modes...
         bf->block_state = BLOCK_ACTIVE;                     // note that this buffer is running
         mr->block_state = BLOCK_INITIAL_ACTION;             // note the planner doesn't look at block_state
 
@@ -455,6 +461,7 @@ stat_t mp_exec_aline(mpBuf_t *bf)
         copy_vector(mr->unit, bf->unit);
         copy_vector(mr->target, bf->gm.target);
         copy_vector(mr->axis_flags, bf->axis_flags);
+        mr->path = bf->path;
 
         mr->run_bf = bf;                                // DIAGNOSTIC: points to running bf
         mr->plan_bf = bf->nx;                           // DIAGNOSTIC: points to next bf to forward plan
@@ -475,6 +482,26 @@ stat_t mp_exec_aline(mpBuf_t *bf)
             mr->waypoint[SECTION_BODY][axis] = mr->position[axis] + mr->unit[axis] * (mr->r->head_length + mr->r->body_length);
             mr->waypoint[SECTION_TAIL][axis] = mr->position[axis] + mr->unit[axis] * (mr->r->head_length + mr->r->body_length + mr->r->tail_length);
         }
+
+        // arcs and splines replace the XYZ waypoints with points on the path. The block may be
+        // the rest of a path split by a feedhold, so travel starts where the previous part left
+        // off. The last section ends exactly on the path length, and so on the target.
+        if (mr->path.type != PATH_LINE) {
+            mr->path_travel = mr->path.length - bf->length;
+            mr->path_waypoint[SECTION_HEAD] = mr->path_travel + mr->r->head_length;
+            mr->path_waypoint[SECTION_BODY] = mr->path_waypoint[SECTION_HEAD] + mr->r->body_length;
+            mr->path_waypoint[SECTION_TAIL] = mr->path.length;
+            if (fp_ZERO(mr->r->tail_length)) {
+                mr->path_waypoint[SECTION_BODY] = mr->path.length;
+                if (fp_ZERO(mr->r->body_length)) {
+                    mr->path_waypoint[SECTION_HEAD] = mr->path.length;
+                }
+            }
+            for (uint8_t section = SECTION_HEAD; section < SECTIONS; section++) {
+                _exec_path_position(mr->path_waypoint[section], mr->waypoint[section]);
+            }
+            mr->arc_correction_count = 1;               // first arc segment gets an exact sin/cos
+        }
     }
 
     // Feed Override Processing - We need to handle the following cases (listed in rough sequence order):
@@ -903,11 +930,22 @@ static stat_t _exec_aline_segment()
 
     if ((--mr->segment_count == 0) && (cm->hold_state == FEEDHOLD_OFF)) {
         copy_vector(mr->gm.target, mr->waypoint[mr->section]);
+        mr->path_travel = mr->path_waypoint[mr->section];   // only meaningful for arcs and splines
+        mr->arc_correction_count = 1;                       // resync the arc rotation on the next section
     } else {
         float segment_length = mr->segment_velocity * mr->segment_time;
+        uint8_t a = 0;
+        if (mr->path.type == PATH_ARC) {                    // XYZ of arcs and splines come from the path, the rest are linear
+            _exec_arc_step(segment_length, mr->gm.target);
+            a = AXIS_Z+1;
+        } else if (mr->path.type == PATH_SPLINE) {
+            mr->path_travel += segment_length;
+            _exec_path_position(mr->path_travel, mr->gm.target);
+            a = AXIS_Z+1;
+        }
         // See https://en.wikipedia.org/wiki/Kahan_summation_algorithm
         // for the summation compensation description
-        for (uint8_t a=0; a<AXES; a++) {
+        for (; a<AXES; a++) {
             float to_add = (mr->unit[a] * segment_length) - mr->gm.target_comp[a];
             float target = mr->position[a] + to_add;
             mr->gm.target_comp[a] = (target - mr->position[a]) - to_add;
@@ -952,12 +990,156 @@ static stat_t _exec_aline_segment()
     // Call the stepper prep function
     ritorno(st_prep_line(travel_steps, mr->following_error, mr->segment_time));
     copy_vector(mr->position, mr->gm.target);               // update position from target
+    sr_mark_changed(SR_CHANGE_MOTION);                      // position and velocity moved
     if (mr->segment_count == 0) {
         return (STAT_OK);                                   // this section has run all its segments
     }
     return (STAT_EAGAIN);                                   // this section still has more segments to run
 }
 
+/*********************************************************************************************
+ * _exec_path_position()    - set XYZ of position[] to the point on the running path at travel
+ * _exec_arc_step()         - advance along the running arc by one segment and set XYZ of position[]
+ * _exec_remaining_length() - length left in the running block, along the path if it's curved
+ *
+ *  Travel at or beyond the path length returns the target, so the path ends exactly where the
+ *  planner thinks it does. Segments are NOM_SEGMENT_MS apart, so a point per segment is far
+ *  less work than planning a chord per segment.
+ *
+ *  An exact arc point costs a sin() and a cos(), so segments step the angle instead: the sin
+ *  and cos pair is rotated by the segment's angle, as cm_arc_callback() rotates its radius
+ *  vector. The segment angle follows the velocity, so its own sin and cos come from their
+ *  Taylor series - exact to float precision for the few degrees a segment turns. The pair is
+ *  recomputed exactly on the first segment of each section (the waypoints are exact), every
+ *  ARC_STEP_CORRECTION segments, and for any segment turning more than ARC_STEP_MAX.
+ *
+ *  A spline point finds the Bezier parameter t for
+ *  the length travelled from the table built by mp_spline(), then evaluates the cubic. Every
+ *  point is on the curve; finding t only affects how evenly the speed is held along it.
+ *  Interpolating t linearly in the table is off by up to ~15% in speed where the curve speeds
+ *  up or slows down in t, so it's refined by SPLINE_SEARCH_STEPS steps of a bracketed search.
+ */
+
+static void _exec_path_position(const float travel, float position[])
+{
+    if (travel >= mr->path.length) {
+        position[AXIS_X] = mr->target[AXIS_X];
+        position[AXIS_Y] = mr->target[AXIS_Y];
+        position[AXIS_Z] = mr->target[AXIS_Z];
+        return;
+    }
+    float fraction = travel / mr->path.length;
+
+    if (mr->path.type == PATH_ARC) {
+        float angle = mr->path.arc.theta + mr->path.arc.angular_travel * fraction;
+        float sin_angle = sin(angle);
+        float cos_angle = cos(angle);
+        for (uint8_t i = 0; i < 3; i++) {
+            position[i] = mr->path.arc.center[i] + mr->path.arc.linear[i] * fraction +
+                          mr->path.arc.sin_vector[i] * sin_angle + mr->path.arc.cos_vector[i] * cos_angle;
+        }
+        return;
+    }
+
+    // PATH_SPLINE - binary search for the table interval holding the length travelled
+    const float *table = mr->path.spline->table;
+    float length = fraction * table[SPLINE_TABLE_SIZE];
+    uint8_t lo = 0;
+    uint8_t hi = SPLINE_TABLE_SIZE;
+    while (hi - lo > 1) {
+        uint8_t mid = (lo + hi) >> 1;
+        if (table[mid] <= length) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    // interpolate t in the interval, then refine it by false position (Illinois variant) on
+    // the length to t, measured from the start of the interval with 2 point Gauss-Legendre
+    // quadrature. The bracket always holds the answer, which Newton's method can't promise
+    // where the curve's speed goes to zero.
+    const float t_lo = lo * (1.0 / SPLINE_TABLE_SIZE);
+    float t_min = t_lo;
+    float t_max = hi * (1.0 / SPLINE_TABLE_SIZE);
+    float error_min = table[lo] - length;           // <= 0
+    float error_max = table[hi] - length;           // > 0
+    int8_t side = 0;
+    float t = t_min - error_min * (t_max - t_min) / (error_max - error_min);
+    for (uint8_t i = 0; i < SPLINE_SEARCH_STEPS; i++) {
+        float h = t - t_lo;
+        float error = table[lo] - length + h * 0.5 * (_exec_spline_speed(t_lo + h * 0.2113248654) +
+                                                      _exec_spline_speed(t_lo + h * 0.7886751346));
+        if (error > 0) {
+            t_max = t;
+            error_max = error;
+            if (side > 0) {
+                error_min *= 0.5;
+            }
+            side = 1;
+        } else {
+            t_min = t;
+            error_min = error;
+            if (side < 0) {
+                error_max *= 0.5;
+            }
+            side = -1;
+        }
+        t = t_min - error_min * (t_max - t_min) / (error_max - error_min);
+    }
+    const float (*coeff)[3] = mr->path.spline->coeff;
+    for (uint8_t i = 0; i < 3; i++) {
+        position[i] = ((coeff[0][i] * t + coeff[1][i]) * t + coeff[2][i]) * t + coeff[3][i];
+    }
+}
+
+static void _exec_arc_step(const float segment_length, float position[])
+{
+    mr->path_travel += segment_length;
+    if (mr->path_travel >= mr->path.length) {
+        _exec_path_position(mr->path_travel, position);    // the target
+        return;
+    }
+    float fraction = mr->path_travel / mr->path.length;
+    float step = mr->path.arc.angular_travel * (segment_length / mr->path.length);
+
+    if ((--mr->arc_correction_count == 0) || (fabs(step) > ARC_STEP_MAX)) {
+        float angle = mr->path.arc.theta + mr->path.arc.angular_travel * fraction;
+        mr->arc_sin = sin(angle);
+        mr->arc_cos = cos(angle);
+        mr->arc_correction_count = ARC_STEP_CORRECTION;
+    } else {
+        float step_sq = step * step;
+        float step_sin = step * (1 - step_sq * 0.16666667);              // error < step^5/120
+        float step_cos = 1 - step_sq * (0.5 - step_sq * 0.041666667);   // error < step^6/720
+        float arc_sin = mr->arc_sin;
+        mr->arc_sin = arc_sin * step_cos + mr->arc_cos * step_sin;
+        mr->arc_cos = mr->arc_cos * step_cos - arc_sin * step_sin;
+    }
+    for (uint8_t i = 0; i < 3; i++) {
+        position[i] = mr->path.arc.center[i] + mr->path.arc.linear[i] * fraction +
+                      mr->path.arc.sin_vector[i] * mr->arc_sin + mr->path.arc.cos_vector[i] * mr->arc_cos;
+    }
+}
+
+static float _exec_spline_speed(const float t)      // |B'(t)| of the running spline
+{
+    const float (*coeff)[3] = mr->path.spline->coeff;
+    float speed_sq = 0;
+    for (uint8_t i = 0; i < 3; i++) {
+        speed_sq += square((3 * coeff[0][i] * t + 2 * coeff[1][i]) * t + coeff[2][i]);
+    }
+    return (sqrt(speed_sq));
+}
+
+static float _exec_remaining_length()
+{
+    if (mr->path.type != PATH_LINE) {
+        return (mr->path.length - mr->path_travel);
+    }
+    return (get_axis_vector_length(mr->target, mr->position));
+}
+
 /*********************************************************************************************
  * _exec_aline_normalize_block() - re-organize block to eliminate minimum time segments
  *
@@ -1051,7 +1233,7 @@ static stat_t _exec_aline_feedhold(mpBuf_t *bf)
             
             // Otherwise setup the block to complete motion (regardless of how hold will ultimately be exited)      
             else { 
-                bf->length = get_axis_vector_length(mr->position, mr->target);  // update bf w/remaining length in move
+                bf->length = _exec_remaining_length();      // update bf w/remaining length in move
                 
                 // If length ~= 0 it's because the deceleration was exact. Handle this exception to avoid planning errors
                 if (bf->length < EPSILON4) {
@@ -1119,7 +1301,7 @@ static stat_t _exec_aline_feedhold(mpBuf_t *bf)
         // enough (to EPSILON2) (1e). Case 1e happens frequently when the tail in the move was 
         // already planned to zero. EPSILON2 deals with floating point rounding errors that can 
         // mis-classify this case. EPSILON2 is 0.0001, which is 0.1 microns in length.
-        float available_length = get_axis_vector_length(mr->target, mr->position);
+        float available_length = _exec_remaining_length();
 
         // Cases (1b1, 1c1) deceleration will fit in the block
         if ((available_length + EPSILON2 - mr->r->tail_length) > 0) {
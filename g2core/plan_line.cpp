@@ -50,8 +50,10 @@ extern OutputPin<kDebug3_PinNumber> debug_pin3;
 // planner helper functions
 static mpBuf_t* _plan_block(mpBuf_t* bf);
 static void _calculate_override(mpBuf_t* bf);
-static void _calculate_jerk(mpBuf_t* bf);
-static void _calculate_vmaxes(mpBuf_t* bf, const float axis_length[], const float axis_square[]);
+static void _calculate_jerk(mpBuf_t* bf, const float unit[]);
+static void _calculate_vmaxes(mpBuf_t* bf, const float axis_length[], const float linear_length, const float rotary_length);
+static void _calculate_arc_vmax(mpBuf_t* bf, const float radius, const float planar_fraction);
+static void _spline_tangent(const float d1[], const float d2[], const float chord[], float tangent[]);
 static void _calculate_junction_vmax(mpBuf_t* bf);
 
 
@@ -74,6 +76,8 @@ static void _set_bf_diagnostics(mpBuf_t* bf) {}
  * mp_set_runtime_display_offset()    - set combined display offsets in the MR struct
  * mp_get_runtime_display_position()  - returns current axis position in work display coordinates
  *                                      that were in effect at move planning time
+ * mp_get_runtime_model_position()    - returns the runtime position with the transform undone,
+ *                                      as the Gcode model (gm.target, gmx.position) keeps it
  */
 
 void  mp_zero_segment_velocity() { mr->segment_velocity = 0; }
@@ -81,25 +85,26 @@ float mp_get_runtime_velocity(void) { return (mr->segment_velocity); }
 float mp_get_runtime_absolute_position(mpPlannerRuntime_t *_mr, uint8_t axis) { return (_mr->position[axis]); }
 void mp_set_runtime_display_offset(float offset[]) { copy_vector(mr->gm.display_offset, offset); }
 
-// We have to handle rotation - "rotate" by the transverse of the matrix to got "normal" coordinates
-float mp_get_runtime_display_position(uint8_t axis) {
-    // Shorthand:
-    // target_rotated[0] = a x_1 + b x_2 + c x_3
-    // target_rotated[1] = a y_1 + b y_2 + c y_3
-    // target_rotated[2] = a z_1 + b z_2 + c z_3 + z_offset
-
-    if (axis == AXIS_X) {
-        return mr->position[0] * cm->rotation_matrix[0][0] + mr->position[1] * cm->rotation_matrix[1][0] +
-               mr->position[2] * cm->rotation_matrix[2][0] - mr->gm.display_offset[0];
-    } else if (axis == AXIS_Y) {
-        return mr->position[0] * cm->rotation_matrix[0][1] + mr->position[1] * cm->rotation_matrix[1][1] +
-               mr->position[2] * cm->rotation_matrix[2][1] - mr->gm.display_offset[1];
-    } else if (axis == AXIS_Z) {
-        return mr->position[0] * cm->rotation_matrix[0][2] + mr->position[1] * cm->rotation_matrix[1][2] +
-               mr->position[2] * cm->rotation_matrix[2][2] - cm->rotation_z_offset - mr->gm.display_offset[2];
-    } else {
+// We have to undo the transform applied in mp_aline() to get back to "normal" coordinates.
+// The transform may have changed since the running block was planned, so the block carries its own.
+static float _runtime_model_position(const mpPlannerRuntime_t *_mr, uint8_t axis) {
+    if (axis > AXIS_Z) {
         // ABC, UVW, we don't rotate them
-        return (mr->position[axis] - mr->gm.display_offset[axis]);
+        return (_mr->position[axis]);
+    }
+    const cmTransform_t *inverse = &_mr->inverse;
+    return (_mr->position[AXIS_X] * inverse->matrix[axis][0] + 
+            _mr->position[AXIS_Y] * inverse->matrix[axis][1] +
+            _mr->position[AXIS_Z] * inverse->matrix[axis][2] + inverse->offset[axis]);
+}
+
+float mp_get_runtime_display_position(uint8_t axis) {
+    return (_runtime_model_position(mr, axis) - mr->gm.display_offset[axis]);
+}
+
+void mp_get_runtime_model_position(const mpPlannerRuntime_t *_mr, float position[]) {
+    for (uint8_t axis = 0; axis < AXES; axis++) {
+        position[axis] = _runtime_model_position(_mr, axis);
     }
 }
 
@@ -159,29 +164,34 @@ stat_t mp_aline(GCodeState_t* _gm)
     //  target_rotated (after the rotation here, of course)
     //  mp.* (anything in mp, including mp.gm.*)
     //
-    // Shorthand:
-    //  target_rotated[0] = a x_0 + b y_0 + c z_0
-    //  target_rotated[1] = a x_1 + b y_1 + c z_1
-    //  target_rotated[2] = a x_2 + b y_2 + c z_2 + z_offset
+    // The rotation is the bed tram combined with any G68 rotation and G51 scaling, compiled
+    // into one affine transform by cm_update_transform(). Shorthand:
+    //  target_rotated[0] = a x_0 + b y_0 + c z_0 + offset_0
+    //  target_rotated[1] = a x_1 + b y_1 + c z_1 + offset_1
+    //  target_rotated[2] = a x_2 + b y_2 + c z_2 + offset_2
     //
     // With:
     //  a being target[0],
     //  b being target[1],
     //  c being target[2],
-    //  x_1 being cm->rotation_matrix[1][0]
+    //  x_1 being transform->matrix[1][0]
+
+    const cmTransform_t *transform = cm_get_transform(_gm, false);
 
-    target_rotated[AXIS_X] = _gm->target[AXIS_X] * cm->rotation_matrix[0][0] + 
-                             _gm->target[AXIS_Y] * cm->rotation_matrix[0][1] +
-                             _gm->target[AXIS_Z] * cm->rotation_matrix[0][2];
+    target_rotated[AXIS_X] = _gm->target[AXIS_X] * transform->matrix[0][0] + 
+                             _gm->target[AXIS_Y] * transform->matrix[0][1] +
+                             _gm->target[AXIS_Z] * transform->matrix[0][2] +
+                             transform->offset[0];
 
-    target_rotated[AXIS_Y] = _gm->target[AXIS_X] * cm->rotation_matrix[1][0] + 
-                             _gm->target[AXIS_Y] * cm->rotation_matrix[1][1] +
-                             _gm->target[AXIS_Z] * cm->rotation_matrix[1][2];
+    target_rotated[AXIS_Y] = _gm->target[AXIS_X] * transform->matrix[1][0] + 
+                             _gm->target[AXIS_Y] * transform->matrix[1][1] +
+                             _gm->target[AXIS_Z] * transform->matrix[1][2] +
+                             transform->offset[1];
 
-    target_rotated[AXIS_Z] = _gm->target[AXIS_X] * cm->rotation_matrix[2][0] + 
-                             _gm->target[AXIS_Y] * cm->rotation_matrix[2][1] +
-                             _gm->target[AXIS_Z] * cm->rotation_matrix[2][2] + 
-                             cm->rotation_z_offset;
+    target_rotated[AXIS_Z] = _gm->target[AXIS_X] * transform->matrix[2][0] + 
+                             _gm->target[AXIS_Y] * transform->matrix[2][1] +
+                             _gm->target[AXIS_Z] * transform->matrix[2][2] + 
+                             transform->offset[2];
 
     // copy rotation axes for UVW (no changes)
     target_rotated[AXIS_U] = _gm->target[AXIS_U];
@@ -220,6 +230,7 @@ stat_t mp_aline(GCodeState_t* _gm)
     }
     memcpy(&bf->gm, _gm, sizeof(GCodeState_t));
     copy_vector(bf->gm.target, target_rotated);         // copy the rotated target in place
+    bf->inverse = *cm_get_transform(_gm, true);         // for position displays while it runs
 
     // setup the buffer
     bf->bf_func = mp_exec_aline;                        // register the callback to the exec function
@@ -229,8 +240,318 @@ stat_t mp_aline(GCodeState_t* _gm)
             bf->unit[axis] = axis_length[axis] / length;// nb: bf-> unit was cleared by mp_get_write_buffer()
         }
     }
-    _calculate_jerk(bf);                                // compute bf->jerk values
-    _calculate_vmaxes(bf, axis_length, axis_square);    // compute cruise_vmax and absolute_vmax
+    _calculate_jerk(bf, bf->unit);                      // compute bf->jerk values
+
+    // XYZ length for the feed rate, or ABC length (degrees) if no linear axes move
+    float linear_length = sqrt(axis_square[AXIS_X] + axis_square[AXIS_Y] + axis_square[AXIS_Z]);
+    float rotary_length = 0;
+    if (fp_ZERO(linear_length)) {
+        rotary_length = sqrt(axis_square[AXIS_A] + axis_square[AXIS_B] + axis_square[AXIS_C]);
+    }
+    _calculate_vmaxes(bf, axis_length, linear_length, rotary_length); // compute cruise_vmax and absolute_vmax
+    _set_bf_diagnostics(bf);                            // DIAGNOSTIC
+
+    // Note: these next lines must remain in exact order. Position must update before committing the buffer.
+    copy_vector(mp->position, bf->gm.target);           // update the planner position for the next move
+    mp_commit_write_buffer(BLOCK_TYPE_ALINE);           // commit current block (must follow the position update)
+    return (STAT_OK);
+}
+
+/****************************************************************************************
+ * mp_arc() - plan an arc as a single move with acceleration / deceleration
+ *
+ *  Queues the arc set up by cm_arc_feed() as one ALINE block with bf->path set, instead of the
+ *  chord segments cm_arc_callback() would queue. The block is planned like a line of the same
+ *  length - one velocity profile, one junction in and one out - so an arc takes one planner
+ *  buffer however finely it is cut. The runtime computes each segment's position on the arc
+ *  itself (see _exec_aline_segment()).
+ *
+ *  The arc goes through the same affine transform mp_aline() applies to lines. In machine
+ *  coordinates the XYZ position at fraction f of the arc, at angle a = theta + f * angular_travel, is:
+ *
+ *      center + f * linear + sin(a) * sin_vector + cos(a) * cos_vector
+ *
+ *  Other axes move in proportion to f, as they would in a line. The planner treats this as a
+ *  helix traversed at constant speed, which holds if the transform keeps circles circular
+ *  (tram, G68 rotation, uniform G51 scaling). If it doesn't - G51 with unequal scale factors -
+ *  this returns STAT_NOOP and the caller falls back to chord segments.
+ *
+ *  Must be called with the arc singleton set up by _compute_arc().
+ */
+
+static inline float _dot3(const float a[], const float b[])
+{
+    return (a[0]*b[0] + a[1]*b[1] + a[2]*b[2]);
+}
+
+stat_t mp_arc(const cmArc_t* arc)
+{
+    const cmTransform_t *transform = cm_get_transform(&arc->gm, false);
+    const uint8_t plane_0 = arc->plane_axis_0;
+    const uint8_t plane_1 = arc->plane_axis_1;
+    const uint8_t linear  = arc->linear_axis;
+    mpPath_t geometry;
+
+    float target[AXES];                                 // endpoint before the transform
+    copy_vector(target, arc->gm.target);
+    target[linear] = arc->position[linear] + arc->linear_travel;  // _compute_arc() reset it for segments
+
+    float center[3];                                    // center at the start, before the transform
+    center[plane_0] = arc->center_0;
+    center[plane_1] = arc->center_1;
+    center[linear]  = arc->position[linear];
+
+    float target_rotated[AXES];
+    for (uint8_t i = 0; i < 3; i++) {
+        const float *row = transform->matrix[i];
+        geometry.arc.center[i]     = _dot3(row, center) + transform->offset[i];
+        geometry.arc.linear[i]     = row[linear] * arc->linear_travel;
+        geometry.arc.sin_vector[i] = row[plane_0] * arc->radius;
+        geometry.arc.cos_vector[i] = row[plane_1] * arc->radius;
+        target_rotated[i]      = _dot3(row, target) + transform->offset[i];
+    }
+    for (uint8_t axis = AXIS_Z+1; axis < AXES; axis++) {
+        target_rotated[axis] = target[axis];            // UVW and ABC are not transformed
+    }
+
+    // the transformed arc must still be a circle, square to its helix axis
+    float radius = sqrt(_dot3(geometry.arc.sin_vector, geometry.arc.sin_vector));
+    float helix_length = sqrt(_dot3(geometry.arc.linear, geometry.arc.linear));
+    if ((fabs(sqrt(_dot3(geometry.arc.cos_vector, geometry.arc.cos_vector)) - radius) > EPSILON3 * radius) ||
+        (fabs(_dot3(geometry.arc.sin_vector, geometry.arc.cos_vector)) > EPSILON3 * radius * radius) ||
+        (fabs(_dot3(geometry.arc.sin_vector, geometry.arc.linear)) > EPSILON3 * radius * helix_length) ||
+        (fabs(_dot3(geometry.arc.cos_vector, geometry.arc.linear)) > EPSILON3 * radius * helix_length)) {
+        return (STAT_NOOP);
+    }
+
+    float planar_length = fabs(arc->angular_travel) * radius;
+    float xyz_length = hypotf(planar_length, helix_length);
+    float length_square = square(xyz_length);
+    float axis_travel[AXES];
+    for (uint8_t axis = AXIS_Z+1; axis < AXES; axis++) {
+        axis_travel[axis] = target_rotated[axis] - mp->position[axis];
+        length_square += square(axis_travel[axis]);
+    }
+    float length = sqrt(length_square);
+    if (length < 0.0001) {                              // same minimum as mp_aline()
+        sr_request_status_report(SR_REQUEST_TIMED_FULL);
+        return (STAT_MINIMUM_LENGTH_MOVE);
+    }
+
+    // unit vectors at the start and end, and the largest each axis's unit vector gets on the arc
+    float unit[AXES];
+    float peak_unit[AXES];
+    bool flags[AXES];
+    float theta_end = arc->theta + arc->angular_travel;
+    float theta_rate = arc->angular_travel / length;    // radians per mm along the block
+    for (uint8_t i = 0; i < 3; i++) {
+        float linear_unit = geometry.arc.linear[i] / length;
+        unit[i] = linear_unit + theta_rate *
+                  (cos(arc->theta) * geometry.arc.sin_vector[i] - sin(arc->theta) * geometry.arc.cos_vector[i]);
+        geometry.exit_unit[i] = linear_unit + theta_rate *
+                  (cos(theta_end) * geometry.arc.sin_vector[i] - sin(theta_end) * geometry.arc.cos_vector[i]);
+        peak_unit[i] = fabs(linear_unit) +
+                       fabs(theta_rate) * hypotf(geometry.arc.sin_vector[i], geometry.arc.cos_vector[i]);
+    }
+    for (uint8_t axis = AXIS_Z+1; axis < AXES; axis++) {
+        unit[axis] = axis_travel[axis] / length;
+        peak_unit[axis] = fabs(unit[axis]);
+    }
+    float axis_length[AXES];
+    for (uint8_t axis = 0; axis < AXES; axis++) {
+        if ((flags[axis] = (peak_unit[axis] * length > EPSILON))) { // yes, this supposed to be = not ==
+            axis_length[axis] = peak_unit[axis] * length;
+        } else {
+            unit[axis] = 0;
+            peak_unit[axis] = 0;
+            axis_length[axis] = 0;
+        }
+    }
+    geometry.type = PATH_ARC;
+    geometry.arc.theta = arc->theta;
+    geometry.arc.angular_travel = arc->angular_travel;
+    geometry.length = length;
+
+    // get a cleared buffer and copy in the Gcode model state
+    mpBuf_t* bf = mp_get_write_buffer();
+    if (bf == NULL) {                                   // never supposed to fail
+        return (cm_panic(STAT_FAILED_GET_PLANNER_BUFFER, "arc()"));
+    }
+    memcpy(&bf->gm, &arc->gm, sizeof(GCodeState_t));
+    copy_vector(bf->gm.target, target_rotated);         // copy the rotated target in place
+    bf->inverse = *cm_get_transform(&arc->gm, true);    // for position displays while it runs
+
+    // setup the buffer
+    bf->bf_func = mp_exec_aline;                        // arcs run as alines
+    bf->length = length;
+    copy_vector(bf->unit, unit);
+    copy_vector(bf->axis_flags, flags);
+    bf->path = geometry;
+    _calculate_jerk(bf, peak_unit);                     // jerk for the worst point on the arc
+    _calculate_vmaxes(bf, axis_length, xyz_length, 0);  // arcs always have XYZ length
+    _calculate_arc_vmax(bf, radius, planar_length / length);
+    _set_bf_diagnostics(bf);                            // DIAGNOSTIC
+
+    // Note: these next lines must remain in exact order. Position must update before committing the buffer.
+    copy_vector(mp->position, bf->gm.target);           // update the planner position for the next move
+    mp_commit_write_buffer(BLOCK_TYPE_ALINE);           // commit current block (must follow the position update)
+    return (STAT_OK);
+}
+
+/****************************************************************************************
+ * mp_spline() - plan a cubic Bezier curve as a single move with acceleration / deceleration
+ *
+ *  Queues a G5 or G5.1 spline set up by cm_spline_feed() as one ALINE block with bf->path
+ *  set, the same way mp_arc() queues an arc. control_1 and control_2 are the XYZ of the two
+ *  inner control points and _gm->target is the end point, all before the transform. The
+ *  curve starts on the planner position. An affine transform maps a Bezier curve onto the
+ *  Bezier curve of the transformed control points, so splines don't need a fallback.
+ *
+ *  The curve is stored as polynomial coefficients in t, in an entry of the planner's spline
+ *  pool rather than in the buffer, so the buffers stay the size arcs need. mp_planner_is_full()
+ *  holds input back while the pool is used up. The runtime moves along the curve by length,
+ *  so the length is measured here once: 3 point Gauss-Legendre quadrature of |B'(t)| over
+ *  each of SPLINE_TABLE_SIZE intervals gives the table of lengths at t = i/SIZE that
+ *  _exec_path_position() inverts. The quadrature points also give the largest each axis's
+ *  unit vector gets (for jerk) and the tightest radius of curvature (for velocity).
+ *
+ *  Other axes move in proportion to the length, as they would in a line.
+ */
+
+stat_t mp_spline(GCodeState_t* _gm, const float control_1[], const float control_2[])
+{
+    const cmTransform_t *transform = cm_get_transform(_gm, false);
+    float point[4][3];                                  // control points in machine coordinates
+    float target_rotated[AXES];
+
+    for (uint8_t i = 0; i < 3; i++) {
+        const float *row = transform->matrix[i];
+        point[0][i] = mp->position[i];
+        point[1][i] = _dot3(row, control_1) + transform->offset[i];
+        point[2][i] = _dot3(row, control_2) + transform->offset[i];
+        point[3][i] = _dot3(row, _gm->target) + transform->offset[i];
+        target_rotated[i] = point[3][i];
+    }
+    for (uint8_t axis = AXIS_Z+1; axis < AXES; axis++) {
+        target_rotated[axis] = _gm->target[axis];       // UVW and ABC are not transformed
+    }
+
+    // B(t) = ((a*t + b)*t + c)*t + d, B'(t) = (3a*t + 2b)*t + c, B''(t) = 6a*t + 2b
+    mpPath_t geometry;
+    mpSpline_t spline;
+    float (*coeff)[3] = spline.coeff;
+    float chord[3];
+    for (uint8_t i = 0; i < 3; i++) {
+        coeff[0][i] = point[3][i] - point[0][i] + 3 * (point[1][i] - point[2][i]);
+        coeff[1][i] = 3 * (point[0][i] - 2 * point[1][i] + point[2][i]);
+        coeff[2][i] = 3 * (point[1][i] - point[0][i]);
+        coeff[3][i] = point[0][i];
+        chord[i] = point[3][i] - point[0][i];
+    }
+
+    // measure the length, peak unit vector and tightest radius at the quadrature points
+    static const float node[3]   = { 0.1127016654, 0.5, 0.8872983346 };    // (1 -/+ sqrt(3/5)) / 2
+    static const float weight[3] = { 0.2777777778, 0.4444444444, 0.2777777778 };
+    float peak_unit[AXES] = INIT_AXES_ZEROES;
+    float radius = 8675309;
+    float xyz_length = 0;
+    spline.table[0] = 0;
+    for (uint8_t k = 0; k < SPLINE_TABLE_SIZE; k++) {
+        for (uint8_t n = 0; n < 3; n++) {
+            float t = (k + node[n]) * (1.0 / SPLINE_TABLE_SIZE);
+            float d1[3], d2[3];
+            for (uint8_t i = 0; i < 3; i++) {
+                d1[i] = (3 * coeff[0][i] * t + 2 * coeff[1][i]) * t + coeff[2][i];
+                d2[i] = 6 * coeff[0][i] * t + 2 * coeff[1][i];
+            }
+            float speed = sqrt(_dot3(d1, d1));
+            xyz_length += weight[n] * speed * (1.0 / SPLINE_TABLE_SIZE);
+            if (speed < EPSILON) {
+                continue;                               // on a cusp; the neighbours see its curvature
+            }
+            for (uint8_t i = 0; i < 3; i++) {
+                peak_unit[i] = max(peak_unit[i], (float)fabs(d1[i]) / speed);
+            }
+            float cross = sqrt(square(d1[1]*d2[2] - d1[2]*d2[1]) +
+                               square(d1[2]*d2[0] - d1[0]*d2[2]) +
+                               square(d1[0]*d2[1] - d1[1]*d2[0]));
+            if (cross * radius > speed * speed * speed) {  // radius of curvature is |B'|^3 / |B' x B''|
+                radius = speed * speed * speed / cross;
+            }
+        }
+        spline.table[k+1] = xyz_length;
+    }
+
+    float length_square = square(xyz_length);
+    float axis_travel[AXES];
+    for (uint8_t axis = AXIS_Z+1; axis < AXES; axis++) {
+        axis_travel[axis] = target_rotated[axis] - mp->position[axis];
+        length_square += square(axis_travel[axis]);
+    }
+    float length = sqrt(length_square);
+    if ((length < 0.0001) || (xyz_length < EPSILON)) {  // same minimum as mp_aline()
+        sr_request_status_report(SR_REQUEST_TIMED_FULL);
+        return (STAT_MINIMUM_LENGTH_MOVE);
+    }
+
+    // unit vectors at the start and end. XYZ share the block's unit length with the other axes
+    float xyz_fraction = xyz_length / length;
+    float unit[AXES];
+    bool flags[AXES];
+    float d1[3], d2[3];
+    for (uint8_t i = 0; i < 3; i++) {
+        d1[i] = coeff[2][i];                            // B'(0), B''(0)
+        d2[i] = 2 * coeff[1][i];
+    }
+    _spline_tangent(d1, d2, chord, unit);
+    for (uint8_t i = 0; i < 3; i++) {
+        d1[i] = 3 * coeff[0][i] + 2 * coeff[1][i] + coeff[2][i];   // B'(1), -B''(1)
+        d2[i] = -(6 * coeff[0][i] + 2 * coeff[1][i]);
+    }
+    _spline_tangent(d1, d2, chord, geometry.exit_unit);
+    for (uint8_t i = 0; i < 3; i++) {
+        peak_unit[i] = max(peak_unit[i], max((float)fabs(unit[i]), (float)fabs(geometry.exit_unit[i]))) * xyz_fraction;
+        unit[i] *= xyz_fraction;
+        geometry.exit_unit[i] *= xyz_fraction;
+    }
+    for (uint8_t axis = AXIS_Z+1; axis < AXES; axis++) {
+        unit[axis] = axis_travel[axis] / length;
+        peak_unit[axis] = fabs(unit[axis]);
+    }
+    float axis_length[AXES];
+    for (uint8_t axis = 0; axis < AXES; axis++) {
+        if ((flags[axis] = (peak_unit[axis] * length > EPSILON))) { // yes, this supposed to be = not ==
+            axis_length[axis] = peak_unit[axis] * length;
+        } else {
+            unit[axis] = 0;
+            peak_unit[axis] = 0;
+            axis_length[axis] = 0;
+        }
+    }
+    geometry.type = PATH_SPLINE;
+    geometry.length = length;
+
+    // get a cleared buffer and copy in the Gcode model state
+    mpBuf_t* bf = mp_get_write_buffer();
+    mpSpline_t* pool_entry = mp_get_spline_buffer();
+    if ((bf == NULL) || (pool_entry == NULL)) {         // never supposed to fail
+        return (cm_panic(STAT_FAILED_GET_PLANNER_BUFFER, "spline()"));
+    }
+    *pool_entry = spline;                               // the curve lives in the spline pool...
+    geometry.spline = pool_entry;                       // ...until the buffer is freed
+    memcpy(&bf->gm, _gm, sizeof(GCodeState_t));
+    copy_vector(bf->gm.target, target_rotated);         // copy the rotated target in place
+    bf->inverse = *cm_get_transform(_gm, true);         // for position displays while it runs
+
+    // setup the buffer
+    bf->bf_func = mp_exec_aline;                        // splines run as alines
+    bf->length = length;
+    copy_vector(bf->unit, unit);
+    copy_vector(bf->axis_flags, flags);
+    bf->path = geometry;
+    _calculate_jerk(bf, peak_unit);                     // jerk for the worst point on the curve
+    _calculate_vmaxes(bf, axis_length, xyz_length, 0);  // splines always have XYZ length
+    _calculate_arc_vmax(bf, radius, xyz_fraction);
     _set_bf_diagnostics(bf);                            // DIAGNOSTIC
 
     // Note: these next lines must remain in exact order. Position must update before committing the buffer.
@@ -239,6 +560,31 @@ stat_t mp_aline(GCodeState_t* _gm)
     return (STAT_OK);
 }
 
+/*
+ * _spline_tangent() - unit tangent at an end of a spline
+ *
+ *  d1 is the first derivative at the end. If a control point sits on the end point d1 is zero
+ *  and the curve leaves along d2 (the second derivative, signed to point along the motion);
+ *  if that is zero too the curve is a straight line along the chord.
+ */
+
+static void _spline_tangent(const float d1[], const float d2[], const float chord[], float tangent[])
+{
+    const float *d = d1;
+    float magnitude = sqrt(_dot3(d1, d1));
+    if (magnitude < EPSILON) {
+        d = d2;
+        magnitude = sqrt(_dot3(d2, d2));
+        if (magnitude < EPSILON) {
+            d = chord;
+            magnitude = sqrt(_dot3(chord, chord));
+        }
+    }
+    for (uint8_t i = 0; i < 3; i++) {
+        tangent[i] = d[i] / magnitude;
+    }
+}
+
 /****************************************************************************************
  * mp_plan_block_list() - plan all the blocks in the list
  *
@@ -504,17 +850,19 @@ static void _calculate_override(mpBuf_t* bf)  // execute ramp to adjust cruise v
  *  Go through the axes one by one and compute the scaled jerk, then pick
  *  the highest jerk that does not violate any of the axes in the move.
  *
+ *  Lines pass bf->unit. Arcs pass the largest each axis's unit vector gets anywhere on the arc.
+ *
  * Cost about ~65 uSec
  */
 
-static void _calculate_jerk(mpBuf_t* bf) 
+static void _calculate_jerk(mpBuf_t* bf, const float unit[]) 
 {
     // compute the jerk as the largest jerk that still meets axis constraints
     bf->jerk   = 8675309;  // a ridiculously large number
     float jerk = 0;
 
     for (uint8_t axis = 0; axis < AXES; axis++) {
-        if (fabs(bf->unit[axis]) > 0) {  // if this axis is participating in the move
+        if (fabs(unit[axis]) > 0) {  // if this axis is participating in the move
             float axis_jerk = 0;
 #ifdef TRAVERSE_AT_HIGH_JERK
 #warning using experimental feature TRAVERSE_AT_HIGH_JERK!
@@ -530,7 +878,7 @@ static void _calculate_jerk(mpBuf_t* bf)
             axis_jerk = cm->a[axis].jerk_max;
 #endif
 
-            jerk = axis_jerk / fabs(bf->unit[axis]);
+            jerk = axis_jerk / fabs(unit[axis]);
             if (jerk < bf->jerk) {
                 bf->jerk = jerk;
                 //              bf->jerk_axis = axis;           // +++ diagnostic
@@ -571,6 +919,10 @@ static void _calculate_jerk(mpBuf_t* bf)
  *  Prerequisites for calling this function:
  *    - Targets must be set via cm_set_target(). Axis modes are taken into account by this.
  *    - The unit vector and associated flags were computed.
+ *
+ *  linear_length is the XYZ length the feed rate applies to. rotary_length is the ABC length
+ *  in degrees, used if there is no linear length. axis_length[] is the travel used to rate
+ *  limit each axis - for an arc this is the travel at the axis's fastest point on the arc.
  */
 /* --- NIST RS274NGC_v3 Guidance ---
  *
@@ -624,7 +976,7 @@ static void _calculate_jerk(mpBuf_t* bf)
  *      F = ma
  *      S(z) / V(xy)
  */
-static void _calculate_vmaxes(mpBuf_t* bf, const float axis_length[], const float axis_square[]) 
+static void _calculate_vmaxes(mpBuf_t* bf, const float axis_length[], const float linear_length, const float rotary_length) 
 {
     float feed_time = 0;        // one of: XYZ time, ABC time or inverse time. Mutually exclusive
     float max_time  = 0;        // time required for the rate-limiting axis
@@ -638,12 +990,12 @@ static void _calculate_vmaxes(mpBuf_t* bf, const float axis_length[], const floa
             feed_time = bf->gm.feed_rate;  // NB: feed rate was un-inverted to minutes by cm_set_feed_rate()
             bf->gm.feed_rate_mode = UNITS_PER_MINUTE_MODE;
         } else {
-            // compute length of linear move in millimeters. Feed rate is provided as mm/min
-            feed_time = sqrt(axis_square[AXIS_X] + axis_square[AXIS_Y] + axis_square[AXIS_Z]) / bf->gm.feed_rate;
-            // if no linear axes, compute length of multi-axis rotary move in degrees. 
+            // time of linear move in millimeters. Feed rate is provided as mm/min
+            feed_time = linear_length / bf->gm.feed_rate;
+            // if no linear axes, use the length of multi-axis rotary move in degrees. 
             // Feed rate is provided as degrees/min
             if (fp_ZERO(feed_time)) {
-                feed_time = sqrt(axis_square[AXIS_A] + axis_square[AXIS_B] + axis_square[AXIS_C]) / bf->gm.feed_rate;
+                feed_time = rotary_length / bf->gm.feed_rate;
             }
         }
     }
@@ -670,6 +1022,42 @@ static void _calculate_vmaxes(mpBuf_t* bf, const float axis_length[], const floa
     bf->block_time    = block_time;               // initial estimate - used for ramp computations
 }
 
+/****************************************************************************************
+ * _calculate_arc_vmax() - limit cruise_vmax and absolute_vmax by centripetal acceleration
+ *
+ *  A segmented arc is limited by the junction velocity between its segments, which depends
+ *  on how finely it was cut rather than on the arc. An arc block is limited by the
+ *  centripetal acceleration v^2/r instead. The acceleration allowed is the one the junction
+ *  model already accepts at a corner: max_junction_accel is the velocity change permitted
+ *  over one junction integration time, so max_junction_accel / T is the acceleration.
+ *  The smallest over the moving XYZ axes is used, as the normal to the arc swings through
+ *  all of them.
+ *
+ *  Splines use the same limit with the tightest radius of curvature found on the curve.
+ *
+ *  planar_fraction is the part of the block's velocity that goes around the circle; the
+ *  rest is helix and rotary travel.
+ */
+
+static void _calculate_arc_vmax(mpBuf_t* bf, const float radius, const float planar_fraction)
+{
+    float T = cm->junction_integration_time / 1000.0;   // time quantum, as in _cm_recalc_junction_accel()
+    float accel = 8675309;
+
+    for (uint8_t axis = AXIS_X; axis <= AXIS_Z; axis++) {
+        if (bf->axis_flags[axis]) {
+            accel = min(accel, cm->a[axis].max_junction_accel / T);
+        }
+    }
+    float velocity = sqrt(accel * radius) / planar_fraction;
+    if (bf->cruise_vset > velocity) {
+        bf->cruise_vset = velocity;
+        bf->cruise_vmax = velocity;
+        bf->block_time  = bf->length / velocity;
+    }
+    bf->absolute_vmax = min(bf->absolute_vmax, velocity);
+}
+
 /****************************************************************************************
  * _calculate_junction_vmax() - Giseburt's Algorithm ;-)
  *
@@ -721,6 +1109,17 @@ static void _calculate_vmaxes(mpBuf_t* bf, const float axis_length[], const floa
 
 static void _calculate_junction_vmax(mpBuf_t* bf) 
 {
+    // arcs and splines leave in a different direction than they started
+    const float *unit = bf->unit;
+    float exit_unit[AXES];
+    if (bf->path.type != PATH_LINE) {
+        copy_vector(exit_unit, bf->unit);
+        exit_unit[AXIS_X] = bf->path.exit_unit[AXIS_X];
+        exit_unit[AXIS_Y] = bf->path.exit_unit[AXIS_Y];
+        exit_unit[AXIS_Z] = bf->path.exit_unit[AXIS_Z];
+        unit = exit_unit;
+    }
+
     // If we change cruise_vmax, we'll need to recompute junction_vmax, if we do this:
 //    float velocity = min(bf->cruise_vmax, bf->nx->cruise_vmax);  // start with our maximum possible velocity
     float velocity = 8675309;
@@ -729,7 +1128,7 @@ static void _calculate_junction_vmax(mpBuf_t* bf)
 
     for (uint8_t axis = 0; axis < AXES; axis++) {
         if (bf->axis_flags[axis] || bf->nx->axis_flags[axis]) {       // skip axes with no movement
-            float delta = fabs(bf->unit[axis] - bf->nx->unit[axis]);  // formula (1)
+            float delta = fabs(unit[axis] - bf->nx->unit[axis]);      // formula (1)
 
             // Corner case: If an axis has zero delta, we might have a straight line.
             // Corner case: An axis doesn't change (and it's not a straight line).
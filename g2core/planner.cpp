@@ -77,6 +77,9 @@ mpPlannerRuntime_t mr2;                     // secondary planner runtime context
 mpBuf_t mp1_queue[PLANNER_QUEUE_SIZE];      // storage allocation for primary planner queue buffers
 mpBuf_t mp2_queue[SECONDARY_QUEUE_SIZE];    // storage allocation for secondary planner queue buffers
 
+mpSpline_t mp1_splines[SPLINE_POOL_SIZE];   // storage allocation for primary planner spline geometry
+mpSpline_t mp2_splines[SECONDARY_SPLINE_POOL_SIZE]; // storage allocation for secondary planner spline geometry
+
 // Execution routines (NB: These are called from the LO interrupt)
 static stat_t _exec_dwell(mpBuf_t *bf);
 static stat_t _exec_command(mpBuf_t *bf);
@@ -149,7 +152,7 @@ _json_commands_t jc;
  */
 
 // initialize a planner queue
-void _init_planner_queue(mpPlanner_t *_mp, mpBuf_t *queue, uint8_t size)
+void _init_planner_queue(mpPlanner_t *_mp, mpBuf_t *queue, uint8_t size, mpSpline_t *splines, uint8_t spline_pool_size)
 {
     mpBuf_t *pv, *nx;
     uint8_t i, nx_i;
@@ -165,6 +168,8 @@ void _init_planner_queue(mpPlanner_t *_mp, mpBuf_t *queue, uint8_t size)
     q->r = queue;
     q->queue_size = size;
     q->buffers_available = size;
+    q->spline = splines;                    // spline pool is empty once the buffers are
+    q->spline_pool_size = spline_pool_size;
     
     pv = &q->bf[size-1];
     for (i=0; i < size; i++) {
@@ -178,7 +183,8 @@ void _init_planner_queue(mpPlanner_t *_mp, mpBuf_t *queue, uint8_t size)
     q->bf[size-1].nx = queue;
 }
 
-void planner_init(mpPlanner_t *_mp, mpPlannerRuntime_t *_mr, mpBuf_t *queue, uint8_t queue_size)
+void planner_init(mpPlanner_t *_mp, mpPlannerRuntime_t *_mr, mpBuf_t *queue, uint8_t queue_size,
+                  mpSpline_t *splines, uint8_t spline_pool_size)
 {
     // init planner master structure
     memset(_mp, 0, sizeof(mpPlanner_t));    // clear all values, pointers and status    
@@ -188,7 +194,7 @@ void planner_init(mpPlanner_t *_mp, mpPlannerRuntime_t *_mr, mpBuf_t *queue, uin
    
     // init planner queues
     _mp->q.bf = queue;                      // assign puffer pool to queue manager structure
-    _init_planner_queue(_mp, queue, queue_size);
+    _init_planner_queue(_mp, queue, queue_size, splines, spline_pool_size);
  
     // init runtime structs
     _mp->mr = _mr;
@@ -200,6 +206,9 @@ void planner_init(mpPlanner_t *_mp, mpPlannerRuntime_t *_mr, mpBuf_t *queue, uin
     _mr->block[1].nx = &_mr->block[0];
     _mr->r = &_mr->block[0];
     _mr->p = &_mr->block[1];
+    for (uint8_t i=0; i<3; i++) {
+        _mr->inverse.matrix[i][i] = 1;      // no transform until the first block runs
+    }
 }
 
 void planner_reset(mpPlanner_t *_mp)        // reset planner queue, cease MR activity, but leave positions alone
@@ -208,7 +217,7 @@ void planner_reset(mpPlanner_t *_mp)        // reset planner queue, cease MR act
     _mp->reset();
     _mp->mr->reset();
     jc.reset();
-    _init_planner_queue(_mp, _mp->q.bf, _mp->q.queue_size); // reset planner buffers
+    _init_planner_queue(_mp, _mp->q.bf, _mp->q.queue_size, _mp->q.spline, _mp->q.spline_pool_size); // reset planner buffers
 }
 
 stat_t planner_assert(const mpPlanner_t *_mp)
@@ -260,7 +269,7 @@ void mp_halt_runtime()
  */
 
 void mp_set_planner_position(uint8_t axis, const float position) { mp->position[axis] = position; }
-void mp_set_runtime_position(uint8_t axis, const float position) { mr->position[axis] = position; }
+void mp_set_runtime_position(uint8_t axis, const float position) { mr->position[axis] = position; sr_mark_changed(SR_CHANGE_MOTION); }
 
 void mp_set_steps_to_runtime_position()
 {
@@ -329,6 +338,7 @@ static stat_t _exec_command(mpBuf_t *bf)
 stat_t mp_runtime_command(mpBuf_t *bf)
 {
     bf->cm_func(bf->unit, bf->axis_flags);          // 2 vectors used by callbacks
+    sr_mark_changed(SR_CHANGE_MODEL);               // runtime commands change modes and offsets
     if (mp_free_run_buffer()) {
         cm_cycle_end();                             // free buffer & perform cycle_end if planner is empty
     }
@@ -481,8 +491,9 @@ uint8_t mp_get_planner_buffers(const mpPlanner_t *_mp)  // which planner are you
 
 bool mp_planner_is_full(const mpPlanner_t *_mp)         // which planner are you interested in?
 {
-    // We also need to ensure we have room for another JSON command
-    return ((_mp->q.buffers_available < PLANNER_BUFFER_HEADROOM) || (jc.available == 0));
+    // We also need to ensure we have room for another JSON command and another spline
+    return ((_mp->q.buffers_available < PLANNER_BUFFER_HEADROOM) || (jc.available == 0) ||
+            ((uint8_t)(_mp->q.splines_taken - _mp->q.splines_freed) >= _mp->q.spline_pool_size));
 }
 
 bool mp_has_runnable_buffer(const mpPlanner_t *_mp)     // which planner are you interested in?)
@@ -736,6 +747,12 @@ void mp_planner_time_accounting()
  *                            Return true if queue is empty, false otherwise.
  *                            This is useful for doing queue empty / end move functions.
  *
+ *   mp_get_spline_buffer()   Take the next spline pool entry for the block being written.
+ *                            Return NULL if the pool is used up. The entry goes back to the
+ *                            pool when mp_free_run_buffer() frees the block. Blocks are freed
+ *                            in the order written, so the pool is a ring: the planner counts
+ *                            entries taken and the runtime counts entries freed.
+ *
  * UNUSED BUT PROVIDED FOR REFERENCE:
  *   mp_copy_buffer(bf,bp)    Copy the contents of bp into bf - preserves links.
  */
@@ -830,6 +847,9 @@ bool mp_free_run_buffer()           // EMPTY current run buffer & advance to the
     mpBuf_t *r_now = q->r;          // save this pointer is to avoid a race condition when clearing the buffer
 
     _audit_buffers();               // DIAGNOSTIC audit for buffer chain integrity (only runs in DEBUG mode)
+    if (r_now->path.type == PATH_SPLINE) {
+        q->splines_freed++;         // return its spline to the pool (see mp_get_spline_buffer())
+    }
     q->r = q->r->nx;                // advance to next run buffer first...
     _clear_buffer(r_now);           // ... then clear out the old buffer (& set MP_BUFFER_EMPTY)
 //    r_now->buffer_state = MP_BUFFER_EMPTY; //... then mark the buffer empty while preserving content for debug inspection
@@ -838,6 +858,18 @@ bool mp_free_run_buffer()           // EMPTY current run buffer & advance to the
     return (q->w == q->r);          // return true if the queue emptied
 }
 
+mpSpline_t * mp_get_spline_buffer()
+{
+    mpPlannerQueue_t *q = &(mp->q);
+
+    if ((uint8_t)(q->splines_taken - q->splines_freed) < q->spline_pool_size) {
+        return (&q->spline[q->splines_taken++ & (q->spline_pool_size-1)]);
+    }
+    // mp_planner_is_full() holds input back until there is a free entry, so this is a panic
+    rpt_exception(STAT_FAILED_TO_GET_PLANNER_BUFFER, "mp_get_spline_buffer()");
+    return (NULL);
+}
+
 /* UNUSED FUNCTIONS - left in for completeness and for reference
 void mp_copy_buffer(mpBuf_t *bf, const mpBuf_t *bp)
 {
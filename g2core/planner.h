@@ -77,13 +77,17 @@
  *
  * The planner is entered by calling one of:
  *  - mp_aline()         - plan and queue a move with acceleration management
+ *  - mp_arc()           - plan and queue an arc as a single move with acceleration management
+ *  - mp_spline()        - plan and queue a cubic spline (G5, G5.1) as a single move
  *  - mp_dwell()         - plan and queue a pause (dwell) to the planner queue
  *  - mp_queue_command() - queue a canned command
  *  - mp_json_command()  - queue a JSON command for run-time interpretation and execution (M100)  
  *  - mp_json_wait()     - queue a JSON wait for run-time interpretation and execution (M101)
  *  - 
- * In addition, cm_arc_feed() valaidates and sets up a arc paramewters and calls mp_aline() 
- * repeatedly to spool out the arc segments into the planner queue.
+ * In addition, cm_arc_feed() valaidates and sets up a arc paramewters and calls mp_arc(),
+ * or calls mp_aline() repeatedly to spool out the arc segments into the planner queue
+ * if arc blocks are disabled ($ab=0). cm_spline_feed() does the same for splines, which
+ * always go to mp_spline().
  *
  * All the above queueing commands other than mp_aline() are relatively trivial; they just
  * post callbacks into the next available planner buffer. Command functions are in 2 parts: 
@@ -311,6 +315,42 @@ typedef enum {                      // code blocks for planning and trapezoid ge
 
 //**** Planner Queue Structures ****
 
+typedef enum {
+    PATH_LINE = 0,                      // straight line along bf->unit
+    PATH_ARC,                           // circular arc or helix - see mp_arc()
+    PATH_SPLINE                         // cubic Bezier curve - see mp_spline()
+} mpPathType;
+
+#define SPLINE_TABLE_SIZE 16            // intervals in the arc length table of a spline
+#define SPLINE_SEARCH_STEPS 4           // refinements of t per runtime point - see _exec_path_position()
+#define ARC_STEP_CORRECTION 16          // arc segments between exact sin/cos corrections - see _exec_arc_step()
+#define ARC_STEP_MAX        0.25        // radians - an arc segment turning further gets an exact sin/cos
+
+#define SPLINE_POOL_SIZE            ((uint8_t)8)        // spline blocks the primary planner may hold. Must be a power of 2
+#define SECONDARY_SPLINE_POOL_SIZE  ((uint8_t)2)        // spline blocks the secondary planner may hold. Must be a power of 2
+
+typedef struct mpSpline {               // geometry of a spline - kept in the planner's spline pool, not in the buffer
+    float coeff[4][3];                  // XYZ = ((coeff[0]*t + coeff[1])*t + coeff[2])*t + coeff[3]
+    float table[SPLINE_TABLE_SIZE+1];   // XYZ length from the start to t = i/SPLINE_TABLE_SIZE
+} mpSpline_t;
+
+typedef struct mpPath {                 // geometry of a curved block
+    mpPathType type;                    // PATH_LINE if the block is a straight line
+    float length;                       // length of the whole block. bf->length is less once a feedhold splits it
+    float exit_unit[3];                 // XYZ unit vector at the end of the block. bf->unit is the entry
+    union {
+        struct {
+            float theta;                // arc angle at the start of the arc
+            float angular_travel;       // signed angle swept by the arc
+            float center[3];            // XYZ of the arc center at the start of the arc
+            float linear[3];            // XYZ travel of the center over the arc (helix)
+            float sin_vector[3];        // XYZ from the center per unit of sin(angle)
+            float cos_vector[3];        // XYZ from the center per unit of cos(angle)
+        } arc;
+        const mpSpline_t *spline;       // spline pool entry, held until the buffer is freed
+    };
+} mpPath_t;
+
 typedef struct mpBuffer {
 
     // *** CAUTION *** These two pointers are not reset by _clear_buffer()
@@ -367,6 +407,9 @@ typedef struct mpBuffer {
     float sqrt_j;                       // sqrt(jM) used for planning (computed and cached)
     float q_recip_2_sqrt_j;             // (q/(2 sqrt(jM))) where q = (sqrt(10)/(3^(1/4))), used in length computations (computed and cached)
 
+    mpPath_t path;                      // geometry if this block is an arc or a spline
+    cmTransform_t inverse;              // inverse of the transform the block was planned with
+
     GCodeState_t gm;                    // Gcode model state - passed from model, used by planner and runtime
 
     // clears the above structure
@@ -407,6 +450,7 @@ typedef struct mpBuffer {
         recip_jerk = 0.0;
         sqrt_j = 0.0;
         q_recip_2_sqrt_j = 0.0;
+        path.type = PATH_LINE;
         gm.reset();
     }
 } mpBuf_t;
@@ -418,6 +462,10 @@ typedef struct mpPlannerQueue {         // control structure for queue
     uint8_t queue_size;                 // total number of buffers, one-based (e.g. 48 not 47)
     uint8_t buffers_available;          // running count of available buffers in queue
     mpBuf_t *bf;                        // pointer to buffer pool (storage array)
+    mpSpline_t *spline;                 // pointer to spline pool (storage array)
+    uint8_t spline_pool_size;           // total number of spline pool entries
+    uint8_t splines_taken;              // free running count of entries taken by mp_spline()
+    uint8_t splines_freed;              // free running count of entries freed with their buffers
     magic_t magic_end;
 } mpPlannerQueue_t;
 
@@ -453,6 +501,14 @@ typedef struct mpPlannerRuntime {       // persistent runtime variables
     float target[AXES];                 // final target for bf (used to correct rounding errors)
     float position[AXES];               // current move position
     float waypoint[SECTIONS][AXES];     // head/body/tail endpoints for correction
+    cmTransform_t inverse;              // maps position back to the untransformed model - see cm_get_transform()
+
+    mpPath_t path;                      // geometry if the running block is an arc or a spline
+    float path_travel;                  // distance from the start of the path to the current position
+    float path_waypoint[SECTIONS];      // path_travel at the head/body/tail endpoints
+    float arc_sin;                      // sin and cos of the arc angle at path_travel - see _exec_arc_step()
+    float arc_cos;
+    uint8_t arc_correction_count;       // segments until the next exact sin/cos, 1 = next segment
 
     float target_steps[MOTORS];         // current MR target (absolute target as steps)
     float position_steps[MOTORS];       // current MR position (target from previous segment)
@@ -563,6 +619,8 @@ extern mpPlannerRuntime_t mr2;          // secondary planner runtime context
 
 extern mpBuf_t mp1_queue[PLANNER_QUEUE_SIZE];   // storage allocation for primary planner queue buffers
 extern mpBuf_t mp2_queue[SECONDARY_QUEUE_SIZE]; // storage allocation for secondary planner queue buffers
+extern mpSpline_t mp1_splines[SPLINE_POOL_SIZE];             // storage allocation for primary planner splines
+extern mpSpline_t mp2_splines[SECONDARY_SPLINE_POOL_SIZE];   // storage allocation for secondary planner splines
 
 /*
  * Global Scope Functions
@@ -570,7 +628,8 @@ extern mpBuf_t mp2_queue[SECONDARY_QUEUE_SIZE]; // storage allocation for second
 
 //**** planner.cpp functions
 
-void planner_init(mpPlanner_t *_mp, mpPlannerRuntime_t *_mr, mpBuf_t *queue, uint8_t queue_size);
+void planner_init(mpPlanner_t *_mp, mpPlannerRuntime_t *_mr, mpBuf_t *queue, uint8_t queue_size,
+                  mpSpline_t *splines, uint8_t spline_pool_size);
 void planner_reset(mpPlanner_t *_mp);
 stat_t planner_assert(const mpPlanner_t *_mp);
 
@@ -621,17 +680,21 @@ mpBuf_t * mp_get_write_buffer(void);
 void mp_commit_write_buffer(const blockType block_type);
 mpBuf_t * mp_get_run_buffer(void);
 bool mp_free_run_buffer(void);
+mpSpline_t * mp_get_spline_buffer(void);
 
 //**** plan_line.c functions
 void mp_zero_segment_velocity(void);                    // getters and setters...
 float mp_get_runtime_velocity(void);
 float mp_get_runtime_absolute_position(mpPlannerRuntime_t *_mr, uint8_t axis);
 float mp_get_runtime_display_position(uint8_t axis);
+void mp_get_runtime_model_position(const mpPlannerRuntime_t *_mr, float position[]);
 void mp_set_runtime_display_offset(float offset[]);
 bool mp_get_runtime_busy(void);
 bool mp_runtime_is_idle(void);
 
 stat_t mp_aline(GCodeState_t *_gm);                   // line planning...
+stat_t mp_arc(const cmArc_t *arc);                    // arc planning...
+stat_t mp_spline(GCodeState_t *_gm, const float control_1[], const float control_2[]); // spline planning...
 void mp_plan_block_list(void);
 void mp_plan_block_forward(mpBuf_t *bf);
 
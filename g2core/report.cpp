@@ -164,9 +164,34 @@ void rpt_print_system_ready_message(void)
  *      the system into text mode.
  *
  *    - Automatic status reports in text mode return CSV format according to si setting
+ *
+ *  Change tracking:
+ *
+ *      Filtered reports only poll elements whose change class has been marked dirty
+ *      since the last filtered report. Subsystems call sr_mark_changed() when their
+ *      values move: the runtime on every segment (MOTION) and every new block (MODEL),
+ *      the Gcode parser and nv_set() on every command (all classes), the temperature
+ *      and spindle code on their own changes. Machine states are assigned directly in
+ *      many places, so they are caught by comparing a packed state word at report time.
+ *      An idle machine with nothing dirty skips the report without touching the nv list.
+ *
+ *  Report scheduling:
+ *
+ *      Each change class has its own minimum interval: $sim for positions and velocity,
+ *      $sit for temperatures, and $si for everything else (which is otherwise reported
+ *      only on change). Timed requests run at the shortest of these (the scheduler tick).
+ *      Each tick packs every class that is both dirty and due into one filtered report.
+ *      Dirty classes that are not yet due stay dirty and re-arm the request for when the
+ *      earliest of them comes due, or for the next tick if that is sooner: the pending
+ *      request turns away timed requests, which would otherwise leave a faster class
+ *      marked in the meantime waiting on a slower one. Nothing is sent while the TX path
+ *      is congested.
+ *      A deadline further off than its interval is stale - the class sat idle for more
+ *      than half the SysTick range, or its interval was shortened - and counts as due.
  */
 static stat_t _populate_unfiltered_status_report(void);
-static uint8_t _populate_filtered_status_report(void);
+static uint8_t _populate_filtered_status_report(const bool *pending);
+static void _print_status_report_keys(void);
 
 uint8_t _is_stat(nvObj_t *nv)
 {
@@ -177,6 +202,56 @@ uint8_t _is_stat(nvObj_t *nv)
     return (false);
 }
 
+/*
+ * _sr_change_class() - return the srChangeClass a status report element belongs to
+ */
+static uint8_t _sr_change_class(const index_t index)
+{
+    const char *group = cfgArray[index].group;
+
+    if ((strcmp(group, "pos") == 0) || (strcmp(group, "mpo") == 0) ||
+        (strcmp(cfgArray[index].token, "vel") == 0)) {
+        return (SR_CHANGE_MOTION);
+    }
+    if ((strncmp(group, "he", 2) == 0) || (strncmp(group, "pid", 3) == 0)) {
+        return (SR_CHANGE_TEMPERATURE);
+    }
+    if (strcmp(group, "sp") == 0) {
+        return (SR_CHANGE_SPINDLE);
+    }
+    return (SR_CHANGE_MODEL);
+}
+
+/*
+ * _sr_state_word() - pack the machine states reported by stat, macs, cycs, mots and hold
+ */
+static uint32_t _sr_state_word(void)
+{
+    return ((uint32_t)cm_get_machine_state() |
+           ((uint32_t)cm_get_cycle_type() << 8) |
+           ((uint32_t)cm_get_motion_state() << 16) |
+           ((uint32_t)cm_get_hold_state() << 24));
+}
+
+/*
+ * sr_mark_changed()     - flag a class of status report values as changed
+ * sr_mark_all_changed() - flag every class as changed
+ *
+ *  Safe to call from LO interrupts: each class is a single byte store, and the
+ *  callback clears a class before polling it, so a racing mark is never lost.
+ */
+void sr_mark_changed(srChangeClass change)
+{
+    sr.changed[change] = true;
+}
+
+void sr_mark_all_changed()
+{
+    for (uint8_t i=0; i < SR_CHANGE_CLASSES; i++) {
+        sr.changed[i] = true;
+    }
+}
+
 /*
  * sr_init_status_report()
  *
@@ -203,10 +278,41 @@ void sr_init_status_report()
             rpt_exception(STAT_BAD_STATUS_REPORT_SETTING, "sr_init_status_report() encountered bad SR setting"); // trap mis-configured profile settings
             return;
         }
+        sr.status_report_class[i] = _sr_change_class(nv->value_int);
         nv_set(nv);
         nv_persist(nv);                                         // conditionally persist - automatic by nv_persist()
         nv->index++;                                            // increment SR NVM index
     }
+    sr_mark_all_changed();                                      // first filtered report polls everything
+    sr.keys_pending = true;
+}
+
+/*
+ * sr_restore_status_report() - set up SRs from the list that config_init() loaded from NVM
+ *
+ *  Returns false if no list was persisted, in which case the caller should init the defaults
+ */
+
+bool sr_restore_status_report()
+{
+    sr.status_report_request = SR_OFF;
+    sr.stat_index = nv_get_index((const char *)"", (const char *)"stat");
+    if (sr.status_report_list[0] == 0) {
+        return (false);
+    }
+    for (uint8_t i=0; i < NV_STATUS_REPORT_LEN; i++) {
+        if (sr.status_report_list[i] >= nv_index_max()) {         // stale or damaged entry - truncate the list here
+            sr.status_report_list[i] = 0;
+        }
+        if (sr.status_report_list[i] == 0) {
+            break;
+        }
+        sr.status_report_value[i] = -1234567;                   // pre-load values with an unlikely number
+        sr.status_report_class[i] = _sr_change_class(sr.status_report_list[i]);
+    }
+    sr_mark_all_changed();
+    sr.keys_pending = true;
+    return (true);
 }
 
 /*
@@ -242,7 +348,19 @@ stat_t sr_set_status_report(nvObj_t *nv)
     if (elements == 0) {
         return (STAT_INPUT_LESS_THAN_MIN_VALUE);
     }
+    nvObj_t tail;                                           // clear persisted entries past the end of the new list
+    for (uint8_t i=elements; i<NV_STATUS_REPORT_LEN; i++) {
+        tail.index = sr_start + i;
+        tail.value_int = 0;
+        tail.value_flt = 0;
+        nv_persist(&tail);
+    }
     memcpy(sr.status_report_list, status_report_list, sizeof(status_report_list));
+    for (uint8_t i=0; i<elements; i++) {
+        sr.status_report_class[i] = _sr_change_class(status_report_list[i]);
+    }
+    sr_mark_all_changed();
+    sr.keys_pending = true;
     return(_populate_unfiltered_status_report());            // return current values
 }
 
@@ -276,7 +394,7 @@ stat_t sr_request_status_report(cmStatusReportRequest request_type)
 
     } else if (request_type == SR_REQUEST_TIMED) {
         sr.status_report_request = sr.status_report_verbosity;
-        sr.status_report_systick += sr.status_report_interval;
+        sr.status_report_systick += sr.tick_interval;  // classes are held to their own rates
 
     } else {
         sr.status_report_request = SR_VERBOSE;
@@ -293,7 +411,7 @@ stat_t sr_status_report_callback()         // called by controller dispatcher
     // conditions where autogenerated SRs will not be returned
     if ((sr.status_report_request == SR_OFF) ||
         (sr.status_report_verbosity == SR_OFF) ||
-        (SysTickTimer_getValue() < sr.status_report_systick) ) {
+        ((int32_t)(SysTickTimer_getValue() - sr.status_report_systick) < 0)) {  // wrap-safe "not yet"
         return (STAT_NOOP);
     }
 
@@ -305,12 +423,58 @@ stat_t sr_status_report_callback()         // called by controller dispatcher
         sr.throttle_counter = 0;
     }
 
+    // don't add to a TX backlog - the request stays pending for the next pass
+    if (xio_tx_congested()) {
+        return (STAT_NOOP);
+    }
+
     sr.status_report_request = SR_OFF;
+    if (sr.keys_pending && (js.json_encoding == JSON_ENCODING_CBOR) && (js.json_mode == JSON_MODE)) {
+        _print_status_report_keys();
+    }
     if ((sr.status_report_request == SR_VERBOSE) ||
         (sr.status_report_verbosity == SR_VERBOSE)) {
         _populate_unfiltered_status_report();
     } else {
-        if (_populate_filtered_status_report() == false) {  // no new data
+        uint32_t state_word = _sr_state_word();     // states are not marked by their setters
+        if (state_word != sr.state_word) {
+            sr.state_word = state_word;
+            sr.changed[SR_CHANGE_MODEL] = true;
+        }
+        uint32_t now = SysTickTimer_getValue();
+        uint32_t next_due = 0;                      // earliest time a held-back class comes due...
+        bool held_back = false;                     // ...if there is one
+        bool pending[SR_CHANGE_CLASSES];
+        bool any_pending = false;
+        for (uint8_t i=0; i < SR_CHANGE_CLASSES; i++) {
+            pending[i] = false;
+            if (!sr.changed[i]) {
+                continue;
+            }
+            if (((int32_t)(now - sr.class_systick[i]) < 0) &&  // changed, but reported too recently...
+                ((int32_t)(sr.class_systick[i] - now) <= sr.class_interval[i])) {  // ...unless the deadline went stale
+                if (!held_back || ((int32_t)(sr.class_systick[i] - next_due) < 0)) {
+                    next_due = sr.class_systick[i];
+                    held_back = true;
+                }
+                continue;
+            }
+            sr.changed[i] = false;                  // clear before polling so a racing mark is kept
+            sr.class_systick[i] = now + sr.class_interval[i];
+            pending[i] = true;
+            any_pending = true;
+        }
+        if (held_back) {                            // come back for the held-back classes...
+            if ((int32_t)(next_due - (now + sr.tick_interval)) > 0) {
+                next_due = now + sr.tick_interval;  // ...or at the next tick, for a faster class marked meanwhile
+            }
+            sr.status_report_request = SR_FILTERED;
+            sr.status_report_systick = next_due;
+        }
+        if (!any_pending) {                         // nothing due - don't even reset the nv list
+            return (STAT_OK);
+        }
+        if (_populate_filtered_status_report(pending) == false) {  // no new data
             return (STAT_OK);
         }
     }
@@ -318,6 +482,31 @@ stat_t sr_status_report_callback()         // called by controller dispatcher
     return (STAT_OK);
 }
 
+/*
+ * _print_status_report_keys() - announce the SR keys before binary status reports
+ *
+ *  CBOR status reports are keyed by cfgArray index, which depends on the build.
+ *  Hosts learn the mapping from an {"srk":{"posx":<index>,...}} object sent ahead
+ *  of the first binary report and again whenever the SR list or encoding changes.
+ */
+static void _print_status_report_keys()
+{
+    nvObj_t *nv = nv_reset_nv_list();
+
+    nv->valuetype = TYPE_PARENT;
+    strcpy(nv->token, "srk");
+    for (uint8_t i=0; i<NV_STATUS_REPORT_LEN; i++) {
+        if (sr.status_report_list[i] == 0) { break;}
+        if ((nv = nv->nx) == NULL) { break;}    // more keys than list - should never happen
+        nv_reset_nv(nv);
+        strcpy(nv->token, cfgArray[sr.status_report_list[i]].token);
+        nv->value_int = sr.status_report_list[i];
+        nv->valuetype = TYPE_INTEGER;
+    }
+    json_print_object(nv_body);
+    sr.keys_pending = false;
+}
+
 /*
  * sr_run_text_status_report() - generate a text mode status report in multiline format
  */
@@ -371,8 +560,11 @@ static stat_t _populate_unfiltered_status_report()
  *
  *  NOTE: Room for improvement - look up the SR index initially and cache it, use the
  *        cached value for all remaining reports.
+ *
+ *  Only elements whose change class is set in pending[] are read; the rest are
+ *  skipped without calling their getters. The precision filter still has the last word.
  */
-static uint8_t _populate_filtered_status_report()
+static uint8_t _populate_filtered_status_report(const bool *pending)
 {
     const char sr_str[] = "sr";
     bool has_data = false;
@@ -390,9 +582,13 @@ static uint8_t _populate_filtered_status_report()
     nv = nv->nx;                                // no need to check for NULL as list has just been reset
 
     for (uint8_t i=0; i<NV_STATUS_REPORT_LEN; i++) {
-        if ((nv->index = sr.status_report_list[i]) == 0) {  // end of list
+        if (sr.status_report_list[i] == 0) {    // end of list
             break;
         }
+        if (!pending[sr.status_report_class[i]]) {  // unchanged since the last filtered report
+            continue;
+        }
+        nv->index = sr.status_report_list[i];
         nv_get_nvObj(nv);
 
         // extract the value and cast into a float, regardless of value type 
@@ -443,15 +639,36 @@ static uint8_t _populate_filtered_status_report()
  * sr_set_sv() - set status report verbosity
  * sr_get_si() - get status report interval
  * sr_set_si() - set status report interval
+ * sr_get_sim() - get minimum interval between position and velocity reports
+ * sr_set_sim() - set minimum interval between position and velocity reports
+ * sr_get_sit() - get minimum interval between temperature reports
+ * sr_set_sit() - set minimum interval between temperature reports
  */
 
+static stat_t _sr_set_intervals(const stat_t status)
+{
+    sr.class_interval[SR_CHANGE_MODEL] = sr.status_report_interval;   // on change, no faster than si
+    sr.class_interval[SR_CHANGE_SPINDLE] = sr.status_report_interval;
+    sr.tick_interval = sr.status_report_interval;
+    for (uint8_t i=0; i < SR_CHANGE_CLASSES; i++) {
+        if ((sr.class_interval[i] > 0) && (sr.class_interval[i] < sr.tick_interval)) {
+            sr.tick_interval = sr.class_interval[i];
+        }
+    }
+    return (status);
+}
+
 stat_t sr_get(nvObj_t *nv) { return (_populate_unfiltered_status_report()); }
 stat_t sr_set(nvObj_t *nv) { return (sr_set_status_report(nv)); }
 
 stat_t sr_get_sv(nvObj_t *nv) { return(get_integer(nv, (uint8_t &)sr.status_report_verbosity)); }
 stat_t sr_set_sv(nvObj_t *nv) { return(set_integer(nv, (uint8_t &)sr.status_report_verbosity, SR_OFF, SR_VERBOSE)); }
 stat_t sr_get_si(nvObj_t *nv) { return(get_integer(nv, sr.status_report_interval)); }
-stat_t sr_set_si(nvObj_t *nv) { return(set_int32(nv, sr.status_report_interval, STATUS_REPORT_MIN_MS, STATUS_REPORT_MAX_MS)); }
+stat_t sr_set_si(nvObj_t *nv) { return(_sr_set_intervals(set_int32(nv, sr.status_report_interval, STATUS_REPORT_MIN_MS, STATUS_REPORT_MAX_MS))); }
+stat_t sr_get_sim(nvObj_t *nv) { return(get_integer(nv, sr.class_interval[SR_CHANGE_MOTION])); }
+stat_t sr_set_sim(nvObj_t *nv) { return(_sr_set_intervals(set_int32(nv, sr.class_interval[SR_CHANGE_MOTION], STATUS_REPORT_RATE_MIN_MS, STATUS_REPORT_MAX_MS))); }
+stat_t sr_get_sit(nvObj_t *nv) { return(get_integer(nv, sr.class_interval[SR_CHANGE_TEMPERATURE])); }
+stat_t sr_set_sit(nvObj_t *nv) { return(_sr_set_intervals(set_int32(nv, sr.class_interval[SR_CHANGE_TEMPERATURE], STATUS_REPORT_RATE_MIN_MS, STATUS_REPORT_MAX_MS))); }
 
 /*********************
  * TEXT MODE SUPPORT *
@@ -460,10 +677,14 @@ stat_t sr_set_si(nvObj_t *nv) { return(set_int32(nv, sr.status_report_interval,
 
 static const char fmt_sv[] = "[sv]  status report verbosity%6d [0=off,1=filtered,2=verbose]\n";
 static const char fmt_si[] = "[si]  status interval%14d ms\n";
+static const char fmt_sim[] = "[sim] status motion interval%7d ms\n";
+static const char fmt_sit[] = "[sit] status temperature interval%2d ms\n";
 
 void sr_print_sr(nvObj_t *nv) { _populate_unfiltered_status_report();}
 void sr_print_sv(nvObj_t *nv) { text_print(nv, fmt_sv);}
 void sr_print_si(nvObj_t *nv) { text_print(nv, fmt_si);}
+void sr_print_sim(nvObj_t *nv) { text_print(nv, fmt_sim);}
+void sr_print_sit(nvObj_t *nv) { text_print(nv, fmt_sit);}
 
 #endif // __TEXT_MODE
 
@@ -549,6 +770,17 @@ stat_t qr_queue_report_callback()         // called by controller dispatcher
 
     char report[32];    // we know these reports can't be longer than 30 bytes
 
+    if ((js.json_encoding == JSON_ENCODING_CBOR) && (js.json_mode == JSON_MODE)) {
+        nv_reset_nv_list();                     // binary reports go through the nv list
+        nv_add_integer((const char *)"qr", qr.buffers_available);
+        if (qr.queue_report_verbosity != QR_SINGLE) {
+            nv_add_integer((const char *)"qi", qr.buffers_added);
+            nv_add_integer((const char *)"qo", qr.buffers_removed);
+        }
+        json_print_object(nv_body);
+        qr_init_queue_report();
+        return (STAT_OK);
+    }
     if (cs.comm_mode == TEXT_MODE) {
         if (qr.queue_report_verbosity == QR_SINGLE) {
             sprintf(report, "qr:%d\n", qr.buffers_available);
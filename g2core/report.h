@@ -51,6 +51,14 @@ typedef enum {
     SR_REQUEST_TIMED_FULL           // request a full status report at next timer interval (as above)
 } cmStatusReportRequest;
 
+typedef enum {                      // status report change classes - see sr_mark_changed()
+    SR_CHANGE_MOTION = 0,           // runtime positions and velocity
+    SR_CHANGE_MODEL,                // gcode model, line number, machine states, inputs and everything else
+    SR_CHANGE_TEMPERATURE,          // heater temperatures
+    SR_CHANGE_SPINDLE,              // spindle state and speed
+    SR_CHANGE_CLASSES               // count of change classes - must be last
+} srChangeClass;
+
 typedef enum {                      // planner queue enable and verbosity
     QR_OFF = 0,                     // no response is provided
     QR_SINGLE,                      // queue depth reported
@@ -70,6 +78,13 @@ typedef struct srSingleton {
     uint8_t throttle_counter;                           // slow down SRs when in a constrained time (not phat_city)
     index_t status_report_list[NV_STATUS_REPORT_LEN];   // status report elements to report
     float status_report_value[NV_STATUS_REPORT_LEN];    // previous values for filtered reporting
+    uint8_t status_report_class[NV_STATUS_REPORT_LEN];  // srChangeClass of each element - set with the list
+    volatile bool changed[SR_CHANGE_CLASSES];           // set by subsystems, cleared when the class is polled
+    uint32_t state_word;                                // packed machine states at the last filtered report
+    int32_t class_interval[SR_CHANGE_CLASSES];          // minimum ms between reports of each change class
+    uint32_t class_systick[SR_CHANGE_CLASSES];          // SysTick value when each class may be reported again
+    int32_t tick_interval;                              // shortest class interval - the scheduler tick
+    bool keys_pending;                                  // announce SR keys before the next CBOR report
 
 } srSingleton_t;
 
@@ -105,9 +120,12 @@ void rpt_print_initializing_message(void);
 void rpt_print_system_ready_message(void);
 
 void sr_init_status_report(void);
+bool sr_restore_status_report(void);
 stat_t sr_set_status_report(nvObj_t *nv);
 stat_t sr_request_status_report(cmStatusReportRequest request_type);
 stat_t sr_status_report_callback(void);
+void sr_mark_changed(srChangeClass change);
+void sr_mark_all_changed(void);
 stat_t sr_run_text_status_report(void);
 
 stat_t sr_get(nvObj_t *nv);
@@ -117,6 +135,10 @@ stat_t sr_get_sv(nvObj_t *nv);
 stat_t sr_set_sv(nvObj_t *nv);
 stat_t sr_get_si(nvObj_t *nv);
 stat_t sr_set_si(nvObj_t *nv);
+stat_t sr_get_sim(nvObj_t *nv);
+stat_t sr_set_sim(nvObj_t *nv);
+stat_t sr_get_sit(nvObj_t *nv);
+stat_t sr_set_sit(nvObj_t *nv);
 
 void qr_init_queue_report(void);
 void qr_request_queue_report(int8_t buffers);
@@ -137,6 +159,8 @@ stat_t qr_set_qv(nvObj_t *nv);
     void sr_print_sr(nvObj_t *nv);
     void sr_print_si(nvObj_t *nv);
     void sr_print_sv(nvObj_t *nv);
+    void sr_print_sim(nvObj_t *nv);
+    void sr_print_sit(nvObj_t *nv);
     void qr_print_qv(nvObj_t *nv);
     void qr_print_qr(nvObj_t *nv);
     void qr_print_qi(nvObj_t *nv);
@@ -147,6 +171,8 @@ stat_t qr_set_qv(nvObj_t *nv);
     #define sr_print_sr tx_print_stub
     #define sr_print_si tx_print_stub
     #define sr_print_sv tx_print_stub
+    #define sr_print_sim tx_print_stub
+    #define sr_print_sit tx_print_stub
     #define qr_print_qv tx_print_stub
     #define qr_print_qr tx_print_stub
     #define qr_print_qi tx_print_stub
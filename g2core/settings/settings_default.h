@@ -66,6 +66,10 @@
 #define CHORDAL_TOLERANCE           0.01    // {ct: chordal tolerance for arcs (in mm)
 #endif
 
+#ifndef ARC_BLOCK_ENABLE
+#define ARC_BLOCK_ENABLE            1       // {ab: 0=arcs as chord segments, 1=arcs as single planner blocks
+#endif
+
 #ifndef MOTOR_POWER_TIMEOUT
 #define MOTOR_POWER_TIMEOUT         2.00    // {mt:  motor power timeout in seconds
 #endif
@@ -163,6 +167,10 @@
 #define XIO_UART_MUTES_WHEN_USB_CONNECTED  0                // UART will be muted when USB connected (off by default)
 #endif
 
+#ifndef JSON_ENCODING
+#define JSON_ENCODING               JSON_ENCODING_TEXT      // {jb: JSON_ENCODING_TEXT, JSON_ENCODING_CBOR
+#endif
+
 #ifndef JSON_VERBOSITY
 #define JSON_VERBOSITY              JV_MESSAGES             // {jv: JV_SILENT, JV_FOOTER, JV_CONFIGS, JV_MESSAGES, JV_LINENUM, JV_VERBOSE
 #endif
@@ -179,10 +187,22 @@
 #define STATUS_REPORT_MIN_MS        100                     // (no JSON) milliseconds - enforces a viable minimum
 #endif
 
+#ifndef STATUS_REPORT_RATE_MIN_MS
+#define STATUS_REPORT_RATE_MIN_MS   20                      // (no JSON) fastest per-class rate (sim, sit) - 50 Hz
+#endif
+
 #ifndef STATUS_REPORT_INTERVAL_MS
 #define STATUS_REPORT_INTERVAL_MS   250                     // {si: milliseconds - set $SV=0 to disable
 #endif
 
+#ifndef STATUS_REPORT_MOTION_MS
+#define STATUS_REPORT_MOTION_MS     STATUS_REPORT_INTERVAL_MS // {sim: milliseconds between position and velocity reports
+#endif
+
+#ifndef STATUS_REPORT_TEMPERATURE_MS
+#define STATUS_REPORT_TEMPERATURE_MS 500                    // {sit: milliseconds between temperature reports
+#endif
+
 #ifndef STATUS_REPORT_DEFAULTS                              // {sr: See Status Reports wiki page
 #define STATUS_REPORT_DEFAULTS "line","posx","posy","posz","posa","feed","vel","unit","coor","dist","admo","frmo","momo","stat"
 // Alternate SRs that report in drawable units
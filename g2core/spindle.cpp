@@ -35,6 +35,7 @@
 #include "hardware.h"
 #include "settings.h"
 #include "pwm.h"
+#include "report.h"
 #include "util.h"
 
 /**** Allocate structures ****/
@@ -214,6 +215,7 @@ static void _exec_spindle_control(float *value, bool *flag)
         spindle_enable_pin.set();           // drive pin HI
     }
     pwm_set_duty(PWM_1, _get_spindle_pwm(spindle, pwm));
+    sr_mark_changed(SR_CHANGE_SPINDLE);
 
     if (spinup_delay) {
         mp_request_out_of_band_dwell(spindle.spinup_delay);
@@ -260,6 +262,7 @@ static void _exec_spindle_speed(float *value, bool *flag)
 
     spindle.speed = value[0];
     pwm_set_duty(PWM_1, _get_spindle_pwm(spindle, pwm));
+    sr_mark_changed(SR_CHANGE_SPINDLE);
 
     if (fp_ZERO(previous_speed)) {
         mp_request_out_of_band_dwell(spindle.spinup_delay);
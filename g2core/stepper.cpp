@@ -779,11 +779,14 @@ void st_prep_out_of_band_dwell(float microseconds)
  * _set_hw_microsteps() - set microsteps in hardware
  */
 
+static uint8_t _hw_microsteps[MOTORS];          // microsteps last written to the hardware
+
 static void _set_hw_microsteps(const uint8_t motor, const uint8_t microsteps)
 {
     if (motor >= MOTORS) { return; }
 
     Motors[motor]->setMicrosteps(microsteps);
+    _hw_microsteps[motor] = microsteps;
 }
 
 /***********************************************************************************
@@ -806,9 +809,8 @@ static int8_t _motor(const index_t index)
  * This function will need to be rethought if microstep morphing is implemented
  */
 
-static float _set_motor_steps_per_unit(nvObj_t *nv)
+static float _set_motor_steps_per_unit(const uint8_t m)
 {
-    uint8_t m = _motor(nv->index);
     st_cfg.mot[m].units_per_step = (st_cfg.mot[m].travel_rev * st_cfg.mot[m].step_angle) / 
                                    (360 * st_cfg.mot[m].microsteps);
 
@@ -816,6 +818,62 @@ static float _set_motor_steps_per_unit(nvObj_t *nv)
     return (st_cfg.mot[m].steps_per_unit);
 }
 
+/*
+ * _motor_changed() - recompute steps per unit (and optionally HW microsteps) after sa, tr or mi
+ * st_apply_deferred_settings() - do it once per motor once deferring ends (see nv_defer_derived())
+ *
+ *  The steps and microsteps bits are independent: su clears a pending steps recompute (its
+ *  value is exact) but a pending hardware microstep update must still be applied. After
+ *  applying, every motor touched by the transaction is checked against the state that the
+ *  same sets would have left if made one at a time: su consistent with sa/tr/mi, and the
+ *  hardware microsteps equal to mi.
+ */
+
+static uint16_t _steps_deferred = 0;            // motors awaiting recalc - one bit per motor
+static uint16_t _microsteps_deferred = 0;       // motors awaiting a hardware microstep update
+static uint16_t _motors_deferred = 0;           // motors touched while deferring (for the check)
+
+static void _motor_changed(const uint8_t m, const bool microsteps)
+{
+    if (nv_deferring_derived()) {
+        _steps_deferred |= (1 << m);
+        _motors_deferred |= (1 << m);
+        if (microsteps) {
+            _microsteps_deferred |= (1 << m);
+        }
+        return;
+    }
+    _set_motor_steps_per_unit(m);
+    if (microsteps) {
+        _set_hw_microsteps(m, st_cfg.mot[m].microsteps);
+    }
+}
+
+static bool _motor_state_differs(const uint8_t m)
+{
+    float su = (360 * st_cfg.mot[m].microsteps) / (st_cfg.mot[m].travel_rev * st_cfg.mot[m].step_angle);
+    return ((fabs(su - st_cfg.mot[m].steps_per_unit) > (su * 0.0001)) ||
+            (_hw_microsteps[m] != st_cfg.mot[m].microsteps));
+}
+
+void st_apply_deferred_settings()
+{
+    for (uint8_t m=0; m<MOTORS; m++) {
+        if (_steps_deferred & (1 << m)) {
+            _set_motor_steps_per_unit(m);
+        }
+        if (_microsteps_deferred & (1 << m)) {
+            _set_hw_microsteps(m, st_cfg.mot[m].microsteps);
+        }
+        if (_motors_deferred & (1 << m)) {
+            debug_trap_if_true(_motor_state_differs(m), "deferred motor settings differ from direct sets");
+        }
+    }
+    _steps_deferred = 0;
+    _microsteps_deferred = 0;
+    _motors_deferred = 0;
+}
+
 /* PER-MOTOR FUNCTIONS
  *
  * st_get_ma() - get motor axis mapping
@@ -882,7 +940,7 @@ stat_t st_get_sa(nvObj_t *nv) { return(get_float(nv, st_cfg.mot[_motor(nv->index
 stat_t st_set_sa(nvObj_t *nv)
 {
     ritorno(set_float_range(nv, st_cfg.mot[_motor(nv->index)].step_angle, 0.001, 360));
-    _set_motor_steps_per_unit(nv);
+    _motor_changed(_motor(nv->index), false);
     return(STAT_OK);
 }
 
@@ -891,7 +949,7 @@ stat_t st_get_tr(nvObj_t *nv) { return(get_float(nv, st_cfg.mot[_motor(nv->index
 stat_t st_set_tr(nvObj_t *nv)
 {
     ritorno(set_float_range(nv, st_cfg.mot[_motor(nv->index)].travel_rev, 0.0001, 1000000));
-    _set_motor_steps_per_unit(nv);
+    _motor_changed(_motor(nv->index), false);
     return(STAT_OK);
 }
 
@@ -910,8 +968,7 @@ stat_t st_set_mi(nvObj_t *nv)
     }
     // set it anyway, even if it's unsupported
     ritorno(set_integer(nv, st_cfg.mot[_motor(nv->index)].microsteps, 1, 255));
-    _set_motor_steps_per_unit(nv);
-    _set_hw_microsteps(_motor(nv->index), nv->value_int);
+    _motor_changed(_motor(nv->index), true);
     return (STAT_OK);
 }
 
@@ -926,7 +983,7 @@ stat_t st_set_su(nvObj_t *nv)
     // Don't set a zero or negative value - just calculate based on sa, tr, and mi
     // This way, if STEPS_PER_UNIT is set to 0 it is unused and we get the computed value
     if(nv->value_flt <= 0) {
-        nv->value_flt = _set_motor_steps_per_unit(nv);
+        nv->value_flt = _set_motor_steps_per_unit(_motor(nv->index));
         return(STAT_OK);
     }
 
@@ -944,6 +1001,8 @@ stat_t st_set_su(nvObj_t *nv)
     // You could scale any one of the other values, but TR makes the most sense
     st_cfg.mot[m].travel_rev = (360.0 * st_cfg.mot[m].microsteps) / 
                                (st_cfg.mot[m].steps_per_unit * st_cfg.mot[m].step_angle);
+    _steps_deferred &= ~(1 << m);   // su is now exact - a deferred recompute would only round it
+    _motors_deferred |= (nv_deferring_derived() ? (1 << m) : 0);  // checked by st_apply_deferred_settings()
     return(STAT_OK);
 }
 
@@ -586,6 +586,7 @@ stat_t stepper_test_assertions(void);
 bool st_runtime_isbusy(void);
 stat_t st_clc(nvObj_t *nv);
 void st_set_motor_power(const uint8_t motor);
+void st_apply_deferred_settings(void);
 stat_t st_motor_power_callback(void);
 
 void st_request_forward_plan(void);
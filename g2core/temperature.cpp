@@ -339,6 +339,9 @@ struct PID {
 
     bool _enable;                   // set true to enable this heater
 
+    float _reported[4] = {0, 0, 0, 0};  // output, P, I and D as of the last reportChanged()
+    bool _reported_at_set_point = false;
+
     PID(float P, float I, float D, float min_rise_over_time, float startSetPoint = 0.0) : _p_factor{P/100.0f}, _i_factor{I/100.0f}, _d_factor{D/100.0f}, _set_point{startSetPoint}, _at_set_point{false}, _min_rise_over_time(min_rise_over_time) {};
 
     float getNewOutput(float input) {
@@ -427,6 +430,21 @@ struct PID {
         return _at_set_point;
     }
 
+    // True if the output or any PID value a status report shows has moved since the last call
+    bool reportChanged(float output) {
+        const float now[4] = { output, _proportional, _integral, _derivative };
+        bool changed = (_at_set_point != _reported_at_set_point);
+
+        _reported_at_set_point = _at_set_point;
+        for (uint8_t i = 0; i < 4; i++) {
+            if (now[i] != _reported[i]) {
+                _reported[i] = now[i];
+                changed = true;
+            }
+        }
+        return changed;
+    }
+
 // //New-style JSON bindings. DISABLED FOR NOW.
 //    auto json_bindings(const char *object_name) {
 //        return JSON::bind_object(object_name,
@@ -522,14 +540,20 @@ void temperature_reset()
     pid3._set_point = 0.0;
 
     pid_timeout.set(100);
+    sr_mark_changed(SR_CHANGE_TEMPERATURE);
 }
 
-// Minimum difference in temp before it'll trigger an SR
+// Minimum difference in temp before it will trigger an SR. Output and PID changes always do (see reportChanged())
 const float kTempDiffSRTrigger = 0.25;
 
 stat_t temperature_callback()
 {
     if (cm->machine_state == MACHINE_ALARM) {
+        if (((float)fet_pin1 != 0.0) || ((float)fet_pin2 != 0.0) || ((float)fet_pin3 != 0.0) ||
+            (pid1._set_point != 0.0) || (pid2._set_point != 0.0) || (pid3._set_point != 0.0)) {
+            sr_mark_changed(SR_CHANGE_TEMPERATURE);     // report the heaters going off, once
+        }
+
         // Force the heaters off (redundant with the safety circuit)
         fet_pin1 = 0.0;
         fet_pin2 = 0.0;
@@ -552,6 +576,7 @@ stat_t temperature_callback()
         if (pid1._enable) {
             temp = thermistor1.temperature_exact();
             fet_pin1 = pid1.getNewOutput(temp);
+            sr_requested |= pid1.reportChanged((float)fet_pin1);
 
             if (fabs(temp - last_reported_temp1) > kTempDiffSRTrigger) {
                 last_reported_temp1 = temp;
@@ -564,6 +589,7 @@ stat_t temperature_callback()
         if (pid2._enable) {
             temp = thermistor2.temperature_exact();
             fet_pin2 = pid2.getNewOutput(temp);
+            sr_requested |= pid2.reportChanged((float)fet_pin2);
 
             if (fabs(temp - last_reported_temp2) > kTempDiffSRTrigger) {
                 last_reported_temp2 = temp;
@@ -574,6 +600,7 @@ stat_t temperature_callback()
         if (pid3._enable) {
             temp = thermistor3.temperature_exact();
             fet_pin3 = pid3.getNewOutput(temp);
+            sr_requested |= pid3.reportChanged((float)fet_pin3);
 
             if (fabs(temp - last_reported_temp3) > kTempDiffSRTrigger) {
                 last_reported_temp3 = temp;
@@ -582,6 +609,7 @@ stat_t temperature_callback()
         }
 
         if (sr_requested) {
+            sr_mark_changed(SR_CHANGE_TEMPERATURE);
             sr_request_status_report(SR_REQUEST_TIMED);
         }
     }
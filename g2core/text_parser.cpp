@@ -56,6 +56,7 @@ static stat_t _text_parser_kernal(char *str, nvObj_t *nv);
  * Use cases handled:
  *  - $xfr=1200       set a parameter (strict separators))
  *  - $xfr 1200       set a parameter (relaxed separators)
+ *  - $dump=1*        set a string parameter (the value is taken as it is, lower cased)
  *  - $xfr            display a parameter
  *  - $x              display a group
  *  - ?               generate a status report (multiline format)
@@ -89,6 +90,9 @@ stat_t text_parser(char *str)
     } else {                                    // process SET and RUN commands
         ritorno(cm_is_alarmed());               // don't process SET or RUN commands if in alarm, shutdown or panic
         status = nv_set(nv);                    // set (or run) single value
+        if (status == STAT_COMPLETE) {          // e.g. $dump=1* - the dump sends its own responses
+            return (STAT_OK);
+        }
         if (status == STAT_OK) {
             nv_persist(nv);                     // conditionally persist depending on flags in array
         }
@@ -100,6 +104,7 @@ stat_t text_parser(char *str)
 static stat_t _text_parser_kernal(char *str, nvObj_t *nv)
 {
     char *rd, *wr;                              // read and write pointers
+    char *value = NULL;                         // start of the value part, if there is one
 //  char separators[] = {"="};                  // STRICT: only separator allowed is = sign
     char separators[] = {" =:|\t"};             // RELAXED: any separator someone might use
 
@@ -120,7 +125,7 @@ static stat_t _text_parser_kernal(char *str, nvObj_t *nv)
     } else {
         *rd = NUL;                              // terminate at end of name
         strncpy(nv->token, str, TOKEN_LEN);
-        str = ++rd;
+        str = value = ++rd;
         nv->value_int = atol(str);              // collect the number as an integer
         nv->value_flt = strtof(str, &rd);       // collect the number as a float - rd used as end pointer
         if (rd != str) {
@@ -133,6 +138,10 @@ static stat_t _text_parser_kernal(char *str, nvObj_t *nv)
         return (STAT_UNRECOGNIZED_NAME);
     }
     strcpy(nv->group, cfgArray[nv->index].group); // capture the group string if there is one
+    if ((value != NULL) && ((cfgArray[nv->index].flags & F_TYPE_MASK) == TYPE_STRING)) {
+        ritorno(nv_copy_string(nv, value));     // string values aren't numbers - e.g. $dump=?vm
+        nv->valuetype = TYPE_STRING;
+    }
     nv_coerce_types(nv);                        // adjust types based on type fields in configApp table
         
     // see if you need to strip the token - but only if in text mode
@@ -160,7 +160,7 @@ float max4(float x1, float x2, float x3, float x4)
 /**** String utilities ****
  * strcpy_U()      - strcpy workalike to get around initial NUL for blank string - possibly wrong
  * isnumber()      - isdigit that also accepts plus, minus, and decimal point
- * escape_string() - add escapes to a string - currently for quotes only
+ * escape_string() - add escapes to a string - currently for quotes only. Writes at most size bytes
  */
 
 /*
@@ -182,15 +182,17 @@ uint8_t isnumber(char c)
     return (isdigit(c));
 }
 
-char *escape_string(char *dst, char *src)
+char *escape_string(char *dst, char *src, const uint16_t size)
 {
     char c;
     char *start_dst = dst;
+    char *dst_max = dst + size - 1;         // leave room for the NUL
 
     while ((c = *(src++)) != 0) {           // NUL
-        if (c == '"') { *(dst++) = '\\'; }
         if (c == 0x0d) { continue; }        // CR happens in some pathological malformed input cases
         if (c == 0x0a) { continue; }        // LF happens in some pathological malformed input cases
+        if (dst + ((c == '"') ? 2 : 1) > dst_max) { break; }   // truncate, never split an escape
+        if (c == '"') { *(dst++) = '\\'; }
         *(dst++) = c;
     }
     *dst = 0;
@@ -227,6 +229,127 @@ uint32_t SysTickTimer_getValue()
     return (SysTickTimer.getValue());
 }
 
+/******************************************
+ **** Fast ASCII to Number Conversions ****
+ ******************************************/
+
+/***********************************************************************************
+ * scan_number() - read a decimal number once, returning both its integer and float forms
+ *
+ *  Reads an optional sign, digits, an optional fraction and (if exponent is true) an optional
+ *  e/E exponent. A leading '.' is accepted ("X.5"). The exponent is left alone if exponent is
+ *  false, as E is a Gcode word letter. Returns a pointer to the first character after the
+ *  number, or str itself if there was no number there.
+ *
+ *  The digits are accumulated into an exact integer mantissa and a power of 10, and the float
+ *  is made from those with a single correctly rounded operation where that is exact:
+ *    - mantissa <= 2^24 and |exponent| <= 10: float times or divided by an exact power of 10.
+ *      This covers nearly every Gcode coordinate and JSON setting.
+ *    - mantissa <= 2^53 and |exponent| <= 22: the same in double, then narrowed to float. The
+ *      narrowing can only round wrongly if the double lands exactly on a float midpoint.
+ *  Anything else (more than 19 digits, huge exponents, that midpoint case) is handed to
+ *  strtof() over the same characters, so the float is always correctly rounded.
+ */
+
+static const float _pow10_flt[] = { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+static const double _pow10_dbl[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                     1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+static inline void _scan_digit(numberScan_t *n, const char c, const bool fraction)
+{
+    if (n->mantissa < 1000000000000000000ULL) { // 10^18 - room for one more digit
+        n->mantissa = (n->mantissa * 10) + (c - '0');
+        if (fraction) {
+            n->exponent--;
+        }
+    } else {
+        if (!fraction) {
+            n->exponent++;
+        }
+        if (c != '0') {
+            n->truncated = true;
+        }
+    }
+}
+
+static float _scan_value(const numberScan_t *n, char *start, char *end)
+{
+    int16_t e = n->exponent;
+    if (n->mantissa == 0) {
+        return (n->negative ? -0.0f : 0.0f);
+    }
+    if (!n->truncated) {
+        if ((n->mantissa <= (1UL << 24)) && (e >= -10) && (e <= 10)) {
+            float value = (float)n->mantissa;       // exact
+            value = (e < 0) ? (value / _pow10_flt[-e]) : (value * _pow10_flt[e]);
+            return (n->negative ? -value : value);
+        }
+        if ((n->mantissa <= (1ULL << 53)) && (e >= -22) && (e <= 22)) {
+            double value = (double)n->mantissa;     // exact
+            value = (e < 0) ? (value / _pow10_dbl[-e]) : (value * _pow10_dbl[e]);
+            uint64_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            if ((bits & 0x1FFFFFFF) != 0x10000000) { // not on a float midpoint - see above
+                return (n->negative ? -(float)value : (float)value);
+            }
+        }
+    }
+    char c = *end;                                  // the slow path - terminate the number...
+    *end = NUL;
+    float value = strtof(start, NULL);              //...so strtof() reads exactly what we read
+    *end = c;
+    return (value);
+}
+
+char *scan_number(char *str, numberScan_t *n, const bool exponent)
+{
+    char *start = str;
+    bool digits = false;
+    uint32_t int_part = 0;
+
+    n->mantissa = 0;
+    n->exponent = 0;
+    n->truncated = false;
+    n->negative = (*str == '-');
+    if ((*str == '-') || (*str == '+')) {
+        str++;
+    }
+    for (; isdigit(*str); str++) {
+        digits = true;
+        int_part = (int_part * 10) + (*str - '0');
+        _scan_digit(n, *str, false);
+    }
+    if (*str == '.') {
+        for (str++; isdigit(*str); str++) {
+            digits = true;
+            _scan_digit(n, *str, true);
+        }
+    }
+    if (!digits) {
+        return (start);
+    }
+    if (exponent && ((*str == 'e') || (*str == 'E'))) { // an exponent is only taken if it has digits
+        char *exp = str+1;
+        bool exp_negative = (*exp == '-');
+        if ((*exp == '-') || (*exp == '+')) {
+            exp++;
+        }
+        if (isdigit(*exp)) {
+            int16_t exp_value = 0;
+            for (; isdigit(*exp); exp++) {
+                if (exp_value < 1000) {
+                    exp_value = (exp_value * 10) + (*exp - '0');
+                }
+            }
+            n->exponent += exp_negative ? -exp_value : exp_value;
+            str = exp;
+        }
+    }
+    n->value_int = (int32_t)(n->negative ? (0 - int_part) : int_part);  // negate unsigned - int32 can't negate INT32_MIN
+    n->value = _scan_value(n, start, str);
+    return (str);
+}
+
 /******************************************
  **** Fast Number to ASCII Conversions ****
  ******************************************/
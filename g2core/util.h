@@ -93,11 +93,22 @@ float max4(float x1, float x2, float x3, float x4);
 //*** string utilities ***
 
 uint8_t isnumber(char c);
-char *escape_string(char *dst, char *src);
+char *escape_string(char *dst, char *src, const uint16_t size);
 uint16_t compute_checksum(char const *string, const uint16_t length);
 char floattoa(char *buffer, float in, int precision, int maxlen = 16);
 char inttoa(char *str, int n);
 
+typedef struct numberScan {             // a decimal number as read by scan_number()
+    uint64_t mantissa;                  // significant digits as an integer - exact to 19 digits
+    int16_t exponent;                   // power of 10 to apply to the mantissa
+    bool negative;
+    bool truncated;                     // non-zero digits past the 19th were dropped
+    int32_t value_int;                  // integer part, truncated toward zero (as atol() returns)
+    float value;                        // correctly rounded value (as strtof() returns)
+} numberScan_t;
+
+char *scan_number(char *str, numberScan_t *n, const bool exponent);
+
 //*** other utilities ***
 
 uint32_t SysTickTimer_getValue(void);
@@ -175,22 +186,6 @@ inline T avg(const T a,const T b) {return (a+b)/2; }
 #define M_SQRT3 (1.73205080756888)
 #endif
 
-// Fraction part
-constexpr float c_atof_frac_(char *&p_, float v_, float m_) {
-    return ((*p_ >= '0') && (*p_ <= '9')) ? (v_ = ((v_) + ((*p_) - '0') * m_), c_atof_frac_(++p_, v_, m_ / 10.0)) : v_;
-}
-
-// Integer part
-template <typename int_type>
-constexpr float c_atof_int_(char *&p_, int_type v_) {
-    return (*p_ == '.')
-    ? (float)(v_) + c_atof_frac_(++p_, 0, 1.0 / 10.0)
-    : (((*p_ >= '0') && (*p_ <= '9')) ? ((v_ = ((*p_) - '0') + (v_ * 10)), c_atof_int_(++p_, v_)) : v_);
-}
-
-// Start portion
-constexpr float c_atof(char *&p_) { return (*p_ == '-') ? (c_atof_int_(++p_, 0) * -1.0) : ( (*p_ == '+') ? c_atof_int_(++p_, 0) : (c_atof_int_(p_, 0))); }
-
 // It's assumed that the string buffer contains at lest count_ non-\0 chars
 //constexpr int c_strreverse(char * const t, const int count_, char hold = 0) {
 //    return count_>1 ? (hold=*t, *t=*(t+(count_-1)), *(t+(count_-1))=hold), c_strreverse(t+1, count_-2), count_ : count_;
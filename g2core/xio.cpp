@@ -166,18 +166,63 @@ struct xioDeviceWrapperBase {                // C++ base class for device primit
     virtual int16_t write(const char *buffer, int16_t len) { return -1; };
 
     virtual char *readline(devflags_t limit_flags, uint16_t &size) { return nullptr; };
+    virtual int16_t lineChecksum() { return XIO_CHECKSUM_UNKNOWN; };  // checksum of the last line read
+
+    virtual void scanRealtime() {};     // look for realtime characters - may be called from an interrupt
+    virtual void takeRealtime(char c, bool accept) {}; // act on the character scanRealtime() posted - main loop only
+    virtual void flushToRealtime() {};  // flush the read buffer up to the last posted realtime character
 
 #if MARLIN_COMPAT_ENABLED == true
     virtual void exitFakeBootloaderMode() {};
 #endif
 };
 
+/**** REALTIME CHARACTER MAILBOX ****
+ *
+ * Realtime characters (!, ~, %, ^D and ^X) are picked out of the RX buffers as soon as they
+ * arrive, from the SysTick interrupt as well as from readline(), rather than waiting for the
+ * line scanner to reach them. The character is posted to this single-slot mailbox and acted on
+ * at the top of the controller loop, so hold latency no longer depends on how much G-code is
+ * queued in front of it.
+ *
+ * The interrupt only finds and posts the character. It reads the RX buffer but never writes
+ * it, and doesn't look at machine state. The controller decides whether the character counts
+ * ('%' is only a flush in a hold) and calls xio_accept_realtime() or xio_reject_realtime(),
+ * which take it out of the buffer or hand it back to the line scan. The line scan stops at a
+ * posted character until then.
+ *
+ * Scanning stops while the slot is full, so realtime characters are delivered in the order
+ * received. 'scanning' is set while the main loop is scanning so the interrupt stays out.
+ */
+
+struct xioRealtimeMailbox {
+    volatile char c = NUL;                          // the pending realtime character, or NUL if the slot is empty
+    xioDeviceWrapperBase * volatile from = nullptr; // the device it came from
+    volatile bool scanning = false;                 // a scan is in progress
+
+    bool isEmpty() { return (c == NUL); }
+
+    void post(char realtime_char, xioDeviceWrapperBase *device) {
+        from = device;
+        c = realtime_char;
+    }
+
+    void release() {
+        from = nullptr;
+        c = NUL;
+    }
+};
+
+xioRealtimeMailbox xio_realtime;
+
 // Here we create the xio_t class, which has convenience methods to handle cross-device actions as a whole.
 struct xio_t {
     uint16_t magic_start;
 
     xioDeviceWrapperBase* DeviceWrappers[DEV_MAX];
     const uint8_t _dev_count;
+    int16_t line_checksum = XIO_CHECKSUM_UNKNOWN;   // checksum of the last line returned by readline()
+    uint32_t tx_congested_until = 0;                // SysTick value until which TX counts as congested
 
     template<typename... ds>
     xio_t(ds... args) : magic_start(MAGICNUM), DeviceWrappers {args...}, _dev_count(sizeof...(args)), magic_end(MAGICNUM) {
@@ -270,6 +315,9 @@ struct xio_t {
                 int16_t to_write = size;
                 while (to_write > 0) {
                     size_t written = DeviceWrappers[i]->write(buf, to_write);
+                    if ((int16_t)written < to_write) {   // TX buffer filled up - we're about to spin
+                        tx_congested_until = SysTickTimer_getValue() + XIO_TX_CONGESTION_MS;
+                    }
                     buf += written;
                     to_write -= written;
                     total_written += written;
@@ -366,6 +414,7 @@ struct xio_t {
 
             if (size > 0) {
                 flags = DeviceWrappers[dev]->flags;
+                line_checksum = DeviceWrappers[dev]->lineChecksum();
                 return ret_buffer;
             }
         }
@@ -380,16 +429,41 @@ struct xio_t {
 
                 if (size > 0) {
                     flags = DeviceWrappers[dev]->flags;
+                    line_checksum = DeviceWrappers[dev]->lineChecksum();
                     return ret_buffer;
                 }
             }
         }
         size = 0;
         flags = 0;
+        line_checksum = XIO_CHECKSUM_UNKNOWN;
 
         return (NULL);
     };
 
+    /*
+     * scanRealtime() - scan all devices for realtime characters. Runs from the SysTick interrupt
+     */
+    void scanRealtime()
+    {
+        if (xio_realtime.scanning) {    // the main loop is scanning - it'll pick up anything new
+            return;
+        }
+        for (int8_t i = 0; (i < _dev_count) && xio_realtime.isEmpty(); ++i) {
+            DeviceWrappers[i]->scanRealtime();
+        }
+    }
+
+    /*
+     * flushToRealtime() - flush the device that sent the pending realtime character up to that character
+     */
+    void flushToRealtime()
+    {
+        if (xio_realtime.from != nullptr) {
+            xio_realtime.from->flushToRealtime();
+        }
+    }
+
 #if MARLIN_COMPAT_ENABLED == true
     void exitFakeBootloaderMode() {
         for (int8_t i = 0; i < _dev_count; ++i) {
@@ -446,9 +520,14 @@ struct LineRXBuffer : RXBuffer<_size, owner_type, char> {
 
     uint16_t _lines_found;              // count of complete non-control lines that were found during scanning.
 
+    volatile uint16_t _realtime_offset; // offset of the next character to check for realtime characters
+    uint16_t _realtime_flush_offset;    // offset just past the last realtime character posted
+    bool     _realtime_at_start_of_line;// true if the last character checked for realtime was a line ending
+
     volatile uint16_t _last_scan_offset;  // DIAGNOSTIC
 
     bool _last_returned_a_control = false;
+    int16_t _last_line_checksum = XIO_CHECKSUM_UNKNOWN; // checksum of the line last returned by readline()
 
 #if MARLIN_COMPAT_ENABLED == true
     enum class STK500V2_State {
@@ -481,6 +560,7 @@ struct LineRXBuffer : RXBuffer<_size, owner_type, char> {
     void init() {
         parent_type::init();
         _at_start_of_line = true;
+        _realtime_at_start_of_line = true;
     };
 
 
@@ -550,12 +630,144 @@ struct LineRXBuffer : RXBuffer<_size, owner_type, char> {
 
     SkipSections _skip_sections;
 
+    /*
+     * LineChecksums - checksums of the data lines found by the scan, in order
+     *
+     * The XOR checksum of each line is accumulated a character at a time by _scanBuffer()
+     * so the G-code parser only has to compare it to the one sent after the '*'. Results
+     * are queued in the same order as the lines. If the queue fills, the remaining lines
+     * are counted as UNKNOWN (and checked by the parser) until the queue drains, so results
+     * stay matched to their lines.
+     *
+     * While the planner is full the host keeps the buffer full, and every line in it has
+     * been scanned, so the queue has room for a full buffer of 16 character lines.
+     */
+    static const uint16_t _checksum_count = _size / 16;
+    static_assert(((_checksum_count-1)&_checksum_count)==0, "_size / 16 must be 2^N");
+    static_assert(_checksum_count <= 256, "checksum queue indexes are 8 bits");
+
+    struct LineChecksums {
+        int16_t _checksums[_checksum_count];
+        uint8_t read_idx;           // index of the checksum of the next line to be read
+        uint8_t write_idx;          // index of the next checksum to populate
+        uint16_t unknown_count;     // lines after the queued ones that have no checksum recorded
+
+        uint8_t checksum;           // checksum of the line being scanned
+        bool started;               // seen the first non-whitespace character of the line
+        bool ended;                 // seen the '*' - the rest is the checksum sent with the line
+
+        bool isFull() {
+            return ((write_idx+1)&(_checksum_count-1)) == read_idx;
+        };
+        bool isEmpty() {
+            return (write_idx == read_idx);
+        };
+
+        void startLine() {
+            checksum = 0;
+            started = false;
+            ended = false;
+        };
+
+        // the same characters as _verify_checksum() in the G-code parser, which sees the line
+        // after the controller has stripped leading whitespace
+        void addChar(const char c) {
+            if (ended || (!started && ((c == ' ') || (c == '\t')))) {
+                return;
+            }
+            started = true;
+            if (c == '*') {
+                ended = true;
+            } else {
+                checksum ^= c;
+            }
+        };
+
+        void endLine(bool truncated) {
+            if ((unknown_count != 0) || isFull()) {
+                unknown_count++;
+                return;
+            }
+            _checksums[write_idx] = truncated ? XIO_CHECKSUM_UNKNOWN : (ended ? checksum : XIO_CHECKSUM_NONE);
+            write_idx = ((write_idx+1)&(_checksum_count-1));
+        };
+
+        int16_t popLine() {
+            if (isEmpty()) {
+                if (unknown_count != 0) {
+                    unknown_count--;
+                }
+                return XIO_CHECKSUM_UNKNOWN;
+            }
+            int16_t result = _checksums[read_idx];
+            read_idx = ((read_idx+1)&(_checksum_count-1));
+            return result;
+        };
+
+        void clear() {
+            read_idx = write_idx;
+            unknown_count = 0;
+        };
+    };
+
+    LineChecksums _line_checksums;
+
     uint16_t _getNextScanOffset() {
         return ((_scan_offset + 1) & (_size-1));
     }
 
+    // the line scan never passes the realtime scan, so it never sees a realtime character twice
     bool _isMoreToScan() {
-        return _canBeRead(_scan_offset);
+        return (_scan_offset != _realtime_offset);
+    };
+
+    /*
+     * _scanRealtime()
+     * _takeRealtime()
+     *
+     * _scanRealtime() checks newly arrived characters for realtime characters (see
+     * xioRealtimeMailbox). It may be called from the SysTick interrupt, so it only reads the
+     * buffer and only moves the _realtime_ members. Like the line scan, realtime characters are
+     * only recognized at the start of a line. Returns the candidate found, or NUL if none.
+     * Scanning stops on the candidate, so the line scan (which never passes _realtime_offset)
+     * waits for the controller to decide.
+     *
+     * _takeRealtime() is called from the main loop once the controller has decided. An accepted
+     * character is overwritten with a LF so the line scan sees an empty line in its place, and
+     * marks the point flushToRealtime() flushes to. A rejected one is left as data. Either way
+     * the realtime scan moves on. Nothing is done if the buffer was flushed in between.
+     */
+    char _scanRealtime() {
+        while (_canBeRead(_realtime_offset)) {
+            char c = _data[_realtime_offset];
+
+#if MARLIN_COMPAT_ENABLED == true
+            if (_stk_parser_state != STK500V2_State::Done) {    // binary stk500v2 data is left to the line scan
+                _realtime_offset = (_realtime_offset + 1) & (_size-1);
+                continue;
+            }
+#endif
+            if (_realtime_at_start_of_line && xio_is_realtime_char(c)) {
+                return c;                   // left in place for _takeRealtime()
+            }
+            _realtime_at_start_of_line = ((c == '\r') || (c == '\n'));
+            _realtime_offset = (_realtime_offset + 1) & (_size-1);
+        }
+        return NUL;
+    };
+
+    void _takeRealtime(char c, bool accept) {
+        uint16_t offset = _realtime_offset;
+        if (!_canBeRead(offset) || (_data[offset] != c)) {
+            return;
+        }
+        _realtime_offset = (offset + 1) & (_size-1);
+        if (accept) {
+            _data[offset] = '\n';
+            _realtime_flush_offset = _realtime_offset;
+        } else {
+            _realtime_at_start_of_line = false;
+        }
     };
 
     /*
@@ -723,6 +935,9 @@ struct LineRXBuffer : RXBuffer<_size, owner_type, char> {
                 else if (!_at_start_of_line) {  // We only mark ends_line for the first end-line char, and if
                     ends_line  = true;          // _at_start_of_line is already true, this is not the first.
                 }
+                else {                          // blank lines aren't part of any line, so they don't count
+                    _last_line_length = 0;      // toward the too-long limit
+                }
             }
             // prevent going further if we are ignoring
             else if (_ignore_until_next_line)
@@ -730,14 +945,7 @@ struct LineRXBuffer : RXBuffer<_size, owner_type, char> {
                 // don't do anything
             }
             // Classify the line if it's a single character 
-            else if (_at_start_of_line &&
-                ((c == '!')         ||      // feedhold
-                 (c == '~')         ||      // cycle start
-                 (c == ENQ)         ||      // request ENQ/ack
-                 (c == CHAR_RESET)  ||      // ^X - reset (aka cancel, terminate)
-                 (c == CHAR_ALARM)  ||      // ^D - request job kill (end of transmission)
-                 (c == '%' && cm_has_hold()) // flush (only in feedhold or part of control header)
-                ))
+            else if (_at_start_of_line && xio_is_control_char(c))
             {
 
                 _line_start_offset = _scan_offset;
@@ -751,8 +959,10 @@ struct LineRXBuffer : RXBuffer<_size, owner_type, char> {
                     // This is the first character at the beginning of the line.
                     _line_start_offset = _scan_offset;
                     _last_line_length = 0;
+                    _line_checksums.startLine();
                 }
                 _at_start_of_line = false;
+                _line_checksums.addChar(c);
             }
 
             // bump the _scan_offset
@@ -787,6 +997,7 @@ struct LineRXBuffer : RXBuffer<_size, owner_type, char> {
                     }
                     return true;
                 } else {                // we did find one more line, though.
+                    _line_checksums.endLine(false);
                     _lines_found++;
                 }
             } // if ends_line
@@ -794,6 +1005,7 @@ struct LineRXBuffer : RXBuffer<_size, owner_type, char> {
                 // force an end-of-line, splitting this line into two lines
                 _ignore_until_next_line = true;
                 _line_start_offset = _scan_offset;
+                _line_checksums.endLine(true);
                 _lines_found++;
             }
         } //while (_isMoreToScan())
@@ -826,6 +1038,7 @@ struct LineRXBuffer : RXBuffer<_size, owner_type, char> {
         _restartTransfer();
 
         _last_returned_a_control = found_control;
+        _last_line_checksum = XIO_CHECKSUM_UNKNOWN;
 
         char *dst_ptr = _line_buffer;
         line_size = 0;
@@ -890,7 +1103,18 @@ struct LineRXBuffer : RXBuffer<_size, owner_type, char> {
         _skip_sections.skip(_read_offset);
 
         if (_lines_found == 0) {
-            // nothing to return
+            // nothing to return - but let go of any line endings already scanned (an accepted
+            // realtime character leaves one), or a host sending only realtime characters fills
+            // the buffer with them
+            bool freed = false;
+            while ((_read_offset != _scan_offset) && ((_data[_read_offset] == '\n') || (_data[_read_offset] == '\r'))) {
+                _read_offset = (_read_offset+1)&(_size-1);
+                _skip_sections.skip(_read_offset);
+                freed = true;
+            }
+            if (freed) {
+                _restartTransfer();
+            }
             line_size = 0;
             return nullptr;
         }
@@ -938,6 +1162,7 @@ struct LineRXBuffer : RXBuffer<_size, owner_type, char> {
         }
 
         --_lines_found;
+        _last_line_checksum = _line_checksums.popLine();
 
         _restartTransfer();
 
@@ -951,6 +1176,8 @@ struct LineRXBuffer : RXBuffer<_size, owner_type, char> {
     void flush() {
         parent_type::flush();
         _scan_offset = _read_offset;
+        _realtime_offset = _read_offset;
+        _realtime_at_start_of_line = true;
 
         // This is similar to the % "queue flush" handling above, except we flush
         // the scan to the to the read (which was just set tot he write by the parent),
@@ -958,6 +1185,7 @@ struct LineRXBuffer : RXBuffer<_size, owner_type, char> {
 
         // record that we have 0 lines (of data) in the buffer
         _lines_found = 0;
+        _line_checksums.clear();
 
         // and clear out any skip sections we have
         while (!_skip_sections.isEmpty()) {
@@ -989,6 +1217,7 @@ struct LineRXBuffer : RXBuffer<_size, owner_type, char> {
 
         // record that we have 0 lines (of data) in the buffer
         _lines_found = 0;
+        _line_checksums.clear();
 
         // and clear out any skip sections we have
         while (!_skip_sections.isEmpty()) {
@@ -998,7 +1227,26 @@ struct LineRXBuffer : RXBuffer<_size, owner_type, char> {
         _last_returned_a_control = false;
 
         return true;
-    }; // flush
+    }; // flushToCommand
+
+    void flushToRealtime() {
+        // Same as flushToCommand(), but the "command" is a realtime character, which may be
+        // ahead of the line scan. Anything after it has not been line scanned, so is kept.
+        _read_offset = _realtime_flush_offset;
+        _scan_offset = _realtime_flush_offset;
+        _line_start_offset = _realtime_flush_offset;
+        _at_start_of_line = true;
+        _ignore_until_next_line = false;
+        _lines_found = 0;
+        _line_checksums.clear();
+
+        while (!_skip_sections.isEmpty()) {
+            _skip_sections.popSkip();
+        }
+
+        _last_returned_a_control = false;
+        _restartTransfer();
+    }; // flushToRealtime
 
 }; // LineRXBuffer
 
@@ -1047,7 +1295,9 @@ struct xioDeviceWrapper : xioDeviceWrapperBase {    // describes a device for re
 
     void flushRead() final {
         // Flush out any partially or wholly read lines being stored:
+        xio_realtime.scanning = true;       // keep the realtime scan out of the buffer while it's reset
         _rx_buffer.flush();
+        xio_realtime.scanning = false;
         _flushLine();
         return _dev->flushRead();
     }
@@ -1069,6 +1319,9 @@ struct xioDeviceWrapper : xioDeviceWrapperBase {    // describes a device for re
 
     virtual char *readline(devflags_t limit_flags, uint16_t &size) final {
         if ((limit_flags & flags) && isConnected()) {
+            xio_realtime.scanning = true;   // keep the interrupt out while we catch up
+            scanRealtime();
+            xio_realtime.scanning = false;
             return _rx_buffer.readline(!(limit_flags & DEV_IS_DATA), size);
         }
 
@@ -1076,6 +1329,28 @@ struct xioDeviceWrapper : xioDeviceWrapperBase {    // describes a device for re
         return NULL;
     };
 
+    int16_t lineChecksum() final {
+        return _rx_buffer._last_line_checksum;
+    };
+
+    void scanRealtime() final {
+        if (!isConnected() || !xio_realtime.isEmpty()) {
+            return;
+        }
+        char c = _rx_buffer._scanRealtime();
+        if (c != NUL) {
+            xio_realtime.post(c, this);
+        }
+    };
+
+    void takeRealtime(char c, bool accept) final {
+        _rx_buffer._takeRealtime(c, accept);
+    };
+
+    void flushToRealtime() final {
+        _rx_buffer.flushToRealtime();
+    };
+
     void connectedStateChanged(bool connected) {
         if (connected) {
             if (isNotConnected()) {
@@ -1193,18 +1468,19 @@ struct xioDeviceWrapper : xioDeviceWrapperBase {    // describes a device for re
 };
 
 
-// Specialization for xio_flash_file -- we don't need most of the structure around a Device for xio_flash_file
+// Specialization for xio_file -- we don't need most of the structure around a Device for xio_file
+// This serves both compiled-in xio_flash_files and block-buffered xio_block_files (SD card, etc.)
 template<uint16_t _line_buffer_size = 512>
 struct xioFlashFileDeviceWrapper : xioDeviceWrapperBase {    // describes a device for reading and writing
-    xio_flash_file *_current_file = nullptr;
+    xio_file *_current_file = nullptr;
 
-    char _line_buffer[_line_buffer_size]; // hold exactly one line to return -- flash files are read-only, so we copy it
+    char _line_buffer[_line_buffer_size]; // hold exactly one line to return -- files are read-only, so we copy it
 
     xioFlashFileDeviceWrapper() : xioDeviceWrapperBase(DEV_CAN_READ | DEV_IS_ALWAYS_BOTH)
     {
     };
 
-    bool sendFile(xio_flash_file &new_file) {
+    bool sendFile(xio_file &new_file) {
         if (nullptr != _current_file) {
             return false; // we're still sending a file
         }
@@ -1247,12 +1523,14 @@ struct xioFlashFileDeviceWrapper : xioDeviceWrapperBase {    // describes a devi
         }
 
         const char *from = _current_file->readline(!(limit_flags & DEV_IS_DATA), line_size);
-        if ((nullptr == from) && (_current_file->isDone())) {
-            // all done sending this file, "close" it
-            _current_file = nullptr;
-            cs.responses_suppressed = false;
-            clearActive();
-            return nullptr;
+        if (nullptr == from) {
+            if (_current_file->isDone()) {
+                // all done sending this file, "close" it
+                _current_file = nullptr;
+                cs.responses_suppressed = false;
+                clearActive();
+            }
+            return nullptr;     // otherwise the next line is still being read from the source
         }
         char *dst_ptr = _line_buffer;
 
@@ -1313,6 +1591,11 @@ xio_t xio = {
 #endif
 };
 
+// SysTickEvent for realtime character scanning (see xioRealtimeMailbox)
+Motate::SysTickEvent xio_realtime_systick_event {[&] {
+    xio.scanRealtime();
+}, nullptr};
+
 /**** CODE ****/
 
 /*
@@ -1341,6 +1624,8 @@ void xio_init()
 #if XIO_HAS_UART == 1
     serial0Wrapper.init();
 #endif
+
+    SysTickTimer.registerEvent(&xio_realtime_systick_event);
 }
 
 stat_t xio_test_assertions()
@@ -1360,6 +1645,20 @@ size_t xio_write(const char *buffer, size_t size, bool only_to_muted /*= false*/
     return xio.write(buffer, size, only_to_muted);
 }
 
+/*
+ * xio_tx_congested() - true if a write recently had to wait for TX buffer space
+ *
+ *  Lets optional output such as status reports stand back while the host is slow to drain.
+ *  A window that ends further off than XIO_TX_CONGESTION_MS was set more than half the
+ *  SysTick range ago, and has long since ended.
+ */
+
+bool xio_tx_congested()
+{
+    int32_t remaining = (int32_t)(xio.tx_congested_until - SysTickTimer_getValue());  // wrap-safe "until"
+    return ((remaining > 0) && (remaining <= XIO_TX_CONGESTION_MS));
+}
+
 /*
  * xio_readline() - read a complete line from a device
  * xio_writeline() - write a complete line to control device
@@ -1372,6 +1671,19 @@ char *xio_readline(devflags_t &flags, uint16_t &size)
     return xio.readline(flags, size);
 }
 
+/*
+ * xio_get_line_checksum() - checksum of the line last returned by xio_readline()
+ *
+ *  Returns the XOR checksum computed while the line was scanned in the RX buffer,
+ *  XIO_CHECKSUM_NONE if the line carried no checksum, or XIO_CHECKSUM_UNKNOWN if
+ *  the device didn't compute one (the line must then be checked by the caller).
+ */
+
+int16_t xio_get_line_checksum()
+{
+    return xio.line_checksum;
+}
+
 int16_t xio_writeline(const char *buffer, bool only_to_muted /*= false*/)
 {
     return xio.writeline(buffer, only_to_muted);
@@ -1387,13 +1699,21 @@ bool xio_connected()
 }
 
 /*
- * xio_send_file() - send the contents of a xio_flash_file - returns false if there's already one sending
+ * xio_send_file() - send the contents of a xio_file - returns false if there's already one sending
  */
 
-bool xio_send_file(xio_flash_file &file) {
+bool xio_send_file(xio_file &file) {
     return flashFileWrapper.sendFile(file);
 }
 
+/*
+ * xio_file_is_sending() - true while a xio_file is being sent
+ */
+
+bool xio_file_is_sending() {
+    return (nullptr != flashFileWrapper._current_file);
+}
+
 /*
  * xio_flush_to_command() - clear the last read channel up until the command that was read
  */
@@ -1402,6 +1722,39 @@ void xio_flush_to_command() {
     return xio.flushToCommand();
 }
 
+/*
+ * xio_get_realtime()       - return the pending realtime character, or NUL if there is none
+ * xio_accept_realtime()    - the pending character is a realtime command - take it out of the RX buffer
+ * xio_reject_realtime()    - the pending character is data - leave it to the line scan and free the mailbox
+ * xio_flush_to_realtime()  - clear the channel that sent the pending realtime character up to it
+ * xio_release_realtime()   - done with the pending realtime character - free the mailbox for the next
+ */
+
+char xio_get_realtime() {
+    return xio_realtime.c;
+}
+
+void xio_accept_realtime() {
+    if (xio_realtime.from != nullptr) {
+        xio_realtime.from->takeRealtime(xio_realtime.c, true);
+    }
+}
+
+void xio_reject_realtime() {
+    if (xio_realtime.from != nullptr) {
+        xio_realtime.from->takeRealtime(xio_realtime.c, false);
+    }
+    xio_realtime.release();
+}
+
+void xio_flush_to_realtime() {
+    return xio.flushToRealtime();
+}
+
+void xio_release_realtime() {
+    return xio_realtime.release();
+}
+
 #if MARLIN_COMPAT_ENABLED == true
 /*
  * xio_end_fake_bootloader() - end the fake bootloader mode
@@ -111,6 +111,13 @@ enum xioSPIMode {
 
 #define RX_BUFFER_SIZE       512            // maximum length of recieved lines from xio_readline
 
+// Line checksums are computed as the RX buffer is scanned. xio_get_line_checksum() returns the XOR
+// checksum of the text of the last line read (up to the '*') or one of these:
+#define XIO_CHECKSUM_NONE    -1             // the line has no '*' checksum
+#define XIO_CHECKSUM_UNKNOWN -2             // not computed by the device - check the line text instead
+
+#define XIO_TX_CONGESTION_MS 50             // TX counts as congested this long after a write had to wait
+
 /**** function prototypes ****/
 
 void xio_init(void);
@@ -118,9 +125,16 @@ stat_t xio_test_assertions(void);
 
 size_t xio_write(const char *buffer, size_t size, bool only_to_muted = false);
 char *xio_readline(devflags_t &flags, uint16_t &size);
+int16_t xio_get_line_checksum();
 int16_t xio_writeline(const char *buffer, bool only_to_muted = false);
+bool xio_tx_congested();
 bool xio_connected();
 void xio_flush_to_command();
+char xio_get_realtime();
+void xio_accept_realtime();
+void xio_reject_realtime();
+void xio_flush_to_realtime();
+void xio_release_realtime();
 #if MARLIN_COMPAT_ENABLED == true
 void xio_exit_fake_bootloader();
 #endif
@@ -164,9 +178,49 @@ extern "C" {
 #define CHAR_CYCLE_START (char)'~'  // Feedhold Exit and Resume
 #define CHAR_QUEUE_FLUSH (char)'%'  // Feedhold Exit and Flush  
 
+/**** xio_is_control_char() - true if c is a single-character control that may start a line ****/
+
+inline bool xio_is_control_char(const char c) {
+    return ((c == CHAR_FEEDHOLD)    ||
+            (c == CHAR_CYCLE_START) ||
+            (c == ENQ)              ||      // request ENQ/ack
+            (c == CHAR_RESET)       ||      // ^X - reset (aka cancel, terminate)
+            (c == CHAR_ALARM)       ||      // ^D - request job kill (end of transmission)
+            (c == CHAR_QUEUE_FLUSH && cm_has_hold()));  // flush (only in feedhold or part of control header)
+}
+
+/**** xio_is_realtime_char() - true if c is a candidate realtime character (interrupt safe) ****/
+/*
+ *  Unlike xio_is_control_char() this doesn't look at machine state: '%' is always a candidate,
+ *  and the controller decides whether it is a flush or data (see _dispatch_realtime()).
+ */
+
+inline bool xio_is_realtime_char(const char c) {
+    return ((c == CHAR_FEEDHOLD)    ||
+            (c == CHAR_CYCLE_START) ||
+            (c == CHAR_RESET)       ||
+            (c == CHAR_ALARM)       ||
+            (c == CHAR_QUEUE_FLUSH));
+}
+
+/**** xio_file - base object for read-only "files" sent through the DEV_FLASH_FILE device ****/
+/*
+ *  readline() returns a pointer to the next line (not NUL terminated) and its size, or nullptr
+ *  if no line is available right now. If control_only is true a line is only returned if it
+ *  starts with a single-character control. isDone() returns true once the file is exhausted.
+ *
+ *  Don't use pure virtuals! They massively slow down the calls. But these MUST be overridden!
+ */
+
+struct xio_file {
+    virtual void reset() {};
+    virtual const char *readline(bool control_only, uint16_t &line_size) { line_size = 0; return nullptr; };
+    virtual bool isDone() { return true; };
+};
+
 /**** xio_flash_file - object to hold in-flash (compiled-in) "files" to run ****/
 
-struct xio_flash_file {
+struct xio_flash_file : xio_file {
     const char * const _data;
     const int32_t _length;
 
@@ -174,27 +228,16 @@ struct xio_flash_file {
 
     xio_flash_file(const char * const data, int32_t length) : _data{data}, _length{length} {};
 
-    void reset() {
+    void reset() override {
         _read_offset = 0;
     };
 
-    const char *readline(bool control_only, uint16_t &line_size) {
+    const char *readline(bool control_only, uint16_t &line_size) override {
         line_size = 0;
         if (_read_offset == _length) { return nullptr; }
 
-        if (control_only) {
-            char c = _data[_read_offset];
-            if (!
-                ((c == '!')         ||
-                 (c == '~')         ||
-                 (c == ENQ)         ||        // request ENQ/ack
-                 (c == CHAR_RESET)  ||        // ^X - reset (aka cancel, terminate)
-                 (c == CHAR_ALARM)  ||        // ^D - request job kill (end of transmission)
-                 (c == '%' && cm_has_hold())  // flush (only in feedhold or part of control header)
-                ))
-            {
-                return nullptr;
-            }
+        if (control_only && !xio_is_control_char(_data[_read_offset])) {
+            return nullptr;
         }
 
         const char *line_start = _data + _read_offset;
@@ -212,7 +255,7 @@ struct xio_flash_file {
         return line_start;
     };
 
-    bool isDone() {
+    bool isDone() override {
         return _read_offset == _length;
     }
 };
@@ -224,9 +267,192 @@ constexpr xio_flash_file make_xio_flash_file(const char (&data)[length]) {
     return {data, length};
 }
 
+/**** xio_block_source - block storage behind a xio_block_file (SD card, host file, memory) ****/
+/*
+ *  startRead() starts a read of up to length bytes from offset into buffer, and returns false
+ *  if the read could not be started. Only one read is outstanding at a time. readResult()
+ *  returns -1 while that read is in flight, otherwise the number of bytes read. A result
+ *  shorter than the request marks the end of the file.
+ *
+ *  Sources backed by DMA (e.g. an SD card) complete the read in the background. Synchronous
+ *  sources simply complete it inside startRead().
+ */
+
+struct xio_block_source {
+    virtual void reset() {};
+    virtual bool startRead(char *buffer, uint32_t offset, uint16_t length) { return false; };
+    virtual int32_t readResult() { return 0; };
+};
+
+/**** xio_memory_block_source - block source over a memory region (mmap'd file, RAM or flash image) ****/
+
+struct xio_memory_block_source : xio_block_source {
+    const char *_data;
+    uint32_t _length;
+    int32_t _result = 0;
+
+    xio_memory_block_source(const char *data, uint32_t length) : _data{data}, _length{length} {};
+
+    bool startRead(char *buffer, uint32_t offset, uint16_t length) override {
+        if (offset > _length) {
+            offset = _length;
+        }
+        _result = std::min((uint32_t)length, _length - offset);
+        memcpy(buffer, _data + offset, _result);
+        return true;
+    };
+
+    int32_t readResult() override {
+        return _result;
+    };
+};
+
+/**** xio_block_file - double-buffered, line-oriented reader over a xio_block_source ****/
+/*
+ *  Two block buffers are used in rotation. While lines are being read out of one block the
+ *  other is being filled by the source, so a DMA-capable source keeps reading ahead of the
+ *  parser. Lines may span block boundaries, so they are assembled in _line_buffer, which also
+ *  lets a line be left half-built while waiting on a read. CR, LF and CRLF all end a line,
+ *  blank lines are skipped and over-long lines are truncated. Control characters are
+ *  filtered the same way as xio_flash_file.
+ */
+
+template <uint16_t _block_size = 512, uint16_t _line_buffer_size = RX_BUFFER_SIZE>
+struct xio_block_file : xio_file {
+    enum class BlockState : uint8_t {
+        Empty,                              // consumed, or not yet requested
+        Pending,                            // read started, waiting on the source
+        Full                                // holding data to be consumed
+    };
+
+    struct Block {
+        char data[_block_size];
+        uint16_t length;                    // valid characters in data
+        BlockState state;
+    };
+
+    xio_block_source &_source;
+    Block _blocks[2];
+
+    uint8_t  _read_block;                   // index of the block being consumed
+    uint16_t _read_offset;                  // offset of the next character in the block being consumed
+    uint8_t  _fill_block;                   // index of the next block to be filled
+    uint32_t _file_offset;                  // offset in the file of the next block to request
+    bool     _source_eof;                   // the source returned a short block - nothing more to request
+
+    char _line_buffer[_line_buffer_size];   // line assembly buffer
+    uint16_t _line_size;                    // characters of the current line assembled so far
+
+    xio_block_file(xio_block_source &source) : _source{source} {
+        reset();
+    };
+
+    void reset() override {
+        _source.reset();
+        for (auto &block : _blocks) {
+            block.length = 0;
+            block.state = BlockState::Empty;
+        }
+        _read_block = 0;
+        _read_offset = 0;
+        _fill_block = 0;
+        _file_offset = 0;
+        _source_eof = false;
+        _line_size = 0;
+        _readAhead();
+    };
+
+    // collect a completed read and start the next one into whichever buffer is free
+    void _readAhead() {
+        while (true) {
+            Block &block = _blocks[_fill_block];
+            if (block.state == BlockState::Pending) {
+                int32_t result = _source.readResult();
+                if (result < 0) {
+                    return;                                 // still in flight
+                }
+                block.length = result;
+                block.state = BlockState::Full;
+                _file_offset += result;
+                if (result < _block_size) {
+                    _source_eof = true;
+                }
+                _fill_block ^= 1;
+                continue;
+            }
+            if (_source_eof || (block.state != BlockState::Empty)) {
+                return;
+            }
+            if (!_source.startRead(block.data, _file_offset, _block_size)) {
+                _source_eof = true;                         // treat a failed read as the end of the file
+                return;
+            }
+            block.state = BlockState::Pending;
+        }
+    };
+
+    // returns the next character without consuming it, -1 if it hasn't arrived yet, or -2 at end of file
+    int16_t _peek() {
+        _readAhead();
+        Block *block = &_blocks[_read_block];
+        while ((block->state == BlockState::Full) && (_read_offset == block->length)) {
+            block->state = BlockState::Empty;               // this block is used up, hand it back for filling
+            _read_offset = 0;
+            _read_block ^= 1;
+            _readAhead();
+            block = &_blocks[_read_block];
+        }
+        if (block->state == BlockState::Full) {
+            return (uint8_t)block->data[_read_offset];
+        }
+        if (_source_eof && (block->state == BlockState::Empty)) {
+            return -2;
+        }
+        return -1;
+    };
+
+    const char *_finishLine(uint16_t &line_size) {
+        line_size = _line_size;
+        _line_size = 0;
+        return _line_buffer;
+    };
+
+    const char *readline(bool control_only, uint16_t &line_size) override {
+        line_size = 0;
+        int16_t c = _peek();
+
+        if (control_only && ((_line_size != 0) || (c < 0) || !xio_is_control_char(c))) {
+            return nullptr;
+        }
+
+        while (c >= 0) {
+            _read_offset++;
+            if ((c == '\r') || (c == '\n')) {
+                if (_line_size != 0) {
+                    return _finishLine(line_size);
+                }
+                // blank line, or the second half of a CRLF
+            } else if (_line_size < _line_buffer_size) {
+                _line_buffer[_line_size++] = c;
+            }
+            c = _peek();
+        }
+
+        if ((c == -2) && (_line_size != 0)) {               // the last line had no line ending
+            return _finishLine(line_size);
+        }
+        return nullptr;
+    };
+
+    bool isDone() override {
+        return ((_line_size == 0) && (_peek() == -2));
+    };
+};
+
 /**** function prototype for file-sending ****/
 
-bool xio_send_file(xio_flash_file &file);
+bool xio_send_file(xio_file &file);
+bool xio_file_is_sending();
 
 #ifdef __TEXT_MODE
 